@@ -0,0 +1,164 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Helpers shared by the benchmark programs. Each program runs both ends over loopback in one process, one context per
+// end, and prints every result as a JSON object on a line of its own so runs of two builds can be diffed or loaded
+// into any tool. Pass --label to tag the results of a build. Build each program together with the library sources, the
+// same way as main.c.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "nex.h"
+
+#define BENCH_TIMEOUT_MS 10000
+
+static inline int benchArgInt(int argc, char **argv, const char *name, int fallback)
+{
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (strcmp(argv[i], name) == 0)
+    {
+      return atoi(argv[i + 1]);
+    }
+  }
+  return fallback;
+}
+
+static inline const char *benchArgString(int argc, char **argv, const char *name, const char *fallback)
+{
+  for (int i = 1; i + 1 < argc; i++)
+  {
+    if (strcmp(argv[i], name) == 0)
+    {
+      return argv[i + 1];
+    }
+  }
+  return fallback;
+}
+
+static inline int benchHasFlag(int argc, char **argv, const char *name)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], name) == 0)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Stream transport picked with --local or --shm, TCP otherwise, and its name in the results.
+static inline ConnectionType benchTransport(int argc, char **argv)
+{
+  if (benchHasFlag(argc, argv, "--shm"))
+  {
+    return CONNECTION_SHARED_MEMORY;
+  }
+  return benchHasFlag(argc, argv, "--local") ? CONNECTION_LOCAL : CONNECTION_TCP;
+}
+
+static inline const char *benchTransportName(ConnectionType transport)
+{
+  return transport == CONNECTION_SHARED_MEMORY ? "shm" : transport == CONNECTION_LOCAL ? "local" : "tcp";
+}
+
+// Waits until a counter bumped by the library threads reaches target. Returns 0 on timeout.
+static inline int benchWaitFor(uint64_t *counter, uint64_t target, int timeoutMs)
+{
+  uint64_t deadline = monotonicMilliseconds() + (uint64_t)timeoutMs;
+  while (ATOMIC_LOAD(counter) < target)
+  {
+    if (monotonicMilliseconds() >= deadline)
+    {
+      return 0;
+    }
+    sleepMilliseconds(1);
+  }
+  return 1;
+}
+
+// Counter that a library thread bumps and the benchmark thread blocks on, for waits too short to poll for.
+typedef struct
+{
+  uint64_t value;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+} BenchCounter;
+
+#define BENCH_COUNTER_INITIALIZER {0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER}
+
+static inline void benchSignal(BenchCounter *counter)
+{
+  pthread_mutex_lock(&counter->lock);
+  counter->value++;
+  pthread_cond_broadcast(&counter->changed);
+  pthread_mutex_unlock(&counter->lock);
+}
+
+static inline void benchAwait(BenchCounter *counter, uint64_t target)
+{
+  pthread_mutex_lock(&counter->lock);
+  while (counter->value < target)
+  {
+    pthread_cond_wait(&counter->changed, &counter->lock);
+  }
+  pthread_mutex_unlock(&counter->lock);
+}
+
+static inline int benchCompare(const void *a, const void *b)
+{
+  uint64_t left = *(const uint64_t *)a;
+  uint64_t right = *(const uint64_t *)b;
+  return left < right ? -1 : left > right;
+}
+
+// Sorts samples in place and returns the value below which the fraction q of them fall.
+static inline uint64_t benchPercentile(uint64_t *samples, size_t count, double q)
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  qsort(samples, count, sizeof(uint64_t), benchCompare);
+  size_t index = (size_t)(q * (double)count);
+  return samples[index < count ? index : count - 1];
+}
+
+static inline double benchMean(const uint64_t *samples, size_t count)
+{
+  double sum = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    sum += (double)samples[i];
+  }
+  return count > 0 ? sum / (double)count : 0;
+}
+
+// Payload of the given size, filled so that it is a valid C string of exactly size bytes.
+static inline char *benchPayload(size_t size)
+{
+  char *payload = (char *)malloc(size + 1);
+  if (payload == NULL)
+  {
+    return NULL;
+  }
+  for (size_t i = 0; i < size; i++)
+  {
+    payload[i] = (char)('a' + i % 26);
+  }
+  payload[size] = '\0';
+  return payload;
+}
+
+static inline void benchFail(NexContext *ctx, const char *step)
+{
+  fprintf(stderr, "%s failed: %s\n", step, ctx ? getLastErrorCtx(ctx) : getLastError());
+  exit(1);
+}
+
+#endif
@@ -0,0 +1,122 @@
+// Round trip latency of an echo over TCP, a Unix domain socket with --local or shared memory rings with --shm: the
+// client sends a string, the server sends it straight back, and the client waits for it before sending the next one.
+//
+// Usage: echoLatency [--port 9500] [--count 20000] [--warmup 1000] [--size 32] [--nodelay] [--local | --shm] [--label name]
+
+#include "bench.h"
+
+static uint64_t connected = 0;
+static BenchCounter replies = BENCH_COUNTER_INITIALIZER;
+
+static void onClientData(Data data, socket_t client)
+{
+  if (data.type == TYPE_STRING)
+  {
+    sendToClientCtx(getCurrentContext(), data, client);
+  }
+}
+
+static void onServerData(Data data)
+{
+  if (data.type == TYPE_CONNECTED)
+  {
+    ATOMIC_ADD(&connected, 1);
+  }
+  else if (data.type == TYPE_STRING)
+  {
+    benchSignal(&replies);
+  }
+}
+
+static int roundTrip(NexContext *client, Data data, uint64_t expected)
+{
+  if (sendToServerCtx(client, data) != NETWORK_OK)
+  {
+    return 0;
+  }
+
+  benchAwait(&replies, expected);
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  int port = benchArgInt(argc, argv, "--port", 9500);
+  int count = benchArgInt(argc, argv, "--count", 20000);
+  int warmup = benchArgInt(argc, argv, "--warmup", 1000);
+  int size = benchArgInt(argc, argv, "--size", 32);
+  bool noDelay = benchHasFlag(argc, argv, "--nodelay");
+  ConnectionType transport = benchTransport(argc, argv);
+  const char *label = benchArgString(argc, argv, "--label", "");
+
+  NexContext *server;
+  NexContext *client;
+  if (createContext(&server, transport, Server) != NETWORK_OK || createContext(&client, transport, Client) != NETWORK_OK)
+  {
+    benchFail(NULL, "createContext");
+  }
+
+  SocketOptions options;
+  memset(&options, 0, sizeof(options));
+  options.noDelay = noDelay;
+  if (startServerWithOptionsCtx(server, port, 1, onClientData, &options) != NETWORK_OK)
+  {
+    benchFail(server, "startServer");
+  }
+  if (connectToServerWithOptionsCtx(client, "127.0.0.1", port, onServerData, &options) != NETWORK_OK)
+  {
+    benchFail(client, "connectToServer");
+  }
+  if (!benchWaitFor(&connected, 1, BENCH_TIMEOUT_MS))
+  {
+    benchFail(client, "connect");
+  }
+
+  char *payload = benchPayload((size_t)size);
+  uint64_t *samples = (uint64_t *)malloc((size_t)count * sizeof(uint64_t));
+  if (payload == NULL || samples == NULL)
+  {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  Data data;
+  data.type = TYPE_STRING;
+  data.data.s = payload;
+
+  uint64_t sent = 0;
+  for (int i = 0; i < warmup; i++)
+  {
+    if (!roundTrip(client, data, ++sent))
+    {
+      benchFail(client, "sendToServer");
+    }
+  }
+
+  uint64_t started = monotonicMicroseconds();
+  for (int i = 0; i < count; i++)
+  {
+    uint64_t before = monotonicMicroseconds();
+    if (!roundTrip(client, data, ++sent))
+    {
+      benchFail(client, "sendToServer");
+    }
+    samples[i] = monotonicMicroseconds() - before;
+  }
+  double seconds = (double)(monotonicMicroseconds() - started) / 1e6;
+
+  double mean = benchMean(samples, (size_t)count);
+  uint64_t p50 = benchPercentile(samples, (size_t)count, 0.5);
+  uint64_t p99 = benchPercentile(samples, (size_t)count, 0.99);
+  uint64_t p999 = benchPercentile(samples, (size_t)count, 0.999);
+  printf("{\"benchmark\":\"echo_latency\",\"label\":\"%s\",\"transport\":\"%s\",\"payload_bytes\":%d,\"no_delay\":%s,\"round_trips\":%d,"
+         "\"round_trips_per_sec\":%.0f,\"mean_us\":%.1f,\"p50_us\":%llu,\"p99_us\":%llu,\"p999_us\":%llu,\"max_us\":%llu}\n",
+         label, benchTransportName(transport), size, noDelay ? "true" : "false", count, count / seconds, mean,
+         (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999, (unsigned long long)samples[count - 1]);
+
+  destroyContext(client);
+  destroyContext(server);
+  free(samples);
+  free(payload);
+  return 0;
+}
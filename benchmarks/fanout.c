@@ -0,0 +1,111 @@
+// Broadcast fan-out: the server sends one message to every connected client with sendToAllClients, and the sample is
+// the time until the last client callback has it. Clients are added in steps of powers of two up to --max-clients,
+// each on its own context.
+//
+// Usage: fanout [--port 9520] [--max-clients 64] [--rounds 500] [--size 64] [--label name]
+
+#include "bench.h"
+
+static uint64_t connected = 0;
+static BenchCounter delivered = BENCH_COUNTER_INITIALIZER;
+
+static void onClientData(Data data, socket_t client)
+{
+  (void)client;
+  if (data.type == TYPE_CONNECTED)
+  {
+    ATOMIC_ADD(&connected, 1);
+  }
+}
+
+static void onServerData(Data data)
+{
+  if (data.type == TYPE_STRING)
+  {
+    benchSignal(&delivered);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int port = benchArgInt(argc, argv, "--port", 9520);
+  int maxClients = benchArgInt(argc, argv, "--max-clients", 64);
+  int rounds = benchArgInt(argc, argv, "--rounds", 500);
+  int size = benchArgInt(argc, argv, "--size", 64);
+  const char *label = benchArgString(argc, argv, "--label", "");
+
+  NexContext *server;
+  if (createContext(&server, CONNECTION_TCP, Server) != NETWORK_OK)
+  {
+    benchFail(NULL, "createContext");
+  }
+  if (startServerCtx(server, port, maxClients, onClientData) != NETWORK_OK)
+  {
+    benchFail(server, "startServer");
+  }
+
+  NexContext **clients = (NexContext **)calloc((size_t)maxClients, sizeof(NexContext *));
+  uint64_t *samples = (uint64_t *)malloc((size_t)rounds * sizeof(uint64_t));
+  char *payload = benchPayload((size_t)size);
+  if (clients == NULL || samples == NULL || payload == NULL)
+  {
+    fprintf(stderr, "Out of memory\n");
+    return 1;
+  }
+
+  Data data;
+  data.type = TYPE_STRING;
+  data.data.s = payload;
+
+  int clientCount = 0;
+  uint64_t expected = 0;
+  for (int step = 1; step <= maxClients; step *= 2)
+  {
+    for (; clientCount < step; clientCount++)
+    {
+      if (createContext(&clients[clientCount], CONNECTION_TCP, Client) != NETWORK_OK)
+      {
+        benchFail(NULL, "createContext");
+      }
+      if (connectToServerCtx(clients[clientCount], "127.0.0.1", port, onServerData) != NETWORK_OK)
+      {
+        benchFail(clients[clientCount], "connectToServer");
+      }
+    }
+    if (!benchWaitFor(&connected, (uint64_t)clientCount, BENCH_TIMEOUT_MS))
+    {
+      benchFail(server, "connect");
+    }
+
+    for (int round = 0; round < rounds; round++)
+    {
+      expected += (uint64_t)clientCount;
+      uint64_t before = monotonicMicroseconds();
+      if (sendToAllClientsCtx(server, data) != NETWORK_OK)
+      {
+        benchFail(server, "sendToAllClients");
+      }
+      benchAwait(&delivered, expected);
+      samples[round] = monotonicMicroseconds() - before;
+    }
+
+    double mean = benchMean(samples, (size_t)rounds);
+    uint64_t p50 = benchPercentile(samples, (size_t)rounds, 0.5);
+    uint64_t p99 = benchPercentile(samples, (size_t)rounds, 0.99);
+    printf("{\"benchmark\":\"fanout\",\"label\":\"%s\",\"transport\":\"tcp\",\"clients\":%d,\"payload_bytes\":%d,\"rounds\":%d,"
+           "\"mean_us\":%.1f,\"p50_us\":%llu,\"p99_us\":%llu,\"max_us\":%llu,\"per_client_p50_us\":%.2f}\n",
+           label, clientCount, size, rounds, mean, (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)samples[rounds - 1],
+           (double)p50 / clientCount);
+    fflush(stdout);
+  }
+
+  for (int i = 0; i < clientCount; i++)
+  {
+    destroyContext(clients[i]);
+  }
+  destroyContext(server);
+  free(clients);
+  free(samples);
+  free(payload);
+  return 0;
+}
@@ -0,0 +1,764 @@
+// Load generator for capacity planning of a startServer deployment. It opens --clients connections from one process
+// and drives them from a single epoll loop, speaking the library's wire format directly, since a client context holds
+// only one connection and a thread for it.
+//
+// Messages follow an open loop schedule: message k is due --rate per second after the start, whatever happened to the
+// ones before it, and goes to connection k modulo --clients. Request latency is measured from when a request was due,
+// not from when it could be written, so a server that falls behind shows up in the percentiles instead of silently
+// slowing the generator down. --mix sets the weights of the message types, for example request:1,string:4,json:1.
+// Only requests get an answer, through the request handler of the server or an unhandled response without one.
+//
+// Every --report-ms an interval line is printed, and a summary line at the end. Linux only.
+//
+// Usage: loadGenerator [--host 127.0.0.1] [--port 9540] [--clients 1000] [--rate 10000] [--duration 10]
+//                      [--mix request:1] [--size 64] [--timeout-ms 1000] [--report-ms 1000] [--seed 1] [--serve]
+//                      [--label name]
+
+#include "bench.h"
+#include "request.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#define FRAME_HEADER_SIZE 5
+#define READ_CHUNK (64 * 1024)
+#define EVENT_BATCH 256
+#define CONNECT_TIMEOUT_MS 10000
+// Tag of the schedule timer in epoll events, connections are tagged with their index.
+#define TIMER_TAG UINT64_MAX
+
+typedef enum
+{
+  MIX_INT,
+  MIX_FLOAT,
+  MIX_STRING,
+  MIX_JSON,
+  MIX_REQUEST,
+  MIX_KINDS
+} MixKind;
+
+static const char *mixNames[MIX_KINDS] = {"int", "float", "string", "json", "request"};
+
+typedef struct
+{
+  int socket;
+  bool connected;
+  bool closed;
+  ByteBuffer in;
+  ByteBuffer out;
+  size_t written;
+  bool waitingWritable;
+} Connection;
+
+// A request in flight, found by id modulo the table size. Id 0 marks a free slot.
+typedef struct
+{
+  uint32_t id;
+  uint64_t dueAt;
+} InFlight;
+
+typedef struct
+{
+  uint64_t sent[MIX_KINDS];
+  uint64_t answered;
+  uint64_t unhandled;
+  uint64_t timeouts;
+  uint64_t late;
+  uint64_t sendErrors;
+  uint64_t disconnects;
+  uint64_t rejected;
+  uint64_t received;
+} Counts;
+
+typedef struct
+{
+  uint64_t *values;
+  size_t count;
+  size_t capacity;
+} Samples;
+
+static Connection *connections;
+static int connectionCount;
+static int epollSocket;
+static InFlight *inFlight;
+static uint32_t inFlightCapacity;
+static uint32_t nextRequestId = 1;
+static Counts counts;
+static Samples samples;
+static uint64_t randomState;
+
+static uint64_t nextRandom()
+{
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+  return randomState;
+}
+
+static int parseMix(const char *text, int weights[MIX_KINDS])
+{
+  memset(weights, 0, sizeof(int) * MIX_KINDS);
+  char copy[256];
+  strncpy(copy, text, sizeof(copy) - 1);
+  copy[sizeof(copy) - 1] = '\0';
+
+  int total = 0;
+  for (char *entry = strtok(copy, ","); entry; entry = strtok(NULL, ","))
+  {
+    char *colon = strchr(entry, ':');
+    int weight = colon ? atoi(colon + 1) : 1;
+    if (colon)
+    {
+      *colon = '\0';
+    }
+
+    int kind = 0;
+    while (kind < MIX_KINDS && strcmp(entry, mixNames[kind]) != 0)
+    {
+      kind++;
+    }
+    if (kind == MIX_KINDS || weight < 0)
+    {
+      fprintf(stderr, "Unknown message type in --mix: %s\n", entry);
+      return 0;
+    }
+    weights[kind] += weight;
+    total += weight;
+  }
+  return total;
+}
+
+static MixKind pickKind(const int weights[MIX_KINDS], int total)
+{
+  int pick = (int)(nextRandom() % (uint64_t)total);
+  for (int kind = 0; kind < MIX_KINDS; kind++)
+  {
+    if (pick < weights[kind])
+    {
+      return (MixKind)kind;
+    }
+    pick -= weights[kind];
+  }
+  return MIX_REQUEST;
+}
+
+static void addSample(uint64_t value)
+{
+  if (samples.count == samples.capacity)
+  {
+    size_t capacity = samples.capacity ? samples.capacity * 2 : 65536;
+    uint64_t *values = (uint64_t *)realloc(samples.values, capacity * sizeof(uint64_t));
+    if (values == NULL)
+    {
+      return;
+    }
+    samples.values = values;
+    samples.capacity = capacity;
+  }
+  samples.values[samples.count++] = value;
+}
+
+static void closeConnection(Connection *connection)
+{
+  if (connection->closed)
+  {
+    return;
+  }
+
+  epoll_ctl(epollSocket, EPOLL_CTL_DEL, connection->socket, NULL);
+  close(connection->socket);
+  connection->closed = true;
+  if (connection->connected)
+  {
+    counts.disconnects++;
+  }
+  byteBufferFree(&connection->in);
+  byteBufferFree(&connection->out);
+  connection->written = 0;
+}
+
+static void watch(Connection *connection, int index, bool writable)
+{
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN | (writable ? EPOLLOUT : 0);
+  event.data.u64 = (uint64_t)index;
+  epoll_ctl(epollSocket, EPOLL_CTL_MOD, connection->socket, &event);
+  connection->waitingWritable = writable;
+}
+
+// Writes as much of the queued output as the socket takes, and waits for it to become writable for the rest.
+static void flushConnection(Connection *connection, int index)
+{
+  while (connection->written < connection->out.length)
+  {
+    ssize_t sent = send(connection->socket, connection->out.bytes + connection->written, connection->out.length - connection->written,
+                        MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      break;
+    }
+    if (sent <= 0)
+    {
+      closeConnection(connection);
+      return;
+    }
+    connection->written += (size_t)sent;
+  }
+
+  bool pending = connection->written < connection->out.length;
+  if (!pending)
+  {
+    connection->out.length = 0;
+    connection->written = 0;
+  }
+  if (pending != connection->waitingWritable)
+  {
+    watch(connection, index, pending);
+  }
+}
+
+static void handleResponse(const uint8_t *payload, uint32_t size, uint64_t now)
+{
+  Data frame;
+  frame.type = TYPE_RESPONSE;
+  frame.data.raw.bytes = (uint8_t *)payload;
+  frame.data.raw.size = size;
+
+  uint32_t id;
+  RequestStatus status;
+  Data data;
+  if (decodeResponse(&frame, &id, &status, &data) == PLATFORM_FAILURE)
+  {
+    return;
+  }
+  freeRecvData(&data);
+
+  InFlight *slot = &inFlight[id & (inFlightCapacity - 1)];
+  if (slot->id != id)
+  {
+    counts.late++;
+    return;
+  }
+
+  addSample(now - slot->dueAt);
+  slot->id = 0;
+  counts.answered++;
+  if (status != REQUEST_OK)
+  {
+    counts.unhandled++;
+  }
+}
+
+static void readConnection(Connection *connection)
+{
+  uint8_t chunk[READ_CHUNK];
+  for (;;)
+  {
+    ssize_t received = recv(connection->socket, chunk, sizeof(chunk), MSG_DONTWAIT);
+    if (received < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      break;
+    }
+    if (received <= 0 || byteBufferAppend(&connection->in, chunk, (size_t)received) == PLATFORM_FAILURE)
+    {
+      closeConnection(connection);
+      return;
+    }
+  }
+
+  uint64_t now = monotonicMicroseconds();
+  size_t offset = 0;
+  while (connection->in.length - offset >= FRAME_HEADER_SIZE)
+  {
+    const uint8_t *frame = connection->in.bytes + offset;
+    uint32_t size;
+    memcpy(&size, frame + 1, sizeof(uint32_t));
+    size = ntohl(size);
+    if (connection->in.length - offset - FRAME_HEADER_SIZE < size)
+    {
+      break;
+    }
+
+    counts.received++;
+    if (frame[0] == TYPE_RESPONSE)
+    {
+      handleResponse(frame + FRAME_HEADER_SIZE, size, now);
+    }
+    else if (frame[0] == TYPE_REJECTED)
+    {
+      counts.rejected++;
+      closeConnection(connection);
+      return;
+    }
+    offset += FRAME_HEADER_SIZE + size;
+  }
+
+  memmove(connection->in.bytes, connection->in.bytes + offset, connection->in.length - offset);
+  connection->in.length -= offset;
+}
+
+static int encodeMessage(ByteBuffer *out, MixKind kind, const char *payload, cJSON *json, uint64_t dueAt)
+{
+  Data data;
+  switch (kind)
+  {
+  case MIX_INT:
+    data.type = TYPE_INT;
+    data.data.i = (int)dueAt;
+    return encodeData(out, data);
+  case MIX_FLOAT:
+    data.type = TYPE_FLOAT;
+    data.data.f = (float)dueAt;
+    return encodeData(out, data);
+  case MIX_STRING:
+    data.type = TYPE_STRING;
+    data.data.s = (char *)payload;
+    return encodeData(out, data);
+  case MIX_JSON:
+    data.type = TYPE_JSON;
+    data.data.json = json;
+    return encodeData(out, data);
+  default:
+    break;
+  }
+
+  // A request whose slot is still taken has been unanswered for about the length of the table.
+  uint32_t id = nextRequestId++;
+  if (nextRequestId == 0)
+  {
+    nextRequestId = 1;
+  }
+  InFlight *slot = &inFlight[id & (inFlightCapacity - 1)];
+  if (slot->id != 0)
+  {
+    counts.timeouts++;
+  }
+  slot->id = id;
+  slot->dueAt = dueAt;
+
+  data.type = TYPE_STRING;
+  data.data.s = (char *)payload;
+  return encodeRequest(out, id, data);
+}
+
+static void sendScheduled(uint64_t index, uint64_t dueAt, MixKind kind, const char *payload, cJSON *json)
+{
+  int target = (int)(index % (uint64_t)connectionCount);
+  Connection *connection = &connections[target];
+  counts.sent[kind]++;
+  if (connection->closed || !connection->connected)
+  {
+    counts.sendErrors++;
+    return;
+  }
+
+  if (encodeMessage(&connection->out, kind, payload, json, dueAt) == PLATFORM_FAILURE)
+  {
+    counts.sendErrors++;
+    return;
+  }
+  if (!connection->waitingWritable)
+  {
+    flushConnection(connection, target);
+  }
+}
+
+// Counts requests that were due more than timeout ago as timed out.
+static void expireRequests(uint64_t now, uint64_t timeout)
+{
+  for (uint32_t i = 0; i < inFlightCapacity; i++)
+  {
+    if (inFlight[i].id != 0 && now - inFlight[i].dueAt > timeout)
+    {
+      inFlight[i].id = 0;
+      counts.timeouts++;
+    }
+  }
+}
+
+static void handleEvents(struct epoll_event *events, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    if (events[i].data.u64 == TIMER_TAG)
+    {
+      continue;
+    }
+
+    int index = (int)events[i].data.u64;
+    Connection *connection = &connections[index];
+    if (connection->closed)
+    {
+      continue;
+    }
+
+    if (!connection->connected)
+    {
+      int error = 0;
+      socklen_t length = sizeof(error);
+      getsockopt(connection->socket, SOL_SOCKET, SO_ERROR, &error, &length);
+      if (error != 0)
+      {
+        closeConnection(connection);
+        continue;
+      }
+      connection->connected = true;
+      watch(connection, index, false);
+      continue;
+    }
+
+    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    {
+      readConnection(connection);
+    }
+    if (!connection->closed && (events[i].events & EPOLLOUT))
+    {
+      flushConnection(connection, index);
+    }
+  }
+}
+
+static int pollEvents(int timeoutMs)
+{
+  struct epoll_event events[EVENT_BATCH];
+  int count = epoll_wait(epollSocket, events, EVENT_BATCH, timeoutMs);
+  if (count > 0)
+  {
+    handleEvents(events, count);
+  }
+  return count;
+}
+
+static int openConnections(const char *host, int port)
+{
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, host, &address.sin_addr) != 1)
+  {
+    fprintf(stderr, "Invalid --host %s\n", host);
+    return 0;
+  }
+
+  for (int i = 0; i < connectionCount; i++)
+  {
+    Connection *connection = &connections[i];
+    connection->socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (connection->socket < 0)
+    {
+      connection->closed = true;
+      continue;
+    }
+
+    int noDelay = 1;
+    setsockopt(connection->socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    if (connect(connection->socket, (struct sockaddr *)&address, sizeof(address)) != 0 && errno != EINPROGRESS)
+    {
+      close(connection->socket);
+      connection->closed = true;
+      continue;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLOUT;
+    event.data.u64 = (uint64_t)i;
+    epoll_ctl(epollSocket, EPOLL_CTL_ADD, connection->socket, &event);
+    connection->waitingWritable = true;
+  }
+
+  uint64_t deadline = monotonicMilliseconds() + CONNECT_TIMEOUT_MS;
+  int settled = 0;
+  while (monotonicMilliseconds() < deadline)
+  {
+    settled = 0;
+    for (int i = 0; i < connectionCount; i++)
+    {
+      settled += connections[i].connected || connections[i].closed;
+    }
+    if (settled == connectionCount)
+    {
+      break;
+    }
+    pollEvents(10);
+  }
+
+  int connected = 0;
+  for (int i = 0; i < connectionCount; i++)
+  {
+    if (!connections[i].connected)
+    {
+      closeConnection(&connections[i]);
+    }
+    connected += connections[i].connected && !connections[i].closed;
+  }
+  return connected;
+}
+
+static void armTimer(int timer, uint64_t atMicroseconds)
+{
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = (time_t)(atMicroseconds / 1000000);
+  spec.it_value.tv_nsec = (long)(atMicroseconds % 1000000) * 1000;
+  timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+static uint64_t totalSent()
+{
+  uint64_t total = 0;
+  for (int kind = 0; kind < MIX_KINDS; kind++)
+  {
+    total += counts.sent[kind];
+  }
+  return total;
+}
+
+static void reportInterval(const char *label, double elapsed, const Counts *previous, size_t firstSample)
+{
+  uint64_t sent = totalSent();
+  uint64_t previousSent = 0;
+  for (int kind = 0; kind < MIX_KINDS; kind++)
+  {
+    previousSent += previous->sent[kind];
+  }
+
+  size_t count = samples.count - firstSample;
+  uint64_t *interval = samples.values + firstSample;
+  uint64_t p50 = benchPercentile(interval, count, 0.5);
+  uint64_t p99 = benchPercentile(interval, count, 0.99);
+  printf("{\"benchmark\":\"load\",\"kind\":\"interval\",\"label\":\"%s\",\"elapsed_s\":%.2f,\"sent\":%llu,\"answered\":%llu,\"timeouts\":%llu,"
+         "\"send_errors\":%llu,\"disconnects\":%llu,\"p50_us\":%llu,\"p99_us\":%llu}\n",
+         label, elapsed, (unsigned long long)(sent - previousSent), (unsigned long long)(counts.answered - previous->answered),
+         (unsigned long long)(counts.timeouts - previous->timeouts), (unsigned long long)(counts.sendErrors - previous->sendErrors),
+         (unsigned long long)(counts.disconnects - previous->disconnects), (unsigned long long)p50, (unsigned long long)p99);
+  fflush(stdout);
+}
+
+static void onServedClientData(Data data, socket_t client)
+{
+  (void)data;
+  (void)client;
+}
+
+static void onServedRequest(Data data, socket_t client, uint32_t id)
+{
+  respondToClientCtx(getCurrentContext(), data, client, id);
+}
+
+int main(int argc, char **argv)
+{
+  const char *host = benchArgString(argc, argv, "--host", "127.0.0.1");
+  int port = benchArgInt(argc, argv, "--port", 9540);
+  connectionCount = benchArgInt(argc, argv, "--clients", 1000);
+  int rate = benchArgInt(argc, argv, "--rate", 10000);
+  int duration = benchArgInt(argc, argv, "--duration", 10);
+  const char *mix = benchArgString(argc, argv, "--mix", "request:1");
+  int size = benchArgInt(argc, argv, "--size", 64);
+  int timeoutMs = benchArgInt(argc, argv, "--timeout-ms", 1000);
+  int reportMs = benchArgInt(argc, argv, "--report-ms", 1000);
+  randomState = (uint64_t)benchArgInt(argc, argv, "--seed", 1) * 0x9E3779B97F4A7C15ULL | 1;
+  bool serve = benchHasFlag(argc, argv, "--serve");
+  const char *label = benchArgString(argc, argv, "--label", "");
+
+  int weights[MIX_KINDS];
+  int totalWeight = parseMix(mix, weights);
+  if (totalWeight <= 0 || connectionCount <= 0 || rate <= 0 || duration <= 0 || timeoutMs <= 0 || reportMs <= 0)
+  {
+    fprintf(stderr, "Invalid arguments\n");
+    return 1;
+  }
+
+  // Thousands of connections need more descriptors than the usual soft limit.
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+  {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  NexContext *server = NULL;
+  if (serve)
+  {
+    if (createContext(&server, CONNECTION_TCP, Server) != NETWORK_OK)
+    {
+      benchFail(NULL, "createContext");
+    }
+    if (setClientRequestHandlerCtx(server, onServedRequest) != NETWORK_OK)
+    {
+      benchFail(server, "setClientRequestHandler");
+    }
+    if (startServerCtx(server, port, connectionCount, onServedClientData) != NETWORK_OK)
+    {
+      benchFail(server, "startServer");
+    }
+  }
+
+  // Large enough that a slot is only reused after its request is long past the timeout.
+  inFlightCapacity = 1024;
+  while (inFlightCapacity < (uint64_t)rate * (uint64_t)timeoutMs / 1000 * 4)
+  {
+    inFlightCapacity <<= 1;
+  }
+  connections = (Connection *)calloc((size_t)connectionCount, sizeof(Connection));
+  inFlight = (InFlight *)calloc(inFlightCapacity, sizeof(InFlight));
+  char *payload = benchPayload((size_t)size);
+  epollSocket = epoll_create1(0);
+  int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (connections == NULL || inFlight == NULL || payload == NULL || epollSocket < 0 || timer < 0)
+  {
+    fprintf(stderr, "Setup failed\n");
+    return 1;
+  }
+
+  struct epoll_event timerEvent;
+  memset(&timerEvent, 0, sizeof(timerEvent));
+  timerEvent.events = EPOLLIN;
+  timerEvent.data.u64 = TIMER_TAG;
+  epoll_ctl(epollSocket, EPOLL_CTL_ADD, timer, &timerEvent);
+
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddStringToObject(json, "name", "player");
+  cJSON_AddNumberToObject(json, "x", 12.5);
+  cJSON_AddNumberToObject(json, "y", -3.25);
+
+  uint64_t connectStarted = monotonicMicroseconds();
+  int connected = openConnections(host, port);
+  double connectSeconds = (double)(monotonicMicroseconds() - connectStarted) / 1e6;
+  if (connected == 0)
+  {
+    fprintf(stderr, "No connection to %s:%d could be opened\n", host, port);
+    return 1;
+  }
+
+  uint64_t started = monotonicMicroseconds();
+  uint64_t ends = started + (uint64_t)duration * 1000000;
+  uint64_t nextReport = started + (uint64_t)reportMs * 1000;
+  uint64_t nextExpiry = started + (uint64_t)timeoutMs * 1000;
+  uint64_t scheduled = 0;
+  Counts previous = counts;
+  size_t firstSample = 0;
+  uint64_t sendLag = 0;
+
+  for (;;)
+  {
+    uint64_t now = monotonicMicroseconds();
+    uint64_t dueAt = started + scheduled * 1000000 / (uint64_t)rate;
+    if (dueAt >= ends)
+    {
+      break;
+    }
+
+    if (now >= nextExpiry)
+    {
+      expireRequests(now, (uint64_t)timeoutMs * 1000);
+      nextExpiry = now + (uint64_t)timeoutMs * 1000 / 4;
+    }
+    if (now >= nextReport)
+    {
+      reportInterval(label, (double)(now - started) / 1e6, &previous, firstSample);
+      previous = counts;
+      firstSample = samples.count;
+      nextReport += (uint64_t)reportMs * 1000;
+    }
+
+    if (dueAt <= now)
+    {
+      sendScheduled(scheduled++, dueAt, pickKind(weights, totalWeight), payload, json);
+      sendLag = now - dueAt > sendLag ? now - dueAt : sendLag;
+      // Keep reading while catching up, so responses are timestamped when they arrive.
+      if (scheduled % 64 == 0)
+      {
+        pollEvents(0);
+      }
+      continue;
+    }
+
+    armTimer(timer, dueAt < nextReport ? dueAt : nextReport);
+    pollEvents(-1);
+    uint64_t expirations;
+    while (read(timer, &expirations, sizeof(expirations)) > 0)
+    {
+    }
+  }
+  double sendingSeconds = (double)(monotonicMicroseconds() - started) / 1e6;
+
+  // Gives the last requests their full timeout to be answered.
+  uint64_t drainUntil = monotonicMicroseconds() + (uint64_t)timeoutMs * 1000;
+  uint64_t outstanding = 0;
+  do
+  {
+    outstanding = 0;
+    for (uint32_t i = 0; i < inFlightCapacity; i++)
+    {
+      outstanding += inFlight[i].id != 0;
+    }
+    if (outstanding > 0)
+    {
+      pollEvents(10);
+    }
+  } while (outstanding > 0 && monotonicMicroseconds() < drainUntil);
+  expireRequests(UINT64_MAX, 0);
+
+  uint64_t sent = totalSent();
+  uint64_t errors = counts.timeouts + counts.sendErrors;
+  double mean = benchMean(samples.values, samples.count);
+  uint64_t p50 = benchPercentile(samples.values, samples.count, 0.5);
+  uint64_t p90 = benchPercentile(samples.values, samples.count, 0.9);
+  uint64_t p99 = benchPercentile(samples.values, samples.count, 0.99);
+  uint64_t p999 = benchPercentile(samples.values, samples.count, 0.999);
+  uint64_t max = samples.count > 0 ? samples.values[samples.count - 1] : 0;
+
+  printf("{\"benchmark\":\"load\",\"kind\":\"summary\",\"label\":\"%s\",\"clients\":%d,\"connected\":%d,\"connect_seconds\":%.3f,"
+         "\"target_rate\":%d,\"achieved_rate\":%.0f,\"max_send_lag_us\":%llu,\"mix\":\"%s\",\"sent\":%llu,",
+         label, connectionCount, connected, connectSeconds, rate, (double)sent / sendingSeconds, (unsigned long long)sendLag, mix,
+         (unsigned long long)sent);
+  for (int kind = 0; kind < MIX_KINDS; kind++)
+  {
+    printf("\"sent_%s\":%llu,", mixNames[kind], (unsigned long long)counts.sent[kind]);
+  }
+  printf("\"answered\":%llu,\"unhandled\":%llu,\"timeouts\":%llu,\"late\":%llu,\"send_errors\":%llu,\"disconnects\":%llu,\"rejected\":%llu,"
+         "\"received_frames\":%llu,\"error_rate\":%.6f,\"mean_us\":%.1f,\"p50_us\":%llu,\"p90_us\":%llu,\"p99_us\":%llu,\"p999_us\":%llu,"
+         "\"max_us\":%llu}\n",
+         (unsigned long long)counts.answered, (unsigned long long)counts.unhandled, (unsigned long long)counts.timeouts,
+         (unsigned long long)counts.late, (unsigned long long)counts.sendErrors, (unsigned long long)counts.disconnects,
+         (unsigned long long)counts.rejected, (unsigned long long)counts.received, sent > 0 ? (double)errors / (double)sent : 0,
+         mean, (unsigned long long)p50, (unsigned long long)p90, (unsigned long long)p99, (unsigned long long)p999,
+         (unsigned long long)max);
+
+  for (int i = 0; i < connectionCount; i++)
+  {
+    closeConnection(&connections[i]);
+  }
+  if (server)
+  {
+    destroyContext(server);
+  }
+  cJSON_Delete(json);
+  close(timer);
+  close(epollSocket);
+  free(samples.values);
+  free(connections);
+  free(inFlight);
+  free(payload);
+  return 0;
+}
@@ -0,0 +1,147 @@
+// UDP peer packet rate: one peer sends a burst of messages to another as fast as the channel takes them. Unreliable
+// cases report how many arrived, the reliable case waits for every message and retries sends the channel refuses
+// with NETWORK_ERR_QUEUE_FULL.
+//
+// Usage: peerRate [--port 9530] [--count 100000] [--label name]
+
+#include "bench.h"
+
+// How long the receiver has to be quiet before an unreliable burst counts as over.
+#define PEER_QUIET_MS 200
+
+typedef struct
+{
+  const char *channelName;
+  PeerChannel channel;
+  size_t size;
+} PeerCase;
+
+static const PeerCase cases[] = {
+    {"unreliable", PEER_CHANNEL_UNRELIABLE, 64},
+    {"unreliable", PEER_CHANNEL_UNRELIABLE, 1024},
+    {"reliable_ordered", PEER_CHANNEL_RELIABLE_ORDERED, 64}};
+
+static uint64_t received = 0;
+static uint64_t lastArrival = 0;
+
+static void onSenderData(Data data, int peer)
+{
+  (void)data;
+  (void)peer;
+}
+
+static void onReceiverData(Data data, int peer)
+{
+  (void)peer;
+  if (data.type == TYPE_STRING)
+  {
+    ATOMIC_STORE_RELEASE(&lastArrival, monotonicMicroseconds());
+    ATOMIC_ADD(&received, 1);
+  }
+}
+
+// Waits until count messages arrived, or with untilQuiet until nothing arrived for PEER_QUIET_MS, and returns how many
+// did.
+static uint64_t awaitBurst(uint64_t base, uint64_t count, bool untilQuiet)
+{
+  uint64_t deadline = monotonicMilliseconds() + BENCH_TIMEOUT_MS;
+  uint64_t seen = ATOMIC_LOAD(&received);
+  uint64_t quietSince = monotonicMilliseconds();
+  while (seen - base < count && monotonicMilliseconds() < deadline)
+  {
+    sleepMilliseconds(1);
+    uint64_t now = ATOMIC_LOAD(&received);
+    if (now != seen)
+    {
+      seen = now;
+      quietSince = monotonicMilliseconds();
+    }
+    else if (monotonicMilliseconds() - quietSince >= PEER_QUIET_MS && untilQuiet)
+    {
+      break;
+    }
+  }
+  return seen - base;
+}
+
+static void runCase(NexContext *sender, const PeerCase *test, int count, const char *label)
+{
+  char *payload = benchPayload(test->size);
+  Data data;
+  data.type = TYPE_STRING;
+  data.data.s = payload;
+
+  bool reliable = test->channel == PEER_CHANNEL_RELIABLE_ORDERED;
+  uint64_t base = ATOMIC_LOAD(&received);
+  uint64_t refused = 0;
+  uint64_t failed = 0;
+  uint64_t started = monotonicMicroseconds();
+  for (int i = 0; i < count; i++)
+  {
+    int result = sendToPeerOnChannelCtx(sender, data, 0, test->channel);
+    while (reliable && result == NETWORK_ERR_QUEUE_FULL)
+    {
+      refused++;
+      sleepMilliseconds(0);
+      result = sendToPeerOnChannelCtx(sender, data, 0, test->channel);
+    }
+    if (result != NETWORK_OK)
+    {
+      failed++;
+    }
+  }
+  uint64_t sendMicroseconds = monotonicMicroseconds() - started;
+
+  uint64_t arrived = awaitBurst(base, (uint64_t)count, !reliable);
+  uint64_t finished = ATOMIC_LOAD_ACQUIRE(&lastArrival);
+  double seconds = (double)(finished > started ? finished - started : 1) / 1e6;
+
+  PeerStats stats;
+  memset(&stats, 0, sizeof(stats));
+  getPeerStatsCtx(sender, 0, &stats);
+
+  printf("{\"benchmark\":\"peer_rate\",\"label\":\"%s\",\"transport\":\"udp\",\"channel\":\"%s\",\"payload_bytes\":%zu,\"messages\":%d,"
+         "\"send_failures\":%llu,\"queue_full_retries\":%llu,\"sent_per_sec\":%.0f,\"received\":%llu,\"received_per_sec\":%.0f,"
+         "\"loss\":%.4f,\"retransmits\":%llu}\n",
+         label, test->channelName, test->size, count, (unsigned long long)failed, (unsigned long long)refused,
+         (double)count / ((double)sendMicroseconds / 1e6), (unsigned long long)arrived, (double)arrived / seconds,
+         1.0 - (double)arrived / (double)count, (unsigned long long)stats.retransmits);
+  fflush(stdout);
+  free(payload);
+}
+
+int main(int argc, char **argv)
+{
+  int port = benchArgInt(argc, argv, "--port", 9530);
+  int count = benchArgInt(argc, argv, "--count", 100000);
+  const char *label = benchArgString(argc, argv, "--label", "");
+
+  NexContext *sender;
+  NexContext *receiver;
+  if (createContext(&sender, CONNECTION_UDP, Peer) != NETWORK_OK || createContext(&receiver, CONNECTION_UDP, Peer) != NETWORK_OK)
+  {
+    benchFail(NULL, "createContext");
+  }
+  if (startPeerCtx(sender, port, 1, onSenderData) != NETWORK_OK)
+  {
+    benchFail(sender, "startPeer");
+  }
+  if (startPeerCtx(receiver, port + 1, 1, onReceiverData) != NETWORK_OK)
+  {
+    benchFail(receiver, "startPeer");
+  }
+  // Both ends have to know each other, the receiver acknowledges reliable messages.
+  if (connectToPeerCtx(sender, "127.0.0.1", port + 1) != NETWORK_OK || connectToPeerCtx(receiver, "127.0.0.1", port) != NETWORK_OK)
+  {
+    benchFail(sender, "connectToPeer");
+  }
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    runCase(sender, &cases[i], count, label);
+  }
+
+  destroyContext(sender);
+  destroyContext(receiver);
+  return 0;
+}
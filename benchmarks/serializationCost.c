@@ -0,0 +1,344 @@
+// CPU cost of the wire format, without a network: framing with encodeData/decodeData, the socket senders and recvAny
+// over a local socketpair, and the cJSON printing and parsing underneath the JSON type. Every operation runs in
+// batches until --min-ms of timed work, and reports ns, allocations and allocated bytes per operation. Allocations
+// are counted by wrapping malloc, which needs glibc; elsewhere they are reported as null. POSIX only.
+//
+// Usage: serializationCost [--min-ms 200] [--label name]
+
+#include "bench.h"
+#include <sys/socket.h>
+
+// Operations timed together. CPU bound batches grow until they take CPU_BATCH_MICROSECONDS, so the clock resolution
+// does not matter, and slow operations do not run for long. Batches of socket operations are kept small enough for everything they write to fit in
+// the socketpair buffer, which also accounts for the overhead of every single write.
+#define CPU_BATCH 4096
+#define CPU_BATCH_MICROSECONDS 1000
+#define SOCKET_BATCH 32
+#define SOCKET_BATCH_BYTES (64 * 1024)
+
+static bool counting = false;
+static uint64_t allocations = 0;
+static uint64_t allocatedBytes = 0;
+
+#ifdef __GLIBC__
+#define ALLOCATIONS_COUNTED 1
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+static void countAllocation(size_t size)
+{
+  if (counting)
+  {
+    allocations++;
+    allocatedBytes += size;
+  }
+}
+
+void *malloc(size_t size)
+{
+  countAllocation(size);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+  countAllocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+  countAllocation(size);
+  return __libc_realloc(pointer, size);
+}
+#else
+#define ALLOCATIONS_COUNTED 0
+#endif
+
+typedef enum
+{
+  OPERATION_ENCODE,
+  OPERATION_DECODE,
+  OPERATION_SEND,
+  OPERATION_RECV,
+  OPERATION_PRINT,
+  OPERATION_PARSE
+} Operation;
+
+static const char *operationNames[] = {"encodeData", "decodeData", "send", "recvAny", "cJSON_PrintUnformatted", "cJSON_Parse"};
+
+typedef struct
+{
+  const char *name;
+  Data data;
+  ByteBuffer frame;
+  char *text;
+} Shape;
+
+static socket_t writer;
+static socket_t reader;
+static uint8_t drain[SOCKET_BATCH_BYTES];
+
+// Nested objects and arrays, like the state of a game lobby.
+static cJSON *nestedJson()
+{
+  cJSON *root = cJSON_CreateObject();
+  cJSON_AddStringToObject(root, "lobby", "main");
+  cJSON *players = cJSON_AddArrayToObject(root, "players");
+  for (int i = 0; i < 50; i++)
+  {
+    cJSON *player = cJSON_CreateObject();
+    cJSON_AddNumberToObject(player, "id", i);
+    cJSON_AddStringToObject(player, "name", "player_name");
+    cJSON *position = cJSON_AddObjectToObject(player, "position");
+    cJSON_AddNumberToObject(position, "x", i * 1.5);
+    cJSON_AddNumberToObject(position, "y", i * -0.25);
+    cJSON_AddNumberToObject(position, "z", 10);
+    cJSON *inventory = cJSON_AddArrayToObject(player, "inventory");
+    for (int j = 0; j < 4; j++)
+    {
+      cJSON *item = cJSON_CreateObject();
+      cJSON_AddStringToObject(item, "item", "potion");
+      cJSON_AddNumberToObject(item, "count", j);
+      cJSON_AddItemToArray(inventory, item);
+    }
+    cJSON_AddBoolToObject(player, "ready", i % 2);
+    cJSON_AddItemToArray(players, player);
+  }
+  return root;
+}
+
+// Flat arrays of numbers, where printing and parsing doubles dominates.
+static cJSON *numericJson()
+{
+  cJSON *root = cJSON_CreateObject();
+  cJSON *samples = cJSON_AddArrayToObject(root, "samples");
+  cJSON *counts = cJSON_AddArrayToObject(root, "counts");
+  for (int i = 0; i < 1000; i++)
+  {
+    cJSON_AddItemToArray(samples, cJSON_CreateNumber(i * 0.731 - 200.5));
+    cJSON_AddItemToArray(counts, cJSON_CreateNumber(i * 37));
+  }
+  return root;
+}
+
+static void initShape(Shape *shape, const char *name, Data data)
+{
+  memset(shape, 0, sizeof(Shape));
+  shape->name = name;
+  shape->data = data;
+  if (encodeData(&shape->frame, data) == PLATFORM_FAILURE)
+  {
+    fprintf(stderr, "encodeData failed for %s\n", name);
+    exit(1);
+  }
+  if (data.type == TYPE_JSON)
+  {
+    shape->text = cJSON_PrintUnformatted(data.data.json);
+  }
+}
+
+static int sendShape(const Shape *shape)
+{
+  switch (shape->data.type)
+  {
+  case TYPE_INT:
+    return sendInt(writer, shape->data.data.i);
+  case TYPE_STRING:
+    return sendString(writer, shape->data.data.s);
+  case TYPE_JSON:
+    return sendJSON(writer, shape->data.data.json);
+  default:
+    return PLATFORM_FAILURE;
+  }
+}
+
+static void fail(const Shape *shape, Operation operation)
+{
+  fprintf(stderr, "%s failed for %s\n", operationNames[operation], shape->name);
+  exit(1);
+}
+
+// Reads back what the send operations wrote, outside of the timed part of a batch.
+static void drainReader(size_t length)
+{
+  while (length > 0)
+  {
+    int received = recvData(reader, drain, length < sizeof(drain) ? length : sizeof(drain), 0);
+    if (received <= 0)
+    {
+      exit(1);
+    }
+    length -= (size_t)received;
+  }
+}
+
+// Runs count operations and returns the microseconds they took.
+static uint64_t runBatch(Shape *shape, Operation operation, int count)
+{
+  if (operation == OPERATION_RECV)
+  {
+    for (int i = 0; i < count; i++)
+    {
+      if (sendAll(writer, shape->frame.bytes, shape->frame.length, 0) == PLATFORM_FAILURE)
+      {
+        fail(shape, operation);
+      }
+    }
+  }
+
+  ByteBuffer buffer = {0};
+  counting = true;
+  uint64_t started = monotonicMicroseconds();
+  for (int i = 0; i < count; i++)
+  {
+    Data data;
+    switch (operation)
+    {
+    case OPERATION_ENCODE:
+      buffer.length = 0;
+      if (encodeData(&buffer, shape->data) == PLATFORM_FAILURE)
+      {
+        fail(shape, operation);
+      }
+      break;
+    case OPERATION_DECODE:
+      if (decodeData(shape->frame.bytes, shape->frame.length, &data) == PLATFORM_FAILURE)
+      {
+        fail(shape, operation);
+      }
+      freeRecvData(&data);
+      break;
+    case OPERATION_SEND:
+      if (sendShape(shape) == PLATFORM_FAILURE)
+      {
+        fail(shape, operation);
+      }
+      break;
+    case OPERATION_RECV:
+      if (recvAny(reader, &data) != PLATFORM_SUCCESS)
+      {
+        fail(shape, operation);
+      }
+      freeRecvData(&data);
+      break;
+    case OPERATION_PRINT:
+      free(cJSON_PrintUnformatted(shape->data.data.json));
+      break;
+    case OPERATION_PARSE:
+      cJSON_Delete(cJSON_Parse(shape->text));
+      break;
+    }
+  }
+  uint64_t elapsed = monotonicMicroseconds() - started;
+  counting = false;
+  byteBufferFree(&buffer);
+
+  if (operation == OPERATION_SEND)
+  {
+    drainReader(shape->frame.length * (size_t)count);
+  }
+  return elapsed;
+}
+
+static void measure(Shape *shape, Operation operation, uint64_t minMicroseconds, const char *label)
+{
+  int batch = 1;
+  if (operation == OPERATION_SEND || operation == OPERATION_RECV)
+  {
+    batch = (int)(SOCKET_BATCH_BYTES / shape->frame.length);
+    batch = batch < 1 ? 1 : batch > SOCKET_BATCH ? SOCKET_BATCH : batch;
+    runBatch(shape, operation, batch);
+  }
+  else
+  {
+    // The untimed batches that size the batch also warm the caches and the allocator.
+    while (runBatch(shape, operation, batch) < CPU_BATCH_MICROSECONDS && batch < CPU_BATCH)
+    {
+      batch *= 2;
+    }
+  }
+  allocations = 0;
+  allocatedBytes = 0;
+
+  uint64_t operations = 0;
+  uint64_t elapsed = 0;
+  while (elapsed < minMicroseconds)
+  {
+    elapsed += runBatch(shape, operation, batch);
+    operations += (uint64_t)batch;
+  }
+
+  printf("{\"benchmark\":\"serialization\",\"label\":\"%s\",\"shape\":\"%s\",\"operation\":\"%s\",\"frame_bytes\":%zu,\"operations\":%llu,"
+         "\"ns_per_op\":%.1f,",
+         label, shape->name, operationNames[operation], shape->frame.length, (unsigned long long)operations,
+         (double)elapsed * 1000.0 / (double)operations);
+  if (ALLOCATIONS_COUNTED)
+  {
+    printf("\"allocs_per_op\":%.2f,\"alloc_bytes_per_op\":%.1f}\n", (double)allocations / (double)operations,
+           (double)allocatedBytes / (double)operations);
+  }
+  else
+  {
+    printf("\"allocs_per_op\":null,\"alloc_bytes_per_op\":null}\n");
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+  uint64_t minMicroseconds = (uint64_t)benchArgInt(argc, argv, "--min-ms", 200) * 1000;
+  const char *label = benchArgString(argc, argv, "--label", "");
+
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+  {
+    perror("socketpair");
+    return 1;
+  }
+  writer = sockets[0];
+  reader = sockets[1];
+
+  char *shortString = benchPayload(16);
+  char *longString = benchPayload(1024);
+  Shape shapes[5];
+  Data data;
+  data.type = TYPE_INT;
+  data.data.i = 42;
+  initShape(&shapes[0], "int", data);
+  data.type = TYPE_STRING;
+  data.data.s = shortString;
+  initShape(&shapes[1], "string_16", data);
+  data.data.s = longString;
+  initShape(&shapes[2], "string_1024", data);
+  data.type = TYPE_JSON;
+  data.data.json = nestedJson();
+  initShape(&shapes[3], "json_nested", data);
+  data.data.json = numericJson();
+  initShape(&shapes[4], "json_numeric", data);
+
+  for (int i = 0; i < 5; i++)
+  {
+    Operation last = shapes[i].data.type == TYPE_JSON ? OPERATION_PARSE : OPERATION_RECV;
+    for (int operation = OPERATION_ENCODE; operation <= (int)last; operation++)
+    {
+      measure(&shapes[i], (Operation)operation, minMicroseconds, label);
+    }
+  }
+
+  for (int i = 0; i < 5; i++)
+  {
+    byteBufferFree(&shapes[i].frame);
+    if (shapes[i].data.type == TYPE_JSON)
+    {
+      cJSON_Delete(shapes[i].data.data.json);
+      free(shapes[i].text);
+    }
+  }
+  free(shortString);
+  free(longString);
+  closeSocket(writer);
+  closeSocket(reader);
+  return 0;
+}
@@ -0,0 +1,187 @@
+// One way throughput over TCP, a Unix domain socket with --local or shared memory rings with --shm: the client sends a
+// stream of messages of one type and size as fast as it can, and the clock stops once the server callback has seen the
+// last one. Every case streams about --bytes of payload, capped at --max-messages messages. --views has the server
+// receive through a view handler, which borrows strings and JSON from the receive buffer instead of copying them.
+//
+// Usage: throughput [--port 9510] [--bytes 67108864] [--max-messages 200000] [--coalesce] [--views] [--local | --shm]
+//                   [--label name]
+
+#include "bench.h"
+
+typedef struct
+{
+  const char *name;
+  NetworkedType type;
+  size_t size;
+} ThroughputCase;
+
+static const ThroughputCase cases[] = {
+    {"int", TYPE_INT, sizeof(int)},
+    {"float", TYPE_FLOAT, sizeof(float)},
+    {"string", TYPE_STRING, 16},
+    {"string", TYPE_STRING, 256},
+    {"string", TYPE_STRING, 4096},
+    {"string", TYPE_STRING, 65536},
+    {"json", TYPE_JSON, 0}};
+
+static uint64_t connected = 0;
+static uint64_t received = 0;
+
+static void onClientData(Data data, socket_t client)
+{
+  (void)client;
+  if (data.type == TYPE_INT || data.type == TYPE_FLOAT || data.type == TYPE_STRING || data.type == TYPE_JSON)
+  {
+    ATOMIC_ADD(&received, 1);
+  }
+}
+
+static void onClientView(DataView view, socket_t client)
+{
+  (void)client;
+  (void)view;
+  ATOMIC_ADD(&received, 1);
+}
+
+static void onServerData(Data data)
+{
+  if (data.type == TYPE_CONNECTED)
+  {
+    ATOMIC_ADD(&connected, 1);
+  }
+}
+
+// A small object of the shape a game state update would have.
+static cJSON *sampleJson()
+{
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddNumberToObject(json, "id", 42);
+  cJSON_AddStringToObject(json, "name", "player");
+  cJSON_AddNumberToObject(json, "x", 12.5);
+  cJSON_AddNumberToObject(json, "y", -3.25);
+  cJSON_AddBoolToObject(json, "alive", 1);
+  return json;
+}
+
+static void runCase(NexContext *client, const ThroughputCase *test, uint64_t budget, int maxMessages, bool coalesce, bool views,
+                    const char *transport, const char *label)
+{
+  Data data;
+  data.type = test->type;
+  char *payload = NULL;
+  size_t size = test->size;
+  if (test->type == TYPE_INT)
+  {
+    data.data.i = 7;
+  }
+  else if (test->type == TYPE_FLOAT)
+  {
+    data.data.f = 7.5f;
+  }
+  else if (test->type == TYPE_STRING)
+  {
+    payload = benchPayload(size);
+    data.data.s = payload;
+  }
+  else
+  {
+    data.data.json = sampleJson();
+    char *text = cJSON_PrintUnformatted(data.data.json);
+    size = text ? strlen(text) : 0;
+    free(text);
+  }
+
+  uint64_t count = budget / (size > 0 ? size : 1);
+  count = count > (uint64_t)maxMessages ? (uint64_t)maxMessages : count;
+  count = count < 100 ? 100 : count;
+
+  uint64_t target = ATOMIC_LOAD(&received) + count;
+  uint64_t started = monotonicMicroseconds();
+  for (uint64_t i = 0; i < count; i++)
+  {
+    if (sendToServerCtx(client, data) != NETWORK_OK)
+    {
+      benchFail(client, "sendToServer");
+    }
+  }
+  if (coalesce)
+  {
+    flushServerCtx(client);
+  }
+  if (!benchWaitFor(&received, target, BENCH_TIMEOUT_MS))
+  {
+    fprintf(stderr, "%s/%zu: only %llu of %llu messages arrived\n", test->name, size, (unsigned long long)(ATOMIC_LOAD(&received) - (target - count)),
+            (unsigned long long)count);
+    exit(1);
+  }
+  double seconds = (double)(monotonicMicroseconds() - started) / 1e6;
+
+  printf("{\"benchmark\":\"throughput\",\"label\":\"%s\",\"transport\":\"%s\",\"type\":\"%s\",\"payload_bytes\":%zu,\"coalesce\":%s,\"views\":%s,"
+         "\"messages\":%llu,\"seconds\":%.4f,\"messages_per_sec\":%.0f,\"payload_mb_per_sec\":%.2f}\n",
+         label, transport, test->name, size, coalesce ? "true" : "false", views ? "true" : "false", (unsigned long long)count, seconds, (double)count / seconds,
+         (double)count * (double)size / seconds / 1e6);
+  fflush(stdout);
+
+  if (test->type == TYPE_JSON)
+  {
+    cJSON_Delete(data.data.json);
+  }
+  free(payload);
+}
+
+int main(int argc, char **argv)
+{
+  int port = benchArgInt(argc, argv, "--port", 9510);
+  uint64_t budget = (uint64_t)benchArgInt(argc, argv, "--bytes", 64 << 20);
+  int maxMessages = benchArgInt(argc, argv, "--max-messages", 200000);
+  bool coalesce = benchHasFlag(argc, argv, "--coalesce");
+  bool views = benchHasFlag(argc, argv, "--views");
+  ConnectionType transport = benchTransport(argc, argv);
+  const char *label = benchArgString(argc, argv, "--label", "");
+
+  NexContext *server;
+  NexContext *client;
+  if (createContext(&server, transport, Server) != NETWORK_OK || createContext(&client, transport, Client) != NETWORK_OK)
+  {
+    benchFail(NULL, "createContext");
+  }
+
+  if (coalesce)
+  {
+    FlushPolicy policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.mode = FLUSH_COALESCE;
+    policy.maxBufferedBytes = 64 * 1024;
+    policy.flushIntervalMs = 1;
+    if (setFlushPolicyCtx(client, policy) != NETWORK_OK)
+    {
+      benchFail(client, "setFlushPolicy");
+    }
+  }
+
+  if (views && setClientViewHandlerCtx(server, onClientView) != NETWORK_OK)
+  {
+    benchFail(server, "setClientViewHandler");
+  }
+  if (startServerCtx(server, port, 1, onClientData) != NETWORK_OK)
+  {
+    benchFail(server, "startServer");
+  }
+  if (connectToServerCtx(client, "127.0.0.1", port, onServerData) != NETWORK_OK)
+  {
+    benchFail(client, "connectToServer");
+  }
+  if (!benchWaitFor(&connected, 1, BENCH_TIMEOUT_MS))
+  {
+    benchFail(client, "connect");
+  }
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+  {
+    runCase(client, &cases[i], budget, maxMessages, coalesce, views, benchTransportName(transport), label);
+  }
+
+  destroyContext(client);
+  destroyContext(server);
+  return 0;
+}
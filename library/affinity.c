@@ -0,0 +1,82 @@
+#include "affinity.h"
+#include <stdlib.h>
+#include <string.h>
+
+int configureAffinity(Affinity *affinity, const ThreadPlacement *placement)
+{
+  memset(affinity, 0, sizeof(Affinity));
+  if (placement->cpuCount == 0)
+  {
+    return PLATFORM_SUCCESS;
+  }
+
+  affinity->cpus = (int *)malloc(placement->cpuCount * sizeof(int));
+  affinity->nodes = (int *)malloc(placement->cpuCount * sizeof(int));
+  if (affinity->cpus == NULL || affinity->nodes == NULL)
+  {
+    clearAffinity(affinity);
+    return PLATFORM_FAILURE;
+  }
+
+  for (int i = 0; i < placement->cpuCount; i++)
+  {
+    affinity->cpus[i] = placement->cpus[i];
+    affinity->nodes[i] = cpuNode(placement->cpus[i]);
+  }
+  affinity->count = placement->cpuCount;
+  affinity->followIncomingCpu = placement->followIncomingCpu;
+  affinity->pinIoThreads = placement->pinIoThreads;
+  return PLATFORM_SUCCESS;
+}
+
+void clearAffinity(Affinity *affinity)
+{
+  free(affinity->cpus);
+  free(affinity->nodes);
+  memset(affinity, 0, sizeof(Affinity));
+}
+
+void pinIoThread(const Affinity *affinity)
+{
+  if (affinity->count > 0 && affinity->pinIoThreads)
+  {
+    pinCurrentThread(affinity->cpus[0]);
+  }
+}
+
+int connectionCpu(Affinity *affinity, socket_t socket)
+{
+  if (affinity->count == 0)
+  {
+    return -1;
+  }
+
+  // Staying on the CPU that runs the connection's softirqs keeps its socket buffers and protocol state in that
+  // CPU's cache. Failing that, a CPU of the same node at least keeps them in local memory.
+  int incoming;
+  if (affinity->followIncomingCpu && socketIncomingCpu(socket, &incoming) == PLATFORM_SUCCESS)
+  {
+    for (int i = 0; i < affinity->count; i++)
+    {
+      if (affinity->cpus[i] == incoming)
+      {
+        return incoming;
+      }
+    }
+
+    int node = cpuNode(incoming);
+    for (int k = 0; k < affinity->count && node >= 0; k++)
+    {
+      int i = (affinity->next + k) % affinity->count;
+      if (affinity->nodes[i] == node)
+      {
+        affinity->next = (i + 1) % affinity->count;
+        return affinity->cpus[i];
+      }
+    }
+  }
+
+  int cpu = affinity->cpus[affinity->next];
+  affinity->next = (affinity->next + 1) % affinity->count;
+  return cpu;
+}
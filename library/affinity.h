@@ -0,0 +1,30 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdbool.h>
+#include "nex.h"
+
+  typedef struct
+  {
+    int *cpus;
+    int *nodes;
+    int count;
+    int next;
+    bool followIncomingCpu;
+    bool pinIoThreads;
+  } Affinity;
+
+  int configureAffinity(Affinity *affinity, const ThreadPlacement *placement);
+  void clearAffinity(Affinity *affinity);
+
+  void pinIoThread(const Affinity *affinity);
+  // Picks the CPU for the thread of a newly accepted connection, -1 to leave it to the scheduler. Not thread safe.
+  int connectionCpu(Affinity *affinity, socket_t socket);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,200 @@
+#include "capture.h"
+#include <stdlib.h>
+#include <string.h>
+
+static size_t paddedLength(size_t length)
+{
+  return (length + 7) & ~(size_t)7;
+}
+
+int initCapture(Capture *capture)
+{
+  memset(capture, 0, sizeof(Capture));
+  capture->descriptor = -1;
+  return pthread_mutex_init(&capture->lock, NULL) == 0 ? PLATFORM_SUCCESS : PLATFORM_FAILURE;
+}
+
+// Called with capture->lock held. The log stays valid on failure, and capturing stops.
+static int growCapture(Capture *capture, size_t needed)
+{
+  size_t size = capture->size;
+  while (size < needed)
+  {
+    size *= 2;
+  }
+
+  unmapSharedMemory(capture->memory, capture->size);
+  capture->memory = NULL;
+  if (resizeFile(capture->descriptor, size) == PLATFORM_SUCCESS)
+  {
+    capture->memory = (uint8_t *)mapSharedMemory(capture->descriptor, size, 1);
+  }
+  if (capture->memory == NULL)
+  {
+    capture->enabled = false;
+    return PLATFORM_FAILURE;
+  }
+  capture->size = size;
+  return PLATFORM_SUCCESS;
+}
+
+int openCapture(Capture *capture, const char *path)
+{
+  pthread_mutex_lock(&capture->lock);
+  if (capture->memory)
+  {
+    pthread_mutex_unlock(&capture->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  capture->descriptor = openFile(path, 1);
+  if (capture->descriptor != PLATFORM_FAILURE && resizeFile(capture->descriptor, CAPTURE_INITIAL_SIZE) == PLATFORM_SUCCESS)
+  {
+    capture->memory = (uint8_t *)mapSharedMemory(capture->descriptor, CAPTURE_INITIAL_SIZE, 1);
+  }
+  if (capture->memory == NULL)
+  {
+    closeDescriptor(capture->descriptor);
+    capture->descriptor = -1;
+    pthread_mutex_unlock(&capture->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  CaptureHeader *header = (CaptureHeader *)capture->memory;
+  memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+  header->length = sizeof(CaptureHeader);
+  capture->size = CAPTURE_INITIAL_SIZE;
+  capture->startedAt = monotonicMicroseconds();
+  capture->enabled = true;
+  pthread_mutex_unlock(&capture->lock);
+  return PLATFORM_SUCCESS;
+}
+
+void closeCapture(Capture *capture)
+{
+  pthread_mutex_lock(&capture->lock);
+  capture->enabled = false;
+  if (capture->memory)
+  {
+    size_t length = ((CaptureHeader *)capture->memory)->length;
+    unmapSharedMemory(capture->memory, capture->size);
+    resizeFile(capture->descriptor, length);
+  }
+  closeDescriptor(capture->descriptor);
+  capture->memory = NULL;
+  capture->descriptor = -1;
+  capture->size = 0;
+  pthread_mutex_unlock(&capture->lock);
+}
+
+// Appends an encoded frame and frees it.
+static void appendFrame(Capture *capture, uint64_t receivedAt, int64_t connection, ByteBuffer *frame)
+{
+  pthread_mutex_lock(&capture->lock);
+  size_t length = capture->memory ? ((CaptureHeader *)capture->memory)->length : 0;
+  size_t recordSize = sizeof(CaptureRecord) + paddedLength(frame->length);
+  if (capture->memory == NULL || (length + recordSize > capture->size && growCapture(capture, length + recordSize) != PLATFORM_SUCCESS))
+  {
+    pthread_mutex_unlock(&capture->lock);
+    byteBufferFree(frame);
+    return;
+  }
+
+  CaptureRecord record;
+  record.microseconds = receivedAt > capture->startedAt ? receivedAt - capture->startedAt : 0;
+  record.connection = connection;
+  record.length = (uint32_t)frame->length;
+  record.reserved = 0;
+  memcpy(capture->memory + length, &record, sizeof(CaptureRecord));
+  memcpy(capture->memory + length + sizeof(CaptureRecord), frame->bytes, frame->length);
+  ((CaptureHeader *)capture->memory)->length = length + recordSize;
+
+  pthread_mutex_unlock(&capture->lock);
+  byteBufferFree(frame);
+}
+
+void captureFrame(Capture *capture, uint64_t receivedAt, int64_t connection, const Data *data)
+{
+  // The frame is encoded again from the decoded message, outside the lock, which gives back the received bytes for
+  // every type but strings and JSON.
+  ByteBuffer frame = {0};
+  int encoded = data->type == TYPE_CONNECTED || data->type == TYPE_DISCONNECTED ? encodeRaw(&frame, data->type, NULL, 0) : encodeData(&frame, *data);
+  if (encoded != PLATFORM_SUCCESS)
+  {
+    byteBufferFree(&frame);
+    return;
+  }
+  appendFrame(capture, receivedAt, connection, &frame);
+}
+
+void captureBytes(Capture *capture, uint64_t receivedAt, int64_t connection, NetworkedType type, const void *bytes, uint32_t size)
+{
+  ByteBuffer frame = {0};
+  if (encodeRaw(&frame, type, bytes, size) != PLATFORM_SUCCESS)
+  {
+    byteBufferFree(&frame);
+    return;
+  }
+  appendFrame(capture, receivedAt, connection, &frame);
+}
+
+int openCaptureReader(CaptureReader *reader, const char *path)
+{
+  memset(reader, 0, sizeof(CaptureReader));
+  reader->descriptor = openFile(path, 0);
+  if (reader->descriptor == PLATFORM_FAILURE)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  CaptureHeader header;
+  if (sharedMemorySize(reader->descriptor, &reader->size) != PLATFORM_SUCCESS || reader->size < sizeof(CaptureHeader) ||
+      (reader->memory = (const uint8_t *)mapSharedMemory(reader->descriptor, reader->size, 0)) == NULL)
+  {
+    closeCaptureReader(reader);
+    return PLATFORM_FAILURE;
+  }
+
+  // A log that was still being written when it was copied can be longer than its header says, never shorter.
+  memcpy(&header, reader->memory, sizeof(CaptureHeader));
+  if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.length < sizeof(CaptureHeader) || header.length > reader->size)
+  {
+    closeCaptureReader(reader);
+    return PLATFORM_FAILURE;
+  }
+
+  reader->length = (size_t)header.length;
+  reader->position = sizeof(CaptureHeader);
+  return PLATFORM_SUCCESS;
+}
+
+int nextCaptureRecord(CaptureReader *reader, CaptureRecord *record, const uint8_t **frame)
+{
+  size_t left = reader->length - reader->position;
+  if (left == 0)
+  {
+    return PLATFORM_CONNECTION_CLOSED;
+  }
+  if (left < sizeof(CaptureRecord))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  memcpy(record, reader->memory + reader->position, sizeof(CaptureRecord));
+  if (paddedLength(record->length) > left - sizeof(CaptureRecord))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  *frame = reader->memory + reader->position + sizeof(CaptureRecord);
+  reader->position += sizeof(CaptureRecord) + paddedLength(record->length);
+  return PLATFORM_SUCCESS;
+}
+
+void closeCaptureReader(CaptureReader *reader)
+{
+  unmapSharedMemory((void *)reader->memory, reader->size);
+  closeDescriptor(reader->descriptor);
+  reader->memory = NULL;
+  reader->descriptor = -1;
+}
@@ -0,0 +1,76 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "serialization.h"
+
+#define CAPTURE_MAGIC "NEXCAP1"
+// The log starts this large and doubles whenever a record does not fit.
+#define CAPTURE_INITIAL_SIZE (1024 * 1024)
+
+  // Start of a capture log. length covers the header and every complete record, and only moves once a record is fully
+  // written, so the log of a process that died while capturing still reads up to its last whole record. Every field
+  // of the log is in the byte order of the machine that wrote it.
+  typedef struct
+  {
+    char magic[8];
+    uint64_t length;
+  } CaptureHeader;
+
+  // Followed by the frame as it came off the wire, padded to 8 bytes. microseconds count from the start of the
+  // capture. Connects and disconnects are recorded as empty frames of their type.
+  typedef struct
+  {
+    uint64_t microseconds;
+    int64_t connection;
+    uint32_t length;
+    uint32_t reserved;
+  } CaptureRecord;
+
+  // An append-only log mapped into memory. Receive threads append under lock, and only after checking enabled, so
+  // contexts that do not capture never take it.
+  typedef struct
+  {
+    volatile bool enabled;
+    int descriptor;
+    uint8_t *memory;
+    size_t size;
+    uint64_t startedAt;
+    pthread_mutex_t lock;
+  } Capture;
+
+  typedef struct
+  {
+    int descriptor;
+    const uint8_t *memory;
+    size_t size;
+    size_t length;
+    size_t position;
+  } CaptureReader;
+
+  int initCapture(Capture *capture);
+  // Creates the log at path, replacing any file there, and starts appending to it.
+  int openCapture(Capture *capture, const char *path);
+  // Stops appending and trims the log to its records. Safe on a capture that is not open.
+  void closeCapture(Capture *capture);
+  // Appends the frame of a received message by encoding it again. receivedAt is a monotonicMicroseconds() time. Not for
+  // strings and JSON, whose decoded form no longer holds the received bytes; those go through captureBytes().
+  void captureFrame(Capture *capture, uint64_t receivedAt, int64_t connection, const Data *data);
+  // Appends a frame whose payload is still undecoded, which is then recorded exactly as it was received.
+  void captureBytes(Capture *capture, uint64_t receivedAt, int64_t connection, NetworkedType type, const void *bytes, uint32_t size);
+
+  int openCaptureReader(CaptureReader *reader, const char *path);
+  // Returns PLATFORM_SUCCESS with the next record and its frame, PLATFORM_CONNECTION_CLOSED at the end of the log, and
+  // PLATFORM_FAILURE for a record that runs past it.
+  int nextCaptureRecord(CaptureReader *reader, CaptureRecord *record, const uint8_t **frame);
+  void closeCaptureReader(CaptureReader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,715 @@
+#include "channel.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool seqBefore(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+PeerChannels *createPeerChannels()
+{
+  PeerChannels *channels = (PeerChannels *)calloc(1, sizeof(PeerChannels));
+  if (channels == NULL)
+  {
+    return NULL;
+  }
+
+  if (pthread_mutex_init(&channels->lock, NULL) != 0)
+  {
+    free(channels);
+    return NULL;
+  }
+
+  channels->rtoMs = RELIABLE_INITIAL_RTO_MS;
+  return channels;
+}
+
+void destroyPeerChannels(PeerChannels *channels)
+{
+  if (channels == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < RELIABLE_WINDOW; i++)
+  {
+    free(channels->sent[i].datagram);
+    free(channels->received[i].frame);
+  }
+  byteBufferFree(&channels->stream);
+  byteBufferFree(&channels->paced);
+  clearReassemblies(&channels->reassembly);
+  clearFecDecoder(&channels->fecDecoder);
+  pthread_mutex_destroy(&channels->lock);
+  free(channels);
+}
+
+void configurePeerChannels(PeerChannels *channels, const CongestionOptions *options)
+{
+  pthread_mutex_lock(&channels->lock);
+  configureCongestion(&channels->congestion, options, monotonicMilliseconds());
+  pthread_mutex_unlock(&channels->lock);
+}
+
+void configurePeerFec(PeerChannels *channels, int groupSize)
+{
+  pthread_mutex_lock(&channels->lock);
+  channels->fecGroupSize = groupSize;
+  pthread_mutex_unlock(&channels->lock);
+}
+
+void countReceived(PeerChannels *channels, const uint8_t *datagram, size_t length)
+{
+  if (length < 1 || datagram[0] == PEER_DATAGRAM_ACK || datagram[0] == PEER_DATAGRAM_PROBE || datagram[0] == PEER_DATAGRAM_FEEDBACK ||
+      datagram[0] == PEER_DATAGRAM_HEARTBEAT)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&channels->lock);
+  channels->datagramsReceived++;
+  channels->bytesReceived += (uint32_t)length;
+  pthread_mutex_unlock(&channels->lock);
+}
+
+static int writeDatagram(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, const uint8_t *datagram, size_t length)
+{
+  if (sendDataTo(socket, datagram, length, 0, addr) == PLATFORM_FAILURE)
+  {
+    return PLATFORM_FAILURE;
+  }
+  channels->datagramsSent++;
+  channels->bytesSent += (uint32_t)length;
+  return PLATFORM_SUCCESS;
+}
+
+// Writes a datagram now, or queues it behind the ones the pacer is holding back. Called with the lock held.
+static int transmit(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, const uint8_t *datagram, size_t length)
+{
+  if (channels->pacedHead == channels->paced.length && pacerTake(&channels->congestion, monotonicMilliseconds(), length))
+  {
+    return writeDatagram(channels, socket, addr, datagram, length);
+  }
+
+  size_t previousLength = channels->paced.length;
+  uint32_t recordLength = (uint32_t)length;
+  if (byteBufferAppend(&channels->paced, &recordLength, sizeof(uint32_t)) == PLATFORM_FAILURE ||
+      byteBufferAppend(&channels->paced, datagram, length) == PLATFORM_FAILURE)
+  {
+    channels->paced.length = previousLength;
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+static void drainPaced(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, uint64_t now)
+{
+  while (channels->pacedHead < channels->paced.length)
+  {
+    uint32_t length;
+    memcpy(&length, channels->paced.bytes + channels->pacedHead, sizeof(uint32_t));
+    if (!pacerTake(&channels->congestion, now, length))
+    {
+      break;
+    }
+    writeDatagram(channels, socket, addr, channels->paced.bytes + channels->pacedHead + sizeof(uint32_t), length);
+    channels->pacedHead += sizeof(uint32_t) + length;
+  }
+
+  if (channels->pacedHead == channels->paced.length)
+  {
+    channels->paced.length = 0;
+    channels->pacedHead = 0;
+  }
+  else if (channels->pacedHead > channels->paced.length / 2)
+  {
+    memmove(channels->paced.bytes, channels->paced.bytes + channels->pacedHead, channels->paced.length - channels->pacedHead);
+    channels->paced.length -= channels->pacedHead;
+    channels->pacedHead = 0;
+  }
+}
+
+static void transmitParity(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr)
+{
+  uint8_t parity[FEC_MAX_DATAGRAM];
+  size_t length = fecBuildParity(&channels->fecEncoder, PEER_DATAGRAM_FEC_PARITY, parity);
+  channels->fecParitySent++;
+  channels->fecParityBytes += length;
+  transmit(channels, socket, addr, parity, length);
+}
+
+// Sends a datagram nothing will retransmit, covered by a parity datagram when FEC is on. Called with the lock held.
+static int transmitUnreliable(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, const uint8_t *datagram, size_t length)
+{
+  if (channels->fecGroupSize == 0)
+  {
+    return transmit(channels, socket, addr, datagram, length);
+  }
+
+  uint64_t now = monotonicMilliseconds();
+  uint8_t wrapped[FEC_MAX_DATAGRAM];
+  size_t wrappedLength = fecProtect(&channels->fecEncoder, PEER_DATAGRAM_FEC_DATA, datagram, length, wrapped, now);
+  channels->fecDataBytes += wrappedLength;
+  int result = transmit(channels, socket, addr, wrapped, wrappedLength);
+
+  if (fecParityDue(&channels->fecEncoder, channels->fecGroupSize, now))
+  {
+    transmitParity(channels, socket, addr);
+  }
+  return result;
+}
+
+// Sends a datagram that does not need acknowledging, split into fragments when it is bigger than PEER_FRAGMENT_SIZE.
+// Called with the lock held.
+static int sendDatagramLocked(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, const ByteBuffer *datagram)
+{
+  if (channels->congestion.pacing && channels->paced.length - channels->pacedHead > pacerQueueLimit(&channels->congestion))
+  {
+    return CHANNEL_WINDOW_FULL;
+  }
+
+  int result;
+  if (datagram->length <= PEER_FRAGMENT_SIZE)
+  {
+    result = transmitUnreliable(channels, socket, addr, datagram->bytes, datagram->length);
+  }
+  else
+  {
+    size_t fragments = fragmentCount(datagram->length);
+    uint32_t messageId = channels->nextMessageId++;
+    channels->fragmentsSent += fragments;
+
+    result = fragments > 0 ? PLATFORM_SUCCESS : PLATFORM_FAILURE;
+    uint8_t fragment[PEER_FRAGMENT_SIZE];
+    for (size_t i = 0; i < fragments && result == PLATFORM_SUCCESS; i++)
+    {
+      size_t length = buildFragment(fragment, PEER_DATAGRAM_FRAGMENT, messageId, datagram->bytes, datagram->length, i);
+      result = transmitUnreliable(channels, socket, addr, fragment, length);
+    }
+  }
+  return result;
+}
+
+static int sendDatagram(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, const ByteBuffer *datagram)
+{
+  pthread_mutex_lock(&channels->lock);
+  int result = sendDatagramLocked(channels, socket, addr, datagram);
+  pthread_mutex_unlock(&channels->lock);
+  return result;
+}
+
+int sendUnreliable(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, Data data, size_t *frameLength)
+{
+  ByteBuffer datagram = {0};
+  uint8_t kind = PEER_DATAGRAM_UNRELIABLE;
+
+  int result = byteBufferAppend(&datagram, &kind, sizeof(uint8_t));
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = encodeData(&datagram, data);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    *frameLength = datagram.length - 1;
+    result = sendDatagram(channels, socket, addr, &datagram);
+  }
+
+  byteBufferFree(&datagram);
+  return result;
+}
+
+int receiveFragmented(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t **datagram, size_t *datagramLength)
+{
+  pthread_mutex_lock(&channels->lock);
+  int result = receiveFragment(&channels->reassembly, payload, length, monotonicMilliseconds(), datagram, datagramLength);
+  pthread_mutex_unlock(&channels->lock);
+
+  // A reassembled datagram is handled like one that arrived whole, except that it cannot be another fragment.
+  if (*datagram != NULL && (*datagram)[0] == PEER_DATAGRAM_FRAGMENT)
+  {
+    free(*datagram);
+    *datagram = NULL;
+    return PLATFORM_FAILURE;
+  }
+  return result;
+}
+
+int sendReliable(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, Data data, size_t *frameLength)
+{
+  ByteBuffer frame = {0};
+  if (encodeData(&frame, data) == PLATFORM_FAILURE)
+  {
+    byteBufferFree(&frame);
+    return PLATFORM_FAILURE;
+  }
+  *frameLength = frame.length;
+
+  // The frame is cut into datagram sized pieces. Each piece is sequenced and retransmitted on its own,
+  // and the receiver glues them back together in order.
+  const size_t chunkSize = PEER_FRAGMENT_SIZE - RELIABLE_HEADER_SIZE;
+  uint32_t count = (uint32_t)((frame.length + chunkSize - 1) / chunkSize);
+  uint8_t **datagrams = count <= RELIABLE_WINDOW ? (uint8_t **)calloc(count, sizeof(uint8_t *)) : NULL;
+  if (datagrams == NULL)
+  {
+    byteBufferFree(&frame);
+    return PLATFORM_FAILURE;
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    size_t offset = i * chunkSize;
+    size_t chunk = frame.length - offset < chunkSize ? frame.length - offset : chunkSize;
+    datagrams[i] = (uint8_t *)malloc(RELIABLE_HEADER_SIZE + chunk);
+    if (datagrams[i] == NULL)
+    {
+      for (uint32_t j = 0; j < i; j++)
+      {
+        free(datagrams[j]);
+      }
+      free(datagrams);
+      byteBufferFree(&frame);
+      return PLATFORM_FAILURE;
+    }
+    datagrams[i][0] = PEER_DATAGRAM_RELIABLE;
+    memcpy(datagrams[i] + RELIABLE_HEADER_SIZE, frame.bytes + offset, chunk);
+  }
+
+  pthread_mutex_lock(&channels->lock);
+
+  bool congested = channels->congestion.enabled && channels->inFlightBytes > 0 &&
+                   channels->inFlightBytes + frame.length > congestionWindow(&channels->congestion);
+  if (congested)
+  {
+    channels->congestion.rateLimited = true;
+  }
+  if (congested || channels->nextSeq - channels->oldestUnacked + count > RELIABLE_WINDOW)
+  {
+    pthread_mutex_unlock(&channels->lock);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      free(datagrams[i]);
+    }
+    free(datagrams);
+    byteBufferFree(&frame);
+    return CHANNEL_WINDOW_FULL;
+  }
+
+  uint64_t now = monotonicMilliseconds();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t seq = channels->nextSeq++;
+    uint32_t netSeq = htonl(seq);
+    memcpy(datagrams[i] + 1, &netSeq, sizeof(uint32_t));
+
+    ReliableSlot *slot = &channels->sent[seq % RELIABLE_WINDOW];
+    slot->datagram = datagrams[i];
+    slot->length = RELIABLE_HEADER_SIZE + (i + 1 < count ? chunkSize : frame.length - i * chunkSize);
+    slot->sentAt = now;
+    slot->deadline = now + channels->rtoMs;
+    slot->transmissions = 1;
+    slot->fastRetransmitted = false;
+    channels->inFlightBytes += slot->length;
+
+    // A failed send is recovered by the retransmission timer like any other loss.
+    transmit(channels, socket, addr, slot->datagram, slot->length);
+  }
+
+  pthread_mutex_unlock(&channels->lock);
+  free(datagrams);
+  byteBufferFree(&frame);
+  return PLATFORM_SUCCESS;
+}
+
+// RFC 6298 estimator.
+static void updateRtt(PeerChannels *channels, uint32_t sample)
+{
+  if (!channels->hasRttSample)
+  {
+    channels->smoothedRttMs = sample;
+    channels->rttVarianceMs = sample / 2;
+    channels->hasRttSample = true;
+  }
+  else
+  {
+    uint32_t delta = channels->smoothedRttMs > sample ? channels->smoothedRttMs - sample : sample - channels->smoothedRttMs;
+    channels->rttVarianceMs = (3 * channels->rttVarianceMs + delta) / 4;
+    channels->smoothedRttMs = (7 * channels->smoothedRttMs + sample) / 8;
+  }
+
+  uint32_t rto = channels->smoothedRttMs + (4 * channels->rttVarianceMs > 1 ? 4 * channels->rttVarianceMs : 1);
+  channels->rtoMs = rto < RELIABLE_MIN_RTO_MS ? RELIABLE_MIN_RTO_MS : rto > RELIABLE_MAX_RTO_MS ? RELIABLE_MAX_RTO_MS : rto;
+}
+
+static void ackSlot(PeerChannels *channels, uint32_t seq, uint64_t now)
+{
+  ReliableSlot *slot = &channels->sent[seq % RELIABLE_WINDOW];
+  if (slot->datagram == NULL)
+  {
+    return;
+  }
+
+  // Karn's rule: a retransmitted message gives an ambiguous sample.
+  if (slot->transmissions == 1)
+  {
+    updateRtt(channels, (uint32_t)(now - slot->sentAt));
+  }
+  channels->inFlightBytes -= slot->length;
+  free(slot->datagram);
+  slot->datagram = NULL;
+}
+
+void receiveAck(PeerChannels *channels, const uint8_t *payload, size_t length)
+{
+  if (length < 2 * sizeof(uint32_t))
+  {
+    return;
+  }
+
+  uint32_t nextExpected, bitmap;
+  memcpy(&nextExpected, payload, sizeof(uint32_t));
+  memcpy(&bitmap, payload + sizeof(uint32_t), sizeof(uint32_t));
+  nextExpected = ntohl(nextExpected);
+  bitmap = ntohl(bitmap);
+
+  pthread_mutex_lock(&channels->lock);
+  uint64_t now = monotonicMilliseconds();
+
+  if (seqBefore(channels->nextSeq, nextExpected))
+  {
+    pthread_mutex_unlock(&channels->lock);
+    return;
+  }
+
+  while (seqBefore(channels->oldestUnacked, nextExpected))
+  {
+    ackSlot(channels, channels->oldestUnacked, now);
+    channels->oldestUnacked++;
+  }
+
+  uint32_t highestAcked = nextExpected;
+  for (uint32_t i = 0; i < 32; i++)
+  {
+    uint32_t seq = nextExpected + 1 + i;
+    if ((bitmap & (1u << i)) && seqBefore(seq, channels->nextSeq))
+    {
+      ackSlot(channels, seq, now);
+      highestAcked = seq;
+    }
+  }
+
+  for (uint32_t seq = channels->oldestUnacked; seqBefore(seq, highestAcked); seq++)
+  {
+    ReliableSlot *slot = &channels->sent[seq % RELIABLE_WINDOW];
+    if (slot->datagram && !slot->fastRetransmitted && highestAcked - seq >= RELIABLE_FAST_RETRANSMIT_THRESHOLD)
+    {
+      slot->deadline = now;
+      slot->fastRetransmitted = true;
+    }
+  }
+
+  while (seqBefore(channels->oldestUnacked, channels->nextSeq) && channels->sent[channels->oldestUnacked % RELIABLE_WINDOW].datagram == NULL)
+  {
+    channels->oldestUnacked++;
+  }
+
+  pthread_mutex_unlock(&channels->lock);
+}
+
+uint64_t servicePeerChannels(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, uint64_t now)
+{
+  uint64_t nextDeadline = 0;
+
+  pthread_mutex_lock(&channels->lock);
+  expireReassemblies(&channels->reassembly, now);
+  for (uint32_t seq = channels->oldestUnacked; seqBefore(seq, channels->nextSeq); seq++)
+  {
+    ReliableSlot *slot = &channels->sent[seq % RELIABLE_WINDOW];
+    if (slot->datagram == NULL)
+    {
+      continue;
+    }
+
+    if (slot->deadline <= now)
+    {
+      transmit(channels, socket, addr, slot->datagram, slot->length);
+      uint32_t backoff = slot->transmissions < 5 ? slot->transmissions : 5;
+      uint64_t timeout = (uint64_t)channels->rtoMs << backoff;
+      slot->deadline = now + (timeout < RELIABLE_MAX_RTO_MS ? timeout : RELIABLE_MAX_RTO_MS);
+      slot->transmissions++;
+      channels->retransmits++;
+    }
+
+    if (nextDeadline == 0 || slot->deadline < nextDeadline)
+    {
+      nextDeadline = slot->deadline;
+    }
+  }
+
+  // A group cut short by a pause or by turning FEC off still gets its parity.
+  if (fecParityDue(&channels->fecEncoder, channels->fecGroupSize > 0 ? channels->fecGroupSize : 1, now))
+  {
+    transmitParity(channels, socket, addr);
+  }
+  else if (channels->fecEncoder.count > 0 && (nextDeadline == 0 || channels->fecEncoder.startedAt + FEC_FLUSH_MS < nextDeadline))
+  {
+    nextDeadline = channels->fecEncoder.startedAt + FEC_FLUSH_MS;
+  }
+
+  drainPaced(channels, socket, addr, now);
+  if (channels->pacedHead < channels->paced.length)
+  {
+    nextDeadline = now + 1;
+  }
+
+  // A probe follows whatever was sent since the last one, so its feedback covers exactly those datagrams.
+  if (channels->congestion.enabled && channels->datagramsSent != channels->probedSent)
+  {
+    if (now >= channels->congestion.nextProbeAt)
+    {
+      uint8_t probe[PEER_PROBE_SIZE];
+      uint32_t netSent = htonl(channels->datagramsSent);
+      uint32_t netTime = htonl((uint32_t)now);
+      probe[0] = PEER_DATAGRAM_PROBE;
+      memcpy(probe + 1, &netSent, sizeof(uint32_t));
+      memcpy(probe + 1 + sizeof(uint32_t), &netTime, sizeof(uint32_t));
+      sendDataTo(socket, probe, sizeof(probe), 0, addr);
+
+      channels->probedSent = channels->datagramsSent;
+      channels->congestion.nextProbeAt = now + probeInterval(&channels->congestion);
+    }
+    else if (nextDeadline == 0 || channels->congestion.nextProbeAt < nextDeadline)
+    {
+      nextDeadline = channels->congestion.nextProbeAt;
+    }
+  }
+  pthread_mutex_unlock(&channels->lock);
+
+  return nextDeadline;
+}
+
+int receiveReliable(PeerChannels *channels, const uint8_t *payload, size_t length, ByteBuffer *ready, uint8_t ack[RELIABLE_ACK_SIZE])
+{
+  if (length < sizeof(uint32_t))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  uint32_t seq;
+  memcpy(&seq, payload, sizeof(uint32_t));
+  seq = ntohl(seq);
+  const uint8_t *frame = payload + sizeof(uint32_t);
+  size_t frameLength = length - sizeof(uint32_t);
+
+  int result = PLATFORM_SUCCESS;
+  pthread_mutex_lock(&channels->lock);
+
+  // Anything before nextExpected is a duplicate and anything past the window is dropped; both are just acked.
+  if (!seqBefore(seq, channels->nextExpected) && seq - channels->nextExpected < RELIABLE_WINDOW)
+  {
+    ReorderSlot *slot = &channels->received[seq % RELIABLE_WINDOW];
+    if (slot->frame == NULL)
+    {
+      slot->frame = (uint8_t *)malloc(frameLength);
+      if (slot->frame == NULL)
+      {
+        result = PLATFORM_FAILURE;
+      }
+      else
+      {
+        memcpy(slot->frame, frame, frameLength);
+        slot->length = frameLength;
+      }
+    }
+
+    ReorderSlot *next = &channels->received[channels->nextExpected % RELIABLE_WINDOW];
+    while (result == PLATFORM_SUCCESS && next->frame != NULL)
+    {
+      result = byteBufferAppend(&channels->stream, next->frame, next->length);
+      free(next->frame);
+      next->frame = NULL;
+      channels->nextExpected++;
+      next = &channels->received[channels->nextExpected % RELIABLE_WINDOW];
+    }
+
+    // Only whole frames are handed out, the tail of a frame still in flight stays in the stream.
+    size_t complete = 0;
+    while (channels->stream.length - complete >= 1 + sizeof(uint32_t))
+    {
+      uint32_t size;
+      memcpy(&size, channels->stream.bytes + complete + 1, sizeof(uint32_t));
+      size_t frameLength = 1 + sizeof(uint32_t) + ntohl(size);
+      if (frameLength > channels->stream.length - complete)
+      {
+        break;
+      }
+      complete += frameLength;
+    }
+    if (complete > 0 && result == PLATFORM_SUCCESS)
+    {
+      result = byteBufferAppend(ready, channels->stream.bytes, complete);
+      memmove(channels->stream.bytes, channels->stream.bytes + complete, channels->stream.length - complete);
+      channels->stream.length -= complete;
+    }
+  }
+
+  uint32_t bitmap = 0;
+  for (uint32_t i = 0; i < 32; i++)
+  {
+    uint32_t later = channels->nextExpected + 1 + i;
+    if (later - channels->nextExpected < RELIABLE_WINDOW && channels->received[later % RELIABLE_WINDOW].frame != NULL)
+    {
+      bitmap |= 1u << i;
+    }
+  }
+
+  uint32_t netNext = htonl(channels->nextExpected);
+  uint32_t netBitmap = htonl(bitmap);
+  ack[0] = PEER_DATAGRAM_ACK;
+  memcpy(ack + 1, &netNext, sizeof(uint32_t));
+  memcpy(ack + 1 + sizeof(uint32_t), &netBitmap, sizeof(uint32_t));
+
+  pthread_mutex_unlock(&channels->lock);
+  return result;
+}
+
+int sendSequenced(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, Data data, size_t *frameLength)
+{
+  ByteBuffer datagram = {0};
+  uint8_t kind = PEER_DATAGRAM_SEQUENCED;
+  uint32_t seq = 0;
+
+  if (byteBufferAppend(&datagram, &kind, sizeof(uint8_t)) == PLATFORM_FAILURE ||
+      byteBufferAppend(&datagram, &seq, sizeof(uint32_t)) == PLATFORM_FAILURE ||
+      encodeData(&datagram, data) == PLATFORM_FAILURE)
+  {
+    byteBufferFree(&datagram);
+    return PLATFORM_FAILURE;
+  }
+
+  // Numbered and sent under one lock, so concurrent senders put their messages on the wire in sequence order and the
+  // receiver does not drop the older one as stale.
+  *frameLength = datagram.length - 1 - sizeof(uint32_t);
+  pthread_mutex_lock(&channels->lock);
+  seq = htonl(channels->sequencedNextSeq++);
+  memcpy(datagram.bytes + 1, &seq, sizeof(uint32_t));
+  int result = sendDatagramLocked(channels, socket, addr, &datagram);
+  pthread_mutex_unlock(&channels->lock);
+  byteBufferFree(&datagram);
+  return result;
+}
+
+bool acceptSequenced(PeerChannels *channels, const uint8_t *payload, size_t length)
+{
+  if (length < sizeof(uint32_t))
+  {
+    return false;
+  }
+
+  uint32_t seq;
+  memcpy(&seq, payload, sizeof(uint32_t));
+  seq = ntohl(seq);
+
+  pthread_mutex_lock(&channels->lock);
+  // Duplicates count as stale too, only strictly newer messages get through.
+  bool newer = !channels->hasSequenced || seqBefore(channels->sequencedLatest, seq);
+  if (newer)
+  {
+    channels->sequencedLatest = seq;
+    channels->hasSequenced = true;
+  }
+  else
+  {
+    channels->staleDropped++;
+  }
+  pthread_mutex_unlock(&channels->lock);
+
+  return newer;
+}
+
+int receiveProbe(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t feedback[PEER_FEEDBACK_SIZE])
+{
+  if (length < 2 * sizeof(uint32_t))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  pthread_mutex_lock(&channels->lock);
+  uint32_t netReceived = htonl(channels->datagramsReceived);
+  uint32_t netBytes = htonl(channels->bytesReceived);
+  pthread_mutex_unlock(&channels->lock);
+
+  // The probe's sent count and time are echoed back untouched.
+  feedback[0] = PEER_DATAGRAM_FEEDBACK;
+  memcpy(feedback + 1, payload + sizeof(uint32_t), sizeof(uint32_t));
+  memcpy(feedback + 1 + sizeof(uint32_t), payload, sizeof(uint32_t));
+  memcpy(feedback + 1 + 2 * sizeof(uint32_t), &netReceived, sizeof(uint32_t));
+  memcpy(feedback + 1 + 3 * sizeof(uint32_t), &netBytes, sizeof(uint32_t));
+  return PLATFORM_SUCCESS;
+}
+
+void receiveFeedback(PeerChannels *channels, const uint8_t *payload, size_t length)
+{
+  if (length < 4 * sizeof(uint32_t))
+  {
+    return;
+  }
+
+  uint32_t fields[4];
+  memcpy(fields, payload, sizeof(fields));
+  for (int i = 0; i < 4; i++)
+  {
+    fields[i] = ntohl(fields[i]);
+  }
+
+  pthread_mutex_lock(&channels->lock);
+  congestionFeedback(&channels->congestion, monotonicMilliseconds(), fields[0], fields[1], fields[2], fields[3], channels->datagramsSent);
+  pthread_mutex_unlock(&channels->lock);
+}
+
+int receiveFecData(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength)
+{
+  pthread_mutex_lock(&channels->lock);
+  int result = fecReceiveData(&channels->fecDecoder, payload, length, recovered, recoveredLength);
+  pthread_mutex_unlock(&channels->lock);
+  return result;
+}
+
+int receiveFecParity(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength)
+{
+  pthread_mutex_lock(&channels->lock);
+  int result = fecReceiveParity(&channels->fecDecoder, payload, length, recovered, recoveredLength);
+  pthread_mutex_unlock(&channels->lock);
+  return result;
+}
+
+void getChannelStats(PeerChannels *channels, PeerStats *stats)
+{
+  pthread_mutex_lock(&channels->lock);
+
+  stats->rttMs = (int)channels->smoothedRttMs;
+  stats->rttVarianceMs = (int)channels->rttVarianceMs;
+  stats->retransmitTimeoutMs = (int)channels->rtoMs;
+  stats->retransmits = channels->retransmits;
+  stats->staleDropped = channels->staleDropped;
+  stats->fragmentsSent = channels->fragmentsSent;
+  stats->messagesReassembled = channels->reassembly.completed;
+  stats->reassemblyDropped = channels->reassembly.dropped;
+  stats->sendRateBytesPerSecond = channels->congestion.enabled || channels->congestion.pacing ? (uint64_t)channels->congestion.rate : 0;
+  stats->bandwidthBytesPerSecond = (uint64_t)bandwidthEstimate(&channels->congestion);
+  stats->lossRate = channels->congestion.lossRate;
+  stats->pacedBytes = channels->paced.length - channels->pacedHead;
+  stats->fecParitySent = channels->fecParitySent;
+  stats->fecRecovered = channels->fecDecoder.recovered;
+  stats->fecOverhead = channels->fecDataBytes > 0 ? (double)channels->fecParityBytes / (double)channels->fecDataBytes : 0;
+  stats->inFlight = 0;
+  for (uint32_t seq = channels->oldestUnacked; seqBefore(seq, channels->nextSeq); seq++)
+  {
+    if (channels->sent[seq % RELIABLE_WINDOW].datagram != NULL)
+    {
+      stats->inFlight++;
+    }
+  }
+
+  pthread_mutex_unlock(&channels->lock);
+}
@@ -0,0 +1,148 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "nex.h"
+#include "fragment.h"
+#include "congestion.h"
+#include "fec.h"
+
+// Largest datagram the peer socket reads. The library itself never sends more than PEER_FRAGMENT_SIZE.
+#define PEER_MAX_DATAGRAM 65507
+// How often the peer thread services retransmission timers while the socket is idle.
+#define PEER_TIMER_INTERVAL_MS 5
+
+// Reliable datagrams in flight per peer. Also the size of the receiver's reorder buffer.
+// A reliable message is split over as many datagrams as it needs, so this also caps its size.
+#define RELIABLE_WINDOW 1024
+#define RELIABLE_INITIAL_RTO_MS 200
+#define RELIABLE_MIN_RTO_MS 20
+#define RELIABLE_MAX_RTO_MS 2000
+// A hole is retransmitted early once this many later messages have been selectively acknowledged.
+#define RELIABLE_FAST_RETRANSMIT_THRESHOLD 3
+
+// Returned by the send functions when the window or the pacing queue has no room for the message.
+#define CHANNEL_WINDOW_FULL 2
+
+  // The first byte of every peer datagram says what follows it.
+  typedef enum
+  {
+    PEER_DATAGRAM_UNRELIABLE = 0, // [frame]
+    PEER_DATAGRAM_RELIABLE = 1,   // [seq u32][frame]
+    PEER_DATAGRAM_ACK = 2,        // [next expected seq u32][bitmap u32 of the 32 seqs after it]
+    PEER_DATAGRAM_SEQUENCED = 3,  // [seq u32][frame]
+    PEER_DATAGRAM_FRAGMENT = 4,   // [message id u32][message length u32][index u16][part of another datagram]
+    PEER_DATAGRAM_PROBE = 5,      // [datagrams sent u32][time u32]
+    PEER_DATAGRAM_FEEDBACK = 6,   // [probe time u32][probe datagrams sent u32][datagrams received u32][bytes received u32]
+    PEER_DATAGRAM_FEC_DATA = 7,   // [group u32][index u8][unreliable, sequenced or fragment datagram]
+    PEER_DATAGRAM_FEC_PARITY = 8, // [group u32][count u8][length xor u16][xor of the group's datagrams]
+    PEER_DATAGRAM_HEARTBEAT = 9   // empty
+  } PeerDatagramKind;
+
+#define RELIABLE_HEADER_SIZE (1 + sizeof(uint32_t))
+#define RELIABLE_ACK_SIZE (1 + 2 * sizeof(uint32_t))
+#define PEER_PROBE_SIZE (1 + 2 * sizeof(uint32_t))
+#define PEER_FEEDBACK_SIZE (1 + 4 * sizeof(uint32_t))
+
+  typedef struct
+  {
+    uint8_t *datagram;
+    size_t length;
+    uint64_t sentAt;
+    uint64_t deadline;
+    uint32_t transmissions;
+    bool fastRetransmitted;
+  } ReliableSlot;
+
+  typedef struct
+  {
+    uint8_t *frame;
+    size_t length;
+  } ReorderSlot;
+
+  // Per peer channel state. Written by senders and by the peer thread, so everything is behind lock.
+  typedef struct
+  {
+    uint32_t nextSeq;
+    uint32_t oldestUnacked;
+    ReliableSlot sent[RELIABLE_WINDOW];
+    size_t inFlightBytes;
+
+    uint32_t nextExpected;
+    ReorderSlot received[RELIABLE_WINDOW];
+    ByteBuffer stream;
+
+    bool hasRttSample;
+    uint32_t smoothedRttMs;
+    uint32_t rttVarianceMs;
+    uint32_t rtoMs;
+    uint64_t retransmits;
+
+    uint32_t sequencedNextSeq;
+    uint32_t sequencedLatest;
+    bool hasSequenced;
+    uint64_t staleDropped;
+
+    uint32_t nextMessageId;
+    uint64_t fragmentsSent;
+    ReassemblyTable reassembly;
+
+    // Acks, probes and feedback are not counted, so both ends agree on what the loss is measured over.
+    Congestion congestion;
+    ByteBuffer paced;
+    size_t pacedHead;
+    uint32_t datagramsSent;
+    uint32_t bytesSent;
+    uint32_t probedSent;
+    uint32_t datagramsReceived;
+    uint32_t bytesReceived;
+
+    int fecGroupSize;
+    FecEncoder fecEncoder;
+    FecDecoder fecDecoder;
+    uint64_t fecDataBytes;
+    uint64_t fecParityBytes;
+    uint64_t fecParitySent;
+
+    // Threads still sending or reading stats after finding the peer under ctx->outboundLock. Removing the peer waits
+    // for them before it frees anything.
+    uint64_t users;
+
+    pthread_mutex_t lock;
+  } PeerChannels;
+
+  PeerChannels *createPeerChannels();
+  void destroyPeerChannels(PeerChannels *channels);
+  void configurePeerChannels(PeerChannels *channels, const CongestionOptions *options);
+  void configurePeerFec(PeerChannels *channels, int groupSize);
+  void countReceived(PeerChannels *channels, const uint8_t *datagram, size_t length);
+
+  // The send functions report the size of the encoded message, without channel headers, through frameLength.
+  int sendUnreliable(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, Data data, size_t *frameLength);
+  int receiveFragmented(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t **datagram, size_t *datagramLength);
+
+  int sendReliable(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, Data data, size_t *frameLength);
+  int receiveReliable(PeerChannels *channels, const uint8_t *payload, size_t length, ByteBuffer *ready, uint8_t ack[RELIABLE_ACK_SIZE]);
+  void receiveAck(PeerChannels *channels, const uint8_t *payload, size_t length);
+  uint64_t servicePeerChannels(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, uint64_t now);
+
+  int sendSequenced(PeerChannels *channels, socket_t socket, const struct sockaddr_in *addr, Data data, size_t *frameLength);
+  bool acceptSequenced(PeerChannels *channels, const uint8_t *payload, size_t length);
+
+  int receiveProbe(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t feedback[PEER_FEEDBACK_SIZE]);
+  void receiveFeedback(PeerChannels *channels, const uint8_t *payload, size_t length);
+
+  int receiveFecData(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength);
+  int receiveFecParity(PeerChannels *channels, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength);
+
+  void getChannelStats(PeerChannels *channels, PeerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,161 @@
+#include "congestion.h"
+
+void configureCongestion(Congestion *congestion, const CongestionOptions *options, uint64_t now)
+{
+  congestion->enabled = options->congestionControl;
+  congestion->pacing = options->pacing;
+  congestion->maxRate = options->maxRateBytesPerSecond > 0 ? (double)options->maxRateBytesPerSecond : 0;
+
+  if (congestion->rate == 0)
+  {
+    congestion->rate = options->initialRateBytesPerSecond > 0 ? (double)options->initialRateBytesPerSecond : CONGESTION_INITIAL_RATE;
+    congestion->slowStart = true;
+    congestion->lastRefill = now;
+  }
+  if (congestion->maxRate > 0 && congestion->rate > congestion->maxRate)
+  {
+    congestion->rate = congestion->maxRate;
+  }
+}
+
+static double pacerBurst(const Congestion *congestion)
+{
+  double burst = congestion->rate * PACING_BURST_MS / 1000;
+  return burst > 2 * PEER_FRAGMENT_SIZE ? burst : 2 * PEER_FRAGMENT_SIZE;
+}
+
+bool pacerTake(Congestion *congestion, uint64_t now, size_t length)
+{
+  if (!congestion->pacing)
+  {
+    return true;
+  }
+
+  congestion->tokens += congestion->rate * (double)(now - congestion->lastRefill) / 1000;
+  congestion->lastRefill = now;
+  double burst = pacerBurst(congestion);
+  if (congestion->tokens > burst)
+  {
+    congestion->tokens = burst;
+  }
+
+  // The balance may go negative so a datagram bigger than what is left still goes out, and the next ones wait.
+  if (congestion->tokens <= 0)
+  {
+    congestion->rateLimited = true;
+    return false;
+  }
+  congestion->tokens -= (double)length;
+  return true;
+}
+
+size_t pacerQueueLimit(const Congestion *congestion)
+{
+  double limit = congestion->rate * PACING_MAX_DELAY_MS / 1000;
+  return limit > 4 * PEER_FRAGMENT_SIZE ? (size_t)limit : 4 * PEER_FRAGMENT_SIZE;
+}
+
+uint32_t probeInterval(const Congestion *congestion)
+{
+  return congestion->hasRtt && congestion->latestRttMs > CONGESTION_PROBE_INTERVAL_MS ? congestion->latestRttMs : CONGESTION_PROBE_INTERVAL_MS;
+}
+
+size_t congestionWindow(const Congestion *congestion)
+{
+  // Two round trips worth of the current rate keeps the path busy while the acks come back.
+  double window = 2 * congestion->rate * probeInterval(congestion) / 1000;
+  return window > 4 * PEER_FRAGMENT_SIZE ? (size_t)window : 4 * PEER_FRAGMENT_SIZE;
+}
+
+double bandwidthEstimate(const Congestion *congestion)
+{
+  double best = 0;
+  for (int i = 0; i < CONGESTION_BANDWIDTH_SAMPLES; i++)
+  {
+    if (congestion->bandwidth[i] > best)
+    {
+      best = congestion->bandwidth[i];
+    }
+  }
+  return best;
+}
+
+void congestionFeedback(Congestion *congestion, uint64_t now, uint32_t echoedTime, uint32_t echoedSent, uint32_t received, uint32_t bytes, uint32_t datagramsSent)
+{
+  // Feedback overtaken by a later one says nothing new.
+  if (congestion->hasFeedback && (int32_t)(echoedSent - congestion->lastSent) <= 0)
+  {
+    return;
+  }
+
+  uint32_t rtt = (uint32_t)now - echoedTime;
+  congestion->latestRttMs = rtt;
+  if (!congestion->hasRtt || rtt < congestion->minRttMs)
+  {
+    congestion->minRttMs = rtt;
+  }
+  congestion->hasRtt = true;
+
+  if (congestion->hasFeedback)
+  {
+    uint32_t sent = echoedSent - congestion->lastSent;
+    uint32_t delivered = received - congestion->lastReceived;
+    uint32_t deliveredBytes = bytes - congestion->lastBytes;
+    uint64_t elapsed = now - congestion->lastFeedbackAt > 0 ? now - congestion->lastFeedbackAt : 1;
+
+    double loss = delivered < sent ? (double)(sent - delivered) / sent : 0;
+    congestion->lossRate = (7 * congestion->lossRate + loss) / 8;
+    congestion->bandwidth[congestion->nextBandwidthSample] = (double)deliveredBytes * 1000 / (double)elapsed;
+    congestion->nextBandwidthSample = (congestion->nextBandwidthSample + 1) % CONGESTION_BANDWIDTH_SAMPLES;
+
+    bool congested = loss > CONGESTION_LOSS_THRESHOLD || rtt > 2 * congestion->minRttMs + CONGESTION_DELAY_SLACK_MS;
+    if (congestion->enabled && congested)
+    {
+      // One decrease per round trip: intervals that started before the last decrease still carry its cause.
+      if ((int32_t)(congestion->lastSent - congestion->holdUntilSent) >= 0)
+      {
+        congestion->rate *= CONGESTION_DECREASE;
+        congestion->slowStart = false;
+        congestion->holdUntilSent = datagramsSent;
+      }
+    }
+    else if (congestion->enabled && congestion->rateLimited)
+    {
+      if (congestion->slowStart)
+      {
+        congestion->rate *= 2;
+      }
+      else
+      {
+        congestion->rate += (double)PEER_FRAGMENT_SIZE * 1000 / (rtt > 0 ? rtt : 1);
+      }
+
+      // Growth is only earned by traffic the peer actually took in.
+      double bandwidth = bandwidthEstimate(congestion);
+      if (bandwidth > 0 && congestion->rate > 2 * bandwidth)
+      {
+        congestion->rate = 2 * bandwidth;
+      }
+    }
+
+    if (congestion->rate < CONGESTION_MIN_RATE)
+    {
+      congestion->rate = CONGESTION_MIN_RATE;
+    }
+    if (congestion->maxRate > 0 && congestion->rate > congestion->maxRate)
+    {
+      congestion->rate = congestion->maxRate;
+    }
+  }
+
+  if (!congestion->hasFeedback)
+  {
+    congestion->holdUntilSent = echoedSent;
+  }
+  congestion->rateLimited = false;
+  congestion->hasFeedback = true;
+  congestion->lastSent = echoedSent;
+  congestion->lastReceived = received;
+  congestion->lastBytes = bytes;
+  congestion->lastFeedbackAt = now;
+}
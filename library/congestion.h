@@ -0,0 +1,70 @@
+#ifndef CONGESTION_H
+#define CONGESTION_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "nex.h"
+#include "fragment.h"
+
+// Rates are in bytes per second.
+#define CONGESTION_INITIAL_RATE (1024 * 1024)
+#define CONGESTION_MIN_RATE (16 * 1024)
+// Probes go out once per round trip, but never more often than this.
+#define CONGESTION_PROBE_INTERVAL_MS 10
+// An interval losing more than this fraction of its datagrams counts as congested.
+#define CONGESTION_LOSS_THRESHOLD 0.01
+// An interval whose round trip grew past twice the minimum plus this slack counts as congested.
+#define CONGESTION_DELAY_SLACK_MS 10
+#define CONGESTION_DECREASE 0.7
+// The bandwidth estimate is the best delivery rate over this many feedback intervals.
+#define CONGESTION_BANDWIDTH_SAMPLES 10
+
+// The pacer lets this much traffic out at once, so the peer thread can top it up on its timer.
+#define PACING_BURST_MS 2
+// Unreliable messages are refused once the ones already paced would wait longer than this.
+#define PACING_MAX_DELAY_MS 100
+
+  typedef struct
+  {
+    bool enabled;
+    bool pacing;
+    double rate;
+    double maxRate;
+    bool slowStart;
+    bool rateLimited;
+
+    bool hasRtt;
+    uint32_t minRttMs;
+    uint32_t latestRttMs;
+    uint64_t nextProbeAt;
+
+    bool hasFeedback;
+    uint32_t lastSent;
+    uint32_t lastReceived;
+    uint32_t lastBytes;
+    uint64_t lastFeedbackAt;
+    uint32_t holdUntilSent;
+    double lossRate;
+    double bandwidth[CONGESTION_BANDWIDTH_SAMPLES];
+    int nextBandwidthSample;
+
+    double tokens;
+    uint64_t lastRefill;
+  } Congestion;
+
+  void configureCongestion(Congestion *congestion, const CongestionOptions *options, uint64_t now);
+  bool pacerTake(Congestion *congestion, uint64_t now, size_t length);
+  size_t pacerQueueLimit(const Congestion *congestion);
+  size_t congestionWindow(const Congestion *congestion);
+  uint32_t probeInterval(const Congestion *congestion);
+  void congestionFeedback(Congestion *congestion, uint64_t now, uint32_t echoedTime, uint32_t echoedSent, uint32_t received, uint32_t bytes, uint32_t datagramsSent);
+  double bandwidthEstimate(const Congestion *congestion);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
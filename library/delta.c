@@ -0,0 +1,351 @@
+#include "delta.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DELTA_OP_COPY 1
+#define DELTA_OP_INSERT 2
+#define DELTA_MIN_MATCH 4
+#define DELTA_MAX_TABLE_BITS 16
+
+SnapshotHistory *createSnapshotHistory()
+{
+  SnapshotHistory *history = (SnapshotHistory *)calloc(1, sizeof(SnapshotHistory));
+  if (history == NULL)
+  {
+    return NULL;
+  }
+
+  if (pthread_mutex_init(&history->lock, NULL) != 0)
+  {
+    free(history);
+    return NULL;
+  }
+  return history;
+}
+
+void destroySnapshotHistory(SnapshotHistory *history)
+{
+  if (history == NULL)
+  {
+    return;
+  }
+
+  for (int i = 0; i < SNAPSHOT_HISTORY_SIZE; i++)
+  {
+    free(history->entries[i].text);
+  }
+  pthread_mutex_destroy(&history->lock);
+  free(history);
+}
+
+const SnapshotEntry *findSnapshot(SnapshotHistory *history, uint32_t id)
+{
+  if (id == 0)
+  {
+    return NULL;
+  }
+
+  SnapshotEntry *entry = &history->entries[id % SNAPSHOT_HISTORY_SIZE];
+  if (entry->id != id || entry->text == NULL)
+  {
+    return NULL;
+  }
+  return entry;
+}
+
+int storeSnapshot(SnapshotHistory *history, uint32_t id, const char *text, uint32_t length)
+{
+  char *copy = (char *)malloc(length + 1);
+  if (copy == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+
+  SnapshotEntry *entry = &history->entries[id % SNAPSHOT_HISTORY_SIZE];
+  free(entry->text);
+  entry->id = id;
+  entry->text = copy;
+  entry->length = length;
+  return PLATFORM_SUCCESS;
+}
+
+static int appendVarint(ByteBuffer *out, size_t value)
+{
+  uint8_t bytes[10];
+  int count = 0;
+  do
+  {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    if (value)
+    {
+      byte |= 0x80;
+    }
+    bytes[count++] = byte;
+  } while (value);
+
+  return byteBufferAppend(out, bytes, count);
+}
+
+static int readVarint(const uint8_t *bytes, size_t length, size_t *offset, size_t *value)
+{
+  size_t result = 0;
+  int shift = 0;
+
+  while (*offset < length && shift < 64)
+  {
+    uint8_t byte = bytes[(*offset)++];
+    result |= (size_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+    {
+      *value = result;
+      return PLATFORM_SUCCESS;
+    }
+    shift += 7;
+  }
+  return PLATFORM_FAILURE;
+}
+
+static uint32_t hashBytes(const uint8_t *bytes, int bits)
+{
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(uint32_t));
+  return (value * 2654435761u) >> (32 - bits);
+}
+
+static int flushInsert(ByteBuffer *out, const uint8_t *bytes, size_t length)
+{
+  if (length == 0)
+  {
+    return PLATFORM_SUCCESS;
+  }
+
+  uint8_t op = DELTA_OP_INSERT;
+  if (byteBufferAppend(out, &op, 1) == PLATFORM_FAILURE ||
+      appendVarint(out, length) == PLATFORM_FAILURE ||
+      byteBufferAppend(out, bytes, length) == PLATFORM_FAILURE)
+  {
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int deltaEncode(const uint8_t *base, size_t baseLength, const uint8_t *target, size_t targetLength, ByteBuffer *out)
+{
+  int bits = 8;
+  while (bits < DELTA_MAX_TABLE_BITS && ((size_t)1 << bits) < baseLength)
+  {
+    bits++;
+  }
+
+  size_t tableSize = (size_t)1 << bits;
+  int32_t *table = (int32_t *)malloc(tableSize * sizeof(int32_t));
+  if (table == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+  memset(table, 0xFF, tableSize * sizeof(int32_t));
+
+  for (size_t p = 0; p + DELTA_MIN_MATCH <= baseLength; p++)
+  {
+    uint32_t h = hashBytes(base + p, bits);
+    if (table[h] < 0)
+    {
+      table[h] = (int32_t)p;
+    }
+  }
+
+  // `expected` tracks where the target would continue in the baseline if it kept the same
+  // layout, which is the common case for snapshots whose values change but whose shape doesn't.
+  size_t i = 0;
+  size_t literalStart = 0;
+  size_t expected = 0;
+
+  while (i + DELTA_MIN_MATCH <= targetLength)
+  {
+    int64_t candidate = -1;
+
+    if (expected + DELTA_MIN_MATCH <= baseLength && memcmp(base + expected, target + i, DELTA_MIN_MATCH) == 0)
+    {
+      candidate = (int64_t)expected;
+    }
+    else
+    {
+      int32_t position = table[hashBytes(target + i, bits)];
+      if (position >= 0 && (size_t)position + DELTA_MIN_MATCH <= baseLength && memcmp(base + position, target + i, DELTA_MIN_MATCH) == 0)
+      {
+        candidate = position;
+      }
+    }
+
+    if (candidate < 0)
+    {
+      i++;
+      expected++;
+      continue;
+    }
+
+    size_t matchLength = DELTA_MIN_MATCH;
+    while (i + matchLength < targetLength && (size_t)candidate + matchLength < baseLength && base[candidate + matchLength] == target[i + matchLength])
+    {
+      matchLength++;
+    }
+
+    uint8_t op = DELTA_OP_COPY;
+    if (flushInsert(out, target + literalStart, i - literalStart) == PLATFORM_FAILURE ||
+        byteBufferAppend(out, &op, 1) == PLATFORM_FAILURE ||
+        appendVarint(out, (size_t)candidate) == PLATFORM_FAILURE ||
+        appendVarint(out, matchLength) == PLATFORM_FAILURE)
+    {
+      free(table);
+      return PLATFORM_FAILURE;
+    }
+
+    i += matchLength;
+    literalStart = i;
+    expected = (size_t)candidate + matchLength;
+  }
+
+  free(table);
+  return flushInsert(out, target + literalStart, targetLength - literalStart);
+}
+
+int deltaDecode(const uint8_t *base, size_t baseLength, const uint8_t *delta, size_t deltaLength, ByteBuffer *out)
+{
+  size_t offset = 0;
+
+  while (offset < deltaLength)
+  {
+    uint8_t op = delta[offset++];
+
+    if (op == DELTA_OP_COPY)
+    {
+      size_t position, length;
+      if (readVarint(delta, deltaLength, &offset, &position) == PLATFORM_FAILURE ||
+          readVarint(delta, deltaLength, &offset, &length) == PLATFORM_FAILURE)
+      {
+        return PLATFORM_FAILURE;
+      }
+      if (position > baseLength || length > baseLength - position)
+      {
+        return PLATFORM_FAILURE;
+      }
+      if (byteBufferAppend(out, base + position, length) == PLATFORM_FAILURE)
+      {
+        return PLATFORM_FAILURE;
+      }
+    }
+    else if (op == DELTA_OP_INSERT)
+    {
+      size_t length;
+      if (readVarint(delta, deltaLength, &offset, &length) == PLATFORM_FAILURE)
+      {
+        return PLATFORM_FAILURE;
+      }
+      if (length > deltaLength - offset)
+      {
+        return PLATFORM_FAILURE;
+      }
+      if (byteBufferAppend(out, delta + offset, length) == PLATFORM_FAILURE)
+      {
+        return PLATFORM_FAILURE;
+      }
+      offset += length;
+    }
+    else
+    {
+      return PLATFORM_FAILURE;
+    }
+  }
+
+  return PLATFORM_SUCCESS;
+}
+
+int encodeSnapshot(SnapshotHistory *history, const char *text, uint32_t length, ByteBuffer *frame)
+{
+  pthread_mutex_lock(&history->lock);
+
+  uint32_t id = ++history->lastId;
+  if (id == 0)
+  {
+    id = ++history->lastId;
+  }
+
+  const SnapshotEntry *base = findSnapshot(history, history->ackedId);
+  uint32_t baseId = 0;
+  ByteBuffer delta = {0};
+
+  if (base != NULL && deltaEncode((const uint8_t *)base->text, base->length, (const uint8_t *)text, length, &delta) == PLATFORM_SUCCESS && delta.length < length)
+  {
+    baseId = base->id;
+  }
+
+  uint32_t header[2] = {htonl(id), htonl(baseId)};
+  int result = byteBufferAppend(frame, header, sizeof(header));
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = baseId != 0 ? byteBufferAppend(frame, delta.bytes, delta.length) : byteBufferAppend(frame, text, length);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = storeSnapshot(history, id, text, length);
+  }
+
+  byteBufferFree(&delta);
+  pthread_mutex_unlock(&history->lock);
+  return result;
+}
+
+int decodeSnapshot(SnapshotHistory *history, const uint8_t *frame, uint32_t size, uint32_t *id, cJSON **json)
+{
+  uint32_t header[2];
+  *id = 0;
+  *json = NULL;
+
+  if (size < sizeof(header))
+  {
+    return PLATFORM_FAILURE;
+  }
+  memcpy(header, frame, sizeof(header));
+  *id = ntohl(header[0]);
+  uint32_t baseId = ntohl(header[1]);
+
+  const uint8_t *body = frame + sizeof(header);
+  uint32_t bodyLength = size - sizeof(header);
+
+  pthread_mutex_lock(&history->lock);
+
+  ByteBuffer text = {0};
+  int result;
+  if (baseId == 0)
+  {
+    result = byteBufferAppend(&text, body, bodyLength);
+  }
+  else
+  {
+    const SnapshotEntry *base = findSnapshot(history, baseId);
+    result = base != NULL ? deltaDecode((const uint8_t *)base->text, base->length, body, bodyLength, &text) : PLATFORM_FAILURE;
+  }
+
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = storeSnapshot(history, *id, text.length ? (const char *)text.bytes : "", (uint32_t)text.length);
+    history->lastId = *id;
+  }
+
+  pthread_mutex_unlock(&history->lock);
+
+  if (result == PLATFORM_SUCCESS)
+  {
+    *json = cJSON_ParseWithLength((const char *)text.bytes, text.length);
+    if (*json == NULL)
+    {
+      result = PLATFORM_FAILURE;
+    }
+  }
+
+  byteBufferFree(&text);
+  return result;
+}
@@ -0,0 +1,45 @@
+#ifndef DELTA_H
+#define DELTA_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "serialization.h"
+
+// Number of snapshots both sides remember. A delta is only ever encoded against a baseline
+// that is still inside this window, so the receiver is guaranteed to have it.
+#define SNAPSHOT_HISTORY_SIZE 16
+
+  typedef struct
+  {
+    uint32_t id;
+    char *text;
+    uint32_t length;
+  } SnapshotEntry;
+
+  typedef struct
+  {
+    SnapshotEntry entries[SNAPSHOT_HISTORY_SIZE];
+    uint32_t lastId;
+    uint32_t ackedId;
+    pthread_mutex_t lock;
+  } SnapshotHistory;
+
+  SnapshotHistory *createSnapshotHistory();
+  void destroySnapshotHistory(SnapshotHistory *history);
+  const SnapshotEntry *findSnapshot(SnapshotHistory *history, uint32_t id);
+  int storeSnapshot(SnapshotHistory *history, uint32_t id, const char *text, uint32_t length);
+
+  int deltaEncode(const uint8_t *base, size_t baseLength, const uint8_t *target, size_t targetLength, ByteBuffer *out);
+  int deltaDecode(const uint8_t *base, size_t baseLength, const uint8_t *delta, size_t deltaLength, ByteBuffer *out);
+
+  int encodeSnapshot(SnapshotHistory *history, const char *text, uint32_t length, ByteBuffer *frame);
+  int decodeSnapshot(SnapshotHistory *history, const uint8_t *frame, uint32_t size, uint32_t *id, cJSON **json);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,216 @@
+#include "fec.h"
+#include <stdlib.h>
+#include <string.h>
+
+size_t fecProtect(FecEncoder *encoder, uint8_t kind, const uint8_t *datagram, size_t length, uint8_t out[FEC_MAX_DATAGRAM], uint64_t now)
+{
+  if (encoder->count == 0)
+  {
+    encoder->startedAt = now;
+  }
+
+  uint32_t netGroup = htonl(encoder->group);
+  out[0] = kind;
+  memcpy(out + 1, &netGroup, sizeof(uint32_t));
+  out[1 + sizeof(uint32_t)] = encoder->count;
+  memcpy(out + FEC_DATA_HEADER_SIZE, datagram, length);
+
+  for (size_t i = 0; i < length; i++)
+  {
+    encoder->parity[i] ^= datagram[i];
+  }
+  encoder->lengthXor ^= (uint16_t)length;
+  if (length > encoder->longest)
+  {
+    encoder->longest = length;
+  }
+  encoder->count++;
+
+  return FEC_DATA_HEADER_SIZE + length;
+}
+
+bool fecParityDue(const FecEncoder *encoder, int groupSize, uint64_t now)
+{
+  return encoder->count > 0 && (encoder->count >= groupSize || now - encoder->startedAt >= FEC_FLUSH_MS);
+}
+
+size_t fecBuildParity(FecEncoder *encoder, uint8_t kind, uint8_t out[FEC_MAX_DATAGRAM])
+{
+  uint32_t netGroup = htonl(encoder->group);
+  uint16_t netLengthXor = htons(encoder->lengthXor);
+  out[0] = kind;
+  memcpy(out + 1, &netGroup, sizeof(uint32_t));
+  out[1 + sizeof(uint32_t)] = encoder->count;
+  memcpy(out + 2 + sizeof(uint32_t), &netLengthXor, sizeof(uint16_t));
+  memcpy(out + FEC_PARITY_HEADER_SIZE, encoder->parity, encoder->longest);
+  size_t length = FEC_PARITY_HEADER_SIZE + encoder->longest;
+
+  memset(encoder->parity, 0, encoder->longest);
+  encoder->group++;
+  encoder->count = 0;
+  encoder->lengthXor = 0;
+  encoder->longest = 0;
+  return length;
+}
+
+static void releaseGroup(FecGroup *group)
+{
+  for (int i = 0; i < FEC_MAX_GROUP_SIZE; i++)
+  {
+    free(group->datagrams[i]);
+  }
+  free(group->parity);
+  memset(group, 0, sizeof(FecGroup));
+}
+
+// Finds the slot of a group, recycling it if it still holds an older one. NULL when the group is already too old.
+static FecGroup *findGroup(FecDecoder *decoder, uint32_t id)
+{
+  FecGroup *group = &decoder->groups[id % FEC_GROUPS];
+  if (group->used && group->group != id)
+  {
+    if ((int32_t)(id - group->group) < 0)
+    {
+      return NULL;
+    }
+    releaseGroup(group);
+  }
+  if (!group->used)
+  {
+    group->used = true;
+    group->group = id;
+  }
+  return group;
+}
+
+// Rebuilds the one datagram still missing once the parity and every other datagram of the group are in.
+static void recover(FecDecoder *decoder, FecGroup *group, uint8_t **recovered, size_t *recoveredLength)
+{
+  uint32_t all = group->count == 32 ? UINT32_MAX : (1u << group->count) - 1;
+  uint32_t missing = all & ~group->present;
+  if (group->parity == NULL || missing == 0 || (missing & (missing - 1)) != 0)
+  {
+    return;
+  }
+
+  int index = 0;
+  while (!(missing & (1u << index)))
+  {
+    index++;
+  }
+
+  // Every datagram is XORed into a copy of the parity, so none may be longer than it. A peer that sends otherwise
+  // gets nothing rebuilt.
+  uint16_t length = group->lengthXor;
+  for (int i = 0; i < group->count; i++)
+  {
+    if (i != index)
+    {
+      if (group->lengths[i] > group->parityLength)
+      {
+        return;
+      }
+      length ^= group->lengths[i];
+    }
+  }
+  if (length == 0 || length > group->parityLength)
+  {
+    return;
+  }
+
+  uint8_t *datagram = (uint8_t *)malloc(group->parityLength);
+  if (datagram == NULL)
+  {
+    return;
+  }
+  memcpy(datagram, group->parity, group->parityLength);
+  for (int i = 0; i < group->count; i++)
+  {
+    for (size_t j = 0; i != index && j < group->lengths[i]; j++)
+    {
+      datagram[j] ^= group->datagrams[i][j];
+    }
+  }
+
+  group->present |= 1u << index;
+  decoder->recovered++;
+  *recovered = datagram;
+  *recoveredLength = length;
+}
+
+int fecReceiveData(FecDecoder *decoder, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength)
+{
+  const size_t headerSize = FEC_DATA_HEADER_SIZE - 1;
+  *recovered = NULL;
+  if (length <= headerSize || length - headerSize > PEER_FRAGMENT_SIZE || payload[sizeof(uint32_t)] >= FEC_MAX_GROUP_SIZE)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  uint32_t id;
+  memcpy(&id, payload, sizeof(uint32_t));
+  uint8_t index = payload[sizeof(uint32_t)];
+  FecGroup *group = findGroup(decoder, ntohl(id));
+  if (group == NULL)
+  {
+    return PLATFORM_SUCCESS;
+  }
+
+  // Seen already, or rebuilt from the parity before it showed up.
+  if (group->present & (1u << index))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  size_t datagramLength = length - headerSize;
+  group->datagrams[index] = (uint8_t *)malloc(datagramLength);
+  if (group->datagrams[index] != NULL)
+  {
+    memcpy(group->datagrams[index], payload + headerSize, datagramLength);
+    group->lengths[index] = (uint16_t)datagramLength;
+    group->present |= 1u << index;
+    recover(decoder, group, recovered, recoveredLength);
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int fecReceiveParity(FecDecoder *decoder, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength)
+{
+  const size_t headerSize = FEC_PARITY_HEADER_SIZE - 1;
+  *recovered = NULL;
+  if (length <= headerSize || length - headerSize > PEER_FRAGMENT_SIZE || payload[sizeof(uint32_t)] == 0 ||
+      payload[sizeof(uint32_t)] > FEC_MAX_GROUP_SIZE)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  uint32_t id;
+  uint16_t lengthXor;
+  memcpy(&id, payload, sizeof(uint32_t));
+  memcpy(&lengthXor, payload + 1 + sizeof(uint32_t), sizeof(uint16_t));
+  FecGroup *group = findGroup(decoder, ntohl(id));
+  if (group == NULL || group->parity != NULL)
+  {
+    return PLATFORM_SUCCESS;
+  }
+
+  group->parity = (uint8_t *)malloc(length - headerSize);
+  if (group->parity == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+  memcpy(group->parity, payload + headerSize, length - headerSize);
+  group->parityLength = length - headerSize;
+  group->count = payload[sizeof(uint32_t)];
+  group->lengthXor = ntohs(lengthXor);
+  recover(decoder, group, recovered, recoveredLength);
+  return PLATFORM_SUCCESS;
+}
+
+void clearFecDecoder(FecDecoder *decoder)
+{
+  for (int i = 0; i < FEC_GROUPS; i++)
+  {
+    releaseGroup(&decoder->groups[i]);
+  }
+}
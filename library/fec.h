@@ -0,0 +1,68 @@
+#ifndef FEC_H
+#define FEC_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "fragment.h"
+#include "serialization.h"
+
+// [kind u8][group u32][index u8], followed by the protected datagram.
+#define FEC_DATA_HEADER_SIZE (1 + sizeof(uint32_t) + 1)
+// [kind u8][group u32][datagrams in group u8][xor of their lengths u16], followed by the xor of their bytes.
+#define FEC_PARITY_HEADER_SIZE (1 + sizeof(uint32_t) + 1 + sizeof(uint16_t))
+// Both headers still fit with a full PEER_FRAGMENT_SIZE datagram under the 1232 bytes an IPv6 path always carries.
+#define FEC_MAX_DATAGRAM (FEC_PARITY_HEADER_SIZE + PEER_FRAGMENT_SIZE)
+
+#define FEC_MAX_GROUP_SIZE 32
+// A group that has not filled up after this long gets its parity anyway, so a pause never strands a loss.
+#define FEC_FLUSH_MS 5
+// Groups the receiver keeps around waiting for their parity.
+#define FEC_GROUPS 8
+
+  typedef struct
+  {
+    uint32_t group;
+    uint8_t count;
+    uint16_t lengthXor;
+    size_t longest;
+    uint8_t parity[PEER_FRAGMENT_SIZE];
+    uint64_t startedAt;
+  } FecEncoder;
+
+  typedef struct
+  {
+    bool used;
+    uint32_t group;
+    uint32_t present;
+    uint8_t *datagrams[FEC_MAX_GROUP_SIZE];
+    uint16_t lengths[FEC_MAX_GROUP_SIZE];
+    uint8_t *parity;
+    size_t parityLength;
+    uint8_t count;
+    uint16_t lengthXor;
+  } FecGroup;
+
+  typedef struct
+  {
+    FecGroup groups[FEC_GROUPS];
+    uint64_t recovered;
+  } FecDecoder;
+
+  size_t fecProtect(FecEncoder *encoder, uint8_t kind, const uint8_t *datagram, size_t length, uint8_t out[FEC_MAX_DATAGRAM], uint64_t now);
+  bool fecParityDue(const FecEncoder *encoder, int groupSize, uint64_t now);
+  size_t fecBuildParity(FecEncoder *encoder, uint8_t kind, uint8_t out[FEC_MAX_DATAGRAM]);
+
+  // Both return PLATFORM_FAILURE for a datagram that must not be handled, and set *recovered to a datagram rebuilt from
+  // the parity, which the caller frees.
+  int fecReceiveData(FecDecoder *decoder, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength);
+  int fecReceiveParity(FecDecoder *decoder, const uint8_t *payload, size_t length, uint8_t **recovered, size_t *recoveredLength);
+  void clearFecDecoder(FecDecoder *decoder);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,183 @@
+#include "fragment.h"
+#include <stdlib.h>
+#include <string.h>
+
+size_t fragmentCount(size_t length)
+{
+  size_t fragments = (length + FRAGMENT_CHUNK_SIZE - 1) / FRAGMENT_CHUNK_SIZE;
+  return length > REASSEMBLY_MAX_BYTES || fragments > UINT16_MAX ? 0 : fragments;
+}
+
+size_t buildFragment(uint8_t datagram[PEER_FRAGMENT_SIZE], uint8_t kind, uint32_t messageId, const uint8_t *message, size_t length, size_t index)
+{
+  size_t offset = index * FRAGMENT_CHUNK_SIZE;
+  size_t chunk = length - offset < FRAGMENT_CHUNK_SIZE ? length - offset : FRAGMENT_CHUNK_SIZE;
+  uint32_t netId = htonl(messageId);
+  uint32_t netLength = htonl((uint32_t)length);
+  uint16_t netIndex = htons((uint16_t)index);
+
+  datagram[0] = kind;
+  memcpy(datagram + 1, &netId, sizeof(uint32_t));
+  memcpy(datagram + 1 + sizeof(uint32_t), &netLength, sizeof(uint32_t));
+  memcpy(datagram + 1 + 2 * sizeof(uint32_t), &netIndex, sizeof(uint16_t));
+  memcpy(datagram + FRAGMENT_HEADER_SIZE, message + offset, chunk);
+  return FRAGMENT_HEADER_SIZE + chunk;
+}
+
+static void releaseSlot(ReassemblyTable *table, Reassembly *slot)
+{
+  table->bytesInUse -= slot->length;
+  free(slot->bytes);
+  free(slot->received);
+  memset(slot, 0, sizeof(Reassembly));
+}
+
+static Reassembly *oldestSlot(ReassemblyTable *table)
+{
+  Reassembly *oldest = NULL;
+  for (int i = 0; i < REASSEMBLY_SLOTS; i++)
+  {
+    Reassembly *slot = &table->slots[i];
+    if (slot->bytes && (oldest == NULL || slot->deadline < oldest->deadline))
+    {
+      oldest = slot;
+    }
+  }
+  return oldest;
+}
+
+static Reassembly *startReassembly(ReassemblyTable *table, uint32_t messageId, uint32_t length, uint64_t now)
+{
+  // Make room by dropping the messages closest to timing out.
+  Reassembly *slot = NULL;
+  while (true)
+  {
+    slot = NULL;
+    for (int i = 0; i < REASSEMBLY_SLOTS && slot == NULL; i++)
+    {
+      if (table->slots[i].bytes == NULL)
+      {
+        slot = &table->slots[i];
+      }
+    }
+    if (slot != NULL && table->bytesInUse + length <= REASSEMBLY_MAX_BYTES)
+    {
+      break;
+    }
+
+    Reassembly *oldest = oldestSlot(table);
+    if (oldest == NULL)
+    {
+      return NULL;
+    }
+    releaseSlot(table, oldest);
+    table->dropped++;
+  }
+
+  uint32_t fragments = (length + FRAGMENT_CHUNK_SIZE - 1) / FRAGMENT_CHUNK_SIZE;
+  slot->bytes = (uint8_t *)malloc(length);
+  slot->received = (uint8_t *)calloc((fragments + 7) / 8, 1);
+  if (slot->bytes == NULL || slot->received == NULL)
+  {
+    free(slot->bytes);
+    free(slot->received);
+    memset(slot, 0, sizeof(Reassembly));
+    return NULL;
+  }
+
+  slot->messageId = messageId;
+  slot->length = length;
+  slot->fragments = fragments;
+  slot->receivedCount = 0;
+  slot->deadline = now + REASSEMBLY_TIMEOUT_MS;
+  table->bytesInUse += length;
+  return slot;
+}
+
+int receiveFragment(ReassemblyTable *table, const uint8_t *payload, size_t length, uint64_t now, uint8_t **message, size_t *messageLength)
+{
+  const size_t headerSize = FRAGMENT_HEADER_SIZE - 1;
+  *message = NULL;
+  if (length <= headerSize)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  uint32_t messageId, total;
+  uint16_t index;
+  memcpy(&messageId, payload, sizeof(uint32_t));
+  memcpy(&total, payload + sizeof(uint32_t), sizeof(uint32_t));
+  memcpy(&index, payload + 2 * sizeof(uint32_t), sizeof(uint16_t));
+  messageId = ntohl(messageId);
+  total = ntohl(total);
+  index = ntohs(index);
+
+  uint32_t fragments = (total + FRAGMENT_CHUNK_SIZE - 1) / FRAGMENT_CHUNK_SIZE;
+  size_t offset = (size_t)index * FRAGMENT_CHUNK_SIZE;
+  size_t chunk = length - headerSize;
+  if (total == 0 || total > REASSEMBLY_MAX_BYTES || index >= fragments || chunk != (total - offset < FRAGMENT_CHUNK_SIZE ? total - offset : FRAGMENT_CHUNK_SIZE))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  Reassembly *slot = NULL;
+  for (int i = 0; i < REASSEMBLY_SLOTS && slot == NULL; i++)
+  {
+    if (table->slots[i].bytes && table->slots[i].messageId == messageId && table->slots[i].length == total)
+    {
+      slot = &table->slots[i];
+    }
+  }
+  if (slot == NULL)
+  {
+    slot = startReassembly(table, messageId, total, now);
+    if (slot == NULL)
+    {
+      table->dropped++;
+      return PLATFORM_FAILURE;
+    }
+  }
+
+  if (slot->received[index / 8] & (1u << (index % 8)))
+  {
+    return PLATFORM_SUCCESS;
+  }
+  slot->received[index / 8] |= 1u << (index % 8);
+  slot->receivedCount++;
+  memcpy(slot->bytes + offset, payload + headerSize, chunk);
+
+  if (slot->receivedCount == slot->fragments)
+  {
+    *message = slot->bytes;
+    *messageLength = slot->length;
+    slot->bytes = NULL;
+    table->bytesInUse -= slot->length;
+    free(slot->received);
+    memset(slot, 0, sizeof(Reassembly));
+    table->completed++;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+void expireReassemblies(ReassemblyTable *table, uint64_t now)
+{
+  for (int i = 0; i < REASSEMBLY_SLOTS; i++)
+  {
+    if (table->slots[i].bytes && table->slots[i].deadline <= now)
+    {
+      releaseSlot(table, &table->slots[i]);
+      table->dropped++;
+    }
+  }
+}
+
+void clearReassemblies(ReassemblyTable *table)
+{
+  for (int i = 0; i < REASSEMBLY_SLOTS; i++)
+  {
+    if (table->slots[i].bytes)
+    {
+      releaseSlot(table, &table->slots[i]);
+    }
+  }
+}
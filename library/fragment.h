@@ -0,0 +1,53 @@
+#ifndef FRAGMENT_H
+#define FRAGMENT_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "serialization.h"
+
+// Largest datagram the library sends. Anything bigger is split, so the path never has to fragment at the IP layer.
+#define PEER_FRAGMENT_SIZE 1200
+// [kind u8][message id u32][message length u32][index u16]
+#define FRAGMENT_HEADER_SIZE (1 + 2 * sizeof(uint32_t) + sizeof(uint16_t))
+#define FRAGMENT_CHUNK_SIZE (PEER_FRAGMENT_SIZE - FRAGMENT_HEADER_SIZE)
+
+// Messages being reassembled per peer, and the memory they may hold between them.
+#define REASSEMBLY_SLOTS 16
+#define REASSEMBLY_MAX_BYTES (8 * 1024 * 1024)
+// A message still missing fragments after this long is dropped.
+#define REASSEMBLY_TIMEOUT_MS 3000
+
+  typedef struct
+  {
+    uint8_t *bytes;
+    uint8_t *received;
+    uint32_t messageId;
+    uint32_t length;
+    uint32_t fragments;
+    uint32_t receivedCount;
+    uint64_t deadline;
+  } Reassembly;
+
+  typedef struct
+  {
+    Reassembly slots[REASSEMBLY_SLOTS];
+    size_t bytesInUse;
+    uint64_t completed;
+    uint64_t dropped;
+  } ReassemblyTable;
+
+  // Number of fragments a message of this length is split into, or 0 when it is too big to be reassembled.
+  size_t fragmentCount(size_t length);
+  size_t buildFragment(uint8_t datagram[PEER_FRAGMENT_SIZE], uint8_t kind, uint32_t messageId, const uint8_t *message, size_t length, size_t index);
+  int receiveFragment(ReassemblyTable *table, const uint8_t *payload, size_t length, uint64_t now, uint8_t **message, size_t *messageLength);
+  void expireReassemblies(ReassemblyTable *table, uint64_t now);
+  void clearReassemblies(ReassemblyTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
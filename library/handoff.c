@@ -0,0 +1,188 @@
+#include "handoff.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_HEADER_SIZE 5
+
+int preparePayload(Data data, HandoffPayload *payload)
+{
+  memset(payload, 0, sizeof(HandoffPayload));
+  payload->type = data.type;
+  if (data.type == TYPE_STRING)
+  {
+    payload->bytes = data.data.s;
+  }
+  else if (data.type == TYPE_JSON)
+  {
+    payload->printed = cJSON_PrintUnformatted(data.data.json);
+    payload->bytes = payload->printed;
+  }
+
+  if (payload->bytes == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+  payload->size = strlen(payload->bytes);
+  if (payload->size > UINT32_MAX)
+  {
+    releasePayload(payload);
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+void releasePayload(HandoffPayload *payload)
+{
+  cJSON_free(payload->printed);
+  payload->printed = NULL;
+  payload->bytes = NULL;
+}
+
+int sendHandoff(socket_t socket, const HandoffPayload *payload, bool block)
+{
+  // One byte more than the frame, left zero, so the receiver can use the payload as a string right in the mapping.
+  size_t length = FRAME_HEADER_SIZE + payload->size;
+  int descriptor = createSharedMemory(length + 1);
+  if (descriptor == PLATFORM_FAILURE)
+  {
+    return 0;
+  }
+
+  // The frame is written straight into the memfd, and only a read-only mapping of it is ever made on the other side.
+  uint8_t header[FRAME_HEADER_SIZE];
+  uint32_t size = htonl((uint32_t)payload->size);
+  header[0] = (uint8_t)payload->type;
+  memcpy(header + 1, &size, sizeof(uint32_t));
+  int sealed = PLATFORM_FAILURE;
+  if (writeSharedMemory(descriptor, 0, header, FRAME_HEADER_SIZE) == PLATFORM_SUCCESS &&
+      writeSharedMemory(descriptor, FRAME_HEADER_SIZE, payload->bytes, payload->size) == PLATFORM_SUCCESS)
+  {
+    sealed = sealSharedMemory(descriptor);
+  }
+
+  int result = 0;
+  if (sealed == PLATFORM_SUCCESS)
+  {
+    uint8_t frame[FRAME_HEADER_SIZE] = {TYPE_HANDOFF, 0, 0, 0, 0};
+    if (block)
+    {
+      result = sendDescriptor(socket, descriptor, frame, sizeof(frame));
+    }
+    else
+    {
+      int sent = sendDescriptorNonBlocking(socket, descriptor, frame, sizeof(frame));
+      result = sent == (int)sizeof(frame) ? PLATFORM_SUCCESS : sent == 0 ? 0 : PLATFORM_FAILURE;
+    }
+  }
+  closeDescriptor(descriptor);
+  return result;
+}
+
+// Strings and JSON are left in the mapping for a view when they are followed by the terminating zero, or copied into
+// payload when not. Everything else is decoded.
+static int openHandoff(int descriptor, ByteBuffer *payload, HandoffView *mapped, Data *data, size_t *frameLength)
+{
+  size_t length;
+  if (sharedMemorySealed(descriptor) != PLATFORM_SUCCESS || sharedMemorySize(descriptor, &length) != PLATFORM_SUCCESS || length < FRAME_HEADER_SIZE)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  const uint8_t *frame = (const uint8_t *)mapSharedMemory(descriptor, length, 0);
+  if (frame == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  uint32_t netSize;
+  memcpy(&netSize, frame + 1, sizeof(uint32_t));
+  size_t size = ntohl(netSize);
+  if (size > length - FRAME_HEADER_SIZE || frame[0] == TYPE_HANDOFF)
+  {
+    unmapSharedMemory((void *)frame, length);
+    return PLATFORM_FAILURE;
+  }
+
+  *frameLength = FRAME_HEADER_SIZE + size;
+  if (payload == NULL || (frame[0] != TYPE_STRING && frame[0] != TYPE_JSON))
+  {
+    int result = decodeFrame(frame, *frameLength, data);
+    unmapSharedMemory((void *)frame, length);
+    return result;
+  }
+
+  data->type = (NetworkedType)frame[0];
+  data->data.raw.size = (uint32_t)size;
+  if (*frameLength < length && frame[*frameLength] == 0)
+  {
+    mapped->memory = frame;
+    mapped->size = length;
+    data->data.raw.bytes = (uint8_t *)frame + FRAME_HEADER_SIZE;
+    return PLATFORM_SUCCESS;
+  }
+
+  int result = reservePayload(payload, size);
+  if (result == PLATFORM_SUCCESS)
+  {
+    memcpy(payload->bytes, frame + FRAME_HEADER_SIZE, size);
+    data->data.raw.bytes = payload->bytes;
+  }
+  unmapSharedMemory((void *)frame, length);
+  return result;
+}
+
+static int recvLocal(socket_t socket, ByteBuffer *payload, HandoffView *mapped, Data *data, size_t *frameLength, uint64_t *startedAt)
+{
+  // The type byte is read with its ancillary data, since a plain read would drop the descriptor of a handoff.
+  uint8_t rawType;
+  int descriptor;
+  int result = recvDescriptor(socket, &descriptor, &rawType, 1);
+  data->type = (NetworkedType)rawType;
+  if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
+  {
+    return result;
+  }
+  if (startedAt)
+  {
+    *startedAt = monotonicMicroseconds();
+  }
+
+  // Descriptors only ever come along with a handoff.
+  if (data->type != TYPE_HANDOFF)
+  {
+    closeDescriptor(descriptor);
+    return payload ? recvFrameView(socket, data->type, payload, data, frameLength) : recvFrameBody(socket, data->type, data, frameLength);
+  }
+
+  uint32_t size;
+  result = recvAll(socket, &size, 4, 0);
+  if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
+  {
+    closeDescriptor(descriptor);
+    return result;
+  }
+
+  result = size == 0 && descriptor >= 0 ? openHandoff(descriptor, payload, mapped, data, frameLength) : PLATFORM_FAILURE;
+  closeDescriptor(descriptor);
+  return result;
+}
+
+int recvLocalFrame(socket_t socket, Data *data, size_t *frameLength, uint64_t *startedAt)
+{
+  return recvLocal(socket, NULL, NULL, data, frameLength, startedAt);
+}
+
+int recvLocalView(socket_t socket, ByteBuffer *payload, HandoffView *mapped, Data *data, size_t *frameLength, uint64_t *startedAt)
+{
+  return recvLocal(socket, payload, mapped, data, frameLength, startedAt);
+}
+
+void closeHandoffView(HandoffView *mapped)
+{
+  if (mapped->memory)
+  {
+    unmapSharedMemory((void *)mapped->memory, mapped->size);
+  }
+  mapped->memory = NULL;
+  mapped->size = 0;
+}
@@ -0,0 +1,46 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "serialization.h"
+
+  // The payload of a string or JSON message, with the JSON already printed, so the size of its frame is known before
+  // any of it is written.
+  typedef struct
+  {
+    NetworkedType type;
+    const char *bytes;
+    size_t size;
+    char *printed;
+  } HandoffPayload;
+
+  // A handed off frame left mapped read-only so a view can point into it.
+  typedef struct
+  {
+    const uint8_t *memory;
+    size_t size;
+  } HandoffView;
+
+  int preparePayload(Data data, HandoffPayload *payload);
+  void releasePayload(HandoffPayload *payload);
+  // Writes the frame of a payload into a new memfd, seals it and passes it over a Unix domain socket behind a
+  // TYPE_HANDOFF frame. Returns 0 when no memfd could be set up, or without block when the socket is full, so the caller
+  // can send the frame the usual way.
+  int sendHandoff(socket_t socket, const HandoffPayload *payload, bool block);
+  // The recvAnyFrame() of a Unix domain socket. A handed off frame is mapped read-only and decoded from the mapping,
+  // and frameLength is the size of the frame in the memfd.
+  int recvLocalFrame(socket_t socket, Data *data, size_t *frameLength, uint64_t *startedAt);
+  // The recvFrameView() of a Unix domain socket. A handed off string or JSON frame stays in its mapping, which is
+  // described in mapped and has to be closed once the view is done with.
+  int recvLocalView(socket_t socket, ByteBuffer *payload, HandoffView *mapped, Data *data, size_t *frameLength, uint64_t *startedAt);
+  void closeHandoffView(HandoffView *mapped);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -1,18 +1,35 @@
 #include "internal.h"
+#include <stdlib.h>
+#include <string.h>
+
 NetworkContext networkContext;
 
-void removeClient(int i)
+int findClientIndex(NetworkContext *ctx, socket_t socket)
 {
-  pthread_mutex_lock(&networkContext.lock);
-
-  if (i < 0 || i >= networkContext.server.numClients)
+  for (int i = 0; i < ctx->server.numClients; i++)
   {
-    snprintf(networkContext.lastError, sizeof(networkContext.lastError), "Invalid client index");
-    pthread_mutex_unlock(&networkContext.lock);
-    return;
+    if (ctx->server.clients[i].socket.socket == socket)
+    {
+      return i;
+    }
   }
+  return -1;
+}
 
-  ServerClient *client = &networkContext.server.clients[i];
+// Frees a client that is already out of reach of new senders. Senders that found it earlier are woken up by the
+// shutdown and waited for, since they use everything freed here. The socket is closed last so its descriptor cannot be
+// reused while one of them still writes to it.
+void destroyClient(NetworkContext *ctx, ServerClient *client)
+{
+  closeSharedLink(client->shared);
+  if (!client->isClosed)
+  {
+    shutdownBoth(client->socket.socket);
+  }
+  while (client->outbound && ATOMIC_LOAD_ACQUIRE(&client->outbound->users) > 0)
+  {
+    sleepMilliseconds(1);
+  }
 
   if (client->context && client->contextDeleter)
   {
@@ -21,78 +38,96 @@ void removeClient(int i)
     client->contextDeleter = NULL;
   }
 
+  destroySnapshotHistory(client->snapshots);
+  client->snapshots = NULL;
+
+  cancelPendingRequests(client->requests, REQUEST_DISCONNECTED);
+  destroyRequestTable(client->requests);
+  client->requests = NULL;
+
+  destroyKeepalive(ctx, client->keepalive);
+  client->keepalive = NULL;
+
+  destroyOutboundQueue(client->outbound);
+  client->outbound = NULL;
+  free(client->counters);
+  client->counters = NULL;
+  destroySharedLink(client->shared);
+  client->shared = NULL;
+
   if (!client->isClosed)
   {
     closeSocket(client->socket.socket);
     client->isClosed = true;
   }
+}
 
-  pthread_cancel(networkContext.server.clientThreads[i]);
-  pthread_join(networkContext.server.clientThreads[i], NULL);
+void removeClient(NetworkContext *ctx, socket_t socket)
+{
+  pthread_mutex_lock(&ctx->lock);
 
-  for (int j = i; j < networkContext.server.numClients - 1; j++)
+  int i = findClientIndex(ctx, socket);
+  if (i < 0)
   {
-    networkContext.server.clients[j] = networkContext.server.clients[j + 1];
-    networkContext.server.clientThreads[j] = networkContext.server.clientThreads[j + 1];
+    snprintf(ctx->lastError, sizeof(ctx->lastError), "Invalid client socket");
+    pthread_mutex_unlock(&ctx->lock);
+    return;
   }
 
-  int last = networkContext.server.numClients - 1;
-  memset(&networkContext.server.clients[last], 0, sizeof(ServerClient));
-  networkContext.server.clientThreads[last] = 0;
+  // Senders and the metrics functions walk the clients under outboundLock alone.
+  pthread_mutex_lock(&ctx->outboundLock);
+  ServerClient client = ctx->server.clients[i];
+  for (int j = i; j < ctx->server.numClients - 1; j++)
+  {
+    ctx->server.clients[j] = ctx->server.clients[j + 1];
+    ctx->server.clientThreads[j] = ctx->server.clientThreads[j + 1];
+  }
 
-  networkContext.server.numClients--;
+  int last = ctx->server.numClients - 1;
+  memset(&ctx->server.clients[last], 0, sizeof(ServerClient));
+  ctx->server.clientThreads[last] = 0;
 
-  pthread_mutex_unlock(&networkContext.lock);
+  ctx->server.numClients--;
+  pthread_mutex_unlock(&ctx->outboundLock);
+
+  destroyClient(ctx, &client);
+  pthread_mutex_unlock(&ctx->lock);
 }
 
-void removeAllClients()
+void removeAllClients(NetworkContext *ctx)
 {
-  pthread_mutex_lock(&networkContext.lock);
+  pthread_mutex_lock(&ctx->lock);
 
-  int numClients = networkContext.server.numClients;
+  pthread_mutex_lock(&ctx->outboundLock);
+  int numClients = ctx->server.numClients;
+  ServerClient *clients = ctx->server.clients;
+  ctx->server.numClients = 0;
+  pthread_mutex_unlock(&ctx->outboundLock);
 
   for (int i = 0; i < numClients; i++)
   {
-    ServerClient *client = &networkContext.server.clients[i];
-
-    if (client->context && client->contextDeleter)
-    {
-      client->contextDeleter(client->context);
-      client->context = NULL;
-      client->contextDeleter = NULL;
-    }
-
-    if (!client->isClosed)
-    {
-      closeSocket(client->socket.socket);
-      client->isClosed = true;
-    }
-
-    pthread_cancel(networkContext.server.clientThreads[i]);
-    pthread_join(networkContext.server.clientThreads[i], NULL);
+    destroyClient(ctx, &clients[i]);
   }
 
-  memset(networkContext.server.clients, 0, sizeof(networkContext.server.clients));
-  memset(networkContext.server.clientThreads, 0, sizeof(networkContext.server.clientThreads));
-
-  networkContext.server.numClients = 0;
+  if (ctx->server.clients)
+  {
+    memset(ctx->server.clients, 0, ctx->server.maxClients * sizeof(ServerClient));
+  }
+  if (ctx->server.clientThreads)
+  {
+    memset(ctx->server.clientThreads, 0, ctx->server.maxClients * sizeof(pthread_t));
+  }
 
-  pthread_mutex_unlock(&networkContext.lock);
+  pthread_mutex_unlock(&ctx->lock);
 }
 
-void removePeer(int i)
+static void destroyPeer(NetworkContext *ctx, ConnectedPeer *peer)
 {
-  pthread_mutex_lock(&networkContext.lock);
-
-  if (i < 0 || i >= networkContext.peer.numPeers)
+  while (peer->channels && ATOMIC_LOAD_ACQUIRE(&peer->channels->users) > 0)
   {
-    snprintf(networkContext.lastError, sizeof(networkContext.lastError), "Invalid client index");
-    pthread_mutex_unlock(&networkContext.lock);
-    return;
+    sleepMilliseconds(1);
   }
 
-  ConnectedPeer *peer = &networkContext.peer.peers[i];
-
   if (peer->context && peer->contextDeleter)
   {
     peer->contextDeleter(peer->context);
@@ -106,55 +141,147 @@ void removePeer(int i)
   }
   peer->id = -1;
 
-  pthread_cancel(networkContext.peer.peerThreads[i]);
-  pthread_join(networkContext.peer.peerThreads[i], NULL);
+  destroyPeerChannels(peer->channels);
+  peer->channels = NULL;
+
+  destroyKeepalive(ctx, peer->keepalive);
+  peer->keepalive = NULL;
+}
+
+void removePeer(NetworkContext *ctx, int i)
+{
+  pthread_mutex_lock(&ctx->lock);
+
+  if (i < 0 || i >= ctx->peer.numPeers)
+  {
+    snprintf(ctx->lastError, sizeof(ctx->lastError), "Invalid client index");
+    pthread_mutex_unlock(&ctx->lock);
+    return;
+  }
 
-  for (int j = i; j < networkContext.peer.numPeers - 1; j++)
+  // Senders look peers up under outboundLock alone.
+  pthread_mutex_lock(&ctx->outboundLock);
+  ConnectedPeer peer = ctx->peer.peers[i];
+  for (int j = i; j < ctx->peer.numPeers - 1; j++)
   {
-    networkContext.peer.peers[j] = networkContext.peer.peers[j + 1];
-    networkContext.peer.peerThreads[j] = networkContext.peer.peerThreads[j + 1];
+    ctx->peer.peers[j] = ctx->peer.peers[j + 1];
   }
 
-  int last = networkContext.peer.numPeers - 1;
-  memset(&networkContext.peer.peers[last], 0, sizeof(ConnectedPeer));
-  networkContext.peer.peerThreads[last] = 0;
+  int last = ctx->peer.numPeers - 1;
+  memset(&ctx->peer.peers[last], 0, sizeof(ConnectedPeer));
 
-  networkContext.peer.numPeers--;
+  ctx->peer.numPeers--;
+  pthread_mutex_unlock(&ctx->outboundLock);
 
-  pthread_mutex_unlock(&networkContext.lock);
+  destroyPeer(ctx, &peer);
+  pthread_mutex_unlock(&ctx->lock);
 }
 
-void removeAllPeers()
+void removeAllPeers(NetworkContext *ctx)
 {
-  pthread_mutex_lock(&networkContext.lock);
+  pthread_mutex_lock(&ctx->lock);
 
-  int numClients = networkContext.peer.numPeers;
+  pthread_mutex_lock(&ctx->outboundLock);
+  int numPeers = ctx->peer.numPeers;
+  ctx->peer.numPeers = 0;
+  pthread_mutex_unlock(&ctx->outboundLock);
 
-  for (int i = 0; i < numClients; i++)
+  for (int i = 0; i < numPeers; i++)
   {
-    ConnectedPeer *peer = &networkContext.peer.peers[i];
+    destroyPeer(ctx, &ctx->peer.peers[i]);
+  }
 
-    if (peer->context && peer->contextDeleter)
-    {
-      peer->contextDeleter(peer->context);
-      peer->context = NULL;
-      peer->contextDeleter = NULL;
-    }
+  if (ctx->peer.peers)
+  {
+    memset(ctx->peer.peers, 0, ctx->peer.maxPeers * sizeof(ConnectedPeer));
+  }
 
-    if (!peer->isClosed)
-    {
-      peer->isClosed = true;
-    }
-    peer->id = -1;
+  pthread_mutex_unlock(&ctx->lock);
+}
+int applySocketOptions(NetworkContext *ctx, socket_t socket, bool tcp)
+{
+  SocketOptions *options = &ctx->socketOptions;
+  const char *failed = NULL;
 
-    pthread_cancel(networkContext.peer.peerThreads[i]);
-    pthread_join(networkContext.peer.peerThreads[i], NULL);
+  if (options->sendBufferSize > 0 && setSocketOption(socket, SOCKET_OPTION_SEND_BUFFER, options->sendBufferSize) == PLATFORM_FAILURE)
+  {
+    failed = "SO_SNDBUF";
+  }
+  if (options->receiveBufferSize > 0 && setSocketOption(socket, SOCKET_OPTION_RECEIVE_BUFFER, options->receiveBufferSize) == PLATFORM_FAILURE)
+  {
+    failed = "SO_RCVBUF";
+  }
+  if (options->busyPollMicroseconds > 0 && setSocketOption(socket, SOCKET_OPTION_BUSY_POLL, options->busyPollMicroseconds) == PLATFORM_FAILURE)
+  {
+    failed = "SO_BUSY_POLL";
+  }
+  if (options->priority > 0 && setSocketOption(socket, SOCKET_OPTION_PRIORITY, options->priority) == PLATFORM_FAILURE)
+  {
+    failed = "SO_PRIORITY";
+  }
+  if (tcp && options->noDelay && setSocketOption(socket, SOCKET_OPTION_NO_DELAY, 1) == PLATFORM_FAILURE)
+  {
+    failed = "TCP_NODELAY";
+  }
+  if (tcp && options->quickAck && setSocketOption(socket, SOCKET_OPTION_QUICK_ACK, 1) == PLATFORM_FAILURE)
+  {
+    failed = "TCP_QUICKACK";
   }
 
-  memset(networkContext.peer.peers, 0, sizeof(networkContext.peer.peers));
-  memset(networkContext.peer.peerThreads, 0, sizeof(networkContext.peer.peerThreads));
+  if (failed)
+  {
+    snprintf(ctx->lastError, sizeof(ctx->lastError), "Failed to apply socket option %s", failed);
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+Keepalive *createKeepalive(NetworkContext *ctx, socket_t socket, OutboundQueue *outbound, int peer, const struct sockaddr_in *addr)
+{
+  Keepalive *keepalive = (Keepalive *)calloc(1, sizeof(Keepalive));
+  if (keepalive == NULL)
+  {
+    return NULL;
+  }
+
+  keepalive->socket = socket;
+  keepalive->outbound = outbound;
+  keepalive->peer = peer;
+  if (addr)
+  {
+    keepalive->addr = *addr;
+  }
+  keepalive->lastReceived = monotonicMilliseconds();
+  armKeepalive(ctx, keepalive);
+  return keepalive;
+}
+
+// Replaces the timers of a connection with ones matching the current options. Called with ctx->lock held.
+void armKeepalive(NetworkContext *ctx, Keepalive *keepalive)
+{
+  cancelTimer(ctx->timers, keepalive->heartbeat);
+  cancelTimer(ctx->timers, keepalive->idle);
+  keepalive->heartbeat = 0;
+  keepalive->idle = 0;
 
-  networkContext.peer.numPeers = 0;
+  if (ctx->keepalive.heartbeatIntervalMs > 0)
+  {
+    addTimer(ctx->timers, monotonicMilliseconds() + (uint64_t)ctx->keepalive.heartbeatIntervalMs, TIMER_HEARTBEAT, keepalive, 0, &keepalive->heartbeat);
+  }
+  if (ctx->keepalive.idleTimeoutMs > 0)
+  {
+    addTimer(ctx->timers, keepalive->lastReceived + (uint64_t)ctx->keepalive.idleTimeoutMs, TIMER_IDLE, keepalive, 0, &keepalive->idle);
+  }
+}
 
-  pthread_mutex_unlock(&networkContext.lock);
-}
\ No newline at end of file
+void destroyKeepalive(NetworkContext *ctx, Keepalive *keepalive)
+{
+  if (keepalive == NULL)
+  {
+    return;
+  }
+
+  cancelTimer(ctx->timers, keepalive->heartbeat);
+  cancelTimer(ctx->timers, keepalive->idle);
+  free(keepalive);
+}
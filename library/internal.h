@@ -5,13 +5,48 @@ extern "C"
 {
 #endif
 #include "nex.h"
+#include "delta.h"
+#include "outbound.h"
+#include "request.h"
+#include "channel.h"
+#include "timer.h"
+#include "affinity.h"
+#include "metrics.h"
+#include "trace.h"
+#include "capture.h"
 #include <pthread.h>
+
+#define ACCEPT_DEFAULT_BATCH 64
+// The accept thread wakes up at least this often to notice a shutdown.
+#define ACCEPT_POLL_INTERVAL_MS 100
+// How long the metrics endpoint waits for a scraper to finish sending its request.
+#define METRICS_REQUEST_TIMEOUT_MS 1000
+
+  // Heartbeat and idle timers of one connection or peer. Allocated separately so the timers can point at it while the
+  // client and peer arrays shift. outbound is NULL for a peer, and peer is -1 for a TCP connection.
+  typedef struct
+  {
+    socket_t socket;
+    OutboundQueue *outbound;
+    int peer;
+    struct sockaddr_in addr;
+    uint64_t lastReceived;
+    TimerId heartbeat;
+    TimerId idle;
+  } Keepalive;
+
   typedef struct
   {
     Socket socket;
     bool isClosed;
     void *context;
     void (*contextDeleter)(void *);
+    SnapshotHistory *snapshots;
+    OutboundQueue *outbound;
+    RequestTable *requests;
+    Keepalive *keepalive;
+    ConnectionCounters *counters;
+    SharedLink *shared;
   } ServerClient;
 
   typedef struct
@@ -21,9 +56,13 @@ extern "C"
     bool isClosed;
     void *context;
     void (*contextDeleter)(void *);
+    PeerChannels *channels;
+    Keepalive *keepalive;
   } ConnectedPeer;
 
-  typedef struct
+  typedef struct NetworkContext NetworkContext;
+
+  struct NetworkContext
   {
     Socket socket;
     SocketType socketType;
@@ -39,6 +78,35 @@ extern "C"
     pthread_mutex_t lock;
     bool initialized;
     char lastError[256];
+    Affinity affinity;
+
+    SocketOptions socketOptions;
+    FlushPolicy flushPolicy;
+    BackpressureOptions backpressure;
+    size_t handoffThreshold;
+    pthread_mutex_t outboundLock;
+    pthread_t outboundThread;
+    bool outboundRunning;
+
+    void (*onClientRequest)(Data, socket_t, uint32_t);
+    void (*onServerRequest)(Data, uint32_t);
+    void (*onClientView)(DataView, socket_t);
+    void (*onServerView)(DataView);
+    // Request deadlines, heartbeats and idle timeouts of every connection. TCP timers are serviced by the outbound
+    // thread once timersNeeded is set, peer timers by the peer thread.
+    TimerWheel *timers;
+    bool timersNeeded;
+    KeepaliveOptions keepalive;
+
+    Metrics metrics;
+    Trace trace;
+    Capture capture;
+    struct
+    {
+      socket_t socket;
+      pthread_t thread;
+      bool running;
+    } metricsEndpoint;
 
     // tcp specific fields
     //  server specific fields
@@ -49,7 +117,11 @@ extern "C"
       pthread_t acceptThread;
       int maxClients;
       int numClients;
+      int activeThreads;
+      pthread_cond_t threadsDone;
       bool listening;
+      AcceptOptions accept;
+      AcceptStats acceptStats;
     } server;
 
     // client specific fields
@@ -57,27 +129,45 @@ extern "C"
     {
       pthread_t serverThread;
       bool running;
+      SnapshotHistory *snapshots;
+      OutboundQueue *outbound;
+      RequestTable *requests;
+      Keepalive *keepalive;
+      ConnectionCounters *counters;
+      SharedLink *shared;
     } client;
 
     // udp specific fields
     struct
     {
-      pthread_t *peerThreads;
+      pthread_t receiveThread;
       ConnectedPeer *peers;
       int maxPeers;
       int numPeers;
       bool listening;
       int idIncrementer;
+      CongestionOptions congestion;
+      int fecGroupSize;
+      // When the datagram being handled came off the socket. Only touched by the receive thread.
+      uint64_t receivedAt;
     } peer;
 
-  } NetworkContext;
+  };
 
+  // The instance used by the functions that do not take a context.
   extern NetworkContext networkContext;
 
-  void removeClient(int i);
-  void removeAllClients();
-  void removePeer(int i);
-  void removeAllPeers();
+  int findClientIndex(NetworkContext *ctx, socket_t socket);
+  // Frees a client that no sender can find any more, closing its socket. Called with ctx->lock held.
+  void destroyClient(NetworkContext *ctx, ServerClient *client);
+  void removeClient(NetworkContext *ctx, socket_t socket);
+  void removeAllClients(NetworkContext *ctx);
+  void removePeer(NetworkContext *ctx, int i);
+  void removeAllPeers(NetworkContext *ctx);
+  int applySocketOptions(NetworkContext *ctx, socket_t socket, bool tcp);
+  Keepalive *createKeepalive(NetworkContext *ctx, socket_t socket, OutboundQueue *outbound, int peer, const struct sockaddr_in *addr);
+  void armKeepalive(NetworkContext *ctx, Keepalive *keepalive);
+  void destroyKeepalive(NetworkContext *ctx, Keepalive *keepalive);
 
 #ifdef __cplusplus
 }
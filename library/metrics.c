@@ -0,0 +1,261 @@
+#include "metrics.h"
+#include <stdarg.h>
+#include <string.h>
+
+static const char *typeNames[NEX_METRICS_TYPES] = {
+    NULL, "int", "float", "string", "json", NULL, NULL, "snapshot",
+    "snapshot_ack", "request", "response", "heartbeat", "rejected", NULL, NULL, NULL};
+
+static int typeIndex(NetworkedType type)
+{
+  return (int)type > 0 && (int)type < NEX_METRICS_TYPES ? (int)type : 0;
+}
+
+void recordReceived(Metrics *metrics, ConnectionCounters *counters, NetworkedType type, size_t bytes)
+{
+  int index = typeIndex(type);
+  ATOMIC_ADD(&metrics->messagesReceived[index], 1);
+  ATOMIC_ADD(&metrics->bytesReceived[index], (uint64_t)bytes);
+  if (counters)
+  {
+    ATOMIC_ADD(&counters->messagesReceived, 1);
+    ATOMIC_ADD(&counters->bytesReceived, (uint64_t)bytes);
+  }
+}
+
+void recordSent(Metrics *metrics, ConnectionCounters *counters, NetworkedType type, size_t bytes)
+{
+  int index = typeIndex(type);
+  ATOMIC_ADD(&metrics->messagesSent[index], 1);
+  ATOMIC_ADD(&metrics->bytesSent[index], (uint64_t)bytes);
+  if (counters)
+  {
+    ATOMIC_ADD(&counters->messagesSent, 1);
+    ATOMIC_ADD(&counters->bytesSent, (uint64_t)bytes);
+  }
+}
+
+void recordSendFailure(Metrics *metrics, ConnectionCounters *counters)
+{
+  ATOMIC_ADD(&metrics->sendFailures, 1);
+  if (counters)
+  {
+    ATOMIC_ADD(&counters->sendFailures, 1);
+  }
+}
+
+static int highestBit(uint64_t value)
+{
+  int bit = 0;
+  for (int shift = 32; shift > 0; shift >>= 1)
+  {
+    if (value >> shift)
+    {
+      value >>= shift;
+      bit += shift;
+    }
+  }
+  return bit;
+}
+
+static int bucketIndex(uint64_t value)
+{
+  if (value < 2 * METRICS_SUB_BUCKETS)
+  {
+    return (int)value;
+  }
+
+  int bit = highestBit(value);
+  if (bit >= METRICS_MAX_BIT)
+  {
+    return METRICS_BUCKETS - 1;
+  }
+  int shift = bit - METRICS_SUB_BUCKET_BITS;
+  return (bit - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS + (int)(value >> shift) - METRICS_SUB_BUCKETS;
+}
+
+// Largest value that falls into a bucket, the conservative answer for a percentile.
+static uint64_t bucketHighest(int index)
+{
+  if (index < 2 * METRICS_SUB_BUCKETS)
+  {
+    return (uint64_t)index;
+  }
+
+  int bit = index / METRICS_SUB_BUCKETS + METRICS_SUB_BUCKET_BITS - 1;
+  int shift = bit - METRICS_SUB_BUCKET_BITS;
+  uint64_t sub = (uint64_t)(index % METRICS_SUB_BUCKETS + METRICS_SUB_BUCKETS);
+  return ((sub + 1) << shift) - 1;
+}
+
+void recordLatency(Histogram *histogram, uint64_t microseconds)
+{
+  ATOMIC_ADD(&histogram->buckets[bucketIndex(microseconds)], 1);
+  ATOMIC_ADD(&histogram->count, 1);
+  ATOMIC_ADD(&histogram->sum, microseconds);
+
+  uint64_t max = ATOMIC_LOAD(&histogram->max);
+  while (microseconds > max && !ATOMIC_CAS(&histogram->max, max, microseconds))
+  {
+    max = ATOMIC_LOAD(&histogram->max);
+  }
+}
+
+static void summarize(Histogram *histogram, LatencySummary *summary)
+{
+  memset(summary, 0, sizeof(LatencySummary));
+
+  // The buckets keep moving while they are read, so the percentiles are ranked against what was actually copied.
+  uint64_t copied[METRICS_BUCKETS];
+  uint64_t total = 0;
+  for (int i = 0; i < METRICS_BUCKETS; i++)
+  {
+    copied[i] = ATOMIC_LOAD(&histogram->buckets[i]);
+    total += copied[i];
+  }
+
+  summary->count = ATOMIC_LOAD(&histogram->count);
+  summary->sumMicroseconds = ATOMIC_LOAD(&histogram->sum);
+  summary->maxMicroseconds = ATOMIC_LOAD(&histogram->max);
+  if (total == 0)
+  {
+    return;
+  }
+
+  const double quantiles[4] = {0.5, 0.9, 0.99, 0.999};
+  uint64_t *results[4] = {&summary->p50Microseconds, &summary->p90Microseconds, &summary->p99Microseconds, &summary->p999Microseconds};
+  uint64_t seen = 0;
+  int next = 0;
+  for (int i = 0; i < METRICS_BUCKETS && next < 4; i++)
+  {
+    seen += copied[i];
+    while (next < 4 && seen > 0 && (double)seen >= quantiles[next] * (double)total)
+    {
+      uint64_t value = bucketHighest(i);
+      *results[next++] = value < summary->maxMicroseconds ? value : summary->maxMicroseconds;
+    }
+  }
+}
+
+void snapshotMetrics(Metrics *metrics, MetricsSnapshot *snapshot)
+{
+  memset(snapshot, 0, sizeof(MetricsSnapshot));
+  for (int i = 0; i < NEX_METRICS_TYPES; i++)
+  {
+    snapshot->messagesReceived[i] = ATOMIC_LOAD(&metrics->messagesReceived[i]);
+    snapshot->bytesReceived[i] = ATOMIC_LOAD(&metrics->bytesReceived[i]);
+    snapshot->messagesSent[i] = ATOMIC_LOAD(&metrics->messagesSent[i]);
+    snapshot->bytesSent[i] = ATOMIC_LOAD(&metrics->bytesSent[i]);
+  }
+  snapshot->sendFailures = ATOMIC_LOAD(&metrics->sendFailures);
+  snapshot->connects = ATOMIC_LOAD(&metrics->connects);
+  snapshot->disconnects = ATOMIC_LOAD(&metrics->disconnects);
+  summarize(&metrics->callbackDuration, &snapshot->callbackDuration);
+  summarize(&metrics->deliveryLatency, &snapshot->deliveryLatency);
+}
+
+void snapshotConnection(ConnectionCounters *counters, ConnectionMetrics *snapshot)
+{
+  memset(snapshot, 0, sizeof(ConnectionMetrics));
+  snapshot->messagesReceived = ATOMIC_LOAD(&counters->messagesReceived);
+  snapshot->bytesReceived = ATOMIC_LOAD(&counters->bytesReceived);
+  snapshot->messagesSent = ATOMIC_LOAD(&counters->messagesSent);
+  snapshot->bytesSent = ATOMIC_LOAD(&counters->bytesSent);
+  snapshot->sendFailures = ATOMIC_LOAD(&counters->sendFailures);
+}
+
+static int appendText(ByteBuffer *text, const char *format, ...)
+{
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  if (length < 0 || (size_t)length >= sizeof(line))
+  {
+    return PLATFORM_FAILURE;
+  }
+  return byteBufferAppend(text, line, (size_t)length);
+}
+
+static int appendPerType(ByteBuffer *text, const char *name, const char *help, const uint64_t *values)
+{
+  int result = appendText(text, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+  for (int i = 0; i < NEX_METRICS_TYPES && result == PLATFORM_SUCCESS; i++)
+  {
+    if (typeNames[i])
+    {
+      result = appendText(text, "%s{type=\"%s\"} %llu\n", name, typeNames[i], (unsigned long long)values[i]);
+    }
+  }
+  return result;
+}
+
+static int appendSingle(ByteBuffer *text, const char *name, const char *kind, const char *help, unsigned long long value)
+{
+  return appendText(text, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, kind, name, value);
+}
+
+static int appendSummary(ByteBuffer *text, const char *name, const char *help, const LatencySummary *summary)
+{
+  const char *quantiles[4] = {"0.5", "0.9", "0.99", "0.999"};
+  const uint64_t values[4] = {summary->p50Microseconds, summary->p90Microseconds, summary->p99Microseconds, summary->p999Microseconds};
+
+  int result = appendText(text, "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+  for (int i = 0; i < 4 && result == PLATFORM_SUCCESS; i++)
+  {
+    result = appendText(text, "%s{quantile=\"%s\"} %.6f\n", name, quantiles[i], (double)values[i] / 1e6);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendText(text, "%s_sum %.6f\n%s_count %llu\n", name, (double)summary->sumMicroseconds / 1e6, name, (unsigned long long)summary->count);
+  }
+  return result;
+}
+
+int formatPrometheus(const MetricsSnapshot *snapshot, ByteBuffer *text)
+{
+  int result = appendPerType(text, "nex_messages_received_total", "Messages received, by type.", snapshot->messagesReceived);
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendPerType(text, "nex_received_bytes_total", "Encoded bytes received, by type.", snapshot->bytesReceived);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendPerType(text, "nex_messages_sent_total", "Messages accepted for sending, by type.", snapshot->messagesSent);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendPerType(text, "nex_sent_bytes_total", "Encoded bytes accepted for sending, by type.", snapshot->bytesSent);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendSingle(text, "nex_send_failures_total", "counter", "Messages refused or dropped on the way out.", (unsigned long long)snapshot->sendFailures);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendSingle(text, "nex_connects_total", "counter", "Connections and peers that came up.", (unsigned long long)snapshot->connects);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendSingle(text, "nex_disconnects_total", "counter", "Connections and peers that went away.", (unsigned long long)snapshot->disconnects);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendSingle(text, "nex_connections", "gauge", "Current connections or peers.", (unsigned long long)snapshot->connections);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendSingle(text, "nex_queued_bytes", "gauge", "Bytes waiting in outbound queues.", (unsigned long long)snapshot->queuedBytes);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendSummary(text, "nex_callback_duration_seconds", "Time spent in the data callback.", &snapshot->callbackDuration);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = appendSummary(text, "nex_delivery_latency_seconds", "Time from receiving a message to its callback starting.", &snapshot->deliveryLatency);
+  }
+  return result;
+}
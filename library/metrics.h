@@ -0,0 +1,63 @@
+#ifndef METRICS_H
+#define METRICS_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include "nex.h"
+
+// Log-linear buckets in the style of HdrHistogram: values below 2 * METRICS_SUB_BUCKETS have a bucket each, and every
+// power of two above that is split into METRICS_SUB_BUCKETS equal buckets, so no bucket is wider than 1/16 of its
+// values. Values from 2^METRICS_MAX_BIT microseconds, about 12 days, share the last bucket.
+#define METRICS_SUB_BUCKET_BITS 4
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_MAX_BIT 40
+#define METRICS_BUCKETS ((METRICS_MAX_BIT - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+
+  typedef struct
+  {
+    uint64_t buckets[METRICS_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+  } Histogram;
+
+  typedef struct
+  {
+    uint64_t messagesReceived;
+    uint64_t bytesReceived;
+    uint64_t messagesSent;
+    uint64_t bytesSent;
+    uint64_t sendFailures;
+  } ConnectionCounters;
+
+  // Every field is updated with relaxed atomic adds by whichever thread sees the traffic, without ctx->lock.
+  typedef struct
+  {
+    uint64_t messagesReceived[NEX_METRICS_TYPES];
+    uint64_t bytesReceived[NEX_METRICS_TYPES];
+    uint64_t messagesSent[NEX_METRICS_TYPES];
+    uint64_t bytesSent[NEX_METRICS_TYPES];
+    uint64_t sendFailures;
+    uint64_t connects;
+    uint64_t disconnects;
+    Histogram callbackDuration;
+    Histogram deliveryLatency;
+  } Metrics;
+
+  // counters may be NULL for traffic that only counts towards the context.
+  void recordReceived(Metrics *metrics, ConnectionCounters *counters, NetworkedType type, size_t bytes);
+  void recordSent(Metrics *metrics, ConnectionCounters *counters, NetworkedType type, size_t bytes);
+  void recordSendFailure(Metrics *metrics, ConnectionCounters *counters);
+  void recordLatency(Histogram *histogram, uint64_t microseconds);
+
+  // Fills everything but the connection and queued byte gauges, which the caller knows about.
+  void snapshotMetrics(Metrics *metrics, MetricsSnapshot *snapshot);
+  void snapshotConnection(ConnectionCounters *counters, ConnectionMetrics *snapshot);
+  int formatPrometheus(const MetricsSnapshot *snapshot, ByteBuffer *text);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -1,972 +1,3673 @@
 #include "nex.h"
 #include "internal.h"
+#include <stdlib.h>
+#include <string.h>
 
 static void *serverAcceptLoop(void *arg);
 static void *clientDataLoop(void *arg);
 static void *clientAcceptLoop(void *arg);
-static void *peerAcceptLoop(void *arg);
-static void *peerDataLoop(void *arg);
+static void *peerReceiveLoop(void *arg);
+static void acknowledgeSnapshot(NetworkContext *ctx, socket_t socket, const Data *data);
+static int receiveSnapshot(NetworkContext *ctx, Data *data);
+static void receiveRequestFrame(NetworkContext *ctx, socket_t socket, Data *frame);
+static void *outboundLoop(void *arg);
+static int startOutboundThread(NetworkContext *ctx);
+static int handleOutboundResult(NetworkContext *ctx, OutboundQueue *queue, int result, int events);
+static void setContextSocketOptions(NetworkContext *ctx, const SocketOptions *options);
+static void joinThread(pthread_t *thread);
+static bool isSendableType(NetworkedType type);
+
+static THREAD_LOCAL NetworkContext *currentContext = NULL;
+
+static void setCurrentContext(NetworkContext *ctx)
+{
+  currentContext = ctx;
+}
 
-int init(ConnectionType connectionType, SocketType socketType)
+// Whether the context carries framed streams, the server and client functions, rather than peer datagrams.
+static bool streamConnection(const NetworkContext *ctx)
+{
+  return ctx->connectionType == CONNECTION_TCP || ctx->connectionType == CONNECTION_LOCAL || ctx->connectionType == CONNECTION_SHARED_MEMORY;
+}
+
+// Whether the context connects over Unix domain sockets. Shared memory connections start out as local ones.
+static bool localConnection(const NetworkContext *ctx)
+{
+  return ctx->connectionType == CONNECTION_LOCAL || ctx->connectionType == CONNECTION_SHARED_MEMORY;
+}
+
+static int initContext(NetworkContext *ctx, ConnectionType connectionType, SocketType socketType)
 {
   if (platformInit() != PLATFORM_SUCCESS)
   {
-    strncpy(networkContext.lastError, "Platform initialization failed", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Platform initialization failed", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INITIALIZATION;
   }
 
-  memset(&networkContext, 0, sizeof(NetworkContext));
+  memset(ctx, 0, sizeof(NetworkContext));
 
-  if (pthread_mutex_init(&networkContext.lock, NULL) != 0)
+  if (pthread_mutex_init(&ctx->lock, NULL) != 0 || pthread_mutex_init(&ctx->outboundLock, NULL) != 0 || pthread_cond_init(&ctx->server.threadsDone, NULL) != 0)
   {
-    strncpy(networkContext.lastError, "Thread Mutex Failed to Initialize", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Thread Mutex Failed to Initialize", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INITIALIZATION;
+  }
+
+  if (initTrace(&ctx->trace) != PLATFORM_SUCCESS || initCapture(&ctx->capture) != PLATFORM_SUCCESS)
+  {
+    strncpy(ctx->lastError, "Thread Mutex Failed to Initialize", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INITIALIZATION;
   }
 
-  networkContext.connectionType = connectionType;
-  networkContext.socketType = socketType;
-  networkContext.initialized = true;
+  ctx->timers = createTimerWheel(monotonicMilliseconds());
+  if (ctx->timers == NULL)
+  {
+    strncpy(ctx->lastError, "Out of memory allocating timers", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+
+#ifdef PLATFORM_WINDOWS
+  if (connectionType == CONNECTION_SHARED_MEMORY)
+  {
+    strncpy(ctx->lastError, "CONNECTION_SHARED_MEMORY is not supported on Windows", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+#endif
+
+  ctx->connectionType = connectionType;
+  ctx->socketType = socketType;
+  ctx->initialized = true;
+
+  ctx->flushPolicy.mode = FLUSH_IMMEDIATE;
+  ctx->flushPolicy.maxBufferedBytes = 64 * 1024;
+  ctx->flushPolicy.flushIntervalMs = 0;
+  ctx->flushPolicy.noDelay = false;
+  ctx->flushPolicy.cork = false;
 
   if (socketType == Server)
   {
-    networkContext.server.clientThreads = NULL;
-    networkContext.server.clients = NULL;
-    networkContext.server.maxClients = 0;
-    networkContext.server.numClients = 0;
-    networkContext.server.listening = false;
-    networkContext.server.acceptThread = 0;
+    ctx->server.clientThreads = NULL;
+    ctx->server.clients = NULL;
+    ctx->server.maxClients = 0;
+    ctx->server.numClients = 0;
+    ctx->server.listening = false;
+    ctx->server.acceptThread = 0;
   }
   else if (socketType == Client)
   {
-    networkContext.client.serverThread = 0;
+    ctx->client.serverThread = 0;
   }
   else if (socketType == Peer)
   {
-    networkContext.peer.peerThreads = NULL;
-    networkContext.peer.peers = NULL;
-    networkContext.peer.maxPeers = 0;
-    networkContext.peer.numPeers = 0;
-    networkContext.peer.listening = false;
-    networkContext.peer.idIncrementer = 0;
+    ctx->peer.receiveThread = 0;
+    ctx->peer.peers = NULL;
+    ctx->peer.maxPeers = 0;
+    ctx->peer.numPeers = 0;
+    ctx->peer.listening = false;
+    ctx->peer.idIncrementer = 0;
   }
   else
   {
-    strncpy(networkContext.lastError, "Invalid Socket Type Passed Into: int init(ConnectionType connectionType, SocketType socketType)", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Invalid Socket Type Passed Into: int init(ConnectionType connectionType, SocketType socketType)", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
   return NETWORK_OK;
 }
 
-int startServer(int port, int maxClients, void (*onClientData)(Data, socket_t))
+int startServerCtx(NexContext *ctx, int port, int maxClients, void (*onClientData)(Data, socket_t))
+{
+  return startServerWithOptionsCtx(ctx, port, maxClients, onClientData, NULL);
+}
+
+int startServerWithOptionsCtx(NexContext *ctx, int port, int maxClients, void (*onClientData)(Data, socket_t), const SocketOptions *options)
 {
-  if (networkContext.socketType != Server)
+  if (ctx->socketType != Server)
   {
-    strncpy(networkContext.lastError, "Must have socketType Server passed into init() in order to call startServer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call startServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (networkContext.connectionType != CONNECTION_TCP)
+  if (!streamConnection(ctx))
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call startServer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call startServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
   if (maxClients <= 0 || onClientData == NULL)
   {
-    strncpy(networkContext.lastError, "Invalid max clients or client data passed into: int startServer(int port, int maxClients, void (*onClientData)(Socket *, const char *, size_t))", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Invalid max clients or client data passed into: int startServer(int port, int maxClients, void (*onClientData)(Socket *, const char *, size_t))", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (!networkContext.initialized)
+  if (!ctx->initialized)
   {
-    strncpy(networkContext.lastError, "Platform Is Not Initialized!", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Platform Is Not Initialized!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  networkContext.server.maxClients = maxClients;
-  networkContext.callback.onClientData = onClientData;
+  ctx->server.maxClients = maxClients;
+  ctx->callback.onClientData = onClientData;
+  setContextSocketOptions(ctx, options);
 
-  networkContext.server.clients = (ServerClient *)calloc(maxClients, sizeof(ServerClient));
-  networkContext.server.clientThreads = (pthread_t *)calloc(maxClients, sizeof(pthread_t));
-  if (!networkContext.server.clients || !networkContext.server.clientThreads)
+  ctx->server.clients = (ServerClient *)calloc(maxClients, sizeof(ServerClient));
+  ctx->server.clientThreads = (pthread_t *)calloc(maxClients, sizeof(pthread_t));
+  if (!ctx->server.clients || !ctx->server.clientThreads)
   {
-    strncpy(networkContext.lastError, "Out of memory allocating client arrays", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Out of memory allocating client arrays", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_UNKNOWN;
   }
 
-  networkContext.socket.socket = createSocket(SOCK_STREAM, IPPROTO_TCP);
-  if (networkContext.socket.socket == PLATFORM_FAILURE)
+  ctx->socket.socket = localConnection(ctx) ? createLocalSocket() : createSocket(SOCK_STREAM, IPPROTO_TCP);
+  if (ctx->socket.socket == PLATFORM_FAILURE)
   {
-    strncpy(networkContext.lastError, "Socket creation failed\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
+    strncpy(ctx->lastError, "Socket creation failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
     return NETWORK_ERR_SOCKET;
   }
 
-  networkContext.socket.addr = createSockaddrIn(port, "0.0.0.0");
-  if (bindSocket(networkContext.socket.socket, (struct sockaddr *)&networkContext.socket.addr, sizeof(networkContext.socket.addr)) == PLATFORM_FAILURE)
+  if (applySocketOptions(ctx, ctx->socket.socket, ctx->connectionType == CONNECTION_TCP) == PLATFORM_FAILURE)
   {
-    strncpy(networkContext.lastError, "Socket bind failed\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_SOCKET;
+  }
+
+  int bound;
+  if (localConnection(ctx))
+  {
+    bound = bindLocalSocket(ctx->socket.socket, port);
+  }
+  else
+  {
+    ctx->socket.addr = createSockaddrIn(port, "0.0.0.0");
+    bound = bindSocket(ctx->socket.socket, (struct sockaddr *)&ctx->socket.addr, sizeof(ctx->socket.addr));
+  }
+  if (bound == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Socket bind failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
     return NETWORK_ERR_BIND;
   }
 
-  if (listenSocket(networkContext.socket.socket, 1) == PLATFORM_FAILURE)
+  int backlog = ctx->server.accept.listenBacklog > 0 ? ctx->server.accept.listenBacklog : SOMAXCONN;
+  if (listenSocket(ctx->socket.socket, backlog) == PLATFORM_FAILURE || setSocketBlocking(ctx->socket.socket, 0) == PLATFORM_FAILURE)
   {
-    strncpy(networkContext.lastError, "Listen failed\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
+    strncpy(ctx->lastError, "Listen failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
     return NETWORK_ERR_LISTEN;
   }
 
-  if (pthread_create(&networkContext.server.acceptThread, NULL, serverAcceptLoop, NULL) != 0)
+  ctx->server.listening = true;
+  if (pthread_create(&ctx->server.acceptThread, NULL, serverAcceptLoop, ctx) != 0)
   {
-    strncpy(networkContext.lastError, "pthread_create acceptLoop failed", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
+    ctx->server.listening = false;
+    strncpy(ctx->lastError, "pthread_create acceptLoop failed", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
     return NETWORK_ERR_THREAD;
   }
 
-  pthread_detach(networkContext.server.acceptThread);
-  networkContext.server.listening = true;
-
-  return NETWORK_OK;
+  return startOutboundThread(ctx);
 }
 
-typedef struct
-{
-  ServerClient *client;
-  int clientIndex;
-} ClientThreadArgs;
-
-static void *serverAcceptLoop(void *arg)
+static void sampleAcceptQueue(NetworkContext *ctx)
 {
-  while (networkContext.server.listening)
+  int depth, limit;
+  if (getAcceptQueue(ctx->socket.socket, &depth, &limit) == PLATFORM_SUCCESS)
   {
-
-    pthread_mutex_lock(&networkContext.lock);
-
-    if (networkContext.server.numClients >= networkContext.server.maxClients)
-    {
-      strncpy(networkContext.lastError, "Max clients reached\n", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-      pthread_mutex_unlock(&networkContext.lock);
-      continue;
-    }
-
-    int clientIndex = networkContext.server.numClients;
-
-    pthread_mutex_unlock(&networkContext.lock);
-
-    struct sockaddr_in clientAddr;
-    socklen_t addrLen = sizeof(clientAddr);
-    Socket clientSocket;
-    clientSocket.socket = acceptSocket(networkContext.socket.socket, (struct sockaddr *)&clientAddr, &addrLen);
-    if (clientSocket.socket < 0 && networkContext.server.listening)
-    {
-      strncpy(networkContext.lastError, "Client accept failed\n", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-      continue;
-    }
-
-    if (!networkContext.server.listening)
-    {
-      break;
-    }
-
-    pthread_mutex_lock(&networkContext.lock);
-
-    ServerClient *client = &networkContext.server.clients[clientIndex];
-    client->socket = clientSocket;
-    client->context = NULL;
-    client->contextDeleter = NULL;
-
-    pthread_t thread;
-    ClientThreadArgs *args = (ClientThreadArgs *)malloc(sizeof(ClientThreadArgs));
-    if (!args)
-    {
-      strncpy(networkContext.lastError, "Failed to allocate memory\n", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-      pthread_mutex_unlock(&networkContext.lock);
-      continue;
-    }
-
-    args->client = client;
-    args->clientIndex = clientIndex;
-    int result = pthread_create(&thread, NULL, clientDataLoop, args);
-    networkContext.server.clientThreads[clientIndex] = thread;
-
-    if (result != 0)
-    {
-      strncpy(networkContext.lastError, "Failed to create thread\n", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-      closeSocket(client->socket.socket);
-      removeClient(clientIndex);
-      free(args);
-    }
-    else
+    AcceptStats *stats = &ctx->server.acceptStats;
+    stats->queueDepth = depth;
+    stats->queueLimit = limit;
+    if (depth > stats->queueDepthPeak)
     {
-      pthread_detach(thread);
-      networkContext.server.numClients++;
+      stats->queueDepthPeak = depth;
     }
-    pthread_mutex_unlock(&networkContext.lock);
   }
-
-  return NULL;
 }
 
-static void *clientDataLoop(void *arg)
+int setAcceptOptionsCtx(NexContext *ctx, AcceptOptions options)
 {
-  ClientThreadArgs *args = (ClientThreadArgs *)arg;
-  ServerClient *client = args->client;
-  int clientIndex = args->clientIndex;
-
-  Data clientAcceptedData;
-  clientAcceptedData.type = TYPE_CONNECTED;
-  pthread_mutex_lock(&networkContext.lock);
-  networkContext.callback.onClientData(clientAcceptedData, args->client->socket.socket);
-  pthread_mutex_unlock(&networkContext.lock);
-
-  while (networkContext.server.listening)
+  if (ctx->socketType != Server)
   {
-    Data data;
-
-    int result = recvAny(client->socket.socket, &data);
-    pthread_mutex_lock(&networkContext.lock);
-
-    if (result == PLATFORM_SUCCESS)
-    {
-      networkContext.callback.onClientData(data, args->client->socket.socket);
-      pthread_mutex_unlock(&networkContext.lock);
-      freeRecvData(&data);
-    }
-    else if (result == PLATFORM_CONNECTION_CLOSED)
-    {
-      pthread_mutex_unlock(&networkContext.lock);
-      break;
-    }
-    else
-    {
-      pthread_mutex_unlock(&networkContext.lock);
-    }
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call setAcceptOptions()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
   }
 
-  free(args);
-
-  removeClient(clientIndex);
-
-  clientAcceptedData.type = TYPE_DISCONNECTED;
-  pthread_mutex_lock(&networkContext.lock);
-  networkContext.callback.onClientData(clientAcceptedData, -1);
-  pthread_mutex_unlock(&networkContext.lock);
+  if (options.listenBacklog < 0 || options.acceptBatch < 0)
+  {
+    strncpy(ctx->lastError, "Negative backlog or batch passed into setAcceptOptions()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
 
-  return NULL;
+  pthread_mutex_lock(&ctx->lock);
+  ctx->server.accept = options;
+  // Wakes an accept thread waiting for room, in case queueWhenFull was just turned off.
+  pthread_cond_broadcast(&ctx->server.threadsDone);
+  pthread_mutex_unlock(&ctx->lock);
+  return NETWORK_OK;
 }
 
-int connectToServer(const char *ip, int port, void (*onServerData)(Data))
+int getAcceptStatsCtx(NexContext *ctx, AcceptStats *stats)
 {
-  if (networkContext.socketType != Client)
+  if (ctx->socketType != Server || stats == NULL)
   {
-    strncpy(networkContext.lastError, "Must have socketType Client passed into init() in order to call connectToServer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() and a non NULL stats in order to call getAcceptStats()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (networkContext.connectionType != CONNECTION_TCP)
+  if (!ctx->server.listening)
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call connectToServer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "You cannot call getAcceptStats() before calling startServer() or after calling shutdownNetwork().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (onServerData == NULL)
+  pthread_mutex_lock(&ctx->lock);
+  sampleAcceptQueue(ctx);
+  *stats = ctx->server.acceptStats;
+  pthread_mutex_unlock(&ctx->lock);
+  return NETWORK_OK;
+}
+
+int setThreadPlacementCtx(NexContext *ctx, ThreadPlacement placement)
+{
+  if (ctx->server.listening || ctx->client.running || ctx->peer.listening)
   {
-    strncpy(networkContext.lastError, "Invalid onServerData function: int startServer(int port, int maxClients, void (*onClientData)(Socket *, const char *, size_t))", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "setThreadPlacement() must be called before startServer(), connectToServer() or startPeer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (!networkContext.initialized)
+  bool valid = placement.cpuCount >= 0 && (placement.cpuCount == 0 || placement.cpus != NULL);
+  for (int i = 0; valid && i < placement.cpuCount; i++)
   {
-    strncpy(networkContext.lastError, "Platform Is Not Initialized!", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    valid = placement.cpus[i] >= 0 && placement.cpus[i] < cpuCount();
+  }
+  if (!valid)
+  {
+    strncpy(ctx->lastError, "Invalid CPU list passed into setThreadPlacement()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  networkContext.callback.onServerData = onServerData;
+  pthread_mutex_lock(&ctx->lock);
+  clearAffinity(&ctx->affinity);
+  int result = configureAffinity(&ctx->affinity, &placement);
+  pthread_mutex_unlock(&ctx->lock);
+  if (result == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Out of memory copying the CPU list", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+  return NETWORK_OK;
+}
+
+typedef struct
+{
+  NetworkContext *ctx;
+  socket_t socket;
+  SharedLink *shared;
+  ConnectionCounters *counters;
+  int cpu;
+} ClientThreadArgs;
+
+static void admitClient(NetworkContext *ctx, socket_t socket)
+{
+  // The per client threads read with blocking calls, so the socket leaves non-blocking mode once admitted.
+  setSocketBlocking(socket, 1);
 
-  networkContext.socket.socket = createSocket(SOCK_STREAM, IPPROTO_TCP);
-  if (networkContext.socket.socket == PLATFORM_FAILURE)
+  SharedLink *shared = NULL;
+  if (ctx->connectionType == CONNECTION_SHARED_MEMORY)
   {
-    strncpy(networkContext.lastError, "Socket creation failed\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_SOCKET;
+    shared = offerSharedLink(socket);
+    if (shared == NULL)
+    {
+      closeSocket(socket);
+      pthread_mutex_lock(&ctx->lock);
+      strncpy(ctx->lastError, "Failed to set up shared memory for a client\n", sizeof(ctx->lastError) - 1);
+      ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+      pthread_mutex_unlock(&ctx->lock);
+      return;
+    }
   }
 
-  networkContext.socket.addr = createSockaddrIn(port, ip);
-  if (connectSocket(networkContext.socket.socket, (struct sockaddr *)&networkContext.socket.addr, sizeof(networkContext.socket.addr)) == PLATFORM_FAILURE)
+  pthread_mutex_lock(&ctx->lock);
+
+  // Everything is set up before the client goes into the array, so a failure only has to undo what was allocated.
+  int clientIndex = ctx->server.numClients;
+  ServerClient *client = &ctx->server.clients[clientIndex];
+  memset(client, 0, sizeof(ServerClient));
+  client->socket.socket = socket;
+  client->shared = shared;
+  client->snapshots = createSnapshotHistory();
+  client->counters = (ConnectionCounters *)calloc(1, sizeof(ConnectionCounters));
+  if (client->counters)
   {
-    strncpy(networkContext.lastError, "Failed to connect to server.\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
-    return NETWORK_ERR_CONNECT;
+    client->outbound = createOutboundQueue(socket, ctx->connectionType == CONNECTION_TCP, &ctx->flushPolicy, &ctx->backpressure, &ctx->metrics, client->counters);
+  }
+  if (client->outbound)
+  {
+    client->outbound->shared = shared;
+    client->outbound->handoffThreshold = ctx->connectionType == CONNECTION_LOCAL ? &ctx->handoffThreshold : NULL;
+    client->keepalive = createKeepalive(ctx, socket, client->outbound, -1, NULL);
   }
+  client->requests = createRequestTable(ctx->timers);
 
-  if (pthread_create(&networkContext.client.serverThread, NULL, clientAcceptLoop, NULL) != 0)
+  pthread_t thread;
+  ClientThreadArgs *args = (ClientThreadArgs *)malloc(sizeof(ClientThreadArgs));
+  if (!args || !client->snapshots || !client->keepalive || !client->requests)
   {
-    strncpy(networkContext.lastError, "pthread_create acceptLoop failed", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
-    return NETWORK_ERR_THREAD;
+    free(args);
+    destroyClient(ctx, client);
+    memset(client, 0, sizeof(ServerClient));
+    strncpy(ctx->lastError, "Failed to allocate memory\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    pthread_mutex_unlock(&ctx->lock);
+    return;
+  }
+  applySocketOptions(ctx, socket, ctx->connectionType == CONNECTION_TCP);
+
+  args->ctx = ctx;
+  args->socket = socket;
+  args->shared = shared;
+  args->counters = client->counters;
+  args->cpu = connectionCpu(&ctx->affinity, socket);
+  pthread_mutex_lock(&ctx->outboundLock);
+  ctx->server.numClients++;
+  pthread_mutex_unlock(&ctx->outboundLock);
+  ctx->server.acceptStats.accepted++;
+  int result = pthread_create(&thread, NULL, clientDataLoop, args);
+  ctx->server.clientThreads[clientIndex] = thread;
+
+  if (result != 0)
+  {
+    strncpy(ctx->lastError, "Failed to create thread\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    pthread_mutex_unlock(&ctx->lock);
+    removeClient(ctx, socket);
+    free(args);
+    return;
   }
-  else
+
+  pthread_detach(thread);
+  ctx->server.activeThreads++;
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+// Tells an over capacity client why it is closed, without waiting on it: the socket is still non-blocking and the
+// frame fits any send buffer.
+static void rejectClient(NetworkContext *ctx, socket_t socket, RejectReason reason)
+{
+  ByteBuffer frame = {0};
+  uint32_t netReason = htonl((uint32_t)reason);
+  if (encodeRaw(&frame, TYPE_REJECTED, &netReason, sizeof(uint32_t)) == PLATFORM_SUCCESS)
   {
-    pthread_detach(networkContext.client.serverThread);
+    sendDataNonBlocking(socket, frame.bytes, frame.length);
   }
-  networkContext.client.running = true;
+  byteBufferFree(&frame);
+  closeSocket(socket);
 
-  return NETWORK_OK;
+  pthread_mutex_lock(&ctx->lock);
+  ctx->server.acceptStats.rejected++;
+  strncpy(ctx->lastError, "Max clients reached, connection rejected", sizeof(ctx->lastError) - 1);
+  ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  pthread_mutex_unlock(&ctx->lock);
 }
 
-static void *clientAcceptLoop(void *arg)
+static void *serverAcceptLoop(void *arg)
 {
-  Data serverConnectedData;
-  serverConnectedData.type = TYPE_CONNECTED;
-  networkContext.callback.onServerData(serverConnectedData);
+  NetworkContext *ctx = (NetworkContext *)arg;
+  setCurrentContext(ctx);
+  pinIoThread(&ctx->affinity);
 
-  while (networkContext.client.running)
+  while (ctx->server.listening)
   {
-    Data data;
-    int result = recvAny(networkContext.socket.socket, &data);
-    pthread_mutex_lock(&networkContext.lock);
-
-    if (result == PLATFORM_SUCCESS)
+    // A full server either leaves new connections in the kernel queue until a client thread finishes, or accepts
+    // them only to reject them.
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->server.listening && ctx->server.accept.queueWhenFull && ctx->server.numClients >= ctx->server.maxClients)
     {
-      networkContext.callback.onServerData(data);
-      freeRecvData(&data);
+      pthread_cond_wait(&ctx->server.threadsDone, &ctx->lock);
     }
-    else if (result == PLATFORM_CONNECTION_CLOSED && networkContext.client.running)
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (pollReadable(ctx->socket.socket, ACCEPT_POLL_INTERVAL_MS) != PLATFORM_SUCCESS || !ctx->server.listening)
     {
-      networkContext.client.running = false;
-      closeSocket(networkContext.socket.socket);
+      continue;
     }
 
-    pthread_mutex_unlock(&networkContext.lock);
+    pthread_mutex_lock(&ctx->lock);
+    sampleAcceptQueue(ctx);
+    ctx->server.acceptStats.acceptBatches++;
+    int batch = ctx->server.accept.acceptBatch > 0 ? ctx->server.accept.acceptBatch : ACCEPT_DEFAULT_BATCH;
+    pthread_mutex_unlock(&ctx->lock);
+
+    for (int i = 0; i < batch && ctx->server.listening; i++)
+    {
+      pthread_mutex_lock(&ctx->lock);
+      bool full = ctx->server.numClients >= ctx->server.maxClients;
+      bool queueWhenFull = ctx->server.accept.queueWhenFull;
+      pthread_mutex_unlock(&ctx->lock);
+      if (full && queueWhenFull)
+      {
+        break;
+      }
+
+      struct sockaddr_in clientAddr;
+      socklen_t addrLen = sizeof(clientAddr);
+      socket_t clientSocket;
+      int accepted = acceptPending(ctx->socket.socket, &clientSocket, (struct sockaddr *)&clientAddr, &addrLen);
+      if (accepted == PLATFORM_FAILURE && ctx->server.listening)
+      {
+        strncpy(ctx->lastError, "Client accept failed\n", sizeof(ctx->lastError) - 1);
+        ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+      }
+      if (accepted != PLATFORM_SUCCESS)
+      {
+        break;
+      }
+
+      if (!ctx->server.listening)
+      {
+        closeSocket(clientSocket);
+        break;
+      }
+
+      // Only this thread adds clients, so a server that had room still has it.
+      if (full)
+      {
+        rejectClient(ctx, clientSocket, REJECT_SERVER_FULL);
+      }
+      else
+      {
+        admitClient(ctx, clientSocket);
+      }
+    }
   }
 
-  serverConnectedData.type = TYPE_DISCONNECTED;
-  networkContext.callback.onServerData(serverConnectedData);
   return NULL;
 }
 
-int sendToAllClients(Data data)
+// Records incoming traffic for the idle timeout. Skipped, lock included, while no idle timeout is set.
+static void markReceived(NetworkContext *ctx, socket_t socket)
 {
-  if (networkContext.socketType != Server)
+  if (ctx->keepalive.idleTimeoutMs <= 0)
   {
-    strncpy(networkContext.lastError, "Must have socketType Server passed into init() in order to call sendToAllClients()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    return;
   }
 
-  if (networkContext.connectionType != CONNECTION_TCP)
+  pthread_mutex_lock(&ctx->lock);
+  Keepalive *keepalive = ctx->client.keepalive;
+  if (ctx->socketType == Server)
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call sendToAllClients()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    int i = findClientIndex(ctx, socket);
+    keepalive = i >= 0 ? ctx->server.clients[i].keepalive : NULL;
   }
-
-  int result = NETWORK_OK;
-  for (int i = 0; i < networkContext.server.numClients; i++)
+  if (keepalive)
   {
-    int currentResult = sendToClient(data, networkContext.server.clients[i].socket.socket);
-    if (currentResult != NETWORK_OK)
-    {
-      strncpy(networkContext.lastError, "Sending to all clients failed!", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-      result = currentResult;
-    }
+    keepalive->lastReceived = monotonicMilliseconds();
   }
-  return result;
+  pthread_mutex_unlock(&ctx->lock);
 }
 
-int broadcastToClients(Data data, socket_t sender)
+// Start of a traced step, 0 while tracing is off so untraced paths skip the clock.
+static uint64_t traceStart(NetworkContext *ctx)
 {
-  if (networkContext.socketType != Server)
-  {
-    strncpy(networkContext.lastError, "Must have socketType Server passed into init() in order to call broadcastToClients()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
-  }
+  return ctx->trace.enabled ? monotonicMicroseconds() : 0;
+}
 
-  if (networkContext.connectionType != CONNECTION_TCP)
+static void traceEnd(NetworkContext *ctx, TraceStage stage, uint64_t startedAt, int64_t connection, NetworkedType type, size_t bytes)
+{
+  if (startedAt != 0)
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call broadcastToClients()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    traceEvent(&ctx->trace, stage, startedAt, monotonicMicroseconds(), connection, type, bytes);
   }
+}
 
-  int result = NETWORK_OK;
-  for (int i = 0; i < networkContext.server.numClients; i++)
-  {
-    if (networkContext.server.clients[i].socket.socket == sender)
-    {
-      continue;
-    }
+// Brackets a data callback to time it and the wait since its message came off the socket. Called with ctx->lock held.
+static uint64_t beginCallback(NetworkContext *ctx, uint64_t receivedAt)
+{
+  uint64_t now = monotonicMicroseconds();
+  recordLatency(&ctx->metrics.deliveryLatency, now - receivedAt);
+  return now;
+}
 
-    int currentResult = sendToClient(data, networkContext.server.clients[i].socket.socket);
-    if (currentResult != NETWORK_OK)
-    {
-      strncpy(networkContext.lastError, "Broadcasting to clients failed!", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-      result = currentResult;
-    }
-  }
-  return result;
+static void endCallback(NetworkContext *ctx, uint64_t startedAt, int64_t connection, NetworkedType type, size_t bytes)
+{
+  uint64_t now = monotonicMicroseconds();
+  recordLatency(&ctx->metrics.callbackDuration, now - startedAt);
+  traceEvent(&ctx->trace, TRACE_CALLBACK, startedAt, now, connection, type, bytes);
 }
 
-int setClientContext(void *context, socket_t client, void (*deleter)(void *))
+static int receiveFrame(NetworkContext *ctx, socket_t socket, SharedLink *shared, Data *data, size_t *frameLength, uint64_t *startedAt)
 {
-  if (networkContext.socketType != Server)
+  if (shared)
   {
-    strncpy(networkContext.lastError, "Must have socketType Server passed into init() in order to call setClientContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    return recvSharedFrame(shared, data, frameLength, startedAt);
   }
-
-  if (networkContext.connectionType != CONNECTION_TCP)
+  if (ctx->connectionType == CONNECTION_LOCAL)
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call setClientContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    return recvLocalFrame(socket, data, frameLength, startedAt);
   }
+  return recvAnyFrame(socket, data, frameLength, startedAt);
+}
 
-  if (client == -1)
+// The receiveFrame of a connection with a view handler. Strings and JSON stay in source, the receive buffer of the
+// connection, rather than being decoded into a Data of their own. A handed off one stays in its mapping instead, which
+// leaves source NULL.
+static int receiveView(NetworkContext *ctx, socket_t socket, SharedLink *shared, ByteBuffer *payload, HandoffView *mapped, ByteBuffer **source,
+                       Data *data, size_t *frameLength, uint64_t *startedAt)
+{
+  if (shared)
   {
-    strncpy(networkContext.lastError, "Cannot set conext of an invalid or closed client", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    *source = &shared->frame;
+    return recvSharedView(shared, data, frameLength, startedAt);
   }
 
-  for (int i = 0; i < networkContext.server.numClients; i++)
+  *source = payload;
+  if (ctx->connectionType == CONNECTION_LOCAL)
   {
-    if (networkContext.server.clients[i].socket.socket != client)
+    int result = recvLocalView(socket, payload, mapped, data, frameLength, startedAt);
+    if (mapped->memory)
     {
-      continue;
+      *source = NULL;
     }
-
-    networkContext.server.clients[i].context = context;
-    networkContext.server.clients[i].contextDeleter = deleter;
-
-    return NETWORK_OK;
+    return result;
   }
 
-  strncpy(networkContext.lastError, "Client passed into setClientContext does not exist!", sizeof(networkContext.lastError) - 1);
-  networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-  return NETWORK_ERR_UNKNOWN;
+  uint8_t rawType;
+  int result = recvData(socket, &rawType, 1, 0);
+  data->type = (NetworkedType)rawType;
+  if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
+  {
+    return result;
+  }
+  if (startedAt)
+  {
+    *startedAt = monotonicMicroseconds();
+  }
+  return recvFrameView(socket, data->type, payload, data, frameLength);
 }
 
-void *getClientContext(socket_t client)
+static DataView viewOf(const Data *data, ByteBuffer *source)
 {
-  if (networkContext.socketType != Server)
+  DataView view;
+  memset(&view, 0, sizeof(DataView));
+  view.type = data->type;
+  if (data->type == TYPE_INT)
   {
-    strncpy(networkContext.lastError, "Must have socketType Server passed into init() in order to call getClientContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NULL;
+    view.i = data->data.i;
   }
-
-  if (networkContext.connectionType != CONNECTION_TCP)
+  else if (data->type == TYPE_FLOAT)
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call getClientContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NULL;
+    view.f = data->data.f;
   }
-
-  if (client == -1)
+  else
   {
-    strncpy(networkContext.lastError, "Cannot set conext of an invalid or closed client", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NULL;
+    view.bytes = (const char *)data->data.raw.bytes;
+    view.length = data->data.raw.size;
+    view.source = source;
   }
+  return view;
+}
 
-  for (int i = 0; i < networkContext.server.numClients; i++)
+// Strings and JSON are only recorded as received, so raw is set when data holds them undecoded, as receiveView() leaves
+// them.
+static void captureReceived(NetworkContext *ctx, uint64_t receivedAt, socket_t socket, const Data *data, bool raw)
+{
+  if (!ctx->capture.enabled)
   {
-    if (networkContext.server.clients[i].socket.socket != client)
-    {
-      continue;
-    }
-
-    if (networkContext.server.clients[i].context == NULL)
+    return;
+  }
+  if (data->type == TYPE_STRING || data->type == TYPE_JSON)
+  {
+    if (raw)
     {
-      strncpy(networkContext.lastError, "Warning: Getting NULL client context in getClientContext().", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+      captureBytes(&ctx->capture, receivedAt, socket, data->type, data->data.raw.bytes, data->data.raw.size);
     }
-
-    return networkContext.server.clients[i].context;
+    return;
   }
-
-  strncpy(networkContext.lastError, "Client passed into getClientContext does not exist!", sizeof(networkContext.lastError) - 1);
-  networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-  return NULL;
+  captureFrame(&ctx->capture, receivedAt, socket, data);
 }
 
-int sendToClient(Data data, socket_t client)
+// Decodes a string or JSON that receiveView() left undecoded into a Data of its own, for onClientData.
+static int decodeViewed(Data *data)
 {
-  if (networkContext.connectionType != CONNECTION_TCP)
+  const char *bytes = (const char *)data->data.raw.bytes;
+  uint32_t size = data->data.raw.size;
+  if (data->type == TYPE_STRING)
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call sendToClient()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
-  }
-
-  int result = 0;
-  switch (data.type)
-  {
-  case TYPE_INT:
-    result = sendInt(client, data.data.i);
-    break;
-  case TYPE_FLOAT:
-    result = sendFloat(client, data.data.f);
-    break;
-  case TYPE_STRING:
-    result = sendString(client, data.data.s);
-    break;
-  case TYPE_JSON:
-    result = sendJSON(client, data.data.json);
-    break;
-  }
-
-  if (result == PLATFORM_FAILURE)
-  {
-    strncpy(networkContext.lastError, "Failed to send data to client", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_SEND;
+    char *str = (char *)malloc(size + 1);
+    if (str == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+    memcpy(str, bytes, size);
+    str[size] = '\0';
+    data->data.s = str;
   }
-  if (result == 0)
+  else if (data->type == TYPE_JSON)
   {
-    strncpy(networkContext.lastError, "Invalid data type passed into sendToClient()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    data->data.json = cJSON_ParseWithLength(bytes, size);
+    if (data->data.json == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
   }
-  return NETWORK_OK;
+  return PLATFORM_SUCCESS;
 }
 
-int sendToServer(Data data)
+static void *clientDataLoop(void *arg)
 {
-  if (networkContext.socketType != Client)
+  ClientThreadArgs *args = (ClientThreadArgs *)arg;
+  NetworkContext *ctx = args->ctx;
+  socket_t socket = args->socket;
+  SharedLink *shared = args->shared;
+  ConnectionCounters *counters = args->counters;
+  int cpu = args->cpu;
+  free(args);
+  if (cpu >= 0)
   {
-    strncpy(networkContext.lastError, "Must have socketType Client passed into init() in order to call sendToServer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    pinCurrentThread(cpu);
   }
+  setCurrentContext(ctx);
 
-  if (networkContext.connectionType != CONNECTION_TCP)
+  Data clientAcceptedData;
+  clientAcceptedData.type = TYPE_CONNECTED;
+  ATOMIC_ADD(&ctx->metrics.connects, 1);
+  captureReceived(ctx, monotonicMicroseconds(), socket, &clientAcceptedData, false);
+  pthread_mutex_lock(&ctx->lock);
+  ctx->callback.onClientData(clientAcceptedData, socket);
+  pthread_mutex_unlock(&ctx->lock);
+
+  ByteBuffer payload = {0};
+  HandoffView mapped = {0};
+  while (ctx->server.listening)
   {
-    strncpy(networkContext.lastError, "Must have connection TCP type set in order to call sendToServer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    Data data;
+    size_t frameLength;
+    ByteBuffer *source = NULL;
+
+    // Read once, so a handler swapped in the meantime never gets a message received for the other one. A capture also
+    // receives strings and JSON undecoded, to record them exactly as they came off the wire.
+    void (*onClientView)(DataView, socket_t) = ctx->onClientView;
+    bool raw = onClientView || ctx->capture.enabled;
+    uint64_t firstByteAt = 0;
+    int result = raw ? receiveView(ctx, socket, shared, &payload, &mapped, &source, &data, &frameLength, ctx->trace.enabled ? &firstByteAt : NULL)
+                     : receiveFrame(ctx, socket, shared, &data, &frameLength, ctx->trace.enabled ? &firstByteAt : NULL);
+    uint64_t receivedAt = monotonicMicroseconds();
+    bool viewed = result == PLATFORM_SUCCESS && onClientView && isSendableType(data.type);
+    if (ctx->socketOptions.quickAck)
+    {
+      setSocketOption(socket, SOCKET_OPTION_QUICK_ACK, 1);
+    }
+    if (result == PLATFORM_SUCCESS)
+    {
+      traceEnd(ctx, TRACE_RECEIVE, firstByteAt, socket, data.type, frameLength);
+      recordReceived(&ctx->metrics, counters, data.type, frameLength);
+      markReceived(ctx, socket);
+      captureReceived(ctx, receivedAt, socket, &data, raw);
+    }
+    if (result == PLATFORM_SUCCESS && raw && !onClientView && decodeViewed(&data) != PLATFORM_SUCCESS)
+    {
+      closeHandoffView(&mapped);
+      continue;
+    }
+    if (result == PLATFORM_SUCCESS && data.type == TYPE_HEARTBEAT)
+    {
+      freeRecvData(&data);
+      continue;
+    }
+    if (result == PLATFORM_SUCCESS && data.type == TYPE_SNAPSHOT_ACK)
+    {
+      acknowledgeSnapshot(ctx, socket, &data);
+      freeRecvData(&data);
+      continue;
+    }
+    if (result == PLATFORM_SUCCESS && (data.type == TYPE_REQUEST || data.type == TYPE_RESPONSE))
+    {
+      receiveRequestFrame(ctx, socket, &data);
+      continue;
+    }
+
+    uint64_t waitingAt = traceStart(ctx);
+    pthread_mutex_lock(&ctx->lock);
+
+    if (result == PLATFORM_SUCCESS)
+    {
+      traceEnd(ctx, TRACE_LOCK_WAIT, waitingAt, socket, data.type, 0);
+      uint64_t startedAt = beginCallback(ctx, receivedAt);
+      NetworkedType type = data.type;
+      if (viewed)
+      {
+        onClientView(viewOf(&data, source), socket);
+      }
+      else
+      {
+        ctx->callback.onClientData(data, socket);
+      }
+      endCallback(ctx, startedAt, socket, type, frameLength);
+      pthread_mutex_unlock(&ctx->lock);
+      if (!viewed)
+      {
+        freeRecvData(&data);
+      }
+      closeHandoffView(&mapped);
+    }
+    else if (result == PLATFORM_CONNECTION_CLOSED)
+    {
+      pthread_mutex_unlock(&ctx->lock);
+      break;
+    }
+    else
+    {
+      pthread_mutex_unlock(&ctx->lock);
+    }
   }
+  byteBufferFree(&payload);
+
+  removeClient(ctx, socket);
+
+  clientAcceptedData.type = TYPE_DISCONNECTED;
+  ATOMIC_ADD(&ctx->metrics.disconnects, 1);
+  captureReceived(ctx, monotonicMicroseconds(), socket, &clientAcceptedData, false);
+  pthread_mutex_lock(&ctx->lock);
+  ctx->callback.onClientData(clientAcceptedData, -1);
+  ctx->server.activeThreads--;
+  pthread_cond_broadcast(&ctx->server.threadsDone);
+  pthread_mutex_unlock(&ctx->lock);
 
-  int result = 0;
-  switch (data.type)
+  return NULL;
+}
+
+static void acknowledgeSnapshot(NetworkContext *ctx, socket_t socket, const Data *data)
+{
+  pthread_mutex_lock(&ctx->lock);
+  int clientIndex = findClientIndex(ctx, socket);
+  ServerClient *client = clientIndex >= 0 ? &ctx->server.clients[clientIndex] : NULL;
+  if (client == NULL || client->snapshots == NULL || data->data.raw.size != sizeof(uint32_t))
   {
-  case TYPE_INT:
-    result = sendInt(networkContext.socket.socket, data.data.i);
-    break;
-  case TYPE_FLOAT:
-    result = sendFloat(networkContext.socket.socket, data.data.f);
-    break;
-  case TYPE_STRING:
-    result = sendString(networkContext.socket.socket, data.data.s);
-    break;
-  case TYPE_JSON:
-    result = sendJSON(networkContext.socket.socket, data.data.json);
-    break;
+    pthread_mutex_unlock(&ctx->lock);
+    return;
   }
 
-  if (result == PLATFORM_FAILURE)
+  uint32_t id;
+  memcpy(&id, data->data.raw.bytes, sizeof(uint32_t));
+  id = ntohl(id);
+
+  pthread_mutex_lock(&client->snapshots->lock);
+  if (id == 0)
   {
-    strncpy(networkContext.lastError, "Failed to send data to server", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_SEND;
+    client->snapshots->ackedId = 0;
   }
-  if (result == 0)
+  else if (id > client->snapshots->ackedId && id <= client->snapshots->lastId)
   {
-    strncpy(networkContext.lastError, "Invalid data type passed into sendToServer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    client->snapshots->ackedId = id;
   }
-  return NETWORK_OK;
+  pthread_mutex_unlock(&client->snapshots->lock);
+  pthread_mutex_unlock(&ctx->lock);
 }
 
-int startPeer(int port, int maxPeers, void (*onPeerData)(Data, int))
+int connectToServerCtx(NexContext *ctx, const char *ip, int port, void (*onServerData)(Data))
 {
-  if (networkContext.socketType != Peer)
+  return connectToServerWithOptionsCtx(ctx, ip, port, onServerData, NULL);
+}
+
+int connectToServerWithOptionsCtx(NexContext *ctx, const char *ip, int port, void (*onServerData)(Data), const SocketOptions *options)
+{
+  if (ctx->socketType != Client)
   {
-    strncpy(networkContext.lastError, "Must have socketType peer passed into init() in order to call startPeer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Must have socketType Client passed into init() in order to call connectToServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (networkContext.connectionType != CONNECTION_UDP)
+  if (!streamConnection(ctx))
   {
-    strncpy(networkContext.lastError, "Must have connection UDP type set in order to call startPeer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call connectToServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (onPeerData == NULL)
+  if (onServerData == NULL)
   {
-    strncpy(networkContext.lastError, "Invalid onPeerData passed into: int startPeer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Invalid onServerData function: int startServer(int port, int maxClients, void (*onClientData)(Socket *, const char *, size_t))", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  if (!networkContext.initialized)
+  if (!ctx->initialized)
   {
-    strncpy(networkContext.lastError, "Platform Is Not Initialized!", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    strncpy(ctx->lastError, "Platform Is Not Initialized!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_INVALID;
   }
 
-  networkContext.peer.maxPeers = maxPeers;
-  networkContext.callback.onPeerData = onPeerData;
-
-  networkContext.peer.peers = (ConnectedPeer *)calloc(maxPeers, sizeof(ConnectedPeer));
-  networkContext.peer.peerThreads = (pthread_t *)calloc(maxPeers, sizeof(pthread_t));
-  if (!networkContext.peer.peers || !networkContext.peer.peerThreads)
+  ctx->callback.onServerData = onServerData;
+  setContextSocketOptions(ctx, options);
+  ctx->client.snapshots = createSnapshotHistory();
+  if (!ctx->client.snapshots)
   {
-    strncpy(networkContext.lastError, "Out of memory allocating peer arrays", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_UNKNOWN;
+    strncpy(ctx->lastError, "Out of memory allocating snapshot history", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
   }
 
-  networkContext.socket.socket = createSocket(SOCK_DGRAM, IPPROTO_UDP);
-  if (networkContext.socket.socket == PLATFORM_FAILURE)
+  ctx->socket.socket = localConnection(ctx) ? createLocalSocket() : createSocket(SOCK_STREAM, IPPROTO_TCP);
+  if (ctx->socket.socket == PLATFORM_FAILURE)
   {
-    strncpy(networkContext.lastError, "Socket creation failed\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
+    strncpy(ctx->lastError, "Socket creation failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
     return NETWORK_ERR_SOCKET;
   }
 
-  networkContext.socket.addr = createSockaddrIn(port, "0.0.0.0");
-  if (bindSocket(networkContext.socket.socket, (struct sockaddr *)&networkContext.socket.addr, sizeof(networkContext.socket.addr)) == PLATFORM_FAILURE)
+  if (applySocketOptions(ctx, ctx->socket.socket, ctx->connectionType == CONNECTION_TCP) == PLATFORM_FAILURE)
   {
-    strncpy(networkContext.lastError, "Socket bind failed\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    closeSocket(networkContext.socket.socket);
-    return NETWORK_ERR_BIND;
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_SOCKET;
   }
 
-  networkContext.peer.listening = true;
-
-  return NETWORK_OK;
-}
-
-typedef struct
-{
-  ConnectedPeer *peer;
-  int peerIndex;
-} PeerThreadArgs;
-
-int connectToPeer(const char *ip, int port)
-{
-  pthread_mutex_lock(&networkContext.lock);
-
-  if (networkContext.peer.numPeers >= networkContext.peer.maxPeers)
+  int connected;
+  if (localConnection(ctx))
   {
-    strncpy(networkContext.lastError, "Max clients reached\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    pthread_mutex_unlock(&networkContext.lock);
-    return NETWORK_ERR_INVALID;
+    connected = connectLocalSocket(ctx->socket.socket, port);
   }
-
-  if (!networkContext.peer.listening)
+  else
   {
-    strncpy(networkContext.lastError, "You cannot call connectToPeer() before calling startPeer() or after calling shutdownNetwork().\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    pthread_mutex_unlock(&networkContext.lock);
-    return NETWORK_ERR_INVALID;
+    ctx->socket.addr = createSockaddrIn(port, ip);
+    connected = connectSocket(ctx->socket.socket, (struct sockaddr *)&ctx->socket.addr, sizeof(ctx->socket.addr));
+  }
+  if (connected == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Failed to connect to server.\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_CONNECT;
   }
 
-  int peerIndex = networkContext.peer.numPeers;
-
-  ConnectedPeer *peer = &networkContext.peer.peers[peerIndex];
-  peer->addr = createSockaddrIn(port, ip);
-  peer->id = networkContext.peer.idIncrementer++;
-  peer->context = NULL;
-  peer->contextDeleter = NULL;
+  if (ctx->connectionType == CONNECTION_SHARED_MEMORY)
+  {
+    ctx->client.shared = acceptSharedLink(ctx->socket.socket, SHARED_HANDSHAKE_TIMEOUT_MS);
+    if (ctx->client.shared == NULL)
+    {
+      strncpy(ctx->lastError, "Server did not hand over shared memory, it may be full.\n", sizeof(ctx->lastError) - 1);
+      ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+      closeSocket(ctx->socket.socket);
+      return NETWORK_ERR_CONNECT;
+    }
+  }
 
-  pthread_t thread;
-  PeerThreadArgs *args = (PeerThreadArgs *)malloc(sizeof(PeerThreadArgs));
-  if (!args)
+  ctx->client.counters = (ConnectionCounters *)calloc(1, sizeof(ConnectionCounters));
+  ctx->client.outbound = createOutboundQueue(ctx->socket.socket, ctx->connectionType == CONNECTION_TCP, &ctx->flushPolicy, &ctx->backpressure, &ctx->metrics, ctx->client.counters);
+  if (!ctx->client.counters || !ctx->client.outbound)
   {
-    strncpy(networkContext.lastError, "Failed to allocate memory\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    pthread_mutex_unlock(&networkContext.lock);
+    strncpy(ctx->lastError, "Out of memory allocating outbound queue", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_MEMORY;
+  }
+  ctx->client.outbound->shared = ctx->client.shared;
+  ctx->client.outbound->handoffThreshold = ctx->connectionType == CONNECTION_LOCAL ? &ctx->handoffThreshold : NULL;
+  ctx->client.requests = createRequestTable(ctx->timers);
+  if (!ctx->client.requests)
+  {
+    strncpy(ctx->lastError, "Out of memory allocating request table", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
     return NETWORK_ERR_MEMORY;
   }
+  if (ctx->socketOptions.noDelay)
+  {
+    setSocketOption(ctx->socket.socket, SOCKET_OPTION_NO_DELAY, 1);
+  }
 
-  args->peer = peer;
-  args->peerIndex = peerIndex;
-  int result = pthread_create(&thread, NULL, peerDataLoop, args);
-  networkContext.peer.peerThreads[peerIndex] = thread;
+  ctx->client.keepalive = createKeepalive(ctx, ctx->socket.socket, ctx->client.outbound, -1, NULL);
 
-  if (result != 0)
+  ctx->client.running = true;
+  if (pthread_create(&ctx->client.serverThread, NULL, clientAcceptLoop, ctx) != 0)
   {
-    strncpy(networkContext.lastError, "Failed to create thread\n", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    removePeer(peerIndex);
-    free(args);
-    pthread_mutex_unlock(&networkContext.lock);
+    ctx->client.running = false;
+    destroyKeepalive(ctx, ctx->client.keepalive);
+    ctx->client.keepalive = NULL;
+    strncpy(ctx->lastError, "pthread_create acceptLoop failed", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
     return NETWORK_ERR_THREAD;
   }
-  else
-  {
-    pthread_detach(thread);
-    networkContext.peer.numPeers++;
-  }
-  pthread_mutex_unlock(&networkContext.lock);
-  return NETWORK_OK;
+
+  return startOutboundThread(ctx);
 }
 
-static void *peerDataLoop(void *arg)
+static void *clientAcceptLoop(void *arg)
 {
-  PeerThreadArgs *args = (PeerThreadArgs *)arg;
-  ConnectedPeer *peer = args->peer;
-  int peerIndex = args->peerIndex;
+  NetworkContext *ctx = (NetworkContext *)arg;
+  setCurrentContext(ctx);
+  pinIoThread(&ctx->affinity);
 
-  Data peerAcceptedData;
-  peerAcceptedData.type = TYPE_CONNECTED;
-  pthread_mutex_lock(&networkContext.lock);
-  networkContext.callback.onPeerData(peerAcceptedData, peer->id);
-  pthread_mutex_unlock(&networkContext.lock);
+  Data serverConnectedData;
+  serverConnectedData.type = TYPE_CONNECTED;
+  ATOMIC_ADD(&ctx->metrics.connects, 1);
+  ctx->callback.onServerData(serverConnectedData);
 
-  while (networkContext.peer.listening)
+  ByteBuffer payload = {0};
+  HandoffView mapped = {0};
+  while (ctx->client.running)
   {
     Data data;
-    int result = recvAnyFrom(networkContext.socket.socket, &peer->addr, &data);
-    pthread_mutex_lock(&networkContext.lock);
-
+    size_t frameLength;
+    ByteBuffer *source = NULL;
+    void (*onServerView)(DataView) = ctx->onServerView;
+    uint64_t firstByteAt = 0;
+    int result = onServerView ? receiveView(ctx, ctx->socket.socket, ctx->client.shared, &payload, &mapped, &source, &data, &frameLength,
+                                            ctx->trace.enabled ? &firstByteAt : NULL)
+                              : receiveFrame(ctx, ctx->socket.socket, ctx->client.shared, &data, &frameLength, ctx->trace.enabled ? &firstByteAt : NULL);
+    uint64_t receivedAt = monotonicMicroseconds();
+    bool viewed = result == PLATFORM_SUCCESS && onServerView && isSendableType(data.type);
+    if (ctx->socketOptions.quickAck)
+    {
+      setSocketOption(ctx->socket.socket, SOCKET_OPTION_QUICK_ACK, 1);
+    }
     if (result == PLATFORM_SUCCESS)
     {
-      networkContext.callback.onPeerData(data, peer->id);
-      pthread_mutex_unlock(&networkContext.lock);
+      traceEnd(ctx, TRACE_RECEIVE, firstByteAt, ctx->socket.socket, data.type, frameLength);
+      recordReceived(&ctx->metrics, ctx->client.counters, data.type, frameLength);
+      markReceived(ctx, ctx->socket.socket);
+    }
+    if (result == PLATFORM_SUCCESS && data.type == TYPE_HEARTBEAT)
+    {
       freeRecvData(&data);
+      continue;
     }
-    else if (result == PLATFORM_CONNECTION_CLOSED)
+    if (result == PLATFORM_SUCCESS && data.type == TYPE_SNAPSHOT && receiveSnapshot(ctx, &data) != PLATFORM_SUCCESS)
     {
-      pthread_mutex_unlock(&networkContext.lock);
-      if (data.type == TYPE_DISCONNECTED)
-        break;
+      continue;
     }
-    else
+    if (result == PLATFORM_SUCCESS && (data.type == TYPE_REQUEST || data.type == TYPE_RESPONSE))
+    {
+      receiveRequestFrame(ctx, ctx->socket.socket, &data);
+      continue;
+    }
+
+    uint64_t waitingAt = traceStart(ctx);
+    pthread_mutex_lock(&ctx->lock);
+
+    if (result == PLATFORM_SUCCESS)
+    {
+      traceEnd(ctx, TRACE_LOCK_WAIT, waitingAt, ctx->socket.socket, data.type, 0);
+      uint64_t startedAt = beginCallback(ctx, receivedAt);
+      NetworkedType type = data.type;
+      if (viewed)
+      {
+        onServerView(viewOf(&data, source));
+      }
+      else
+      {
+        ctx->callback.onServerData(data);
+      }
+      endCallback(ctx, startedAt, ctx->socket.socket, type, frameLength);
+      if (!viewed)
+      {
+        freeRecvData(&data);
+      }
+      closeHandoffView(&mapped);
+    }
+    else if (result == PLATFORM_CONNECTION_CLOSED && ctx->client.running)
     {
-      pthread_mutex_unlock(&networkContext.lock);
+      ctx->client.running = false;
+      closeSocket(ctx->socket.socket);
     }
+
+    pthread_mutex_unlock(&ctx->lock);
   }
+  byteBufferFree(&payload);
 
-  free(args);
-  removePeer(peerIndex);
+  pthread_mutex_lock(&ctx->lock);
+  cancelPendingRequests(ctx->client.requests, REQUEST_DISCONNECTED);
+  destroyKeepalive(ctx, ctx->client.keepalive);
+  ctx->client.keepalive = NULL;
+  pthread_mutex_unlock(&ctx->lock);
 
-  peerAcceptedData.type = TYPE_DISCONNECTED;
-  pthread_mutex_lock(&networkContext.lock);
-  networkContext.callback.onPeerData(peerAcceptedData, -1);
-  pthread_mutex_unlock(&networkContext.lock);
+  serverConnectedData.type = TYPE_DISCONNECTED;
+  ATOMIC_ADD(&ctx->metrics.disconnects, 1);
+  ctx->callback.onServerData(serverConnectedData);
 
+  destroySnapshotHistory(ctx->client.snapshots);
+  ctx->client.snapshots = NULL;
   return NULL;
 }
 
-int sendToPeer(Data data, int peer)
+static int receiveSnapshot(NetworkContext *ctx, Data *data)
 {
-  if (networkContext.connectionType != CONNECTION_UDP)
-  {
-    strncpy(networkContext.lastError, "Must have connection UDP type set in order to call sendToPeer()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
-  }
+  uint32_t id;
+  cJSON *json;
+  int result = decodeSnapshot(ctx->client.snapshots, data->data.raw.bytes, data->data.raw.size, &id, &json);
+  freeRecvData(data);
+
+  uint32_t ack = htonl(result == PLATFORM_SUCCESS ? id : 0);
+  Data ackData;
+  ackData.type = TYPE_SNAPSHOT_ACK;
+  ackData.data.raw.bytes = (uint8_t *)&ack;
+  ackData.data.raw.size = sizeof(ack);
+  int events = 0;
+  int queued = queueData(ctx->client.outbound, ackData, &events);
+  handleOutboundResult(ctx, ctx->client.outbound, queued, events);
+
+  if (result != PLATFORM_SUCCESS)
+  {
+    strncpy(ctx->lastError, "Failed to reconstruct snapshot, requesting a full resend", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return PLATFORM_FAILURE;
+  }
+
+  data->type = TYPE_JSON;
+  data->data.json = json;
+  return PLATFORM_SUCCESS;
+}
 
-  if (peer == -1)
-  {
-    strncpy(networkContext.lastError, "Cannot send to an invalid peer.", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
-  }
+static bool isSendableType(NetworkedType type)
+{
+  return type == TYPE_INT || type == TYPE_FLOAT || type == TYPE_STRING || type == TYPE_JSON;
+}
 
-  struct sockaddr_in peerAddr;
-  bool foundAddr = false;
-  for (int i = 0; i < networkContext.peer.numPeers; i++)
+static OutboundQueue *findClientQueue(NetworkContext *ctx, socket_t client)
+{
+  for (int i = 0; i < ctx->server.numClients; i++)
   {
-    if (peer == networkContext.peer.peers[i].id)
+    if (ctx->server.clients[i].socket.socket == client)
     {
-      peerAddr = networkContext.peer.peers[i].addr;
-      foundAddr = true;
-      break;
+      return ctx->server.clients[i].outbound;
     }
   }
-  if (!foundAddr)
-  {
-    strncpy(networkContext.lastError, "Cannot send to an inexistent peer.", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
-  }
+  return NULL;
+}
 
-  int result = 0;
-  switch (data.type)
+static RequestTable *findClientRequests(NetworkContext *ctx, socket_t client)
+{
+  for (int i = 0; i < ctx->server.numClients; i++)
   {
-  case TYPE_INT:
-    result = sendIntTo(networkContext.socket.socket, &peerAddr, data.data.i);
-    break;
-  case TYPE_FLOAT:
-    result = sendFloatTo(networkContext.socket.socket, &peerAddr, data.data.f);
-    break;
-  case TYPE_STRING:
-    result = sendStringTo(networkContext.socket.socket, &peerAddr, data.data.s);
-    break;
-  case TYPE_JSON:
-    result = sendJSONTo(networkContext.socket.socket, &peerAddr, data.data.json);
-    break;
-  default:
-    strncpy(networkContext.lastError, "Unknown data type passed into sendToPeer().", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    if (ctx->server.clients[i].socket.socket == client)
+    {
+      return ctx->server.clients[i].requests;
+    }
   }
+  return NULL;
+}
 
-  if (result == PLATFORM_FAILURE)
-  {
-    strncpy(networkContext.lastError, "Send to peer failed.", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_SEND;
-  }
+// What a sender needs of a server client. Acquired under outboundLock, it stays valid until releaseClient() even if the
+// client disconnects meanwhile, because removeClient() waits for every acquired client before it frees anything.
+typedef struct
+{
+  socket_t socket;
+  OutboundQueue *outbound;
+  RequestTable *requests;
+  SnapshotHistory *snapshots;
+} ClientHandle;
 
-  return NETWORK_OK;
+static void holdClient(ServerClient *client, ClientHandle *handle)
+{
+  ATOMIC_ADD(&client->outbound->users, 1);
+  handle->socket = client->socket.socket;
+  handle->outbound = client->outbound;
+  handle->requests = client->requests;
+  handle->snapshots = client->snapshots;
 }
 
-int setPeerContext(void *context, int peer, void (*deleter)(void *))
+static bool acquireClient(NetworkContext *ctx, socket_t socket, ClientHandle *handle)
 {
-  if (networkContext.socketType != Peer)
-  {
-    strncpy(networkContext.lastError, "Must have socketType Peer passed into init() in order to call setPeerContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
-  }
-
-  if (networkContext.connectionType != CONNECTION_UDP)
+  pthread_mutex_lock(&ctx->outboundLock);
+  int i = findClientIndex(ctx, socket);
+  bool found = i >= 0 && ctx->server.clients[i].outbound != NULL;
+  if (found)
   {
-    strncpy(networkContext.lastError, "Must have connection UDP type set in order to call setPeerContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    holdClient(&ctx->server.clients[i], handle);
   }
+  pthread_mutex_unlock(&ctx->outboundLock);
+  return found;
+}
 
-  if (peer == -1)
+// Acquires every client but excluded. Returns how many, or -1 when out of memory. *handles is freed by releaseClients().
+static int acquireClients(NetworkContext *ctx, socket_t excluded, ClientHandle **handles)
+{
+  *handles = (ClientHandle *)malloc((ctx->server.maxClients > 0 ? ctx->server.maxClients : 1) * sizeof(ClientHandle));
+  if (*handles == NULL)
   {
-    strncpy(networkContext.lastError, "Cannot set conext of an invalid or closed peer", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NETWORK_ERR_INVALID;
+    return -1;
   }
 
-  for (int i = 0; i < networkContext.peer.numPeers; i++)
+  int count = 0;
+  pthread_mutex_lock(&ctx->outboundLock);
+  for (int i = 0; i < ctx->server.numClients; i++)
   {
-    if (networkContext.peer.peers[i].id != peer)
+    if (ctx->server.clients[i].socket.socket != excluded && ctx->server.clients[i].outbound != NULL)
     {
-      continue;
+      holdClient(&ctx->server.clients[i], &(*handles)[count++]);
     }
-
-    networkContext.peer.peers[i].context = context;
-    networkContext.peer.peers[i].contextDeleter = deleter;
-
-    return NETWORK_OK;
   }
-
-  strncpy(networkContext.lastError, "Peer passed into setPeerContext does not exist!", sizeof(networkContext.lastError) - 1);
-  networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-  return NETWORK_ERR_UNKNOWN;
+  pthread_mutex_unlock(&ctx->outboundLock);
+  return count;
 }
 
-void *getPeerContext(int peer)
+static void releaseClient(ClientHandle *handle)
 {
-  if (networkContext.socketType != Peer)
-  {
-    strncpy(networkContext.lastError, "Must have socketType Peer passed into init() in order to call getPeerContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NULL;
-  }
+  // Everything done with the client happens before removeClient() sees the count drop.
+  ATOMIC_FENCE();
+  ATOMIC_ADD(&handle->outbound->users, -1);
+}
 
-  if (networkContext.connectionType != CONNECTION_UDP)
+static void releaseClients(ClientHandle *handles, int count)
+{
+  for (int i = 0; i < count; i++)
   {
-    strncpy(networkContext.lastError, "Must have connection UDP type set in order to call getPeerContext()", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NULL;
+    releaseClient(&handles[i]);
   }
+  free(handles);
+}
 
-  if (peer == -1)
+static int queueResponse(NetworkContext *ctx, OutboundQueue *queue, uint32_t id, RequestStatus status, Data data)
+{
+  ByteBuffer frame = {0};
+  if (encodeResponse(&frame, id, status, data) == PLATFORM_FAILURE)
   {
-    strncpy(networkContext.lastError, "Cannot set conext of an invalid or closed peer", sizeof(networkContext.lastError) - 1);
-    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    return NULL;
+    byteBufferFree(&frame);
+    strncpy(ctx->lastError, "Failed to encode response", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
   }
 
-  for (int i = 0; i < networkContext.peer.numPeers; i++)
-  {
-    if (networkContext.peer.peers[i].id != peer)
-    {
-      continue;
-    }
+  int events = 0;
+  int queued = queueFrame(queue, frame.bytes, frame.length, &events);
+  byteBufferFree(&frame);
+  return handleOutboundResult(ctx, queue, queued, events);
+}
 
-    if (networkContext.peer.peers[i].context == NULL)
-    {
-      strncpy(networkContext.lastError, "Warning: Getting NULL peer context in getPeerContext().", sizeof(networkContext.lastError) - 1);
-      networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-    }
+static void receiveResponse(NetworkContext *ctx, socket_t socket, Data *frame)
+{
+  uint32_t id = 0;
+  RequestStatus status;
+  Data response;
+  int decoded = decodeResponse(frame, &id, &status, &response);
+  freeRecvData(frame);
 
-    return networkContext.peer.peers[i].context;
+  pthread_mutex_lock(&ctx->lock);
+  RequestTable *requests = ctx->socketType == Server ? findClientRequests(ctx, socket) : ctx->client.requests;
+  PendingRequest request;
+  // A malformed response is dropped and its request left to time out.
+  if (decoded == PLATFORM_SUCCESS && requests && takePendingRequest(requests, id, &request) == PLATFORM_SUCCESS)
+  {
+    request.onResponse(status, response, request.userData);
   }
+  pthread_mutex_unlock(&ctx->lock);
 
-  strncpy(networkContext.lastError, "Peer passed into getPeerContext does not exist!", sizeof(networkContext.lastError) - 1);
-  networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
-  return NULL;
+  freeRecvData(&response);
 }
 
-int shutdownNetwork()
+static void receiveRequest(NetworkContext *ctx, socket_t socket, Data *frame)
 {
-  if (networkContext.socketType == Server)
+  uint32_t id = 0;
+  Data request;
+  int decoded = decodeRequest(frame, &id, &request);
+  freeRecvData(frame);
+  if (id == 0)
   {
-    networkContext.server.listening = false;
-    removeAllClients();
-    closeSocket(networkContext.socket.socket);
+    return;
   }
 
-  if (networkContext.socketType == Client)
+  bool handled = false;
+  pthread_mutex_lock(&ctx->lock);
+  if (decoded == PLATFORM_SUCCESS && ctx->socketType == Server && ctx->onClientRequest)
   {
-    networkContext.client.running = false;
-    closeSocket(networkContext.socket.socket);
+    ctx->onClientRequest(request, socket, id);
+    handled = true;
   }
-
-  if (networkContext.socketType == Peer)
+  else if (decoded == PLATFORM_SUCCESS && ctx->socketType == Client && ctx->onServerRequest)
   {
-    networkContext.peer.listening = false;
-    closeSocket(networkContext.socket.socket);
-    removeAllPeers();
+    ctx->onServerRequest(request, id);
+    handled = true;
   }
+  OutboundQueue *queue = ctx->socketType == Server ? findClientQueue(ctx, socket) : ctx->client.outbound;
+  pthread_mutex_unlock(&ctx->lock);
 
-  return NETWORK_OK;
+  freeRecvData(&request);
+  if (!handled && queue)
+  {
+    Data empty;
+    memset(&empty, 0, sizeof(Data));
+    queueResponse(ctx, queue, id, REQUEST_UNHANDLED, empty);
+  }
+}
+
+static void receiveRequestFrame(NetworkContext *ctx, socket_t socket, Data *frame)
+{
+  if (frame->type == TYPE_RESPONSE)
+  {
+    receiveResponse(ctx, socket, frame);
+  }
+  else
+  {
+    receiveRequest(ctx, socket, frame);
+  }
+}
+
+static int sendFrameToClients(NetworkContext *ctx, Data data, socket_t excluded, const char *failureMessage)
+{
+  if (!isSendableType(data.type))
+  {
+    strncpy(ctx->lastError, "Invalid data type passed into sendToAllClients() or broadcastToClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ByteBuffer frame = {0};
+  if (encodeData(&frame, data) == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Failed to encode data", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    byteBufferFree(&frame);
+    return NETWORK_ERR_MEMORY;
+  }
+
+  ClientHandle *clients;
+  int count = acquireClients(ctx, excluded, &clients);
+  if (count < 0)
+  {
+    strncpy(ctx->lastError, "Failed to allocate memory", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    byteBufferFree(&frame);
+    return NETWORK_ERR_MEMORY;
+  }
+
+  int result = NETWORK_OK;
+  for (int i = 0; i < count; i++)
+  {
+    uint64_t startedAt = traceStart(ctx);
+    int events = 0;
+    int queued = queueFrame(clients[i].outbound, frame.bytes, frame.length, &events);
+    traceEnd(ctx, TRACE_SEND, startedAt, clients[i].socket, data.type, frame.length);
+    int currentResult = handleOutboundResult(ctx, clients[i].outbound, queued, events);
+    if (currentResult != NETWORK_OK)
+    {
+      strncpy(ctx->lastError, failureMessage, sizeof(ctx->lastError) - 1);
+      ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+      result = currentResult;
+    }
+  }
+  releaseClients(clients, count);
+
+  byteBufferFree(&frame);
+  return result;
+}
+
+int sendToAllClientsCtx(NexContext *ctx, Data data)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call sendToAllClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call sendToAllClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  return sendFrameToClients(ctx, data, -1, "Sending to all clients failed!");
+}
+
+int broadcastToClientsCtx(NexContext *ctx, Data data, socket_t sender)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call broadcastToClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call broadcastToClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  return sendFrameToClients(ctx, data, sender, "Broadcasting to clients failed!");
+}
+
+static int sendSnapshotText(NetworkContext *ctx, ClientHandle *client, const char *text, uint32_t length)
+{
+  if (client->snapshots == NULL || client->outbound == NULL)
+  {
+    return NETWORK_ERR_MEMORY;
+  }
+
+  ByteBuffer payload = {0};
+  ByteBuffer frame = {0};
+  if (encodeSnapshot(client->snapshots, text, length, &payload) == PLATFORM_FAILURE ||
+      encodeRaw(&frame, TYPE_SNAPSHOT, payload.bytes, (uint32_t)payload.length) == PLATFORM_FAILURE)
+  {
+    byteBufferFree(&payload);
+    byteBufferFree(&frame);
+    return NETWORK_ERR_MEMORY;
+  }
+
+  int events = 0;
+  int queued = queueFrame(client->outbound, frame.bytes, frame.length, &events);
+  byteBufferFree(&payload);
+  byteBufferFree(&frame);
+  return handleOutboundResult(ctx, client->outbound, queued, events);
+}
+
+int sendSnapshotToClientCtx(NexContext *ctx, const cJSON *snapshot, socket_t client)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call sendSnapshotToClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (snapshot == NULL)
+  {
+    strncpy(ctx->lastError, "Invalid snapshot passed into sendSnapshotToClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ClientHandle handle;
+  if (!acquireClient(ctx, client, &handle))
+  {
+    strncpy(ctx->lastError, "Client passed into sendSnapshotToClient does not exist!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  char *text = cJSON_PrintUnformatted(snapshot);
+  if (text == NULL)
+  {
+    releaseClient(&handle);
+    strncpy(ctx->lastError, "Failed to serialize snapshot", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+
+  int result = sendSnapshotText(ctx, &handle, text, (uint32_t)strlen(text));
+  releaseClient(&handle);
+  cJSON_free(text);
+  if (result != NETWORK_OK)
+  {
+    strncpy(ctx->lastError, "Failed to send snapshot to client", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  }
+  return result;
+}
+
+int sendSnapshotToAllClientsCtx(NexContext *ctx, const cJSON *snapshot)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call sendSnapshotToAllClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (snapshot == NULL)
+  {
+    strncpy(ctx->lastError, "Invalid snapshot passed into sendSnapshotToAllClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  char *text = cJSON_PrintUnformatted(snapshot);
+  if (text == NULL)
+  {
+    strncpy(ctx->lastError, "Failed to serialize snapshot", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+  uint32_t length = (uint32_t)strlen(text);
+
+  ClientHandle *clients;
+  int count = acquireClients(ctx, -1, &clients);
+  if (count < 0)
+  {
+    cJSON_free(text);
+    strncpy(ctx->lastError, "Failed to allocate memory", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+
+  int result = NETWORK_OK;
+  for (int i = 0; i < count; i++)
+  {
+    int currentResult = sendSnapshotText(ctx, &clients[i], text, length);
+    if (currentResult != NETWORK_OK)
+    {
+      strncpy(ctx->lastError, "Sending snapshot to all clients failed!", sizeof(ctx->lastError) - 1);
+      ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+      result = currentResult;
+    }
+  }
+  releaseClients(clients, count);
+
+  cJSON_free(text);
+  return result;
+}
+
+int setClientContextCtx(NexContext *ctx, void *context, socket_t client, void (*deleter)(void *))
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call setClientContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call setClientContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (client == -1)
+  {
+    strncpy(ctx->lastError, "Cannot set conext of an invalid or closed client", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  for (int i = 0; i < ctx->server.numClients; i++)
+  {
+    if (ctx->server.clients[i].socket.socket != client)
+    {
+      continue;
+    }
+
+    ctx->server.clients[i].context = context;
+    ctx->server.clients[i].contextDeleter = deleter;
+
+    return NETWORK_OK;
+  }
+
+  strncpy(ctx->lastError, "Client passed into setClientContext does not exist!", sizeof(ctx->lastError) - 1);
+  ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  return NETWORK_ERR_UNKNOWN;
+}
+
+void *getClientContextCtx(NexContext *ctx, socket_t client)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call getClientContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NULL;
+  }
+
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call getClientContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NULL;
+  }
+
+  if (client == -1)
+  {
+    strncpy(ctx->lastError, "Cannot set conext of an invalid or closed client", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NULL;
+  }
+
+  for (int i = 0; i < ctx->server.numClients; i++)
+  {
+    if (ctx->server.clients[i].socket.socket != client)
+    {
+      continue;
+    }
+
+    if (ctx->server.clients[i].context == NULL)
+    {
+      strncpy(ctx->lastError, "Warning: Getting NULL client context in getClientContext().", sizeof(ctx->lastError) - 1);
+      ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    }
+
+    return ctx->server.clients[i].context;
+  }
+
+  strncpy(ctx->lastError, "Client passed into getClientContext does not exist!", sizeof(ctx->lastError) - 1);
+  ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  return NULL;
+}
+
+static int queueRequest(NetworkContext *ctx, OutboundQueue *queue, RequestTable *requests, Data data, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData)
+{
+  if (timeoutMs > 0 && !ctx->timersNeeded)
+  {
+    ctx->timersNeeded = true;
+    int started = startOutboundThread(ctx);
+    if (started != NETWORK_OK)
+    {
+      return started;
+    }
+  }
+
+  // The request is registered first so a fast response always finds it.
+  uint32_t id;
+  uint64_t deadline = timeoutMs > 0 ? monotonicMilliseconds() + (uint64_t)timeoutMs : 0;
+  if (addPendingRequest(requests, deadline, onResponse, userData, &id) == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Out of memory allocating pending request", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+
+  ByteBuffer frame = {0};
+  int result = NETWORK_ERR_MEMORY;
+  if (encodeRequest(&frame, id, data) == PLATFORM_SUCCESS)
+  {
+    int events = 0;
+    int queued = queueFrame(queue, frame.bytes, frame.length, &events);
+    result = handleOutboundResult(ctx, queue, queued, events);
+  }
+  byteBufferFree(&frame);
+
+  if (result != NETWORK_OK)
+  {
+    PendingRequest request;
+    takePendingRequest(requests, id, &request);
+  }
+  return result;
+}
+
+int requestClientCtx(NexContext *ctx, Data data, socket_t client, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call requestClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!isSendableType(data.type) || onResponse == NULL || timeoutMs < 0)
+  {
+    strncpy(ctx->lastError, "Invalid arguments passed into requestClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ClientHandle handle;
+  if (!acquireClient(ctx, client, &handle))
+  {
+    strncpy(ctx->lastError, "Client passed into requestClient does not exist!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  int result = queueRequest(ctx, handle.outbound, handle.requests, data, timeoutMs, onResponse, userData);
+  releaseClient(&handle);
+  if (result != NETWORK_OK && result != NETWORK_ERR_QUEUE_FULL && result != NETWORK_ERR_MEMORY)
+  {
+    strncpy(ctx->lastError, "Failed to send request to client", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  }
+  return result;
+}
+
+int setClientRequestHandlerCtx(NexContext *ctx, void (*onRequest)(Data, socket_t, uint32_t))
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call setClientRequestHandler()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ctx->onClientRequest = onRequest;
+  return NETWORK_OK;
+}
+
+int setClientViewHandlerCtx(NexContext *ctx, void (*onClientView)(DataView, socket_t))
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call setClientViewHandler()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ctx->onClientView = onClientView;
+  return NETWORK_OK;
+}
+
+int retainView(DataView *view)
+{
+  ByteBuffer *source = (ByteBuffer *)view->source;
+  if (view->block || view->bytes == NULL)
+  {
+    return NETWORK_OK;
+  }
+
+  // A view without a source points into the mapping of a handoff, which goes away with the handler, so only it is
+  // copied.
+  if (source == NULL)
+  {
+    char *block = (char *)malloc(view->length + 1);
+    if (block == NULL)
+    {
+      return NETWORK_ERR_MEMORY;
+    }
+    memcpy(block, view->bytes, view->length);
+    block[view->length] = '\0';
+    view->block = block;
+    view->bytes = block;
+    return NETWORK_OK;
+  }
+  if (source->bytes == NULL || (const uint8_t *)view->bytes < source->bytes || (const uint8_t *)view->bytes >= source->bytes + source->capacity)
+  {
+    return NETWORK_ERR_INVALID;
+  }
+
+  // The connection gives up its receive buffer, and allocates a new one for the next message.
+  view->block = source->bytes;
+  view->source = NULL;
+  source->bytes = NULL;
+  source->length = 0;
+  source->capacity = 0;
+  return NETWORK_OK;
+}
+
+void releaseView(DataView *view)
+{
+  free(view->block);
+  view->block = NULL;
+  view->bytes = NULL;
+  view->length = 0;
+}
+
+int respondToClientCtx(NexContext *ctx, Data data, socket_t client, uint32_t requestId)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call respondToClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!isSendableType(data.type) || requestId == 0)
+  {
+    strncpy(ctx->lastError, "Invalid arguments passed into respondToClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ClientHandle handle;
+  if (!acquireClient(ctx, client, &handle))
+  {
+    strncpy(ctx->lastError, "Client passed into respondToClient does not exist!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  int result = queueResponse(ctx, handle.outbound, requestId, REQUEST_OK, data);
+  releaseClient(&handle);
+  return result;
+}
+
+int sendToClientCtx(NexContext *ctx, Data data, socket_t client)
+{
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call sendToClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!isSendableType(data.type))
+  {
+    strncpy(ctx->lastError, "Invalid data type passed into sendToClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ClientHandle handle;
+  if (!acquireClient(ctx, client, &handle))
+  {
+    strncpy(ctx->lastError, "Client passed into sendToClient does not exist!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  uint64_t startedAt = traceStart(ctx);
+  int events = 0;
+  int queued = queueData(handle.outbound, data, &events);
+  traceEnd(ctx, TRACE_SEND, startedAt, client, data.type, 0);
+  int result = handleOutboundResult(ctx, handle.outbound, queued, events);
+  releaseClient(&handle);
+  if (result != NETWORK_OK && result != NETWORK_ERR_QUEUE_FULL)
+  {
+    strncpy(ctx->lastError, "Failed to send data to client", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  }
+  return result;
+}
+
+int sendToServerCtx(NexContext *ctx, Data data)
+{
+  if (ctx->socketType != Client)
+  {
+    strncpy(ctx->lastError, "Must have socketType Client passed into init() in order to call sendToServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call sendToServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!isSendableType(data.type))
+  {
+    strncpy(ctx->lastError, "Invalid data type passed into sendToServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (ctx->client.outbound == NULL)
+  {
+    strncpy(ctx->lastError, "You cannot call sendToServer() before calling connectToServer().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  uint64_t startedAt = traceStart(ctx);
+  int events = 0;
+  int queued = queueData(ctx->client.outbound, data, &events);
+  traceEnd(ctx, TRACE_SEND, startedAt, ctx->socket.socket, data.type, 0);
+  int result = handleOutboundResult(ctx, ctx->client.outbound, queued, events);
+  if (result != NETWORK_OK && result != NETWORK_ERR_QUEUE_FULL)
+  {
+    strncpy(ctx->lastError, "Failed to send data to server", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  }
+  return result;
+}
+
+int setFlushPolicyCtx(NexContext *ctx, FlushPolicy policy)
+{
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call setFlushPolicy()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (policy.flushIntervalMs < 0 || (policy.mode == FLUSH_COALESCE && policy.maxBufferedBytes == 0))
+  {
+    strncpy(ctx->lastError, "Invalid flush interval or buffer size passed into setFlushPolicy()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  pthread_mutex_lock(&ctx->outboundLock);
+
+  ctx->flushPolicy = policy;
+
+  for (int i = 0; i < ctx->server.numClients; i++)
+  {
+    if (ctx->server.clients[i].outbound)
+    {
+      applyFlushPolicy(ctx->server.clients[i].outbound);
+      applySocketOptions(ctx, ctx->server.clients[i].socket.socket, ctx->connectionType == CONNECTION_TCP);
+    }
+  }
+  if (ctx->client.outbound)
+  {
+    applyFlushPolicy(ctx->client.outbound);
+    applySocketOptions(ctx, ctx->socket.socket, ctx->connectionType == CONNECTION_TCP);
+  }
+
+  pthread_mutex_unlock(&ctx->outboundLock);
+
+  if (ctx->server.listening || ctx->client.running)
+  {
+    return startOutboundThread(ctx);
+  }
+  return NETWORK_OK;
+}
+
+int setBackpressureCtx(NexContext *ctx, BackpressureOptions options)
+{
+  if (!streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have connection TCP, LOCAL or SHARED_MEMORY type set in order to call setBackpressure()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (options.maxQueuedBytes > 0 && (options.lowWatermark > options.highWatermark || options.highWatermark > options.maxQueuedBytes))
+  {
+    strncpy(ctx->lastError, "Watermarks passed into setBackpressure() must satisfy lowWatermark <= highWatermark <= maxQueuedBytes", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  pthread_mutex_lock(&ctx->outboundLock);
+  ctx->backpressure = options;
+  pthread_mutex_unlock(&ctx->outboundLock);
+
+  if (ctx->server.listening || ctx->client.running)
+  {
+    return startOutboundThread(ctx);
+  }
+  return NETWORK_OK;
+}
+
+int setLocalHandoffCtx(NexContext *ctx, size_t thresholdBytes)
+{
+  if (ctx->connectionType != CONNECTION_LOCAL)
+  {
+    strncpy(ctx->lastError, "Must have connection LOCAL type set in order to call setLocalHandoff()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+#ifdef PLATFORM_WINDOWS
+  if (thresholdBytes > 0)
+  {
+    strncpy(ctx->lastError, "setLocalHandoff() is not supported on Windows", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+#endif
+
+  pthread_mutex_lock(&ctx->outboundLock);
+  ctx->handoffThreshold = thresholdBytes;
+  pthread_mutex_unlock(&ctx->outboundLock);
+  return NETWORK_OK;
+}
+
+int flushClientCtx(NexContext *ctx, socket_t client)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call flushClient()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ClientHandle handle;
+  if (!acquireClient(ctx, client, &handle))
+  {
+    strncpy(ctx->lastError, "Client passed into flushClient does not exist!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  int events = 0;
+  int flushed = flushOutboundQueue(handle.outbound, &events);
+  int result = handleOutboundResult(ctx, handle.outbound, flushed, events);
+  releaseClient(&handle);
+  if (result != NETWORK_OK)
+  {
+    strncpy(ctx->lastError, "Failed to flush data to client", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_SEND;
+  }
+  return NETWORK_OK;
+}
+
+int flushAllClientsCtx(NexContext *ctx)
+{
+  if (ctx->socketType != Server)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() in order to call flushAllClients()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ClientHandle *clients;
+  int count = acquireClients(ctx, -1, &clients);
+  if (count < 0)
+  {
+    strncpy(ctx->lastError, "Failed to allocate memory", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+
+  int result = NETWORK_OK;
+  for (int i = 0; i < count; i++)
+  {
+    int events = 0;
+    int flushed = flushOutboundQueue(clients[i].outbound, &events);
+    if (handleOutboundResult(ctx, clients[i].outbound, flushed, events) != NETWORK_OK)
+    {
+      strncpy(ctx->lastError, "Flushing to all clients failed!", sizeof(ctx->lastError) - 1);
+      ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+      result = NETWORK_ERR_SEND;
+    }
+  }
+  releaseClients(clients, count);
+  return result;
+}
+
+int flushServerCtx(NexContext *ctx)
+{
+  if (ctx->socketType != Client)
+  {
+    strncpy(ctx->lastError, "Must have socketType Client passed into init() in order to call flushServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (ctx->client.outbound == NULL)
+  {
+    strncpy(ctx->lastError, "You cannot call flushServer() before calling connectToServer().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  int events = 0;
+  int flushed = flushOutboundQueue(ctx->client.outbound, &events);
+  if (handleOutboundResult(ctx, ctx->client.outbound, flushed, events) != NETWORK_OK)
+  {
+    strncpy(ctx->lastError, "Failed to flush data to server", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_SEND;
+  }
+  return NETWORK_OK;
+}
+
+int requestServerCtx(NexContext *ctx, Data data, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData)
+{
+  if (ctx->socketType != Client)
+  {
+    strncpy(ctx->lastError, "Must have socketType Client passed into init() in order to call requestServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!isSendableType(data.type) || onResponse == NULL || timeoutMs < 0)
+  {
+    strncpy(ctx->lastError, "Invalid arguments passed into requestServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (ctx->client.outbound == NULL || ctx->client.requests == NULL)
+  {
+    strncpy(ctx->lastError, "You cannot call requestServer() before calling connectToServer().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  int result = queueRequest(ctx, ctx->client.outbound, ctx->client.requests, data, timeoutMs, onResponse, userData);
+  if (result != NETWORK_OK && result != NETWORK_ERR_QUEUE_FULL && result != NETWORK_ERR_MEMORY)
+  {
+    strncpy(ctx->lastError, "Failed to send request to server", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  }
+  return result;
+}
+
+int setServerRequestHandlerCtx(NexContext *ctx, void (*onRequest)(Data, uint32_t))
+{
+  if (ctx->socketType != Client)
+  {
+    strncpy(ctx->lastError, "Must have socketType Client passed into init() in order to call setServerRequestHandler()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ctx->onServerRequest = onRequest;
+  return NETWORK_OK;
+}
+
+int setServerViewHandlerCtx(NexContext *ctx, void (*onServerView)(DataView))
+{
+  if (ctx->socketType != Client)
+  {
+    strncpy(ctx->lastError, "Must have socketType Client passed into init() in order to call setServerViewHandler()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ctx->onServerView = onServerView;
+  return NETWORK_OK;
+}
+
+int respondToServerCtx(NexContext *ctx, Data data, uint32_t requestId)
+{
+  if (ctx->socketType != Client)
+  {
+    strncpy(ctx->lastError, "Must have socketType Client passed into init() in order to call respondToServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!isSendableType(data.type) || requestId == 0)
+  {
+    strncpy(ctx->lastError, "Invalid arguments passed into respondToServer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (ctx->client.outbound == NULL)
+  {
+    strncpy(ctx->lastError, "You cannot call respondToServer() before calling connectToServer().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  return queueResponse(ctx, ctx->client.outbound, requestId, REQUEST_OK, data);
+}
+
+static int handleOutboundResult(NetworkContext *ctx, OutboundQueue *queue, int result, int events)
+{
+  if (events & OUTBOUND_HIGH_WATERMARK && ctx->backpressure.onHighWatermark)
+  {
+    ctx->backpressure.onHighWatermark(queue->socket);
+  }
+  if (events & OUTBOUND_LOW_WATERMARK && ctx->backpressure.onLowWatermark)
+  {
+    ctx->backpressure.onLowWatermark(queue->socket);
+  }
+
+  if (events & OUTBOUND_DISCONNECT)
+  {
+    strncpy(ctx->lastError, "Disconnecting slow consumer, outbound queue is full", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSharedLink(queue->shared);
+    shutdownBoth(queue->socket);
+    return NETWORK_ERR_SEND;
+  }
+  if (events & OUTBOUND_DROPPED_NEW)
+  {
+    strncpy(ctx->lastError, "Outbound queue is full, message dropped", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_QUEUE_FULL;
+  }
+  return result == PLATFORM_FAILURE ? NETWORK_ERR_SEND : NETWORK_OK;
+}
+
+static int startOutboundThread(NetworkContext *ctx)
+{
+  bool timedFlush = ctx->flushPolicy.mode == FLUSH_COALESCE && ctx->flushPolicy.flushIntervalMs > 0;
+
+  pthread_mutex_lock(&ctx->outboundLock);
+  if (ctx->outboundRunning || (!timedFlush && ctx->backpressure.maxQueuedBytes == 0 && !ctx->timersNeeded))
+  {
+    pthread_mutex_unlock(&ctx->outboundLock);
+    return NETWORK_OK;
+  }
+
+  ctx->outboundRunning = true;
+  if (pthread_create(&ctx->outboundThread, NULL, outboundLoop, ctx) != 0)
+  {
+    ctx->outboundRunning = false;
+    pthread_mutex_unlock(&ctx->outboundLock);
+    strncpy(ctx->lastError, "pthread_create outboundLoop failed", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_THREAD;
+  }
+  pthread_mutex_unlock(&ctx->outboundLock);
+  return NETWORK_OK;
+}
+
+static void sendHeartbeat(NetworkContext *ctx, Keepalive *keepalive, uint64_t now)
+{
+  if (keepalive->outbound)
+  {
+    ByteBuffer frame = {0};
+    if (encodeRaw(&frame, TYPE_HEARTBEAT, NULL, 0) == PLATFORM_SUCCESS)
+    {
+      // This runs under ctx->lock, so a client that stopped reading must not block it. A failed write means the
+      // connection is gone, which its receive thread reports.
+      queueHeartbeat(keepalive->outbound, frame.bytes, frame.length);
+    }
+    byteBufferFree(&frame);
+  }
+  else
+  {
+    uint8_t datagram = PEER_DATAGRAM_HEARTBEAT;
+    sendDataTo(keepalive->socket, &datagram, sizeof(datagram), 0, &keepalive->addr);
+  }
+
+  keepalive->heartbeat = 0;
+  if (ctx->keepalive.heartbeatIntervalMs > 0)
+  {
+    addTimer(ctx->timers, now + (uint64_t)ctx->keepalive.heartbeatIntervalMs, TIMER_HEARTBEAT, keepalive, 0, &keepalive->heartbeat);
+  }
+}
+
+// Closes a connection that stayed quiet for the whole idle timeout, or waits for the timeout to run out again since
+// the last traffic. Idle peers are only collected, since forgetting them frees the keepalive.
+static void checkIdle(NetworkContext *ctx, Keepalive *keepalive, uint64_t now, ByteBuffer *idlePeers)
+{
+  uint64_t idleTimeout = (uint64_t)ctx->keepalive.idleTimeoutMs;
+  keepalive->idle = 0;
+  if (idleTimeout == 0)
+  {
+    return;
+  }
+
+  if (keepalive->lastReceived + idleTimeout > now)
+  {
+    addTimer(ctx->timers, keepalive->lastReceived + idleTimeout, TIMER_IDLE, keepalive, 0, &keepalive->idle);
+    return;
+  }
+
+  strncpy(ctx->lastError, "Closing a connection that received nothing within the idle timeout", sizeof(ctx->lastError) - 1);
+  ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  if (keepalive->outbound)
+  {
+    // The receive thread sees the connection close and reports TYPE_DISCONNECTED as usual.
+    closeSharedLink(keepalive->outbound->shared);
+    shutdownBoth(keepalive->socket);
+  }
+  else
+  {
+    byteBufferAppend(idlePeers, &keepalive->peer, sizeof(int));
+  }
+}
+
+static void forgetIdlePeer(NetworkContext *ctx, int id)
+{
+  pthread_mutex_lock(&ctx->lock);
+  int index = -1;
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    if (ctx->peer.peers[i].id == id)
+    {
+      index = i;
+    }
+  }
+  pthread_mutex_unlock(&ctx->lock);
+
+  if (index < 0)
+  {
+    return;
+  }
+  removePeer(ctx, index);
+
+  Data peerDisconnectedData;
+  peerDisconnectedData.type = TYPE_DISCONNECTED;
+  ATOMIC_ADD(&ctx->metrics.disconnects, 1);
+  pthread_mutex_lock(&ctx->lock);
+  ctx->callback.onPeerData(peerDisconnectedData, id);
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+// Fires every due request deadline, heartbeat and idle timeout. Request tables and keepalives cancel their timers under
+// ctx->lock before they are freed, so each event still points at a live owner while the lock is held.
+static void serviceTimers(NetworkContext *ctx)
+{
+  uint64_t now = monotonicMilliseconds();
+  ByteBuffer expired = {0};
+  ByteBuffer idlePeers = {0};
+
+  pthread_mutex_lock(&ctx->lock);
+  advanceTimers(ctx->timers, now, &expired);
+
+  Data empty;
+  memset(&empty, 0, sizeof(Data));
+  TimerEvent *events = (TimerEvent *)expired.bytes;
+  for (size_t i = 0; i < expired.length / sizeof(TimerEvent); i++)
+  {
+    switch (events[i].kind)
+    {
+    case TIMER_REQUEST_DEADLINE:
+    {
+      PendingRequest request;
+      if (takePendingRequest((RequestTable *)events[i].owner, events[i].value, &request) == PLATFORM_SUCCESS)
+      {
+        request.onResponse(REQUEST_TIMEOUT, empty, request.userData);
+      }
+      break;
+    }
+    case TIMER_HEARTBEAT:
+      sendHeartbeat(ctx, (Keepalive *)events[i].owner, now);
+      break;
+    case TIMER_IDLE:
+      checkIdle(ctx, (Keepalive *)events[i].owner, now, &idlePeers);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->lock);
+  byteBufferFree(&expired);
+
+  int *ids = (int *)idlePeers.bytes;
+  for (size_t i = 0; i < idlePeers.length / sizeof(int); i++)
+  {
+    forgetIdlePeer(ctx, ids[i]);
+  }
+  byteBufferFree(&idlePeers);
+}
+
+typedef struct
+{
+  OutboundQueue *queue;
+  socket_t socket;
+  bool shared;
+  // Set when the queue of a server client was acquired, see releaseFlushes().
+  bool held;
+  int events;
+  int result;
+} OutboundFlush;
+
+// With hold, each server client queue collected is kept alive like an acquired client so it can be flushed without
+// outboundLock; a blocked write then only holds up that client. The client's own queue lives until the thread is joined.
+static int collectPendingQueues(NetworkContext *ctx, OutboundFlush *flushes, int capacity, bool all, bool hold)
+{
+  int count = 0;
+  for (int i = 0; i < ctx->server.numClients && count < capacity; i++)
+  {
+    OutboundQueue *queue = ctx->server.clients[i].outbound;
+    if (queue && (all || outboundQueuedBytes(queue) > 0))
+    {
+      flushes[count].queue = queue;
+      flushes[count].socket = queue->socket;
+      flushes[count].shared = queue->shared != NULL;
+      flushes[count].held = hold;
+      if (hold)
+      {
+        ATOMIC_ADD(&queue->users, 1);
+      }
+      count++;
+    }
+  }
+  if (ctx->client.outbound && count < capacity && (all || outboundQueuedBytes(ctx->client.outbound) > 0))
+  {
+    flushes[count].queue = ctx->client.outbound;
+    flushes[count].socket = ctx->client.outbound->socket;
+    flushes[count].shared = ctx->client.outbound->shared != NULL;
+    flushes[count].held = false;
+    count++;
+  }
+  return count;
+}
+
+static void releaseFlushes(OutboundFlush *flushes, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    if (flushes[i].held)
+    {
+      ATOMIC_FENCE();
+      ATOMIC_ADD(&flushes[i].queue->users, -1);
+      flushes[i].held = false;
+    }
+  }
+}
+
+static void *outboundLoop(void *arg)
+{
+  NetworkContext *ctx = (NetworkContext *)arg;
+  setCurrentContext(ctx);
+  pinIoThread(&ctx->affinity);
+
+  int capacity = ctx->server.maxClients + 1;
+  OutboundFlush *flushes = (OutboundFlush *)calloc(capacity, sizeof(OutboundFlush));
+  socket_t *sockets = (socket_t *)calloc(capacity, sizeof(socket_t));
+  int *writable = (int *)calloc(capacity, sizeof(int));
+  if (!flushes || !sockets || !writable)
+  {
+    free(flushes);
+    free(sockets);
+    free(writable);
+    ctx->outboundRunning = false;
+    return NULL;
+  }
+
+  uint64_t nextFlush = monotonicMilliseconds();
+  while (ctx->outboundRunning)
+  {
+    bool timedFlush = ctx->flushPolicy.mode == FLUSH_COALESCE && ctx->flushPolicy.flushIntervalMs > 0;
+    int timeout = timedFlush ? ctx->flushPolicy.flushIntervalMs : OUTBOUND_POLL_INTERVAL_MS;
+    if (ctx->timersNeeded && timeout > TIMER_TICK_MS)
+    {
+      timeout = TIMER_TICK_MS;
+    }
+
+    pthread_mutex_lock(&ctx->outboundLock);
+    int count = collectPendingQueues(ctx, flushes, capacity, false, false);
+    pthread_mutex_unlock(&ctx->outboundLock);
+
+    // The socket of a shared memory connection is always writable, so a backed up ring is retried once per interval.
+    int polled = 0;
+    for (int i = 0; i < count; i++)
+    {
+      if (!flushes[i].shared)
+      {
+        sockets[polled++] = flushes[i].socket;
+      }
+    }
+
+    if (polled == 0 || (timedFlush && ctx->backpressure.maxQueuedBytes == 0))
+    {
+      sleepMilliseconds(timeout);
+    }
+    else
+    {
+      pollWritable(sockets, writable, polled, timeout);
+    }
+
+    if (ctx->timersNeeded)
+    {
+      serviceTimers(ctx);
+    }
+
+    // The loop may wake more often than the flush interval to service timers.
+    uint64_t now = monotonicMilliseconds();
+    if (timedFlush && ctx->backpressure.maxQueuedBytes == 0 && now < nextFlush)
+    {
+      continue;
+    }
+    nextFlush = now + ctx->flushPolicy.flushIntervalMs;
+
+    // Queues may have been removed while polling, so they are collected again under the lock. They are flushed
+    // without it and without blocking, a client that stopped reading must not hold up other senders or other queues.
+    pthread_mutex_lock(&ctx->outboundLock);
+    count = collectPendingQueues(ctx, flushes, capacity, false, true);
+    pthread_mutex_unlock(&ctx->outboundLock);
+
+    for (int i = 0; i < count; i++)
+    {
+      flushes[i].events = 0;
+      flushes[i].result = flushOutboundQueueSome(flushes[i].queue, &flushes[i].events);
+      if (flushes[i].result == PLATFORM_FAILURE)
+      {
+        shutdownBoth(flushes[i].socket);
+      }
+    }
+    // Released before the callbacks, which may remove a client and wait for its users.
+    releaseFlushes(flushes, count);
+
+    for (int i = 0; i < count; i++)
+    {
+      if (flushes[i].events & OUTBOUND_LOW_WATERMARK && ctx->backpressure.onLowWatermark)
+      {
+        ctx->backpressure.onLowWatermark(flushes[i].socket);
+      }
+    }
+  }
+
+  free(flushes);
+  free(sockets);
+  free(writable);
+  return NULL;
+}
+
+int startPeerCtx(NexContext *ctx, int port, int maxPeers, void (*onPeerData)(Data, int))
+{
+  return startPeerWithOptionsCtx(ctx, port, maxPeers, onPeerData, NULL);
+}
+
+int startPeerWithOptionsCtx(NexContext *ctx, int port, int maxPeers, void (*onPeerData)(Data, int), const SocketOptions *options)
+{
+  if (ctx->socketType != Peer)
+  {
+    strncpy(ctx->lastError, "Must have socketType peer passed into init() in order to call startPeer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (ctx->connectionType != CONNECTION_UDP)
+  {
+    strncpy(ctx->lastError, "Must have connection UDP type set in order to call startPeer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (onPeerData == NULL)
+  {
+    strncpy(ctx->lastError, "Invalid onPeerData passed into: int startPeer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!ctx->initialized)
+  {
+    strncpy(ctx->lastError, "Platform Is Not Initialized!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ctx->peer.maxPeers = maxPeers;
+  ctx->callback.onPeerData = onPeerData;
+  setContextSocketOptions(ctx, options);
+
+  ctx->peer.peers = (ConnectedPeer *)calloc(maxPeers, sizeof(ConnectedPeer));
+  if (!ctx->peer.peers)
+  {
+    strncpy(ctx->lastError, "Out of memory allocating peer arrays", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_UNKNOWN;
+  }
+
+  ctx->socket.socket = createSocket(SOCK_DGRAM, IPPROTO_UDP);
+  if (ctx->socket.socket == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Socket creation failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_SOCKET;
+  }
+
+  if (applySocketOptions(ctx, ctx->socket.socket, false) == PLATFORM_FAILURE)
+  {
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_SOCKET;
+  }
+
+  ctx->socket.addr = createSockaddrIn(port, "0.0.0.0");
+  if (bindSocket(ctx->socket.socket, (struct sockaddr *)&ctx->socket.addr, sizeof(ctx->socket.addr)) == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Socket bind failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_BIND;
+  }
+
+  ctx->peer.listening = true;
+  if (pthread_create(&ctx->peer.receiveThread, NULL, peerReceiveLoop, ctx) != 0)
+  {
+    ctx->peer.listening = false;
+    strncpy(ctx->lastError, "pthread_create peerReceiveLoop failed", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(ctx->socket.socket);
+    return NETWORK_ERR_THREAD;
+  }
+
+  return NETWORK_OK;
+}
+
+int connectToPeerCtx(NexContext *ctx, const char *ip, int port)
+{
+  pthread_mutex_lock(&ctx->lock);
+
+  if (ctx->peer.numPeers >= ctx->peer.maxPeers)
+  {
+    strncpy(ctx->lastError, "Max clients reached\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    pthread_mutex_unlock(&ctx->lock);
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!ctx->peer.listening)
+  {
+    strncpy(ctx->lastError, "You cannot call connectToPeer() before calling startPeer() or after calling shutdownNetwork().\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    pthread_mutex_unlock(&ctx->lock);
+    return NETWORK_ERR_INVALID;
+  }
+
+  PeerChannels *channels = createPeerChannels();
+  if (!channels)
+  {
+    strncpy(ctx->lastError, "Failed to allocate memory\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    pthread_mutex_unlock(&ctx->lock);
+    return NETWORK_ERR_MEMORY;
+  }
+
+  ConnectedPeer *peer = &ctx->peer.peers[ctx->peer.numPeers];
+  peer->addr = createSockaddrIn(port, ip);
+  peer->id = ctx->peer.idIncrementer++;
+  peer->isClosed = false;
+  peer->context = NULL;
+  peer->contextDeleter = NULL;
+  peer->channels = channels;
+  configurePeerChannels(channels, &ctx->peer.congestion);
+  configurePeerFec(channels, ctx->peer.fecGroupSize);
+  peer->keepalive = createKeepalive(ctx, ctx->socket.socket, NULL, peer->id, &peer->addr);
+  pthread_mutex_lock(&ctx->outboundLock);
+  ctx->peer.numPeers++;
+  pthread_mutex_unlock(&ctx->outboundLock);
+
+  Data peerConnectedData;
+  peerConnectedData.type = TYPE_CONNECTED;
+  ATOMIC_ADD(&ctx->metrics.connects, 1);
+  ctx->callback.onPeerData(peerConnectedData, peer->id);
+
+  pthread_mutex_unlock(&ctx->lock);
+  return NETWORK_OK;
+}
+
+static ConnectedPeer *findPeerByAddress(NetworkContext *ctx, const struct sockaddr_in *addr)
+{
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    ConnectedPeer *peer = &ctx->peer.peers[i];
+    if (peer->addr.sin_port == addr->sin_port && peer->addr.sin_addr.s_addr == addr->sin_addr.s_addr)
+    {
+      return peer;
+    }
+  }
+  return NULL;
+}
+
+// What a sender needs of a peer. Acquired under outboundLock, so it can be used from callbacks that already hold
+// ctx->lock, and valid until releasePeer() even if the peer is removed meanwhile.
+typedef struct
+{
+  PeerChannels *channels;
+  struct sockaddr_in addr;
+} PeerHandle;
+
+static bool acquirePeer(NetworkContext *ctx, int id, PeerHandle *handle)
+{
+  bool found = false;
+  pthread_mutex_lock(&ctx->outboundLock);
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    if (ctx->peer.peers[i].id == id && ctx->peer.peers[i].channels != NULL)
+    {
+      ATOMIC_ADD(&ctx->peer.peers[i].channels->users, 1);
+      handle->channels = ctx->peer.peers[i].channels;
+      handle->addr = ctx->peer.peers[i].addr;
+      found = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->outboundLock);
+  return found;
+}
+
+static void releasePeer(PeerHandle *handle)
+{
+  ATOMIC_FENCE();
+  ATOMIC_ADD(&handle->channels->users, -1);
+}
+
+static void deliverPeerFrames(NetworkContext *ctx, int peer, const uint8_t *frames, size_t length)
+{
+  size_t offset = 0;
+  while (length - offset >= 1 + sizeof(uint32_t))
+  {
+    uint32_t size;
+    memcpy(&size, frames + offset + 1, sizeof(uint32_t));
+    size_t frameLength = 1 + sizeof(uint32_t) + ntohl(size);
+    if (frameLength > length - offset)
+    {
+      return;
+    }
+
+    Data data;
+    if (decodeData(frames + offset, frameLength, &data) == PLATFORM_SUCCESS)
+    {
+      recordReceived(&ctx->metrics, NULL, data.type, frameLength);
+      uint64_t startedAt = beginCallback(ctx, ctx->peer.receivedAt);
+      NetworkedType type = data.type;
+      ctx->callback.onPeerData(data, peer);
+      endCallback(ctx, startedAt, peer, type, frameLength);
+      freeRecvData(&data);
+    }
+    offset += frameLength;
+  }
+}
+
+static void handlePeerDatagram(NetworkContext *ctx, ConnectedPeer *peer, const uint8_t *datagram, size_t length);
+
+// Only what was sent unreliably is ever FEC protected.
+static void handleProtectedDatagram(NetworkContext *ctx, ConnectedPeer *peer, const uint8_t *datagram, size_t length)
+{
+  if (length > 0 && (datagram[0] == PEER_DATAGRAM_UNRELIABLE || datagram[0] == PEER_DATAGRAM_SEQUENCED || datagram[0] == PEER_DATAGRAM_FRAGMENT))
+  {
+    handlePeerDatagram(ctx, peer, datagram, length);
+  }
+}
+
+static void handlePeerDatagram(NetworkContext *ctx, ConnectedPeer *peer, const uint8_t *datagram, size_t length)
+{
+  if (length < 1)
+  {
+    return;
+  }
+
+  switch (datagram[0])
+  {
+  case PEER_DATAGRAM_UNRELIABLE:
+    deliverPeerFrames(ctx, peer->id, datagram + 1, length - 1);
+    break;
+  case PEER_DATAGRAM_RELIABLE:
+  {
+    ByteBuffer ready = {0};
+    uint8_t ack[RELIABLE_ACK_SIZE];
+    if (receiveReliable(peer->channels, datagram + 1, length - 1, &ready, ack) == PLATFORM_SUCCESS)
+    {
+      sendDataTo(ctx->socket.socket, ack, sizeof(ack), 0, &peer->addr);
+    }
+    // The callback may connect more peers, so the id is taken before delivering.
+    deliverPeerFrames(ctx, peer->id, ready.bytes, ready.length);
+    byteBufferFree(&ready);
+    break;
+  }
+  case PEER_DATAGRAM_ACK:
+    receiveAck(peer->channels, datagram + 1, length - 1);
+    break;
+  case PEER_DATAGRAM_FRAGMENT:
+  {
+    uint8_t *message;
+    size_t messageLength;
+    if (receiveFragmented(peer->channels, datagram + 1, length - 1, &message, &messageLength) == PLATFORM_SUCCESS && message)
+    {
+      handlePeerDatagram(ctx, peer, message, messageLength);
+      free(message);
+    }
+    break;
+  }
+  case PEER_DATAGRAM_SEQUENCED:
+    if (acceptSequenced(peer->channels, datagram + 1, length - 1))
+    {
+      deliverPeerFrames(ctx, peer->id, datagram + 1 + sizeof(uint32_t), length - 1 - sizeof(uint32_t));
+    }
+    break;
+  case PEER_DATAGRAM_PROBE:
+  {
+    uint8_t feedback[PEER_FEEDBACK_SIZE];
+    if (receiveProbe(peer->channels, datagram + 1, length - 1, feedback) == PLATFORM_SUCCESS)
+    {
+      sendDataTo(ctx->socket.socket, feedback, sizeof(feedback), 0, &peer->addr);
+    }
+    break;
+  }
+  case PEER_DATAGRAM_FEEDBACK:
+    receiveFeedback(peer->channels, datagram + 1, length - 1);
+    break;
+  case PEER_DATAGRAM_FEC_DATA:
+  case PEER_DATAGRAM_FEC_PARITY:
+  {
+    uint8_t *recovered;
+    size_t recoveredLength;
+    if (datagram[0] == PEER_DATAGRAM_FEC_DATA)
+    {
+      if (receiveFecData(peer->channels, datagram + 1, length - 1, &recovered, &recoveredLength) == PLATFORM_SUCCESS)
+      {
+        handleProtectedDatagram(ctx, peer, datagram + FEC_DATA_HEADER_SIZE, length - FEC_DATA_HEADER_SIZE);
+      }
+    }
+    else
+    {
+      receiveFecParity(peer->channels, datagram + 1, length - 1, &recovered, &recoveredLength);
+    }
+    if (recovered)
+    {
+      handleProtectedDatagram(ctx, peer, recovered, recoveredLength);
+      free(recovered);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// Runs with ctx->lock held, so onPeerData is called under the lock like every other callback.
+static void receivePeerDatagram(NetworkContext *ctx, const struct sockaddr_in *from, const uint8_t *datagram, size_t length)
+{
+  ConnectedPeer *peer = findPeerByAddress(ctx, from);
+  if (peer == NULL)
+  {
+    return;
+  }
+
+  if (peer->keepalive)
+  {
+    peer->keepalive->lastReceived = monotonicMilliseconds();
+  }
+  countReceived(peer->channels, datagram, length);
+  handlePeerDatagram(ctx, peer, datagram, length);
+}
+
+static void *peerReceiveLoop(void *arg)
+{
+  NetworkContext *ctx = (NetworkContext *)arg;
+  setCurrentContext(ctx);
+  pinIoThread(&ctx->affinity);
+
+  uint8_t *datagram = (uint8_t *)malloc(PEER_MAX_DATAGRAM);
+  if (!datagram)
+  {
+    strncpy(ctx->lastError, "Failed to allocate memory\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NULL;
+  }
+
+  uint64_t nextService = 0;
+  while (ctx->peer.listening)
+  {
+    uint64_t now = monotonicMilliseconds();
+    int timeout = nextService > now && nextService - now < PEER_TIMER_INTERVAL_MS ? (int)(nextService - now) : PEER_TIMER_INTERVAL_MS;
+    int readable = pollReadable(ctx->socket.socket, timeout);
+
+    // Drain everything that is queued before servicing timers, so acks are processed ahead of retransmits.
+    while (readable == PLATFORM_SUCCESS && ctx->peer.listening)
+    {
+      struct sockaddr_in from;
+      uint64_t readingAt = traceStart(ctx);
+      int received = recvDataFrom(ctx->socket.socket, datagram, PEER_MAX_DATAGRAM, 0, &from);
+      if (received > 0)
+      {
+        // The peer and the messages are only known once the datagram is handled under the lock.
+        traceEnd(ctx, TRACE_RECEIVE, readingAt, -1, (NetworkedType)0, (size_t)received);
+        ctx->peer.receivedAt = monotonicMicroseconds();
+        uint64_t waitingAt = traceStart(ctx);
+        pthread_mutex_lock(&ctx->lock);
+        traceEnd(ctx, TRACE_LOCK_WAIT, waitingAt, -1, (NetworkedType)0, 0);
+        receivePeerDatagram(ctx, &from, datagram, (size_t)received);
+        pthread_mutex_unlock(&ctx->lock);
+      }
+      readable = received >= 0 ? pollReadable(ctx->socket.socket, 0) : 0;
+    }
+
+    now = monotonicMilliseconds();
+    if (now >= nextService)
+    {
+      nextService = 0;
+      pthread_mutex_lock(&ctx->lock);
+      for (int i = 0; i < ctx->peer.numPeers; i++)
+      {
+        ConnectedPeer *peer = &ctx->peer.peers[i];
+        uint64_t deadline = servicePeerChannels(peer->channels, ctx->socket.socket, &peer->addr, now);
+        if (deadline != 0 && (nextService == 0 || deadline < nextService))
+        {
+          nextService = deadline;
+        }
+      }
+      pthread_mutex_unlock(&ctx->lock);
+      if (nextService == 0)
+      {
+        nextService = now + PEER_TIMER_INTERVAL_MS;
+      }
+    }
+
+    if (ctx->timersNeeded)
+    {
+      serviceTimers(ctx);
+    }
+  }
+
+  free(datagram);
+  return NULL;
+}
+
+int sendToPeerCtx(NexContext *ctx, Data data, int peer)
+{
+  return sendToPeerOnChannelCtx(ctx, data, peer, PEER_CHANNEL_UNRELIABLE);
+}
+
+int sendToPeerOnChannelCtx(NexContext *ctx, Data data, int peer, PeerChannel channel)
+{
+  if (ctx->connectionType != CONNECTION_UDP)
+  {
+    strncpy(ctx->lastError, "Must have connection UDP type set in order to call sendToPeer()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (peer == -1)
+  {
+    strncpy(ctx->lastError, "Cannot send to an invalid peer.", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (!isSendableType(data.type))
+  {
+    strncpy(ctx->lastError, "Unknown data type passed into sendToPeer().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (channel != PEER_CHANNEL_UNRELIABLE && channel != PEER_CHANNEL_RELIABLE_ORDERED && channel != PEER_CHANNEL_UNRELIABLE_SEQUENCED)
+  {
+    strncpy(ctx->lastError, "Unknown channel passed into sendToPeerOnChannel().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  PeerHandle connected;
+  if (!acquirePeer(ctx, peer, &connected))
+  {
+    strncpy(ctx->lastError, "Cannot send to an inexistent peer.", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  int result;
+  size_t frameLength = 0;
+  uint64_t startedAt = traceStart(ctx);
+  switch (channel)
+  {
+  case PEER_CHANNEL_RELIABLE_ORDERED:
+    result = sendReliable(connected.channels, ctx->socket.socket, &connected.addr, data, &frameLength);
+    break;
+  case PEER_CHANNEL_UNRELIABLE_SEQUENCED:
+    result = sendSequenced(connected.channels, ctx->socket.socket, &connected.addr, data, &frameLength);
+    break;
+  case PEER_CHANNEL_UNRELIABLE:
+  default:
+    result = sendUnreliable(connected.channels, ctx->socket.socket, &connected.addr, data, &frameLength);
+    break;
+  }
+  releasePeer(&connected);
+
+  traceEnd(ctx, TRACE_SEND, startedAt, peer, data.type, frameLength);
+  if (result == PLATFORM_SUCCESS)
+  {
+    recordSent(&ctx->metrics, NULL, data.type, frameLength);
+  }
+  else
+  {
+    recordSendFailure(&ctx->metrics, NULL);
+  }
+
+  if (result == CHANNEL_WINDOW_FULL)
+  {
+    strncpy(ctx->lastError, "Too many messages waiting for an acknowledgement or for the pacer.", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_QUEUE_FULL;
+  }
+  if (result == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Send to peer failed.", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_SEND;
+  }
+
+  return NETWORK_OK;
+}
+
+int setPeerCongestionCtx(NexContext *ctx, CongestionOptions options)
+{
+  if (ctx->connectionType != CONNECTION_UDP)
+  {
+    strncpy(ctx->lastError, "Must have connection UDP type set in order to call setPeerCongestion()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (options.maxRateBytesPerSecond > 0 && options.initialRateBytesPerSecond > options.maxRateBytesPerSecond)
+  {
+    strncpy(ctx->lastError, "Initial rate above the max rate passed into setPeerCongestion()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  pthread_mutex_lock(&ctx->lock);
+  ctx->peer.congestion = options;
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    configurePeerChannels(ctx->peer.peers[i].channels, &options);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+  return NETWORK_OK;
+}
+
+int setPeerFecCtx(NexContext *ctx, int groupSize)
+{
+  if (ctx->connectionType != CONNECTION_UDP)
+  {
+    strncpy(ctx->lastError, "Must have connection UDP type set in order to call setPeerFec()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (groupSize < 0 || groupSize > FEC_MAX_GROUP_SIZE)
+  {
+    strncpy(ctx->lastError, "Invalid group size passed into setPeerFec()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  pthread_mutex_lock(&ctx->lock);
+  ctx->peer.fecGroupSize = groupSize;
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    configurePeerFec(ctx->peer.peers[i].channels, groupSize);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+  return NETWORK_OK;
+}
+
+int getPeerStatsCtx(NexContext *ctx, int peer, PeerStats *stats)
+{
+  if (ctx->socketType != Peer || stats == NULL)
+  {
+    strncpy(ctx->lastError, "Must have socketType Peer passed into init() and a non NULL stats in order to call getPeerStats()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  PeerHandle connected;
+  if (!acquirePeer(ctx, peer, &connected))
+  {
+    strncpy(ctx->lastError, "Peer passed into getPeerStats does not exist!", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  getChannelStats(connected.channels, stats);
+  releasePeer(&connected);
+  return NETWORK_OK;
+}
+
+static void restartKeepalive(NetworkContext *ctx, Keepalive *keepalive, uint64_t now)
+{
+  if (keepalive)
+  {
+    keepalive->lastReceived = now;
+    armKeepalive(ctx, keepalive);
+  }
+}
+
+int setKeepaliveCtx(NexContext *ctx, KeepaliveOptions options)
+{
+  if (options.heartbeatIntervalMs < 0 || options.idleTimeoutMs < 0)
+  {
+    strncpy(ctx->lastError, "Negative interval passed into setKeepalive()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  // Traffic is only recorded while an idle timeout is set, so existing connections start their idle period now.
+  uint64_t now = monotonicMilliseconds();
+  pthread_mutex_lock(&ctx->lock);
+  ctx->keepalive = options;
+  if (options.heartbeatIntervalMs > 0 || options.idleTimeoutMs > 0)
+  {
+    ctx->timersNeeded = true;
+  }
+  for (int i = 0; i < ctx->server.numClients; i++)
+  {
+    restartKeepalive(ctx, ctx->server.clients[i].keepalive, now);
+  }
+  restartKeepalive(ctx, ctx->client.keepalive, now);
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    restartKeepalive(ctx, ctx->peer.peers[i].keepalive, now);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+
+  if (streamConnection(ctx) && (ctx->server.listening || ctx->client.running))
+  {
+    return startOutboundThread(ctx);
+  }
+  return NETWORK_OK;
+}
+
+int setPeerContextCtx(NexContext *ctx, void *context, int peer, void (*deleter)(void *))
+{
+  if (ctx->socketType != Peer)
+  {
+    strncpy(ctx->lastError, "Must have socketType Peer passed into init() in order to call setPeerContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (ctx->connectionType != CONNECTION_UDP)
+  {
+    strncpy(ctx->lastError, "Must have connection UDP type set in order to call setPeerContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (peer == -1)
+  {
+    strncpy(ctx->lastError, "Cannot set conext of an invalid or closed peer", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    if (ctx->peer.peers[i].id != peer)
+    {
+      continue;
+    }
+
+    ctx->peer.peers[i].context = context;
+    ctx->peer.peers[i].contextDeleter = deleter;
+
+    return NETWORK_OK;
+  }
+
+  strncpy(ctx->lastError, "Peer passed into setPeerContext does not exist!", sizeof(ctx->lastError) - 1);
+  ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  return NETWORK_ERR_UNKNOWN;
+}
+
+void *getPeerContextCtx(NexContext *ctx, int peer)
+{
+  if (ctx->socketType != Peer)
+  {
+    strncpy(ctx->lastError, "Must have socketType Peer passed into init() in order to call getPeerContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NULL;
+  }
+
+  if (ctx->connectionType != CONNECTION_UDP)
+  {
+    strncpy(ctx->lastError, "Must have connection UDP type set in order to call getPeerContext()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NULL;
+  }
+
+  if (peer == -1)
+  {
+    strncpy(ctx->lastError, "Cannot set conext of an invalid or closed peer", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NULL;
+  }
+
+  for (int i = 0; i < ctx->peer.numPeers; i++)
+  {
+    if (ctx->peer.peers[i].id != peer)
+    {
+      continue;
+    }
+
+    if (ctx->peer.peers[i].context == NULL)
+    {
+      strncpy(ctx->lastError, "Warning: Getting NULL peer context in getPeerContext().", sizeof(ctx->lastError) - 1);
+      ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    }
+
+    return ctx->peer.peers[i].context;
+  }
+
+  strncpy(ctx->lastError, "Peer passed into getPeerContext does not exist!", sizeof(ctx->lastError) - 1);
+  ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+  return NULL;
+}
+
+int getMetricsCtx(NexContext *ctx, MetricsSnapshot *metrics)
+{
+  if (metrics == NULL)
+  {
+    strncpy(ctx->lastError, "NULL snapshot passed into getMetrics().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  snapshotMetrics(&ctx->metrics, metrics);
+
+  // Only outboundLock is taken, which callbacks do not hold, so this works from inside one as well.
+  pthread_mutex_lock(&ctx->outboundLock);
+  if (ctx->socketType == Server)
+  {
+    metrics->connections = ctx->server.numClients;
+    for (int i = 0; i < ctx->server.numClients; i++)
+    {
+      if (ctx->server.clients[i].outbound)
+      {
+        metrics->queuedBytes += outboundQueuedBytes(ctx->server.clients[i].outbound);
+      }
+    }
+  }
+  else if (ctx->socketType == Client)
+  {
+    metrics->connections = ctx->client.running ? 1 : 0;
+    metrics->queuedBytes = ctx->client.outbound ? outboundQueuedBytes(ctx->client.outbound) : 0;
+  }
+  else
+  {
+    metrics->connections = ctx->peer.numPeers;
+  }
+  pthread_mutex_unlock(&ctx->outboundLock);
+  return NETWORK_OK;
+}
+
+int getConnectionMetricsCtx(NexContext *ctx, socket_t socket, ConnectionMetrics *metrics)
+{
+  if (metrics == NULL)
+  {
+    strncpy(ctx->lastError, "NULL metrics passed into getConnectionMetrics().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  pthread_mutex_lock(&ctx->outboundLock);
+  ConnectionCounters *counters = NULL;
+  OutboundQueue *outbound = NULL;
+  if (ctx->socketType == Server)
+  {
+    int i = findClientIndex(ctx, socket);
+    if (i >= 0)
+    {
+      counters = ctx->server.clients[i].counters;
+      outbound = ctx->server.clients[i].outbound;
+    }
+  }
+  else if (ctx->socketType == Client && socket == ctx->socket.socket)
+  {
+    counters = ctx->client.counters;
+    outbound = ctx->client.outbound;
+  }
+
+  if (counters == NULL)
+  {
+    pthread_mutex_unlock(&ctx->outboundLock);
+    strncpy(ctx->lastError, "Unknown connection passed into getConnectionMetrics().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  snapshotConnection(counters, metrics);
+  metrics->queuedBytes = outbound ? outboundQueuedBytes(outbound) : 0;
+  pthread_mutex_unlock(&ctx->outboundLock);
+  return NETWORK_OK;
+}
+
+static int formatMetrics(NetworkContext *ctx, ByteBuffer *text)
+{
+  MetricsSnapshot snapshot;
+  getMetricsCtx(ctx, &snapshot);
+  return formatPrometheus(&snapshot, text);
+}
+
+int writeMetricsCtx(NexContext *ctx, const char *path)
+{
+  if (path == NULL)
+  {
+    strncpy(ctx->lastError, "NULL path passed into writeMetrics().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  ByteBuffer text = {0};
+  if (formatMetrics(ctx, &text) == PLATFORM_FAILURE)
+  {
+    byteBufferFree(&text);
+    strncpy(ctx->lastError, "Out of memory formatting metrics", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+
+  char temporary[1024];
+  snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+  FILE *file = fopen(temporary, "wb");
+  bool written = file != NULL && fwrite(text.bytes, 1, text.length, file) == text.length;
+  if (file != NULL && fclose(file) != 0)
+  {
+    written = false;
+  }
+  byteBufferFree(&text);
+
+#ifdef PLATFORM_WINDOWS
+  // rename does not replace an existing file on Windows.
+  if (written)
+  {
+    remove(path);
+  }
+#endif
+  if (!written || rename(temporary, path) != 0)
+  {
+    remove(temporary);
+    snprintf(ctx->lastError, sizeof(ctx->lastError), "Failed to write metrics to %s", path);
+    return NETWORK_ERR_UNKNOWN;
+  }
+  return NETWORK_OK;
+}
+
+// Answers one scrape. The request itself is read and ignored, whatever its path.
+static void serveMetrics(NetworkContext *ctx, socket_t socket)
+{
+  setSocketBlocking(socket, 1);
+
+  char request[1024];
+  size_t length = 0;
+  while (length < sizeof(request) - 1 && pollReadable(socket, METRICS_REQUEST_TIMEOUT_MS) == PLATFORM_SUCCESS)
+  {
+    int received = recvData(socket, request + length, sizeof(request) - 1 - length, 0);
+    if (received == PLATFORM_FAILURE || received == PLATFORM_CONNECTION_CLOSED)
+    {
+      break;
+    }
+    length += (size_t)received;
+    request[length] = '\0';
+    if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+    {
+      break;
+    }
+  }
+
+  ByteBuffer body = {0};
+  if (formatMetrics(ctx, &body) == PLATFORM_SUCCESS)
+  {
+    char header[256];
+    int headerLength = snprintf(header, sizeof(header),
+                                "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                body.length);
+    if (sendAll(socket, header, (size_t)headerLength, 0) == PLATFORM_SUCCESS)
+    {
+      sendAll(socket, body.bytes, body.length, 0);
+    }
+  }
+  byteBufferFree(&body);
+  closeSocket(socket);
+}
+
+static void *metricsEndpointLoop(void *arg)
+{
+  NetworkContext *ctx = (NetworkContext *)arg;
+
+  while (ctx->metricsEndpoint.running)
+  {
+    if (pollReadable(ctx->metricsEndpoint.socket, ACCEPT_POLL_INTERVAL_MS) != PLATFORM_SUCCESS)
+    {
+      continue;
+    }
+
+    socket_t client;
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    while (ctx->metricsEndpoint.running && acceptPending(ctx->metricsEndpoint.socket, &client, (struct sockaddr *)&addr, &addrLen) == PLATFORM_SUCCESS)
+    {
+      serveMetrics(ctx, client);
+      addrLen = sizeof(addr);
+    }
+  }
+
+  return NULL;
+}
+
+int startMetricsEndpointCtx(NexContext *ctx, int port)
+{
+  if (ctx->metricsEndpoint.running)
+  {
+    strncpy(ctx->lastError, "The metrics endpoint is already running.", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  socket_t socket = createSocket(SOCK_STREAM, IPPROTO_TCP);
+  if (socket == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Socket creation failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_SOCKET;
+  }
+
+  struct sockaddr_in addr = createSockaddrIn(port, "0.0.0.0");
+  if (bindSocket(socket, (struct sockaddr *)&addr, sizeof(addr)) == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Socket bind failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(socket);
+    return NETWORK_ERR_BIND;
+  }
+
+  if (listenSocket(socket, SOMAXCONN) == PLATFORM_FAILURE || setSocketBlocking(socket, 0) == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Listen failed\n", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(socket);
+    return NETWORK_ERR_LISTEN;
+  }
+
+  ctx->metricsEndpoint.socket = socket;
+  ctx->metricsEndpoint.running = true;
+  if (pthread_create(&ctx->metricsEndpoint.thread, NULL, metricsEndpointLoop, ctx) != 0)
+  {
+    ctx->metricsEndpoint.running = false;
+    ctx->metricsEndpoint.thread = 0;
+    strncpy(ctx->lastError, "pthread_create metricsEndpointLoop failed", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    closeSocket(socket);
+    return NETWORK_ERR_THREAD;
+  }
+
+  return NETWORK_OK;
+}
+
+int setTracingCtx(NexContext *ctx, TraceOptions options)
+{
+  if (options.eventsPerThread < 0)
+  {
+    strncpy(ctx->lastError, "Negative ring size passed into setTracing().", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  configureTrace(&ctx->trace, &options);
+  return NETWORK_OK;
+}
+
+int flushTraceCtx(NexContext *ctx)
+{
+  flushTraceRings(&ctx->trace);
+  return NETWORK_OK;
+}
+
+int startCaptureCtx(NexContext *ctx, const char *path)
+{
+  if (ctx->socketType != Server || !streamConnection(ctx))
+  {
+    strncpy(ctx->lastError, "Must have socketType Server and connection TCP, LOCAL or SHARED_MEMORY type set in order to call startCapture()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  if (path == NULL || openCapture(&ctx->capture, path) != PLATFORM_SUCCESS)
+  {
+    strncpy(ctx->lastError, "Could not create the capture file passed into startCapture(), or a capture is already running", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+  return NETWORK_OK;
+}
+
+int stopCaptureCtx(NexContext *ctx)
+{
+  closeCapture(&ctx->capture);
+  return NETWORK_OK;
+}
+
+// Sleeps through most of the wait for a replayed message and spins through the last millisecond, which a sleep would
+// overshoot.
+static void waitUntil(uint64_t due)
+{
+  uint64_t now = monotonicMicroseconds();
+  if (due > now + 2000)
+  {
+    sleepMilliseconds((int)((due - now) / 1000) - 1);
+  }
+  while (monotonicMicroseconds() < due)
+  {
+  }
+}
+
+int replayCaptureCtx(NexContext *ctx, const char *path, void (*onClientData)(Data, socket_t), ReplayPacing pacing)
+{
+  if (ctx->socketType != Server || onClientData == NULL)
+  {
+    strncpy(ctx->lastError, "Must have socketType Server passed into init() and a callback passed into replayCapture()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  CaptureReader reader;
+  if (path == NULL || openCaptureReader(&reader, path) != PLATFORM_SUCCESS)
+  {
+    strncpy(ctx->lastError, "Could not open the capture file passed into replayCapture()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  setCurrentContext(ctx);
+  uint64_t startedAt = monotonicMicroseconds();
+  CaptureRecord record;
+  const uint8_t *frame;
+  int result;
+  while ((result = nextCaptureRecord(&reader, &record, &frame)) == PLATFORM_SUCCESS)
+  {
+    // The same messages clientDataLoop hands to the callback, with connects and disconnects taken from the log.
+    Data data;
+    NetworkedType type = record.length > 0 ? (NetworkedType)frame[0] : (NetworkedType)0;
+    if (type == TYPE_CONNECTED || type == TYPE_DISCONNECTED)
+    {
+      memset(&data, 0, sizeof(Data));
+      data.type = type;
+    }
+    else if (type == TYPE_HEARTBEAT || type == TYPE_SNAPSHOT_ACK || type == TYPE_REQUEST || type == TYPE_RESPONSE ||
+             decodeFrame(frame, record.length, &data) != PLATFORM_SUCCESS)
+    {
+      continue;
+    }
+
+    uint64_t receivedAt = startedAt + record.microseconds;
+    if (pacing == REPLAY_ORIGINAL_TIMING)
+    {
+      waitUntil(receivedAt);
+    }
+    else
+    {
+      receivedAt = monotonicMicroseconds();
+    }
+    if (type != TYPE_CONNECTED && type != TYPE_DISCONNECTED)
+    {
+      recordReceived(&ctx->metrics, NULL, type, record.length);
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    uint64_t callbackAt = beginCallback(ctx, receivedAt);
+    onClientData(data, type == TYPE_DISCONNECTED ? -1 : (socket_t)record.connection);
+    endCallback(ctx, callbackAt, record.connection, type, record.length);
+    pthread_mutex_unlock(&ctx->lock);
+    freeRecvData(&data);
+  }
+  closeCaptureReader(&reader);
+
+  if (result == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Capture file passed into replayCapture() ends in a partial record", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+  return NETWORK_OK;
+}
+
+void chromeTraceSink(const TraceEvent *events, size_t count, void *userData)
+{
+  static const char *stageNames[] = {"receive", "lock wait", "callback", "send"};
+  FILE *file = (FILE *)userData;
+  if (file == NULL)
+  {
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const TraceEvent *event = &events[i];
+    fputs(ftell(file) == 0 ? "[\n" : ",\n", file);
+    fprintf(file, "{\"name\":\"%s\",\"cat\":\"nex\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"connection\":%lld,\"type\":%d,\"bytes\":%u}}",
+            stageNames[event->stage], (unsigned long long)event->startMicroseconds, (unsigned long long)event->durationMicroseconds, event->thread,
+            (long long)event->connection, (int)event->type, event->bytes);
+  }
+  fflush(file);
+}
+
+int shutdownNetworkCtx(NexContext *ctx)
+{
+  if (ctx->metricsEndpoint.running)
+  {
+    ctx->metricsEndpoint.running = false;
+    shutdownBoth(ctx->metricsEndpoint.socket);
+    joinThread(&ctx->metricsEndpoint.thread);
+    closeSocket(ctx->metricsEndpoint.socket);
+  }
+
+  if (ctx->outboundRunning)
+  {
+    ctx->outboundRunning = false;
+    pthread_join(ctx->outboundThread, NULL);
+  }
+
+  if (ctx->socketType == Server)
+  {
+    pthread_mutex_lock(&ctx->lock);
+    ctx->server.listening = false;
+    pthread_cond_broadcast(&ctx->server.threadsDone);
+    pthread_mutex_unlock(&ctx->lock);
+    shutdownBoth(ctx->socket.socket);
+    joinThread(&ctx->server.acceptThread);
+
+    // A client that stopped reading gets what fits before the deadline, it must not hold up the shutdown.
+    uint64_t deadline = monotonicMilliseconds() + OUTBOUND_DRAIN_TIMEOUT_MS;
+    pthread_mutex_lock(&ctx->lock);
+    for (int i = 0; i < ctx->server.numClients; i++)
+    {
+      if (ctx->server.clients[i].outbound)
+      {
+        int events = 0;
+        drainOutboundQueue(ctx->server.clients[i].outbound, deadline, &events);
+      }
+      closeSharedLink(ctx->server.clients[i].shared);
+      shutdownBoth(ctx->server.clients[i].socket.socket);
+    }
+    // Each client thread removes its own client on the way out.
+    while (ctx->server.activeThreads > 0)
+    {
+      pthread_cond_wait(&ctx->server.threadsDone, &ctx->lock);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    removeAllClients(ctx);
+    closeSocket(ctx->socket.socket);
+  }
+
+  if (ctx->socketType == Client)
+  {
+    pthread_mutex_lock(&ctx->lock);
+    bool wasRunning = ctx->client.running;
+    ctx->client.running = false;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (ctx->client.outbound && wasRunning)
+    {
+      int events = 0;
+      drainOutboundQueue(ctx->client.outbound, monotonicMilliseconds() + OUTBOUND_DRAIN_TIMEOUT_MS, &events);
+    }
+    // The receive thread closes the socket itself when the server goes away first.
+    if (wasRunning)
+    {
+      closeSharedLink(ctx->client.shared);
+      shutdownBoth(ctx->socket.socket);
+    }
+    joinThread(&ctx->client.serverThread);
+    if (wasRunning)
+    {
+      closeSocket(ctx->socket.socket);
+    }
+
+    pthread_mutex_lock(&ctx->outboundLock);
+    destroyOutboundQueue(ctx->client.outbound);
+    ctx->client.outbound = NULL;
+    free(ctx->client.counters);
+    ctx->client.counters = NULL;
+    destroySharedLink(ctx->client.shared);
+    ctx->client.shared = NULL;
+    pthread_mutex_unlock(&ctx->outboundLock);
+
+    destroyRequestTable(ctx->client.requests);
+    ctx->client.requests = NULL;
+  }
+
+  if (ctx->socketType == Peer)
+  {
+    ctx->peer.listening = false;
+    joinThread(&ctx->peer.receiveThread);
+    removeAllPeers(ctx);
+    closeSocket(ctx->socket.socket);
+  }
+
+  destroyTimerWheel(ctx->timers);
+  ctx->timers = NULL;
+  clearAffinity(&ctx->affinity);
+  clearTrace(&ctx->trace);
+  closeCapture(&ctx->capture);
+  return NETWORK_OK;
 }
 
-void printLastError()
+static void joinThread(pthread_t *thread)
+{
+  if (*thread != 0 && !pthread_equal(*thread, pthread_self()))
+  {
+    pthread_join(*thread, NULL);
+  }
+  *thread = 0;
+}
+
+static void setContextSocketOptions(NetworkContext *ctx, const SocketOptions *options)
+{
+  if (options)
+  {
+    ctx->socketOptions = *options;
+  }
+  else
+  {
+    memset(&ctx->socketOptions, 0, sizeof(SocketOptions));
+  }
+
+  if (localConnection(ctx))
+  {
+    ctx->socketOptions.noDelay = false;
+    ctx->socketOptions.quickAck = false;
+  }
+}
+
+socket_t getLocalSocketCtx(NexContext *ctx)
+{
+  if (!ctx->server.listening && !ctx->client.running && !ctx->peer.listening)
+  {
+    strncpy(ctx->lastError, "No socket has been created yet, call startServer(), connectToServer() or startPeer() first.", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return -1;
+  }
+
+  return ctx->socket.socket;
+}
+
+int getSocketOptionsCtx(NexContext *ctx, socket_t socket, SocketOptions *options)
+{
+  if (options == NULL || socket == -1)
+  {
+    strncpy(ctx->lastError, "Invalid socket or options passed into getSocketOptions()", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  memset(options, 0, sizeof(SocketOptions));
+
+  if (getSocketOption(socket, SOCKET_OPTION_SEND_BUFFER, &options->sendBufferSize) == PLATFORM_FAILURE ||
+      getSocketOption(socket, SOCKET_OPTION_RECEIVE_BUFFER, &options->receiveBufferSize) == PLATFORM_FAILURE)
+  {
+    strncpy(ctx->lastError, "Failed to query socket options, the socket may be closed", sizeof(ctx->lastError) - 1);
+    ctx->lastError[sizeof(ctx->lastError) - 1] = '\0';
+    return NETWORK_ERR_SOCKET;
+  }
+
+  int value = 0;
+  if (getSocketOption(socket, SOCKET_OPTION_NO_DELAY, &value) == PLATFORM_SUCCESS)
+  {
+    options->noDelay = value != 0;
+  }
+  value = 0;
+  if (getSocketOption(socket, SOCKET_OPTION_QUICK_ACK, &value) == PLATFORM_SUCCESS)
+  {
+    options->quickAck = value != 0;
+  }
+  getSocketOption(socket, SOCKET_OPTION_BUSY_POLL, &options->busyPollMicroseconds);
+  getSocketOption(socket, SOCKET_OPTION_PRIORITY, &options->priority);
+
+  return NETWORK_OK;
+}
+
+void printLastErrorCtx(NexContext *ctx)
 {
-  if (strlen(networkContext.lastError) > 0)
+  if (strlen(ctx->lastError) > 0)
   {
-    printf("Error: %s\n", networkContext.lastError);
+    printf("Error: %s\n", ctx->lastError);
   }
   else
   {
@@ -974,12 +3675,348 @@ void printLastError()
   }
 }
 
-const char *getLastError()
+const char *getLastErrorCtx(NexContext *ctx)
 {
-  if (strlen(networkContext.lastError) > 0)
+  if (strlen(ctx->lastError) > 0)
   {
-    return networkContext.lastError;
+    return ctx->lastError;
   }
 
   return "No error occurred.\n";
-}
\ No newline at end of file
+}
+int createContext(NexContext **context, ConnectionType connectionType, SocketType socketType)
+{
+  if (context == NULL)
+  {
+    strncpy(networkContext.lastError, "Invalid context pointer passed into createContext()", sizeof(networkContext.lastError) - 1);
+    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    return NETWORK_ERR_INVALID;
+  }
+
+  *context = NULL;
+  NetworkContext *ctx = (NetworkContext *)calloc(1, sizeof(NetworkContext));
+  if (ctx == NULL)
+  {
+    strncpy(networkContext.lastError, "Out of memory allocating context", sizeof(networkContext.lastError) - 1);
+    networkContext.lastError[sizeof(networkContext.lastError) - 1] = '\0';
+    return NETWORK_ERR_MEMORY;
+  }
+
+  int result = initContext(ctx, connectionType, socketType);
+  if (result != NETWORK_OK)
+  {
+    memcpy(networkContext.lastError, ctx->lastError, sizeof(networkContext.lastError));
+    free(ctx);
+    return result;
+  }
+
+  *context = ctx;
+  return NETWORK_OK;
+}
+
+void destroyContext(NexContext *ctx)
+{
+  if (ctx == NULL)
+  {
+    return;
+  }
+
+  shutdownNetworkCtx(ctx);
+  if (ctx == &networkContext)
+  {
+    return;
+  }
+
+  free(ctx->server.clients);
+  free(ctx->server.clientThreads);
+  free(ctx->peer.peers);
+  pthread_mutex_destroy(&ctx->lock);
+  pthread_mutex_destroy(&ctx->outboundLock);
+  pthread_cond_destroy(&ctx->server.threadsDone);
+  free(ctx);
+}
+
+NexContext *getDefaultContext()
+{
+  return &networkContext;
+}
+
+NexContext *getCurrentContext()
+{
+  return currentContext;
+}
+
+int init(ConnectionType connectionType, SocketType socketType)
+{
+  return initContext(&networkContext, connectionType, socketType);
+}
+
+int startServer(int port, int maxClients, void (*onClientData)(Data, socket_t))
+{
+  return startServerCtx(&networkContext, port, maxClients, onClientData);
+}
+
+int startServerWithOptions(int port, int maxClients, void (*onClientData)(Data, socket_t), const SocketOptions *options)
+{
+  return startServerWithOptionsCtx(&networkContext, port, maxClients, onClientData, options);
+}
+
+int setAcceptOptions(AcceptOptions options)
+{
+  return setAcceptOptionsCtx(&networkContext, options);
+}
+
+int getAcceptStats(AcceptStats *stats)
+{
+  return getAcceptStatsCtx(&networkContext, stats);
+}
+
+int setThreadPlacement(ThreadPlacement placement)
+{
+  return setThreadPlacementCtx(&networkContext, placement);
+}
+
+int sendToAllClients(Data data)
+{
+  return sendToAllClientsCtx(&networkContext, data);
+}
+
+int broadcastToClients(Data data, socket_t sender)
+{
+  return broadcastToClientsCtx(&networkContext, data, sender);
+}
+
+int sendToClient(Data data, socket_t client)
+{
+  return sendToClientCtx(&networkContext, data, client);
+}
+
+int sendSnapshotToClient(const cJSON *snapshot, socket_t client)
+{
+  return sendSnapshotToClientCtx(&networkContext, snapshot, client);
+}
+
+int sendSnapshotToAllClients(const cJSON *snapshot)
+{
+  return sendSnapshotToAllClientsCtx(&networkContext, snapshot);
+}
+
+int setFlushPolicy(FlushPolicy policy)
+{
+  return setFlushPolicyCtx(&networkContext, policy);
+}
+
+int setBackpressure(BackpressureOptions options)
+{
+  return setBackpressureCtx(&networkContext, options);
+}
+
+int setLocalHandoff(size_t thresholdBytes)
+{
+  return setLocalHandoffCtx(&networkContext, thresholdBytes);
+}
+
+int flushClient(socket_t client)
+{
+  return flushClientCtx(&networkContext, client);
+}
+
+int flushAllClients()
+{
+  return flushAllClientsCtx(&networkContext);
+}
+
+int setClientContext(void *context, socket_t client, void (*deleter)(void *))
+{
+  return setClientContextCtx(&networkContext, context, client, deleter);
+}
+
+void *getClientContext(socket_t client)
+{
+  return getClientContextCtx(&networkContext, client);
+}
+
+int requestClient(Data data, socket_t client, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData)
+{
+  return requestClientCtx(&networkContext, data, client, timeoutMs, onResponse, userData);
+}
+
+int setClientRequestHandler(void (*onRequest)(Data, socket_t, uint32_t))
+{
+  return setClientRequestHandlerCtx(&networkContext, onRequest);
+}
+
+int setClientViewHandler(void (*onClientView)(DataView, socket_t))
+{
+  return setClientViewHandlerCtx(&networkContext, onClientView);
+}
+
+int respondToClient(Data data, socket_t client, uint32_t requestId)
+{
+  return respondToClientCtx(&networkContext, data, client, requestId);
+}
+
+int connectToServer(const char *ip, int port, void (*onServerData)(Data))
+{
+  return connectToServerCtx(&networkContext, ip, port, onServerData);
+}
+
+int connectToServerWithOptions(const char *ip, int port, void (*onServerData)(Data), const SocketOptions *options)
+{
+  return connectToServerWithOptionsCtx(&networkContext, ip, port, onServerData, options);
+}
+
+int sendToServer(Data data)
+{
+  return sendToServerCtx(&networkContext, data);
+}
+
+int flushServer()
+{
+  return flushServerCtx(&networkContext);
+}
+
+int requestServer(Data data, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData)
+{
+  return requestServerCtx(&networkContext, data, timeoutMs, onResponse, userData);
+}
+
+int setServerRequestHandler(void (*onRequest)(Data, uint32_t))
+{
+  return setServerRequestHandlerCtx(&networkContext, onRequest);
+}
+
+int setServerViewHandler(void (*onServerView)(DataView))
+{
+  return setServerViewHandlerCtx(&networkContext, onServerView);
+}
+
+int respondToServer(Data data, uint32_t requestId)
+{
+  return respondToServerCtx(&networkContext, data, requestId);
+}
+
+int startPeer(int port, int maxPeers, void (*onPeerData)(Data, int))
+{
+  return startPeerCtx(&networkContext, port, maxPeers, onPeerData);
+}
+
+int startPeerWithOptions(int port, int maxPeers, void (*onPeerData)(Data, int), const SocketOptions *options)
+{
+  return startPeerWithOptionsCtx(&networkContext, port, maxPeers, onPeerData, options);
+}
+
+int connectToPeer(const char *ip, int port)
+{
+  return connectToPeerCtx(&networkContext, ip, port);
+}
+
+int sendToPeer(Data data, int peer)
+{
+  return sendToPeerCtx(&networkContext, data, peer);
+}
+
+int sendToPeerOnChannel(Data data, int peer, PeerChannel channel)
+{
+  return sendToPeerOnChannelCtx(&networkContext, data, peer, channel);
+}
+
+int setPeerCongestion(CongestionOptions options)
+{
+  return setPeerCongestionCtx(&networkContext, options);
+}
+
+int setPeerFec(int groupSize)
+{
+  return setPeerFecCtx(&networkContext, groupSize);
+}
+
+int getPeerStats(int peer, PeerStats *stats)
+{
+  return getPeerStatsCtx(&networkContext, peer, stats);
+}
+
+int setKeepalive(KeepaliveOptions options)
+{
+  return setKeepaliveCtx(&networkContext, options);
+}
+
+int setPeerContext(void *context, int peer, void (*deleter)(void *))
+{
+  return setPeerContextCtx(&networkContext, context, peer, deleter);
+}
+
+void *getPeerContext(int peer)
+{
+  return getPeerContextCtx(&networkContext, peer);
+}
+
+int getMetrics(MetricsSnapshot *metrics)
+{
+  return getMetricsCtx(&networkContext, metrics);
+}
+
+int getConnectionMetrics(socket_t socket, ConnectionMetrics *metrics)
+{
+  return getConnectionMetricsCtx(&networkContext, socket, metrics);
+}
+
+int writeMetrics(const char *path)
+{
+  return writeMetricsCtx(&networkContext, path);
+}
+
+int startMetricsEndpoint(int port)
+{
+  return startMetricsEndpointCtx(&networkContext, port);
+}
+
+int setTracing(TraceOptions options)
+{
+  return setTracingCtx(&networkContext, options);
+}
+
+int flushTrace()
+{
+  return flushTraceCtx(&networkContext);
+}
+
+int startCapture(const char *path)
+{
+  return startCaptureCtx(&networkContext, path);
+}
+
+int stopCapture()
+{
+  return stopCaptureCtx(&networkContext);
+}
+
+int replayCapture(const char *path, void (*onClientData)(Data, socket_t), ReplayPacing pacing)
+{
+  return replayCaptureCtx(&networkContext, path, onClientData, pacing);
+}
+
+socket_t getLocalSocket()
+{
+  return getLocalSocketCtx(&networkContext);
+}
+
+int getSocketOptions(socket_t socket, SocketOptions *options)
+{
+  return getSocketOptionsCtx(&networkContext, socket, options);
+}
+
+void printLastError()
+{
+  printLastErrorCtx(&networkContext);
+}
+
+const char *getLastError()
+{
+  return getLastErrorCtx(&networkContext);
+}
+
+int shutdownNetwork()
+{
+  return shutdownNetworkCtx(&networkContext);
+}
@@ -16,10 +16,25 @@ extern "C"
 #define NEX_API __declspec(dllimport)
 #endif
 
+  /// Transport of a context.
+  ///
+  /// `CONNECTION_LOCAL` is a stream transport for a client and server on the same host, over Unix domain sockets
+  /// instead of the TCP/IP loopback. It takes the same server and client functions and the same ports as
+  /// `CONNECTION_TCP`, a port naming a local socket rather than a TCP port, and the IP passed to
+  /// @ref connectToServer() is ignored. TCP only socket options and `cork` do not apply to it. Large messages can skip
+  /// the socket with @ref setLocalHandoff().
+  ///
+  /// `CONNECTION_SHARED_MEMORY` connects the same way as `CONNECTION_LOCAL`, then moves the traffic of each connection
+  /// into a memory segment the server hands to the client: one lock-free ring per direction, 1 MiB each, with a
+  /// futex wakeup only when the receiving side had gone to sleep. The local socket stays open to notice a process that
+  /// exits. A full ring blocks the sender unless @ref setBackpressure() limits the queue, and a client the server
+  /// turns away fails to connect rather than receiving `TYPE_REJECTED`. Linux only.
   typedef enum
   {
     CONNECTION_TCP,
-    CONNECTION_UDP
+    CONNECTION_UDP,
+    CONNECTION_LOCAL,
+    CONNECTION_SHARED_MEMORY
   } ConnectionType;
 
   typedef enum
@@ -37,6 +52,7 @@ extern "C"
     NETWORK_ERR_INITIALIZATION,
     NETWORK_ERR_INVALID,
     NETWORK_ERR_MEMORY,
+    NETWORK_ERR_QUEUE_FULL,
     NETWORK_ERR_UNKNOWN
   } NetworkError;
 
@@ -53,16 +69,319 @@ extern "C"
     struct sockaddr_in addr;
   } Socket;
 
+  /// Kernel level tuning applied to every socket the library creates.
+  ///
+  /// A zero or `false` field leaves the kernel default in place. TCP only options are skipped for UDP sockets.
+  /// `TCP_QUICKACK` is not sticky on Linux, so when `quickAck` is set it is re-armed after every receive.
+  typedef struct
+  {
+    int sendBufferSize;
+    int receiveBufferSize;
+    bool noDelay;
+    bool quickAck;
+    int busyPollMicroseconds;
+    int priority;
+  } SocketOptions;
+
+  typedef enum
+  {
+    FLUSH_IMMEDIATE,
+    FLUSH_COALESCE
+  } FlushMode;
+
+  /// Controls when queued outbound messages are written to a TCP connection.
+  ///
+  /// With `FLUSH_IMMEDIATE` every message is written as soon as it is sent, in a single write.
+  /// With `FLUSH_COALESCE` messages are queued per connection and written together once
+  /// `maxBufferedBytes` is reached, every `flushIntervalMs` milliseconds, or on an explicit flush.
+  typedef struct
+  {
+    FlushMode mode;
+    size_t maxBufferedBytes;
+    int flushIntervalMs;
+    bool noDelay;
+    bool cork;
+  } FlushPolicy;
+
+  typedef enum
+  {
+    SLOW_CONSUMER_DROP_OLDEST,
+    SLOW_CONSUMER_DROP_NEW,
+    SLOW_CONSUMER_DISCONNECT
+  } SlowConsumerPolicy;
+
+  /// Bounds the outbound queue of every TCP connection so a slow reader cannot stall the sender.
+  ///
+  /// When `maxQueuedBytes` is non zero, sends never block: whatever the socket does not accept right away stays
+  /// queued and is written in the background once the socket becomes writable. A send that would grow the queue
+  /// past `maxQueuedBytes` is handled by `slowConsumerPolicy`. `onHighWatermark` is invoked once the unsent bytes
+  /// reach `highWatermark`, and `onLowWatermark` once they drain back down to `lowWatermark`.
+  typedef struct
+  {
+    size_t maxQueuedBytes;
+    size_t highWatermark;
+    size_t lowWatermark;
+    SlowConsumerPolicy slowConsumerPolicy;
+    void (*onHighWatermark)(socket_t);
+    void (*onLowWatermark)(socket_t);
+  } BackpressureOptions;
+
+  /// How a server admits new connections.
+  ///
+  /// `listenBacklog` bounds the connections the kernel completes before the server accepts them, 0 uses the system
+  /// maximum. Up to `acceptBatch` waiting connections are accepted each time the accept thread wakes up, 0 uses a
+  /// default of 64. A connection that arrives while `maxClients` are connected is sent a `TYPE_REJECTED` frame and
+  /// closed right away, unless `queueWhenFull` is set, in which case it waits in the kernel queue until a client leaves.
+  typedef struct
+  {
+    int listenBacklog;
+    int acceptBatch;
+    bool queueWhenFull;
+  } AcceptOptions;
+
+  /// Placement of the library's threads on CPUs.
+  ///
+  /// `cpus` lists the `cpuCount` CPUs that the threads of accepted connections are spread over, and is copied. With
+  /// `followIncomingCpu` set, a connection runs on the CPU that received its packets when that CPU is listed, else on a
+  /// listed CPU of the same NUMA node. Other connections take the listed CPUs in turn. Connection threads pin
+  /// themselves before they allocate anything, so their receive buffers come from their own node. With `pinIoThreads`
+  /// set, the accept, outbound, client receive and peer threads run on the first listed CPU. An empty list leaves every
+  /// thread to the scheduler.
+  typedef struct
+  {
+    const int *cpus;
+    int cpuCount;
+    bool followIncomingCpu;
+    bool pinIoThreads;
+  } ThreadPlacement;
+
+  /// Reason carried in `data.i` of the `TYPE_REJECTED` data a client receives before the server closes it.
+  typedef enum
+  {
+    REJECT_SERVER_FULL = 1
+  } RejectReason;
+
+  /// Connection admission counters of a server.
+  ///
+  /// `queueDepth` is the number of connections the kernel has completed but the server has not accepted yet, and
+  /// `queueLimit` the backlog the kernel actually applies. Both, and `queueDepthPeak`, stay 0 on platforms that cannot
+  /// report the accept queue.
+  typedef struct
+  {
+    uint64_t accepted;
+    uint64_t rejected;
+    uint64_t acceptBatches;
+    int queueDepth;
+    int queueDepthPeak;
+    int queueLimit;
+  } AcceptStats;
+
+  /// Outcome of a request passed to its response callback. The response data is only valid with `REQUEST_OK`.
+  typedef enum
+  {
+    REQUEST_OK,
+    REQUEST_TIMEOUT,
+    REQUEST_DISCONNECTED,
+    REQUEST_UNHANDLED
+  } RequestStatus;
+
+  /// Heartbeats and idle detection for every connection of a context.
+  ///
+  /// Every `heartbeatIntervalMs` a small internal heartbeat is sent on each TCP connection or to each peer, so a quiet
+  /// but healthy link keeps showing traffic on the other side. A connection that has received nothing, heartbeats
+  /// included, for `idleTimeoutMs` is closed and reported through the usual `TYPE_DISCONNECTED` path. A zero field
+  /// turns that part off. Pick an idle timeout of a few heartbeat intervals so a lost heartbeat is not fatal.
+  typedef struct
+  {
+    int heartbeatIntervalMs;
+    int idleTimeoutMs;
+  } KeepaliveOptions;
+
+  /// Delivery guarantee of a message sent to a peer. All channels share the peer's UDP socket.
+  ///
+  /// `PEER_CHANNEL_UNRELIABLE` messages may be lost, duplicated or reordered, exactly like plain datagrams.
+  /// `PEER_CHANNEL_RELIABLE_ORDERED` messages are retransmitted until acknowledged and handed to onPeerData in the order
+  /// they were sent. A lost reliable message only holds back later reliable messages, never unreliable ones.
+  /// `PEER_CHANNEL_UNRELIABLE_SEQUENCED` messages may be lost, but one that arrives after a newer message on the same
+  /// channel is discarded before it reaches onPeerData. Use it for state streams where only the latest value matters.
+  typedef enum
+  {
+    PEER_CHANNEL_UNRELIABLE,
+    PEER_CHANNEL_RELIABLE_ORDERED,
+    PEER_CHANNEL_UNRELIABLE_SEQUENCED
+  } PeerChannel;
+
+  /// Congestion control and pacing of the traffic to every peer.
+  ///
+  /// With `congestionControl` set, each peer that is sent to is probed about once per round trip and reports how much
+  /// of the traffic arrived. Loss or a growing round trip lowers the sending rate of that peer, clean intervals raise
+  /// it while the sender has more to send, and reliable messages in flight are capped to two round trips at that rate.
+  /// With `pacing` set, datagrams leave at that rate instead of in bursts, and unreliable messages are refused with
+  /// `NETWORK_ERR_QUEUE_FULL` while the ones already waiting would be late. A zero rate uses the library default.
+  typedef struct
+  {
+    bool congestionControl;
+    bool pacing;
+    uint32_t initialRateBytesPerSecond;
+    uint32_t maxRateBytesPerSecond;
+  } CongestionOptions;
+
+  /// Statistics of the channels to a peer.
+  ///
+  /// The congestion fields are only maintained while congestion control is enabled with @ref setPeerCongestion().
+  typedef struct
+  {
+    int rttMs;
+    int rttVarianceMs;
+    int retransmitTimeoutMs;
+    int inFlight;
+    uint64_t retransmits;
+    uint64_t staleDropped;
+    uint64_t fragmentsSent;
+    uint64_t messagesReassembled;
+    uint64_t reassemblyDropped;
+    uint64_t sendRateBytesPerSecond;
+    uint64_t bandwidthBytesPerSecond;
+    double lossRate;
+    size_t pacedBytes;
+    uint64_t fecParitySent;
+    uint64_t fecRecovered;
+    double fecOverhead;
+  } PeerStats;
+
+// Size of the per type arrays of MetricsSnapshot, which are indexed by NetworkedType.
+#define NEX_METRICS_TYPES 16
+
+  /// Distribution of a latency, in microseconds. The percentiles are accurate to within about 6%.
+  typedef struct
+  {
+    uint64_t count;
+    uint64_t sumMicroseconds;
+    uint64_t maxMicroseconds;
+    uint64_t p50Microseconds;
+    uint64_t p90Microseconds;
+    uint64_t p99Microseconds;
+    uint64_t p999Microseconds;
+  } LatencySummary;
+
+  /// Traffic counters of a context since @ref init(), plus its current connections and queued bytes.
+  ///
+  /// Messages and bytes are counted per `NetworkedType`, bytes being the encoded frame. A message counts as sent once
+  /// the library has accepted it, queued on a TCP connection or handed to a peer channel, and as a send failure when it
+  /// was refused or dropped. `callbackDuration` is the time spent in the data callback, and `deliveryLatency` the time
+  /// from a message being read off the socket to its callback starting, waiting for the lock included.
+  typedef struct
+  {
+    uint64_t messagesReceived[NEX_METRICS_TYPES];
+    uint64_t bytesReceived[NEX_METRICS_TYPES];
+    uint64_t messagesSent[NEX_METRICS_TYPES];
+    uint64_t bytesSent[NEX_METRICS_TYPES];
+    uint64_t sendFailures;
+    uint64_t connects;
+    uint64_t disconnects;
+    int connections;
+    size_t queuedBytes;
+    LatencySummary callbackDuration;
+    LatencySummary deliveryLatency;
+  } MetricsSnapshot;
+
+  /// Traffic counters of a single TCP connection, all types together.
+  typedef struct
+  {
+    uint64_t messagesReceived;
+    uint64_t bytesReceived;
+    uint64_t messagesSent;
+    uint64_t bytesSent;
+    uint64_t sendFailures;
+    size_t queuedBytes;
+  } ConnectionMetrics;
+
+  /// Step of the message pipeline a @ref TraceEvent covers.
+  ///
+  /// `TRACE_RECEIVE` runs from the first byte of a message being read to the whole message being decoded, so time
+  /// spent waiting for traffic is not included. `TRACE_LOCK_WAIT` is the wait for the context lock before a callback,
+  /// `TRACE_CALLBACK` the data callback itself, and `TRACE_SEND` a send call such as @ref sendToClient().
+  typedef enum
+  {
+    TRACE_RECEIVE,
+    TRACE_LOCK_WAIT,
+    TRACE_CALLBACK,
+    TRACE_SEND
+  } TraceStage;
+
+  /// One timed pipeline step. Times are microseconds of the monotonic clock.
+  ///
+  /// `connection` is the socket of a TCP connection or the id of a peer, -1 when not known yet. `type` and `bytes`
+  /// describe the message, `bytes` being 0 where the encoded size is not known. `thread` is a small number the library
+  /// gives each thread that records events.
+  typedef struct
+  {
+    TraceStage stage;
+    uint32_t thread;
+    uint64_t startMicroseconds;
+    uint64_t durationMicroseconds;
+    int64_t connection;
+    NetworkedType type;
+    uint32_t bytes;
+  } TraceEvent;
+
+  /// Opt-in tracing of every message through the receive and send pipeline.
+  ///
+  /// Each thread records into a ring of its own without taking a lock. A full ring overwrites its oldest events, so
+  /// the most recent `eventsPerThread` events of each thread are kept. @ref flushTrace() hands them to `sink`, which
+  /// may be @ref chromeTraceSink() or your own function. `eventsPerThread` is rounded up to a power of two, 0 means
+  /// 4096, and applies to threads that have not recorded anything yet.
+  typedef struct
+  {
+    bool enabled;
+    int eventsPerThread;
+    void (*sink)(const TraceEvent *events, size_t count, void *userData);
+    void *userData;
+  } TraceOptions;
+
+  /// How @ref replayCapture() spaces out the messages of a capture.
+  ///
+  /// `REPLAY_ORIGINAL_TIMING` delivers each message as long after the start of the replay as it was received after
+  /// the start of the capture, and `REPLAY_MAX_SPEED` delivers them back to back.
+  typedef enum
+  {
+    REPLAY_ORIGINAL_TIMING,
+    REPLAY_MAX_SPEED
+  } ReplayPacing;
+
+  /// A message passed to a view handler, borrowed from the receive buffer of its connection instead of copied out.
+  ///
+  /// For `TYPE_STRING`, `bytes` is the text and for `TYPE_JSON` the unparsed document, `length` bytes long and followed
+  /// by a terminating zero either way. For `TYPE_INT` and `TYPE_FLOAT` the value is in `i` or `f` and `bytes` is NULL.
+  /// `bytes` is only valid until the handler returns, unless the handler calls @ref retainView() on the view.
+  /// `source` and `block` belong to the library.
+  typedef struct
+  {
+    NetworkedType type;
+    int i;
+    float f;
+    const char *bytes;
+    size_t length;
+    void *source;
+    void *block;
+  } DataView;
+
+  /// An independent instance of the library, with its own sockets, threads, lock and last error.
+  ///
+  /// Every function has a `...Ctx` variant taking a context as its first argument. The functions without the suffix
+  /// operate on a default context that @ref init() sets up, so single instance programs never need to see one.
+  typedef struct NetworkContext NexContext;
+
   /// Initializes the library, must call before using other functions in the library.
   ///
-  /// @param connectionType The socket framework you are using. Either 'CONNECTION_TCP' or 'CONNECTION_UDP'.
+  /// @param connectionType The socket framework you are using. Either 'CONNECTION_TCP', 'CONNECTION_UDP', 'CONNECTION_LOCAL' or 'CONNECTION_SHARED_MEMORY'.
   /// @param socketType The type of socket. Either 'Server', 'Client', or 'Peer'.
   /// @return Returns 'NETWORK_OK' on success, else, an error code.
   NEX_API int init(ConnectionType connectionType, SocketType socketType);
 
   /// Starts a server socket and begins listening for clients.
   ///
-  /// Must have called @ref init() with connectionType of CONNECTION_TCP to use.
+  /// Must have called @ref init() with connectionType of CONNECTION_TCP, CONNECTION_LOCAL or CONNECTION_SHARED_MEMORY to use.
   ///
   /// @param port The port to listen on.
   /// @param maxClients Maximum number of concurrent clients.
@@ -72,6 +391,49 @@ extern "C"
   /// @see sendToClient
   NEX_API int startServer(int port, int maxClients, void (*onClientData)(Data, socket_t));
 
+  /// Starts a server socket with the given socket options and begins listening for clients.
+  ///
+  /// The options are applied to the listening socket before it starts listening and to every accepted client socket.
+  /// Otherwise behaves exactly like @ref startServer().
+  ///
+  /// @param port The port to listen on.
+  /// @param maxClients Maximum number of concurrent clients.
+  /// @param onClientData Callback invoked when data is received from a client.
+  /// @param options The socket options to apply, or NULL for kernel defaults.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see startServer
+  /// @see getSocketOptions
+  NEX_API int startServerWithOptions(int port, int maxClients, void (*onClientData)(Data, socket_t), const SocketOptions *options);
+
+  /// Sets the listen backlog, accept batching and over capacity behaviour of the server.
+  ///
+  /// The backlog is applied by @ref startServer(), so set it first. The other fields apply immediately.
+  ///
+  /// Must have called @ref init() with socketType of Server to use.
+  ///
+  /// @param options The admission options.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see getAcceptStats
+  NEX_API int setAcceptOptions(AcceptOptions options);
+
+  /// Gets the accept counters and the current accept queue depth of the server.
+  ///
+  /// Must have called @ref startServer() to use this function.
+  ///
+  /// @param stats Receives the statistics.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setAcceptOptions
+  NEX_API int getAcceptStats(AcceptStats *stats);
+
+  /// Pins the threads of this instance to CPUs.
+  ///
+  /// Must be called after @ref init() and before @ref startServer(), @ref connectToServer() or @ref startPeer().
+  ///
+  /// @param placement The CPUs to use and how to pick among them.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see ThreadPlacement
+  NEX_API int setThreadPlacement(ThreadPlacement placement);
+
   /// Sends data to all clients connected to a server.
   ///
   /// Must have called @ref startServer() to use this function.
@@ -104,6 +466,92 @@ extern "C"
   /// @see startServer
   NEX_API int sendToClient(Data data, socket_t client);
 
+  /// Sends a JSON state snapshot to a specific client, delta encoded against the last snapshot that client acknowledged.
+  ///
+  /// The client rebuilds the full document before it reaches onServerData, where it arrives as a regular `TYPE_JSON`.
+  /// Baselines are tracked per client, so a client that just joined or has fallen behind is sent a full snapshot instead of a diff.
+  ///
+  /// Must have called @ref startServer() to use this function.
+  ///
+  /// @param snapshot The full state document. It is not modified or freed.
+  /// @param client The client you are sending the snapshot to.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see sendSnapshotToAllClients
+  NEX_API int sendSnapshotToClient(const cJSON *snapshot, socket_t client);
+
+  /// Sends a JSON state snapshot to all clients connected to a server, each delta encoded against that client's own baseline.
+  ///
+  /// The snapshot is serialized once and diffed per client. See @ref sendSnapshotToClient() for details.
+  ///
+  /// Must have called @ref startServer() to use this function.
+  ///
+  /// @param snapshot The full state document. It is not modified or freed.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see sendSnapshotToClient
+  NEX_API int sendSnapshotToAllClients(const cJSON *snapshot);
+
+  /// Sets how outbound messages are queued and flushed on TCP connections.
+  ///
+  /// Latency oriented deployments typically use `FLUSH_IMMEDIATE` with `noDelay` set, throughput oriented
+  /// deployments use `FLUSH_COALESCE` with a size and time limit, optionally with `cork` (Linux only) so
+  /// the kernel only emits full segments between flushes. The policy applies to existing and future connections.
+  ///
+  /// Must have called @ref init() with connectionType of CONNECTION_TCP, CONNECTION_LOCAL or CONNECTION_SHARED_MEMORY to use.
+  ///
+  /// @param policy The flush policy to use.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see flushClient
+  /// @see flushServer
+  NEX_API int setFlushPolicy(FlushPolicy policy);
+
+  /// Enables bounded, non-blocking outbound queues for TCP connections.
+  ///
+  /// With `SLOW_CONSUMER_DROP_OLDEST` the oldest unsent messages are discarded to make room, with `SLOW_CONSUMER_DROP_NEW`
+  /// the new message is discarded and the send returns `NETWORK_ERR_QUEUE_FULL`, and with `SLOW_CONSUMER_DISCONNECT`
+  /// the connection is closed and reported through the usual `TYPE_DISCONNECTED` path.
+  /// The watermark callbacks may be invoked from any library thread, including from inside a send function,
+  /// so they must not call back into a blocking send.
+  ///
+  /// Passing a `maxQueuedBytes` of 0 restores the default blocking behaviour.
+  ///
+  /// Must have called @ref init() with connectionType of CONNECTION_TCP, CONNECTION_LOCAL or CONNECTION_SHARED_MEMORY to use.
+  ///
+  /// @param options The queue bounds, watermarks and slow consumer policy.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setFlushPolicy
+  NEX_API int setBackpressure(BackpressureOptions options);
+
+  /// Passes large messages between local processes as sealed shared memory instead of through the socket.
+  ///
+  /// A string or JSON message whose frame is at least `thresholdBytes` long is encoded into a new memory file, sealed
+  /// against further writes and sent over the Unix domain socket as a descriptor. The receiver maps it read-only and
+  /// decodes the message straight from the mapping, or hands a view handler a view into it. This pays off for
+  /// messages of a few MB and up. A handed off message is written right away, after everything queued ahead of it, so
+  /// it may block even with @ref setBackpressure() set. Receiving handed off messages needs no setup.
+  ///
+  /// Must have called @ref init() with connectionType of CONNECTION_LOCAL to use. Linux only.
+  ///
+  /// @param thresholdBytes The smallest frame that is handed off. 0, the default, sends everything through the socket.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  NEX_API int setLocalHandoff(size_t thresholdBytes);
+
+  /// Writes all messages queued for a specific client.
+  ///
+  /// Must have called @ref startServer() to use this function.
+  ///
+  /// @param client The client whose queued messages are written.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setFlushPolicy
+  NEX_API int flushClient(socket_t client);
+
+  /// Writes all messages queued for every client connected to a server.
+  ///
+  /// Must have called @ref startServer() to use this function.
+  ///
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setFlushPolicy
+  NEX_API int flushAllClients();
+
   /// Sets a data structure to be associated with a connected client.
   ///
   /// Must have called @ref startServer() to use this function.
@@ -125,9 +573,80 @@ extern "C"
   /// @see startServer
   NEX_API void *getClientContext(socket_t client);
 
+  /// Delivers the messages clients send as views into the receive buffer of their connection, without a copy.
+  ///
+  /// Once set, every `TYPE_INT`, `TYPE_FLOAT`, `TYPE_STRING` and `TYPE_JSON` message goes to `onClientView` instead of
+  /// onClientData, which keeps getting connects and disconnects. Strings and JSON are neither copied into a new
+  /// allocation nor parsed. A handler that needs the bytes after it returns calls @ref retainView(). Pass NULL to go
+  /// back to onClientData. Handed off @ref setLocalHandoff() messages are viewed right in their read-only mapping.
+  ///
+  /// Must have called @ref init() with socketType Server to use.
+  ///
+  /// @param onClientView Callback invoked with each message and the socket of its sender, or NULL.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see retainView
+  NEX_API int setClientViewHandler(void (*onClientView)(DataView, socket_t));
+
+  /// Keeps the bytes of a view after its handler returns.
+  ///
+  /// The receive buffer holding the message is handed over to the view, so nothing is copied, and the connection
+  /// allocates a new one for its next message. A handed off message is the exception: its mapping goes away with the
+  /// handler, so its bytes are copied. Call it from inside the view handler, on the view it was passed or a copy of
+  /// it, then keep the view and pass it to @ref releaseView() when done.
+  ///
+  /// @param view The view to keep.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see releaseView
+  NEX_API int retainView(DataView *view);
+
+  /// Frees the bytes of a view kept with @ref retainView().
+  ///
+  /// @param view The view to release.
+  NEX_API void releaseView(DataView *view);
+
+  /// Sends a request to a client and invokes a callback once it answers.
+  ///
+  /// Each request carries a correlation id, so any number of requests can be in flight on the same connection and
+  /// responses may arrive in any order. The callback runs exactly once, on a library thread, with the status and,
+  /// for `REQUEST_OK`, the response. The response is freed once the callback returns.
+  /// The client answers through the handler set with @ref setServerRequestHandler().
+  ///
+  /// Must have called @ref startServer() to use this function.
+  ///
+  /// @param data The request.
+  /// @param client The client socket to send the request to.
+  /// @param timeoutMs How long to wait for the response before completing with `REQUEST_TIMEOUT`, or 0 to wait until the connection closes.
+  /// @param onResponse Callback invoked with the outcome.
+  /// @param userData Passed through to onResponse.
+  /// @return `NETWORK_OK` on success, else, an error code. The callback is not invoked when an error is returned.
+  /// @see setClientRequestHandler
+  /// @see requestServer
+  NEX_API int requestClient(Data data, socket_t client, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData);
+
+  /// Sets the function that handles requests sent by clients with @ref requestServer().
+  ///
+  /// The handler receives the request, the client socket and the request id, and answers with @ref respondToClient(),
+  /// either right away or later from any thread. Requests that arrive while no handler is set complete with `REQUEST_UNHANDLED`.
+  ///
+  /// Must have called @ref init() with socketType of Server to use this function.
+  ///
+  /// @param onRequest The handler, or NULL to remove it.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see respondToClient
+  NEX_API int setClientRequestHandler(void (*onRequest)(Data, socket_t, uint32_t));
+
+  /// Answers a request received through the handler set with @ref setClientRequestHandler().
+  ///
+  /// @param data The response.
+  /// @param client The client socket the request came from.
+  /// @param requestId The id passed to the request handler.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setClientRequestHandler
+  NEX_API int respondToClient(Data data, socket_t client, uint32_t requestId);
+
   /// Starts a client socket and connects to a server.
   ///
-  /// Must have called @ref init() with connectionType of CONNECTION_TCP to use.
+  /// Must have called @ref init() with connectionType of CONNECTION_TCP, CONNECTION_LOCAL or CONNECTION_SHARED_MEMORY to use.
   ///
   /// @param ip The IP address of the server.
   /// @param port The port the server is listening on.
@@ -136,6 +655,20 @@ extern "C"
   /// @see init
   NEX_API int connectToServer(const char *ip, int port, void (*onServerData)(Data));
 
+  /// Starts a client socket with the given socket options and connects to a server.
+  ///
+  /// The options are applied before connecting, so buffer sizes take part in window scaling.
+  /// Otherwise behaves exactly like @ref connectToServer().
+  ///
+  /// @param ip The IP address of the server.
+  /// @param port The port the server is listening on.
+  /// @param onServerData Callback invoked when data is received from the server.
+  /// @param options The socket options to apply, or NULL for kernel defaults.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see connectToServer
+  /// @see getSocketOptions
+  NEX_API int connectToServerWithOptions(const char *ip, int port, void (*onServerData)(Data), const SocketOptions *options);
+
   /// Sends data to the server previously connected to.
   ///
   /// Must have called @ref connectToServer() to use this function.
@@ -145,6 +678,57 @@ extern "C"
   /// @see connectToServer
   NEX_API int sendToServer(Data data);
 
+  /// Writes all messages queued for the server.
+  ///
+  /// Must have called @ref connectToServer() to use this function.
+  ///
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setFlushPolicy
+  NEX_API int flushServer();
+
+  /// Delivers the messages the server sends as views into the receive buffer of the connection, without a copy.
+  ///
+  /// Works the same way as @ref setClientViewHandler(). onServerData keeps getting connects, disconnects and the
+  /// documents rebuilt from snapshots.
+  ///
+  /// Must have called @ref init() with socketType Client to use.
+  ///
+  /// @param onServerView Callback invoked with each message, or NULL.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see retainView
+  NEX_API int setServerViewHandler(void (*onServerView)(DataView));
+
+  /// Sends a request to the server and invokes a callback once it answers.
+  ///
+  /// Works the same way as @ref requestClient(). The server answers through the handler set with @ref setClientRequestHandler().
+  ///
+  /// Must have called @ref connectToServer() to use this function.
+  ///
+  /// @param data The request.
+  /// @param timeoutMs How long to wait for the response before completing with `REQUEST_TIMEOUT`, or 0 to wait until the connection closes.
+  /// @param onResponse Callback invoked with the outcome.
+  /// @param userData Passed through to onResponse.
+  /// @return `NETWORK_OK` on success, else, an error code. The callback is not invoked when an error is returned.
+  /// @see requestClient
+  NEX_API int requestServer(Data data, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData);
+
+  /// Sets the function that handles requests sent by the server with @ref requestClient().
+  ///
+  /// Must have called @ref init() with socketType of Client to use this function.
+  ///
+  /// @param onRequest The handler, receiving the request and its id, or NULL to remove it.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see respondToServer
+  NEX_API int setServerRequestHandler(void (*onRequest)(Data, uint32_t));
+
+  /// Answers a request received through the handler set with @ref setServerRequestHandler().
+  ///
+  /// @param data The response.
+  /// @param requestId The id passed to the request handler.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setServerRequestHandler
+  NEX_API int respondToServer(Data data, uint32_t requestId);
+
   /// Starts a peer socket to later connect with peers via @ref connectToPeer().
   ///
   /// Must have called @ref init() with connectionType of CONNECTION_UDP to use.
@@ -157,6 +741,19 @@ extern "C"
   /// @see init
   NEX_API int startPeer(int port, int maxPeers, void (*onPeerData)(Data, int));
 
+  /// Starts a peer socket with the given socket options.
+  ///
+  /// Otherwise behaves exactly like @ref startPeer().
+  ///
+  /// @param port The port the peer is located on.
+  /// @param maxPeers Maximum number of concurrent peers.
+  /// @param onPeerData Callback invoked when data is received from another connected peer.
+  /// @param options The socket options to apply, or NULL for kernel defaults.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see startPeer
+  /// @see getSocketOptions
+  NEX_API int startPeerWithOptions(int port, int maxPeers, void (*onPeerData)(Data, int), const SocketOptions *options);
+
   /// Connects to another peer. When data gets recveived, it calls onPeerData that was passed into @ref startPeer().
   ///
   /// Must have called @ref startPeer() to use this function.
@@ -177,6 +774,59 @@ extern "C"
   /// @see connectToPeer
   NEX_API int sendToPeer(Data data, int peer);
 
+  /// Sends data to a specific connected peer over the given channel.
+  ///
+  /// @ref sendToPeer() is the same as sending over `PEER_CHANNEL_UNRELIABLE`. Messages bigger than one datagram are split
+  /// by the library and rebuilt before onPeerData. An unreliable message is lost if any of its pieces is, and may be
+  /// up to 8 MB. A reliable message resends only the lost pieces, and may be up to roughly 1 MB.
+  /// Must have called @ref connectToPeer() to use this function.
+  ///
+  /// @param data The data to send to the peer.
+  /// @param peer The peer to send the data to.
+  /// @param channel The delivery guarantee for this message.
+  /// @return `NETWORK_OK` on success, else, an error code. `NETWORK_ERR_QUEUE_FULL` when too many reliable messages are waiting for an acknowledgement, or the pacer is too far behind.
+  /// @see PeerChannel
+  NEX_API int sendToPeerOnChannel(Data data, int peer, PeerChannel channel);
+
+  /// Enables congestion control and pacing for every current and future peer.
+  ///
+  /// Must have called @ref init() with connectionType of CONNECTION_UDP to use.
+  ///
+  /// @param options What to enable, and the rate bounds.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see getPeerStats
+  NEX_API int setPeerCongestion(CongestionOptions options);
+
+  /// Enables forward error correction on the unreliable and sequenced channels of every current and future peer.
+  ///
+  /// Every `groupSize` datagrams are followed by one XOR parity datagram, which lets the receiver rebuild any single
+  /// datagram lost from the group without waiting for a round trip. A group that does not fill up within a few
+  /// milliseconds gets its parity early. The bandwidth overhead is one datagram per group.
+  ///
+  /// Must have called @ref init() with connectionType of CONNECTION_UDP to use.
+  ///
+  /// @param groupSize Datagrams per parity datagram, at most 32. 0 turns FEC off.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see getPeerStats
+  NEX_API int setPeerFec(int groupSize);
+
+  /// Gets round trip, retransmission, stale message, fragmentation, bandwidth and FEC statistics for a connected peer.
+  ///
+  /// @param peer The peer to get the statistics of.
+  /// @param stats Receives the statistics.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  NEX_API int getPeerStats(int peer, PeerStats *stats);
+
+  /// Enables heartbeats and idle timeouts for every current and future connection or peer.
+  ///
+  /// An idle server side connection is closed and reported to onClientData, an idle connection to the server is closed
+  /// and reported to onServerData, and an idle peer is forgotten after onPeerData receives `TYPE_DISCONNECTED` with its
+  /// id. Both ends should enable heartbeats when either one uses an idle timeout.
+  ///
+  /// @param options The heartbeat interval and idle timeout in milliseconds.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  NEX_API int setKeepalive(KeepaliveOptions options);
+
   /// Sets a data structure to be associated with a connected peer.
   ///
   /// Must have called @ref connectToPeer() to use this function.
@@ -198,6 +848,122 @@ extern "C"
   /// @see connectToPeer
   NEX_API void *getPeerContext(int peer);
 
+  /// Gets the traffic counters and latency percentiles of this instance.
+  ///
+  /// The counters are kept with atomic increments outside the lock, so reading them never stalls the network threads.
+  ///
+  /// @param metrics Receives the snapshot.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see writeMetrics
+  NEX_API int getMetrics(MetricsSnapshot *metrics);
+
+  /// Gets the traffic counters of one TCP connection.
+  ///
+  /// @param socket A client socket passed to onClientData, or the socket from @ref getLocalSocket() on a client.
+  /// @param metrics Receives the counters.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see getMetrics
+  NEX_API int getConnectionMetrics(socket_t socket, ConnectionMetrics *metrics);
+
+  /// Writes the metrics of this instance to a file in the Prometheus text format.
+  ///
+  /// The file is written next to `path` and renamed over it, so a scraper such as the node exporter textfile collector
+  /// never reads a partial file.
+  ///
+  /// @param path The file to write.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see startMetricsEndpoint
+  NEX_API int writeMetrics(const char *path);
+
+  /// Serves the metrics of this instance in the Prometheus text format over HTTP on a port of its own.
+  ///
+  /// Every request, whatever its path, gets the current metrics. The endpoint runs on its own thread until
+  /// @ref shutdownNetwork().
+  ///
+  /// @param port The port to listen on.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see writeMetrics
+  NEX_API int startMetricsEndpoint(int port);
+
+  /// Turns pipeline tracing on or off and sets where the events go.
+  ///
+  /// Turning tracing off flushes what was recorded to the previous sink. The events left are flushed again on
+  /// @ref shutdownNetwork().
+  ///
+  /// @param options Whether to trace, the ring size, and the sink.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see flushTrace
+  NEX_API int setTracing(TraceOptions options);
+
+  /// Hands every event recorded since the last flush to the sink, oldest first within each thread.
+  ///
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see setTracing
+  NEX_API int flushTrace();
+
+  /// Sink that appends events to a file in the Chrome trace event format, which Perfetto and chrome://tracing open.
+  ///
+  /// Pass an open `FILE *` as the userData of @ref TraceOptions. The file is written as a JSON array without its
+  /// closing bracket, which both viewers accept, so it can keep growing over several flushes.
+  ///
+  /// @param events The events to write.
+  /// @param count The number of events.
+  /// @param userData The `FILE *` to append to.
+  NEX_API void chromeTraceSink(const TraceEvent *events, size_t count, void *userData);
+
+  /// Starts recording every frame the server receives to a binary log, for @ref replayCapture() to play back.
+  ///
+  /// Each record holds the time since the capture started in microseconds, the socket of the connection and the frame
+  /// in wire format, and connects and disconnects are recorded too. The log is a memory-mapped file that is only ever
+  /// appended to, so capturing costs a copy into memory per message rather than a write system call. It is trimmed
+  /// to its records by @ref stopCapture() or @ref shutdownNetwork(), and a log left behind by a crash still reads up to
+  /// its last whole record. Any file at `path` is replaced. Linux only.
+  ///
+  /// Must have called @ref init() with socketType Server and connectionType of CONNECTION_TCP, CONNECTION_LOCAL or
+  /// CONNECTION_SHARED_MEMORY to use.
+  ///
+  /// @param path The log to write.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see stopCapture
+  NEX_API int startCapture(const char *path);
+
+  /// Stops the capture started by @ref startCapture() and closes its log.
+  ///
+  /// @return `NETWORK_OK` on success, else, an error code.
+  NEX_API int stopCapture();
+
+  /// Feeds a log written by @ref startCapture() to `onClientData` on the calling thread, as a live server would.
+  ///
+  /// Messages are delivered with the socket they were received on and with the context lock held, and their callback
+  /// time is recorded in the metrics, so handlers and @ref getMetrics() behave as under real traffic. Sends to those
+  /// sockets fail unless the context happens to have clients with the same sockets. Heartbeats, requests and other
+  /// frames the library handles itself are skipped. Nothing needs to be listening. Linux only.
+  ///
+  /// Must have called @ref init() with socketType Server to use.
+  ///
+  /// @param path The log to read.
+  /// @param onClientData The callback to feed, usually the one passed to @ref startServer().
+  /// @param pacing Whether to keep the original spacing of the messages or deliver them as fast as possible.
+  /// @return `NETWORK_OK` once the whole log was delivered, else, an error code.
+  NEX_API int replayCapture(const char *path, void (*onClientData)(Data, socket_t), ReplayPacing pacing);
+
+  /// Gets the socket the library created for this process: the listening socket of a server, the connection of a client, or the UDP socket of a peer.
+  ///
+  /// @return The socket, or -1 if none has been created yet.
+  /// @see getSocketOptions
+  NEX_API socket_t getLocalSocket();
+
+  /// Reads back the options the kernel actually applied to a socket.
+  ///
+  /// Useful to verify tuning, since the kernel may round or double requested values (Linux doubles buffer sizes).
+  /// Options the platform or socket type does not support are reported as zero.
+  ///
+  /// @param socket A client socket passed to onClientData, or the socket from @ref getLocalSocket().
+  /// @param options Filled in with the current option values.
+  /// @return `NETWORK_OK` on success, else, an error code.
+  /// @see getLocalSocket
+  NEX_API int getSocketOptions(socket_t socket, SocketOptions *options);
+
   /// Prints out the last known error.
   NEX_API void printLastError();
 
@@ -214,6 +980,93 @@ extern "C"
   /// @see init
   NEX_API int shutdownNetwork();
 
+  /// Creates a new, independent instance of the library.
+  ///
+  /// Any number of contexts can run side by side, for example several servers on different ports or many clients
+  /// in one process. Each one has its own lock, so they do not contend with each other.
+  ///
+  /// @param context Receives the new context. Set to NULL on failure.
+  /// @param connectionType The socket framework you are using. Either 'CONNECTION_TCP', 'CONNECTION_UDP', 'CONNECTION_LOCAL' or 'CONNECTION_SHARED_MEMORY'.
+  /// @param socketType The type of socket. Either 'Server', 'Client', or 'Peer'.
+  /// @return `NETWORK_OK` on success, else, an error code. On failure, the reason is available through @ref getLastError().
+  /// @see destroyContext
+  NEX_API int createContext(NexContext **context, ConnectionType connectionType, SocketType socketType);
+
+  /// Shuts a context down and frees it. The context must not be used afterwards.
+  ///
+  /// @param ctx A context from @ref createContext().
+  /// @see createContext
+  NEX_API void destroyContext(NexContext *ctx);
+
+  /// Gets the context used by the functions that do not take one.
+  ///
+  /// @return The default context.
+  NEX_API NexContext *getDefaultContext();
+
+  /// Gets the context whose callback is currently running on this thread.
+  ///
+  /// Lets a callback shared between several contexts reply through the right one.
+  ///
+  /// @return The context, or NULL when called outside of a library callback.
+  NEX_API NexContext *getCurrentContext();
+
+  // Context variants of the functions above. Each behaves exactly like the function of the same name without the
+  // `Ctx` suffix, but operates on `ctx` instead of the default context.
+  NEX_API int startServerCtx(NexContext *ctx, int port, int maxClients, void (*onClientData)(Data, socket_t));
+  NEX_API int startServerWithOptionsCtx(NexContext *ctx, int port, int maxClients, void (*onClientData)(Data, socket_t), const SocketOptions *options);
+  NEX_API int setAcceptOptionsCtx(NexContext *ctx, AcceptOptions options);
+  NEX_API int getAcceptStatsCtx(NexContext *ctx, AcceptStats *stats);
+  NEX_API int setThreadPlacementCtx(NexContext *ctx, ThreadPlacement placement);
+  NEX_API int sendToAllClientsCtx(NexContext *ctx, Data data);
+  NEX_API int broadcastToClientsCtx(NexContext *ctx, Data data, socket_t sender);
+  NEX_API int sendToClientCtx(NexContext *ctx, Data data, socket_t client);
+  NEX_API int sendSnapshotToClientCtx(NexContext *ctx, const cJSON *snapshot, socket_t client);
+  NEX_API int sendSnapshotToAllClientsCtx(NexContext *ctx, const cJSON *snapshot);
+  NEX_API int setFlushPolicyCtx(NexContext *ctx, FlushPolicy policy);
+  NEX_API int setBackpressureCtx(NexContext *ctx, BackpressureOptions options);
+  NEX_API int setLocalHandoffCtx(NexContext *ctx, size_t thresholdBytes);
+  NEX_API int flushClientCtx(NexContext *ctx, socket_t client);
+  NEX_API int flushAllClientsCtx(NexContext *ctx);
+  NEX_API int setClientContextCtx(NexContext *ctx, void *context, socket_t client, void (*deleter)(void *));
+  NEX_API void *getClientContextCtx(NexContext *ctx, socket_t client);
+  NEX_API int requestClientCtx(NexContext *ctx, Data data, socket_t client, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData);
+  NEX_API int setClientRequestHandlerCtx(NexContext *ctx, void (*onRequest)(Data, socket_t, uint32_t));
+  NEX_API int setClientViewHandlerCtx(NexContext *ctx, void (*onClientView)(DataView, socket_t));
+  NEX_API int respondToClientCtx(NexContext *ctx, Data data, socket_t client, uint32_t requestId);
+  NEX_API int connectToServerCtx(NexContext *ctx, const char *ip, int port, void (*onServerData)(Data));
+  NEX_API int connectToServerWithOptionsCtx(NexContext *ctx, const char *ip, int port, void (*onServerData)(Data), const SocketOptions *options);
+  NEX_API int sendToServerCtx(NexContext *ctx, Data data);
+  NEX_API int flushServerCtx(NexContext *ctx);
+  NEX_API int requestServerCtx(NexContext *ctx, Data data, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData);
+  NEX_API int setServerRequestHandlerCtx(NexContext *ctx, void (*onRequest)(Data, uint32_t));
+  NEX_API int setServerViewHandlerCtx(NexContext *ctx, void (*onServerView)(DataView));
+  NEX_API int respondToServerCtx(NexContext *ctx, Data data, uint32_t requestId);
+  NEX_API int startPeerCtx(NexContext *ctx, int port, int maxPeers, void (*onPeerData)(Data, int));
+  NEX_API int startPeerWithOptionsCtx(NexContext *ctx, int port, int maxPeers, void (*onPeerData)(Data, int), const SocketOptions *options);
+  NEX_API int connectToPeerCtx(NexContext *ctx, const char *ip, int port);
+  NEX_API int sendToPeerCtx(NexContext *ctx, Data data, int peer);
+  NEX_API int sendToPeerOnChannelCtx(NexContext *ctx, Data data, int peer, PeerChannel channel);
+  NEX_API int setPeerCongestionCtx(NexContext *ctx, CongestionOptions options);
+  NEX_API int setPeerFecCtx(NexContext *ctx, int groupSize);
+  NEX_API int getPeerStatsCtx(NexContext *ctx, int peer, PeerStats *stats);
+  NEX_API int setKeepaliveCtx(NexContext *ctx, KeepaliveOptions options);
+  NEX_API int setPeerContextCtx(NexContext *ctx, void *context, int peer, void (*deleter)(void *));
+  NEX_API void *getPeerContextCtx(NexContext *ctx, int peer);
+  NEX_API int getMetricsCtx(NexContext *ctx, MetricsSnapshot *metrics);
+  NEX_API int getConnectionMetricsCtx(NexContext *ctx, socket_t socket, ConnectionMetrics *metrics);
+  NEX_API int writeMetricsCtx(NexContext *ctx, const char *path);
+  NEX_API int startMetricsEndpointCtx(NexContext *ctx, int port);
+  NEX_API int setTracingCtx(NexContext *ctx, TraceOptions options);
+  NEX_API int flushTraceCtx(NexContext *ctx);
+  NEX_API int startCaptureCtx(NexContext *ctx, const char *path);
+  NEX_API int stopCaptureCtx(NexContext *ctx);
+  NEX_API int replayCaptureCtx(NexContext *ctx, const char *path, void (*onClientData)(Data, socket_t), ReplayPacing pacing);
+  NEX_API socket_t getLocalSocketCtx(NexContext *ctx);
+  NEX_API int getSocketOptionsCtx(NexContext *ctx, socket_t socket, SocketOptions *options);
+  NEX_API void printLastErrorCtx(NexContext *ctx);
+  NEX_API const char *getLastErrorCtx(NexContext *ctx);
+  NEX_API int shutdownNetworkCtx(NexContext *ctx);
+
 #ifdef __cplusplus
 }
 #endif
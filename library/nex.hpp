@@ -0,0 +1,658 @@
+#ifndef NEX_HPP
+#define NEX_HPP
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include "nex.h"
+
+/// C++20 coroutine layer over the TCP client and server.
+///
+/// Coroutines are resumed directly on the library's receive threads, from inside the same callbacks the C API uses,
+/// so no threads are created for them. The rules for callbacks apply to code running in a coroutine: it must not block
+/// and must not call @ref shutdownNetwork() or @ref destroyContext().
+namespace nex
+{
+  /// Recycles coroutine frames by size class so spawning a handler per connection does not hit the allocator.
+  class FramePool
+  {
+  public:
+    static constexpr std::size_t classCount = 7;
+    static constexpr std::size_t smallestClass = 128;
+    static constexpr std::size_t retainedPerClass = 1024;
+
+    void *allocate(std::size_t size)
+    {
+      std::size_t index = classFor(size);
+      if (index == classCount)
+      {
+        return ::operator new(size);
+      }
+
+      {
+        std::lock_guard<std::mutex> guard(classes[index].lock);
+        if (!classes[index].blocks.empty())
+        {
+          void *block = classes[index].blocks.back();
+          classes[index].blocks.pop_back();
+          return block;
+        }
+      }
+      return ::operator new(smallestClass << index);
+    }
+
+    void deallocate(void *block, std::size_t size)
+    {
+      std::size_t index = classFor(size);
+      if (index < classCount)
+      {
+        std::lock_guard<std::mutex> guard(classes[index].lock);
+        if (classes[index].blocks.size() < retainedPerClass)
+        {
+          classes[index].blocks.push_back(block);
+          return;
+        }
+      }
+      ::operator delete(block);
+    }
+
+    ~FramePool()
+    {
+      for (SizeClass &sizeClass : classes)
+      {
+        for (void *block : sizeClass.blocks)
+        {
+          ::operator delete(block);
+        }
+      }
+    }
+
+  private:
+    struct SizeClass
+    {
+      std::mutex lock;
+      std::vector<void *> blocks;
+    };
+
+    static std::size_t classFor(std::size_t size)
+    {
+      std::size_t index = 0;
+      while (index < classCount && (smallestClass << index) < size)
+      {
+        index++;
+      }
+      return index;
+    }
+
+    SizeClass classes[classCount];
+  };
+
+  inline FramePool &framePool()
+  {
+    static FramePool pool;
+    return pool;
+  }
+
+  /// A detached coroutine. It starts running immediately and frees its frame when it returns.
+  class Task
+  {
+  public:
+    struct promise_type
+    {
+      Task get_return_object() { return Task(); }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+
+      static void *operator new(std::size_t size) { return framePool().allocate(size); }
+      static void operator delete(void *frame, std::size_t size) { framePool().deallocate(frame, size); }
+    };
+  };
+
+  /// Owning copy of a received @ref Data. Evaluates to false once the connection has closed.
+  class Message
+  {
+  public:
+    Message()
+    {
+      std::memset(&value, 0, sizeof(Data));
+      value.type = TYPE_DISCONNECTED;
+    }
+
+    explicit Message(const Data &data)
+    {
+      value = data;
+      if (data.type == TYPE_STRING)
+      {
+        value.data.s = data.data.s ? strdup(data.data.s) : nullptr;
+      }
+      else if (data.type == TYPE_JSON)
+      {
+        value.data.json = cJSON_Duplicate(data.data.json, 1);
+      }
+      else if (data.type != TYPE_INT && data.type != TYPE_FLOAT)
+      {
+        std::memset(&value.data, 0, sizeof(value.data));
+      }
+    }
+
+    Message(Message &&other) noexcept : value(other.value)
+    {
+      other.value.type = TYPE_DISCONNECTED;
+    }
+
+    Message &operator=(Message &&other) noexcept
+    {
+      if (this != &other)
+      {
+        release();
+        value = other.value;
+        other.value.type = TYPE_DISCONNECTED;
+      }
+      return *this;
+    }
+
+    Message(const Message &) = delete;
+    Message &operator=(const Message &) = delete;
+
+    ~Message() { release(); }
+
+    explicit operator bool() const { return value.type != TYPE_DISCONNECTED; }
+    NetworkedType type() const { return value.type; }
+    const Data &data() const { return value; }
+
+  private:
+    void release()
+    {
+      if (value.type == TYPE_STRING)
+      {
+        free(value.data.s);
+      }
+      else if (value.type == TYPE_JSON)
+      {
+        cJSON_Delete(value.data.json);
+      }
+      value.type = TYPE_DISCONNECTED;
+    }
+
+    Data value;
+  };
+
+  /// Outcome of a request. When the request could not be sent, `error` holds the network error and `status` is `REQUEST_DISCONNECTED`.
+  struct Response
+  {
+    RequestStatus status;
+    int error;
+    Message message;
+  };
+
+  /// Result of a send. Sends are queued by the library, so the await always completes without suspending.
+  struct SendAwaitable
+  {
+    int result;
+
+    bool await_ready() const noexcept { return true; }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+    int await_resume() const noexcept { return result; }
+  };
+
+  /// Messages received for one connection, waiting for a single coroutine to pick them up.
+  class Mailbox
+  {
+  public:
+    class Awaitable
+    {
+    public:
+      explicit Awaitable(Mailbox &mailbox) : mailbox(mailbox) {}
+
+      bool await_ready() { return mailbox.hasMessage(); }
+
+      bool await_suspend(std::coroutine_handle<> handle)
+      {
+        std::lock_guard<std::mutex> guard(mailbox.lock);
+        if (!mailbox.messages.empty() || mailbox.closed)
+        {
+          return false;
+        }
+        mailbox.waiter = handle;
+        return true;
+      }
+
+      Message await_resume() { return mailbox.take(); }
+
+    private:
+      Mailbox &mailbox;
+    };
+
+    void deliver(const Data &data)
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      if (closed)
+      {
+        return;
+      }
+      messages.emplace_back(data);
+      wake(guard);
+    }
+
+    void close()
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      closed = true;
+      wake(guard);
+    }
+
+    bool isClosed()
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      return closed;
+    }
+
+  private:
+    bool hasMessage()
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      return !messages.empty() || closed;
+    }
+
+    Message take()
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (messages.empty())
+      {
+        return Message();
+      }
+      Message message = std::move(messages.front());
+      messages.pop_front();
+      return message;
+    }
+
+    void wake(std::unique_lock<std::mutex> &guard)
+    {
+      std::coroutine_handle<> handle = waiter;
+      waiter = nullptr;
+      guard.unlock();
+      if (handle)
+      {
+        handle.resume();
+      }
+    }
+
+    std::mutex lock;
+    std::deque<Message> messages;
+    std::coroutine_handle<> waiter;
+    bool closed = false;
+  };
+
+  /// Awaits the response to a request sent with @ref requestClient() or @ref requestServer().
+  template <typename Send>
+  class RequestAwaitable
+  {
+  public:
+    RequestAwaitable(Send send, Data data, int timeoutMs) : send(send), data(data), timeoutMs(timeoutMs) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      waiter = handle;
+      // Once the request is queued the callback may resume the coroutine on another thread before this returns,
+      // so the awaitable is only touched again when queueing failed.
+      int result = send(data, timeoutMs, &RequestAwaitable::complete, this);
+      if (result == NETWORK_OK)
+      {
+        return true;
+      }
+      response.error = result;
+      return false;
+    }
+
+    Response await_resume() { return std::move(response); }
+
+  private:
+    static void complete(RequestStatus status, Data data, void *userData)
+    {
+      RequestAwaitable *self = static_cast<RequestAwaitable *>(userData);
+      self->response.status = status;
+      if (status == REQUEST_OK)
+      {
+        self->response.message = Message(data);
+      }
+      self->waiter.resume();
+    }
+
+    Send send;
+    Data data;
+    int timeoutMs;
+    std::coroutine_handle<> waiter;
+    Response response{REQUEST_DISCONNECTED, NETWORK_OK, Message()};
+  };
+
+  /// One client connected to a @ref TcpServer.
+  class Connection
+  {
+  public:
+    Connection(NexContext *context, socket_t socket) : context(context), clientSocket(socket) {}
+
+    socket_t socket() const { return clientSocket; }
+
+    /// Awaits the next message from the client. The result is false once the client has disconnected.
+    /// Only one coroutine may await a connection at a time.
+    Mailbox::Awaitable recv() { return Mailbox::Awaitable(mailbox); }
+
+    SendAwaitable send(Data data)
+    {
+      if (mailbox.isClosed())
+      {
+        return SendAwaitable{NETWORK_ERR_INVALID};
+      }
+      return SendAwaitable{sendToClientCtx(context, data, clientSocket)};
+    }
+
+    /// Sends a request and awaits the response. See @ref requestClient().
+    auto request(Data data, int timeoutMs)
+    {
+      NexContext *ctx = mailbox.isClosed() ? nullptr : context;
+      socket_t client = clientSocket;
+      auto send = [ctx, client](Data data, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData)
+      {
+        return ctx ? requestClientCtx(ctx, data, client, timeoutMs, onResponse, userData) : NETWORK_ERR_INVALID;
+      };
+      return RequestAwaitable<decltype(send)>(send, data, timeoutMs);
+    }
+
+    Mailbox mailbox;
+
+  private:
+    NexContext *context;
+    socket_t clientSocket;
+  };
+
+  namespace detail
+  {
+    template <typename T>
+    class Registry
+    {
+    public:
+      static void add(NexContext *context, T *owner)
+      {
+        std::lock_guard<std::mutex> guard(lock());
+        owners()[context] = owner;
+      }
+
+      static void remove(NexContext *context)
+      {
+        std::lock_guard<std::mutex> guard(lock());
+        owners().erase(context);
+      }
+
+      static T *find(NexContext *context)
+      {
+        std::lock_guard<std::mutex> guard(lock());
+        auto it = owners().find(context);
+        return it == owners().end() ? nullptr : it->second;
+      }
+
+    private:
+      static std::mutex &lock()
+      {
+        static std::mutex mutex;
+        return mutex;
+      }
+
+      static std::unordered_map<NexContext *, T *> &owners()
+      {
+        static std::unordered_map<NexContext *, T *> map;
+        return map;
+      }
+    };
+  }
+
+  /// TCP server whose clients are handed out by awaiting @ref accept().
+  ///
+  /// Each server runs in its own context. Errors are reported through return codes and @ref lastError(),
+  /// like the C API.
+  class TcpServer
+  {
+  public:
+    class AcceptAwaitable
+    {
+    public:
+      explicit AcceptAwaitable(TcpServer &server) : server(server) {}
+
+      bool await_ready()
+      {
+        std::lock_guard<std::mutex> guard(server.lock);
+        return !server.pending.empty() || server.stopped;
+      }
+
+      bool await_suspend(std::coroutine_handle<> handle)
+      {
+        std::lock_guard<std::mutex> guard(server.lock);
+        if (!server.pending.empty() || server.stopped)
+        {
+          return false;
+        }
+        server.acceptor = handle;
+        return true;
+      }
+
+      /// @return The new connection, or an empty pointer once the server has stopped.
+      std::shared_ptr<Connection> await_resume()
+      {
+        std::lock_guard<std::mutex> guard(server.lock);
+        if (server.pending.empty())
+        {
+          return nullptr;
+        }
+        std::shared_ptr<Connection> connection = std::move(server.pending.front());
+        server.pending.pop_front();
+        return connection;
+      }
+
+    private:
+      TcpServer &server;
+    };
+
+    TcpServer() = default;
+    TcpServer(const TcpServer &) = delete;
+    TcpServer &operator=(const TcpServer &) = delete;
+
+    ~TcpServer() { stop(); }
+
+    int start(int port, int maxClients, const SocketOptions *options = nullptr)
+    {
+      int result = createContext(&context, CONNECTION_TCP, ::Server);
+      if (result != NETWORK_OK)
+      {
+        return result;
+      }
+
+      detail::Registry<TcpServer>::add(context, this);
+      return startServerWithOptionsCtx(context, port, maxClients, &TcpServer::onClientData, options);
+    }
+
+    AcceptAwaitable accept() { return AcceptAwaitable(*this); }
+
+    /// Closes every connection, then completes a pending @ref accept() with an empty pointer.
+    void stop()
+    {
+      if (context == nullptr)
+      {
+        return;
+      }
+
+      // Shutting down runs the remaining callbacks, so the server stays registered until it returns.
+      destroyContext(context);
+      detail::Registry<TcpServer>::remove(context);
+      context = nullptr;
+
+      std::unique_lock<std::mutex> guard(lock);
+      stopped = true;
+      wakeAcceptor(guard);
+    }
+
+    NexContext *nexContext() const { return context; }
+    const char *lastError() const { return context ? getLastErrorCtx(context) : getLastError(); }
+
+  private:
+    static void onClientData(Data data, socket_t socket)
+    {
+      NexContext *ctx = getCurrentContext();
+      TcpServer *server = detail::Registry<TcpServer>::find(ctx);
+      if (server == nullptr)
+      {
+        return;
+      }
+
+      if (data.type == TYPE_CONNECTED)
+      {
+        server->connected(ctx, socket);
+        return;
+      }
+
+      // Disconnects are handled by the client context deleter, which runs while the socket is still known.
+      if (data.type == TYPE_DISCONNECTED)
+      {
+        return;
+      }
+
+      auto *connection = static_cast<std::shared_ptr<Connection> *>(getClientContextCtx(ctx, socket));
+      if (connection)
+      {
+        (*connection)->mailbox.deliver(data);
+      }
+    }
+
+    static void closeConnection(void *context)
+    {
+      auto *connection = static_cast<std::shared_ptr<Connection> *>(context);
+      (*connection)->mailbox.close();
+      delete connection;
+    }
+
+    void connected(NexContext *ctx, socket_t socket)
+    {
+      auto connection = std::make_shared<Connection>(ctx, socket);
+      if (setClientContextCtx(ctx, new std::shared_ptr<Connection>(connection), socket, &TcpServer::closeConnection) != NETWORK_OK)
+      {
+        return;
+      }
+
+      std::unique_lock<std::mutex> guard(lock);
+      pending.push_back(std::move(connection));
+      wakeAcceptor(guard);
+    }
+
+    void wakeAcceptor(std::unique_lock<std::mutex> &guard)
+    {
+      std::coroutine_handle<> handle = acceptor;
+      acceptor = nullptr;
+      guard.unlock();
+      if (handle)
+      {
+        handle.resume();
+      }
+    }
+
+    NexContext *context = nullptr;
+    std::mutex lock;
+    std::deque<std::shared_ptr<Connection>> pending;
+    std::coroutine_handle<> acceptor;
+    bool stopped = false;
+  };
+
+  /// TCP client whose messages from the server are read by awaiting @ref recv().
+  class TcpClient
+  {
+  public:
+    TcpClient() = default;
+    TcpClient(const TcpClient &) = delete;
+    TcpClient &operator=(const TcpClient &) = delete;
+
+    ~TcpClient() { close(); }
+
+    int connect(const char *ip, int port, const SocketOptions *options = nullptr)
+    {
+      int result = createContext(&context, CONNECTION_TCP, ::Client);
+      if (result != NETWORK_OK)
+      {
+        return result;
+      }
+
+      detail::Registry<TcpClient>::add(context, this);
+      return connectToServerWithOptionsCtx(context, ip, port, &TcpClient::onServerData, options);
+    }
+
+    /// Awaits the next message from the server. The result is false once the connection has closed.
+    Mailbox::Awaitable recv() { return Mailbox::Awaitable(mailbox); }
+
+    SendAwaitable send(Data data)
+    {
+      if (context == nullptr || mailbox.isClosed())
+      {
+        return SendAwaitable{NETWORK_ERR_INVALID};
+      }
+      return SendAwaitable{sendToServerCtx(context, data)};
+    }
+
+    /// Sends a request and awaits the response. See @ref requestServer().
+    auto request(Data data, int timeoutMs)
+    {
+      NexContext *ctx = mailbox.isClosed() ? nullptr : context;
+      auto send = [ctx](Data data, int timeoutMs, void (*onResponse)(RequestStatus, Data, void *), void *userData)
+      {
+        return ctx ? requestServerCtx(ctx, data, timeoutMs, onResponse, userData) : NETWORK_ERR_INVALID;
+      };
+      return RequestAwaitable<decltype(send)>(send, data, timeoutMs);
+    }
+
+    void close()
+    {
+      if (context == nullptr)
+      {
+        return;
+      }
+
+      destroyContext(context);
+      detail::Registry<TcpClient>::remove(context);
+      context = nullptr;
+      mailbox.close();
+    }
+
+    NexContext *nexContext() const { return context; }
+    const char *lastError() const { return context ? getLastErrorCtx(context) : getLastError(); }
+
+  private:
+    static void onServerData(Data data)
+    {
+      TcpClient *client = detail::Registry<TcpClient>::find(getCurrentContext());
+      if (client == nullptr || data.type == TYPE_CONNECTED)
+      {
+        return;
+      }
+
+      if (data.type == TYPE_DISCONNECTED)
+      {
+        client->mailbox.close();
+        return;
+      }
+      client->mailbox.deliver(data);
+    }
+
+    NexContext *context = nullptr;
+    Mailbox mailbox;
+  };
+}
+
+#endif
@@ -0,0 +1,433 @@
+#include "outbound.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define OUTBOUND_RETAINED_CAPACITY (1024 * 1024)
+#define FRAME_HEADER_SIZE 5
+
+OutboundQueue *createOutboundQueue(socket_t socket, bool tcp, const FlushPolicy *flushPolicy, const BackpressureOptions *backpressure, Metrics *metrics,
+                                   ConnectionCounters *counters)
+{
+  OutboundQueue *queue = (OutboundQueue *)calloc(1, sizeof(OutboundQueue));
+  if (queue == NULL)
+  {
+    return NULL;
+  }
+
+  if (pthread_mutex_init(&queue->lock, NULL) != 0)
+  {
+    free(queue);
+    return NULL;
+  }
+
+  queue->socket = socket;
+  queue->tcp = tcp;
+  queue->flushPolicy = flushPolicy;
+  queue->backpressure = backpressure;
+  queue->metrics = metrics;
+  queue->counters = counters;
+  applyFlushPolicy(queue);
+  return queue;
+}
+
+void destroyOutboundQueue(OutboundQueue *queue)
+{
+  if (queue == NULL)
+  {
+    return;
+  }
+
+  byteBufferFree(&queue->pending);
+  pthread_mutex_destroy(&queue->lock);
+  free(queue);
+}
+
+void applyFlushPolicy(OutboundQueue *queue)
+{
+  if (!queue->tcp)
+  {
+    return;
+  }
+
+  const FlushPolicy *policy = queue->flushPolicy;
+  setSocketOption(queue->socket, SOCKET_OPTION_NO_DELAY, policy->noDelay);
+  setSocketOption(queue->socket, SOCKET_OPTION_CORK, policy->cork && policy->mode == FLUSH_COALESCE);
+}
+
+static size_t frameEnd(const ByteBuffer *buffer, size_t offset)
+{
+  uint32_t size;
+  memcpy(&size, buffer->bytes + offset + 1, sizeof(uint32_t));
+  return offset + FRAME_HEADER_SIZE + ntohl(size);
+}
+
+static size_t unsentBytes(const OutboundQueue *queue)
+{
+  return queue->pending.length - queue->written;
+}
+
+// Called before the lock is released after every change, so the depth can be read without waiting on a write.
+static void publishQueued(OutboundQueue *queue)
+{
+  ATOMIC_STORE_RELEASE(&queue->queued, (uint64_t)unsentBytes(queue));
+}
+
+static void compact(OutboundQueue *queue)
+{
+  if (queue->written == queue->pending.length)
+  {
+    queue->pending.length = 0;
+    queue->written = 0;
+    if (queue->pending.capacity > OUTBOUND_RETAINED_CAPACITY)
+    {
+      byteBufferFree(&queue->pending);
+    }
+    return;
+  }
+
+  // Only whole frames are discarded, so the buffer always starts on a frame boundary.
+  size_t offset = 0;
+  while (offset < queue->written)
+  {
+    size_t end = frameEnd(&queue->pending, offset);
+    if (end > queue->written)
+    {
+      break;
+    }
+    offset = end;
+  }
+
+  if (offset > 0)
+  {
+    memmove(queue->pending.bytes, queue->pending.bytes + offset, queue->pending.length - offset);
+    queue->pending.length -= offset;
+    queue->written -= offset;
+  }
+}
+
+// Without block only what the socket takes right away is written, even when senders are meant to block.
+static int writePending(OutboundQueue *queue, bool block, int *events)
+{
+  if (queue->written == queue->pending.length)
+  {
+    return PLATFORM_SUCCESS;
+  }
+
+  int result = PLATFORM_SUCCESS;
+  if (block && queue->backpressure->maxQueuedBytes == 0)
+  {
+    if (queue->shared)
+    {
+      result = writeSharedLink(queue->shared, queue->pending.bytes + queue->written, queue->pending.length - queue->written);
+    }
+    else
+    {
+      result = sendAll(queue->socket, queue->pending.bytes + queue->written, queue->pending.length - queue->written, 0);
+    }
+    queue->written = queue->pending.length;
+  }
+  else
+  {
+    while (queue->written < queue->pending.length)
+    {
+      const uint8_t *unsent = queue->pending.bytes + queue->written;
+      size_t length = queue->pending.length - queue->written;
+      int sent = queue->shared ? writeSharedLinkSome(queue->shared, unsent, length) : sendDataNonBlocking(queue->socket, unsent, length);
+      if (sent == PLATFORM_FAILURE)
+      {
+        result = PLATFORM_FAILURE;
+        queue->written = queue->pending.length;
+        break;
+      }
+      if (sent == 0)
+      {
+        break;
+      }
+      queue->written += sent;
+    }
+  }
+
+  bool drained = queue->written == queue->pending.length;
+  compact(queue);
+
+  if (queue->aboveHighWatermark && unsentBytes(queue) <= queue->backpressure->lowWatermark)
+  {
+    queue->aboveHighWatermark = false;
+    *events |= OUTBOUND_LOW_WATERMARK;
+  }
+
+  const FlushPolicy *policy = queue->flushPolicy;
+  if (result == PLATFORM_SUCCESS && drained && queue->tcp && policy->cork && policy->mode == FLUSH_COALESCE)
+  {
+    setSocketOption(queue->socket, SOCKET_OPTION_CORK, 0);
+    setSocketOption(queue->socket, SOCKET_OPTION_CORK, 1);
+  }
+  return result;
+}
+
+static int makeRoom(OutboundQueue *queue, size_t frameStart, int *events)
+{
+  const BackpressureOptions *backpressure = queue->backpressure;
+  if (backpressure->maxQueuedBytes == 0 || unsentBytes(queue) <= backpressure->maxQueuedBytes)
+  {
+    return PLATFORM_SUCCESS;
+  }
+
+  if (backpressure->slowConsumerPolicy == SLOW_CONSUMER_DISCONNECT)
+  {
+    queue->pending.length = 0;
+    queue->written = 0;
+    queue->disconnecting = true;
+    *events |= OUTBOUND_DISCONNECT;
+    return PLATFORM_FAILURE;
+  }
+
+  if (backpressure->slowConsumerPolicy == SLOW_CONSUMER_DROP_OLDEST)
+  {
+    // The frame at the front may already be partially on the wire and has to be finished.
+    size_t start = queue->written > 0 ? frameEnd(&queue->pending, 0) : 0;
+    size_t end = start;
+    while (end < frameStart && queue->pending.length - (end - start) - queue->written > backpressure->maxQueuedBytes)
+    {
+      end = frameEnd(&queue->pending, end);
+    }
+
+    if (end > start)
+    {
+      memmove(queue->pending.bytes + start, queue->pending.bytes + end, queue->pending.length - end);
+      queue->pending.length -= end - start;
+      frameStart -= end - start;
+      *events |= OUTBOUND_DROPPED_OLD;
+    }
+
+    if (unsentBytes(queue) <= backpressure->maxQueuedBytes)
+    {
+      return PLATFORM_SUCCESS;
+    }
+  }
+
+  queue->pending.length = frameStart;
+  *events |= OUTBOUND_DROPPED_NEW;
+  return PLATFORM_FAILURE;
+}
+
+static int finishQueueing(OutboundQueue *queue, size_t frameStart, int *events)
+{
+  if (makeRoom(queue, frameStart, events) == PLATFORM_FAILURE)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  int result = PLATFORM_SUCCESS;
+  if (queue->flushPolicy->mode == FLUSH_IMMEDIATE || unsentBytes(queue) >= queue->flushPolicy->maxBufferedBytes)
+  {
+    result = writePending(queue, true, events);
+  }
+
+  const BackpressureOptions *backpressure = queue->backpressure;
+  if (backpressure->maxQueuedBytes > 0 && backpressure->highWatermark > 0 && !queue->aboveHighWatermark && unsentBytes(queue) >= backpressure->highWatermark)
+  {
+    queue->aboveHighWatermark = true;
+    *events |= OUTBOUND_HIGH_WATERMARK;
+  }
+  return result;
+}
+
+// A message counts as sent once it is queued, and as failed when the queue dropped it or the socket failed.
+static void countQueued(OutboundQueue *queue, NetworkedType type, size_t length, int result)
+{
+  if (result == PLATFORM_FAILURE)
+  {
+    recordSendFailure(queue->metrics, queue->counters);
+  }
+  else
+  {
+    recordSent(queue->metrics, queue->counters, type, length);
+  }
+}
+
+// Hands a large payload off in a memfd, or frames it into the queue like any other message. A handoff goes straight to
+// the socket, so it has to wait until everything queued ahead of it is written. With a queue limit it never blocks
+// either: a socket too full to take it gets the frame queued, under the same backpressure as everything else.
+static int queuePayload(OutboundQueue *queue, const HandoffPayload *payload, int *events)
+{
+  size_t length = FRAME_HEADER_SIZE + payload->size;
+  if (length >= *queue->handoffThreshold && writePending(queue, true, events) == PLATFORM_SUCCESS && unsentBytes(queue) == 0)
+  {
+    int result = sendHandoff(queue->socket, payload, queue->backpressure->maxQueuedBytes == 0);
+    if (result != 0)
+    {
+      countQueued(queue, payload->type, length, result);
+      return result;
+    }
+  }
+
+  size_t start = queue->pending.length;
+  if (encodeRaw(&queue->pending, payload->type, payload->bytes, (uint32_t)payload->size) == PLATFORM_FAILURE)
+  {
+    queue->pending.length = start;
+    return PLATFORM_FAILURE;
+  }
+
+  int result = finishQueueing(queue, start, events);
+  countQueued(queue, payload->type, length, result);
+  return result;
+}
+
+int queueData(OutboundQueue *queue, Data data, int *events)
+{
+  pthread_mutex_lock(&queue->lock);
+
+  if (queue->disconnecting)
+  {
+    recordSendFailure(queue->metrics, queue->counters);
+    pthread_mutex_unlock(&queue->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  HandoffPayload payload;
+  if (queue->handoffThreshold && *queue->handoffThreshold > 0 && preparePayload(data, &payload) == PLATFORM_SUCCESS)
+  {
+    int result = queuePayload(queue, &payload, events);
+    releasePayload(&payload);
+    publishQueued(queue);
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+  }
+
+  size_t start = queue->pending.length;
+  if (encodeData(&queue->pending, data) == PLATFORM_FAILURE)
+  {
+    queue->pending.length = start;
+    pthread_mutex_unlock(&queue->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  size_t length = queue->pending.length - start;
+  int result = finishQueueing(queue, start, events);
+  countQueued(queue, data.type, length, result);
+  publishQueued(queue);
+  pthread_mutex_unlock(&queue->lock);
+  return result;
+}
+
+int queueFrame(OutboundQueue *queue, const uint8_t *frame, size_t length, int *events)
+{
+  pthread_mutex_lock(&queue->lock);
+
+  if (queue->disconnecting)
+  {
+    recordSendFailure(queue->metrics, queue->counters);
+    pthread_mutex_unlock(&queue->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  size_t start = queue->pending.length;
+  if (byteBufferAppend(&queue->pending, frame, length) == PLATFORM_FAILURE)
+  {
+    pthread_mutex_unlock(&queue->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  int result = finishQueueing(queue, start, events);
+  countQueued(queue, (NetworkedType)frame[0], length, result);
+  publishQueued(queue);
+  pthread_mutex_unlock(&queue->lock);
+  return result;
+}
+
+int queueHeartbeat(OutboundQueue *queue, const uint8_t *frame, size_t length)
+{
+  // A thread holding the lock or bytes still waiting are traffic already, which makes the heartbeat unnecessary.
+  if (pthread_mutex_trylock(&queue->lock) != 0)
+  {
+    return 0;
+  }
+  if (queue->disconnecting || unsentBytes(queue) > 0)
+  {
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+  }
+
+  int sent = queue->shared ? writeSharedLinkSome(queue->shared, frame, length) : sendDataNonBlocking(queue->socket, frame, length);
+  if (sent > 0 && (size_t)sent < length)
+  {
+    // The rest of a frame that is partly on the wire has to follow it, so it waits in the queue for the next write.
+    size_t start = queue->pending.length;
+    if (byteBufferAppend(&queue->pending, frame, length) == PLATFORM_FAILURE)
+    {
+      sent = PLATFORM_FAILURE;
+    }
+    else
+    {
+      queue->written = start + (size_t)sent;
+    }
+  }
+
+  if (sent == PLATFORM_FAILURE)
+  {
+    recordSendFailure(queue->metrics, queue->counters);
+  }
+  else if (sent > 0)
+  {
+    recordSent(queue->metrics, queue->counters, (NetworkedType)frame[0], length);
+  }
+  publishQueued(queue);
+  pthread_mutex_unlock(&queue->lock);
+  return sent == PLATFORM_FAILURE ? PLATFORM_FAILURE : sent > 0 ? PLATFORM_SUCCESS : 0;
+}
+
+int flushOutboundQueue(OutboundQueue *queue, int *events)
+{
+  pthread_mutex_lock(&queue->lock);
+  int result = writePending(queue, true, events);
+  publishQueued(queue);
+  pthread_mutex_unlock(&queue->lock);
+  return result;
+}
+
+int flushOutboundQueueSome(OutboundQueue *queue, int *events)
+{
+  if (pthread_mutex_trylock(&queue->lock) != 0)
+  {
+    return PLATFORM_SUCCESS;
+  }
+  int result = writePending(queue, false, events);
+  publishQueued(queue);
+  pthread_mutex_unlock(&queue->lock);
+  return result;
+}
+
+int drainOutboundQueue(OutboundQueue *queue, uint64_t deadline, int *events)
+{
+  int result = PLATFORM_SUCCESS;
+  while (result == PLATFORM_SUCCESS && outboundQueuedBytes(queue) > 0)
+  {
+    uint64_t now = monotonicMilliseconds();
+    if (now >= deadline)
+    {
+      break;
+    }
+
+    result = flushOutboundQueueSome(queue, events);
+    if (result == PLATFORM_SUCCESS && outboundQueuedBytes(queue) > 0)
+    {
+      int timeout = deadline - now < OUTBOUND_POLL_INTERVAL_MS ? (int)(deadline - now) : OUTBOUND_POLL_INTERVAL_MS;
+      if (queue->shared)
+      {
+        sleepMilliseconds(timeout);
+      }
+      else
+      {
+        int writable;
+        pollWritable(&queue->socket, &writable, 1, timeout);
+      }
+    }
+  }
+  return result;
+}
+
+size_t outboundQueuedBytes(OutboundQueue *queue)
+{
+  return (size_t)ATOMIC_LOAD_ACQUIRE(&queue->queued);
+}
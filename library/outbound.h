@@ -0,0 +1,74 @@
+#ifndef OUTBOUND_H
+#define OUTBOUND_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <pthread.h>
+#include "nex.h"
+#include "metrics.h"
+#include "sharedRing.h"
+#include "handoff.h"
+
+// How long the outbound thread waits for a backed up socket to become writable before rechecking.
+#define OUTBOUND_POLL_INTERVAL_MS 5
+// How long shutdown keeps writing what is still queued to connections that are slow to take it.
+#define OUTBOUND_DRAIN_TIMEOUT_MS 1000
+
+  typedef enum
+  {
+    OUTBOUND_HIGH_WATERMARK = 1,
+    OUTBOUND_LOW_WATERMARK = 2,
+    OUTBOUND_DROPPED_NEW = 4,
+    OUTBOUND_DROPPED_OLD = 8,
+    OUTBOUND_DISCONNECT = 16
+  } OutboundEvent;
+
+  typedef struct
+  {
+    socket_t socket;
+    // TCP only socket options such as TCP_CORK are left alone on other streams.
+    bool tcp;
+    // Set on shared memory connections, whose frames go into the ring instead of the socket.
+    SharedLink *shared;
+    // Set on Unix domain socket connections. Strings and JSON whose frame reaches the threshold are handed off in a
+    // memfd, 0 turns that off.
+    const size_t *handoffThreshold;
+    ByteBuffer pending;
+    size_t written;
+    // The unsent bytes as of the last change, readable without the lock.
+    uint64_t queued;
+    bool aboveHighWatermark;
+    bool disconnecting;
+    // Threads still sending through the queue of a server client after finding it under ctx->outboundLock. Removing
+    // the client waits for them before it frees anything.
+    uint64_t users;
+    const FlushPolicy *flushPolicy;
+    const BackpressureOptions *backpressure;
+    Metrics *metrics;
+    ConnectionCounters *counters;
+    pthread_mutex_t lock;
+  } OutboundQueue;
+
+  OutboundQueue *createOutboundQueue(socket_t socket, bool tcp, const FlushPolicy *flushPolicy, const BackpressureOptions *backpressure, Metrics *metrics,
+                                     ConnectionCounters *counters);
+  void destroyOutboundQueue(OutboundQueue *queue);
+  void applyFlushPolicy(OutboundQueue *queue);
+
+  int queueData(OutboundQueue *queue, Data data, int *events);
+  int queueFrame(OutboundQueue *queue, const uint8_t *frame, size_t length, int *events);
+  // Writes a heartbeat without blocking. Returns 0 without sending anything when the socket is full or other traffic
+  // is on its way.
+  int queueHeartbeat(OutboundQueue *queue, const uint8_t *frame, size_t length);
+  int flushOutboundQueue(OutboundQueue *queue, int *events);
+  // Writes what the socket takes without blocking and leaves the rest queued. A queue another thread is writing is
+  // skipped.
+  int flushOutboundQueueSome(OutboundQueue *queue, int *events);
+  // Keeps flushing without blocking until the queue is empty or monotonicMilliseconds() reaches deadline.
+  int drainOutboundQueue(OutboundQueue *queue, uint64_t deadline, int *events);
+  size_t outboundQueuedBytes(OutboundQueue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -1,15 +1,32 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include "platform.h"
 
 #ifdef PLATFORM_LINUX
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sched.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
 
 struct sockaddr_in createSockaddrIn(int port, const char *ipAddress)
 {
@@ -74,12 +91,64 @@ socket_t acceptSocket(socket_t sock, struct sockaddr *addr, socklen_t *addrlen)
   socket_t clientSock = accept(sock, addr, addrlen);
   if (clientSock < 0)
   {
-    perror("accept");
+    // EINVAL means the listening socket was shut down to stop the accept loop.
+    if (errno != EINVAL)
+    {
+      perror("accept");
+    }
     return PLATFORM_FAILURE;
   }
   return clientSock;
 }
 
+int acceptPending(socket_t sock, socket_t *client, struct sockaddr *addr, socklen_t *addrlen)
+{
+  socket_t clientSock;
+  do
+  {
+    clientSock = accept4(sock, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  } while (clientSock < 0 && errno == EINTR);
+
+  if (clientSock < 0)
+  {
+    // ECONNABORTED is a connection reset while it waited, EINVAL a listening socket shut down to stop the loop.
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+      return 0;
+    if (errno != EINVAL)
+      perror("accept4");
+    return PLATFORM_FAILURE;
+  }
+  *client = clientSock;
+  return PLATFORM_SUCCESS;
+}
+
+int setSocketBlocking(socket_t sock, int blocking)
+{
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0)
+    return PLATFORM_FAILURE;
+
+  flags = blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK;
+  if (fcntl(sock, F_SETFL, flags) < 0)
+    return PLATFORM_FAILURE;
+  return PLATFORM_SUCCESS;
+}
+
+int getAcceptQueue(socket_t sock, int *depth, int *limit)
+{
+  // For a listening socket, TCP_INFO reports the accept queue in tcpi_unacked and its limit in tcpi_sacked.
+  struct tcp_info info;
+  socklen_t length = sizeof(info);
+  *depth = 0;
+  *limit = 0;
+  if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &length) < 0 || info.tcpi_state != TCP_LISTEN)
+    return PLATFORM_FAILURE;
+
+  *depth = (int)info.tcpi_unacked;
+  *limit = (int)info.tcpi_sacked;
+  return PLATFORM_SUCCESS;
+}
+
 int connectSocket(socket_t sock, const struct sockaddr *addr, socklen_t addrlen)
 {
   if (connect(sock, addr, addrlen) < 0)
@@ -90,6 +159,254 @@ int connectSocket(socket_t sock, const struct sockaddr *addr, socklen_t addrlen)
   return PLATFORM_SUCCESS;
 }
 
+socket_t createLocalSocket()
+{
+  socket_t sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock_fd < 0)
+  {
+    perror("socket");
+    return PLATFORM_FAILURE;
+  }
+  return sock_fd;
+}
+
+// Names live in the abstract namespace, so nothing is left behind in the file system when a server exits.
+static socklen_t localAddress(int port, struct sockaddr_un *addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  int length = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "nex.%d", port);
+  return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + length);
+}
+
+int bindLocalSocket(socket_t sock, int port)
+{
+  struct sockaddr_un addr;
+  socklen_t length = localAddress(port, &addr);
+  return bindSocket(sock, (struct sockaddr *)&addr, length);
+}
+
+int connectLocalSocket(socket_t sock, int port)
+{
+  struct sockaddr_un addr;
+  socklen_t length = localAddress(port, &addr);
+  return connectSocket(sock, (struct sockaddr *)&addr, length);
+}
+
+int createSharedMemory(size_t size)
+{
+  int fd = memfd_create("nex", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+  {
+    perror("memfd_create");
+    return PLATFORM_FAILURE;
+  }
+  if (ftruncate(fd, (off_t)size) < 0)
+  {
+    perror("ftruncate");
+    close(fd);
+    return PLATFORM_FAILURE;
+  }
+  return fd;
+}
+
+int sharedMemorySize(int descriptor, size_t *size)
+{
+  struct stat status;
+  if (fstat(descriptor, &status) < 0)
+    return PLATFORM_FAILURE;
+  *size = (size_t)status.st_size;
+  return PLATFORM_SUCCESS;
+}
+
+void *mapSharedMemory(int descriptor, size_t size, int writable)
+{
+  void *memory = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED | MAP_POPULATE, descriptor, 0);
+  if (memory == MAP_FAILED)
+  {
+    perror("mmap");
+    return NULL;
+  }
+  return memory;
+}
+
+int writeSharedMemory(int descriptor, size_t offset, const void *bytes, size_t length)
+{
+  const uint8_t *position = (const uint8_t *)bytes;
+  while (length > 0)
+  {
+    ssize_t written = pwrite(descriptor, position, length, (off_t)offset);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+    {
+      perror("pwrite");
+      return PLATFORM_FAILURE;
+    }
+    position += written;
+    offset += (size_t)written;
+    length -= (size_t)written;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+#define SHARED_MEMORY_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)
+
+int sealSharedMemory(int descriptor)
+{
+  if (fcntl(descriptor, F_ADD_SEALS, SHARED_MEMORY_SEALS) < 0)
+  {
+    perror("fcntl");
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+// A segment that can still shrink would fault the reader, one that can still be written could change under it.
+int sharedMemorySealed(int descriptor)
+{
+  int seals = fcntl(descriptor, F_GET_SEALS);
+  return seals >= 0 && (seals & SHARED_MEMORY_SEALS) == SHARED_MEMORY_SEALS ? PLATFORM_SUCCESS : PLATFORM_FAILURE;
+}
+
+void unmapSharedMemory(void *memory, size_t size)
+{
+  if (memory)
+    munmap(memory, size);
+}
+
+void closeDescriptor(int descriptor)
+{
+  if (descriptor >= 0)
+    close(descriptor);
+}
+
+int openFile(const char *path, int writable)
+{
+  int fd = writable ? open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    perror("open");
+    return PLATFORM_FAILURE;
+  }
+  return fd;
+}
+
+int resizeFile(int descriptor, size_t size)
+{
+  if (ftruncate(descriptor, (off_t)size) < 0)
+  {
+    perror("ftruncate");
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+static ssize_t sendDescriptorMessage(socket_t sock, int descriptor, const void *bytes, size_t length, int flags)
+{
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+
+  struct iovec vector;
+  vector.iov_base = (void *)bytes;
+  vector.iov_len = length;
+
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+
+  ssize_t sent;
+  do
+  {
+    sent = sendmsg(sock, &message, flags | MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  return sent;
+}
+
+int sendDescriptor(socket_t sock, int descriptor, const void *bytes, size_t length)
+{
+  ssize_t sent = sendDescriptorMessage(sock, descriptor, bytes, length, 0);
+  if (sent < 0 || (size_t)sent != length)
+  {
+    perror("sendmsg");
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int sendDescriptorNonBlocking(socket_t sock, int descriptor, const void *bytes, size_t length)
+{
+  ssize_t sent = sendDescriptorMessage(sock, descriptor, bytes, length, MSG_DONTWAIT);
+  if (sent < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    perror("sendmsg");
+    return PLATFORM_FAILURE;
+  }
+  return (int)sent;
+}
+
+int recvDescriptor(socket_t sock, int *descriptor, void *bytes, size_t length)
+{
+  char control[CMSG_SPACE(sizeof(int))];
+  *descriptor = -1;
+
+  struct iovec vector;
+  vector.iov_base = bytes;
+  vector.iov_len = length;
+
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t received;
+  do
+  {
+    received = recvmsg(sock, &message, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  if (received < 0)
+  {
+    perror("recvmsg");
+    return PLATFORM_FAILURE;
+  }
+
+  for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+  {
+    if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS && header->cmsg_len == CMSG_LEN(sizeof(int)))
+      memcpy(descriptor, CMSG_DATA(header), sizeof(int));
+  }
+  return (int)received;
+}
+
+// Not the private futex operations, the word may be mapped by another process.
+int waitAddress(uint32_t *word, uint32_t expected, int timeoutMs)
+{
+  struct timespec timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000L;
+  if (syscall(SYS_futex, word, FUTEX_WAIT, expected, timeoutMs >= 0 ? &timeout : NULL, NULL, 0) < 0 && errno == ETIMEDOUT)
+    return 0;
+  return PLATFORM_SUCCESS;
+}
+
+void wakeAddress(uint32_t *word)
+{
+  syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
 int sendData(socket_t sock, const void *buf, size_t len, int flags)
 {
   if (sock < 0)
@@ -104,6 +421,99 @@ int sendData(socket_t sock, const void *buf, size_t len, int flags)
   return PLATFORM_SUCCESS;
 }
 
+int sendAll(socket_t sock, const void *buf, size_t len, int flags)
+{
+  if (sock < 0)
+    return PLATFORM_FAILURE;
+
+  size_t total = 0;
+  const char *p = buf;
+
+  while (total < len)
+  {
+    ssize_t sent = send(sock, p + total, len - total, flags | MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      perror("send");
+      return PLATFORM_FAILURE;
+    }
+    total += sent;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int sendDataNonBlocking(socket_t sock, const void *buf, size_t len)
+{
+  if (sock < 0)
+    return PLATFORM_FAILURE;
+
+  ssize_t sent;
+  do
+  {
+    sent = send(sock, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+
+  if (sent < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    perror("send");
+    return PLATFORM_FAILURE;
+  }
+  return (int)sent;
+}
+
+int pollWritable(const socket_t *sockets, int *writable, int count, int timeoutMs)
+{
+  struct pollfd stackFds[64];
+  struct pollfd *fds = count <= 64 ? stackFds : (struct pollfd *)malloc(count * sizeof(struct pollfd));
+  if (fds == NULL)
+    return PLATFORM_FAILURE;
+
+  for (int i = 0; i < count; i++)
+  {
+    fds[i].fd = sockets[i];
+    fds[i].events = POLLOUT;
+    fds[i].revents = 0;
+  }
+
+  int ready = poll(fds, count, timeoutMs);
+  for (int i = 0; i < count; i++)
+  {
+    writable[i] = ready > 0 && (fds[i].revents & (POLLOUT | POLLERR | POLLHUP)) != 0;
+  }
+
+  if (fds != stackFds)
+    free(fds);
+
+  if (ready < 0 && errno != EINTR)
+  {
+    perror("poll");
+    return PLATFORM_FAILURE;
+  }
+  return ready < 0 ? 0 : ready;
+}
+
+int pollReadable(socket_t sock, int timeoutMs)
+{
+  struct pollfd fd;
+  fd.fd = sock;
+  fd.events = POLLIN;
+  fd.revents = 0;
+
+  int ready = poll(&fd, 1, timeoutMs);
+  if (ready < 0)
+  {
+    if (errno == EINTR)
+      return 0;
+    perror("poll");
+    return PLATFORM_FAILURE;
+  }
+  return ready > 0 ? PLATFORM_SUCCESS : 0;
+}
+
 int recvData(socket_t sock, void *buf, size_t len, int flags)
 {
   if (sock < 0)
@@ -177,6 +587,144 @@ int platformGetLastError()
   return errno;
 }
 
+static int socketOptionName(SocketOption option, int *level, int *name)
+{
+  switch (option)
+  {
+  case SOCKET_OPTION_SEND_BUFFER:
+    *level = SOL_SOCKET;
+    *name = SO_SNDBUF;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_RECEIVE_BUFFER:
+    *level = SOL_SOCKET;
+    *name = SO_RCVBUF;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_NO_DELAY:
+    *level = IPPROTO_TCP;
+    *name = TCP_NODELAY;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_CORK:
+    *level = IPPROTO_TCP;
+    *name = TCP_CORK;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_BUSY_POLL:
+    *level = SOL_SOCKET;
+    *name = SO_BUSY_POLL;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_QUICK_ACK:
+    *level = IPPROTO_TCP;
+    *name = TCP_QUICKACK;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_PRIORITY:
+    *level = SOL_SOCKET;
+    *name = SO_PRIORITY;
+    return PLATFORM_SUCCESS;
+  }
+  return PLATFORM_FAILURE;
+}
+
+int setSocketOption(socket_t sock, SocketOption option, int value)
+{
+  int level, name;
+  if (socketOptionName(option, &level, &name) == PLATFORM_FAILURE)
+    return PLATFORM_FAILURE;
+
+  if (setsockopt(sock, level, name, &value, sizeof(value)) < 0)
+  {
+    perror("setsockopt");
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int getSocketOption(socket_t sock, SocketOption option, int *value)
+{
+  int level, name;
+  if (socketOptionName(option, &level, &name) == PLATFORM_FAILURE)
+    return PLATFORM_FAILURE;
+
+  socklen_t length = sizeof(*value);
+  if (getsockopt(sock, level, name, value, &length) < 0)
+    return PLATFORM_FAILURE;
+  return PLATFORM_SUCCESS;
+}
+
+void sleepMilliseconds(int milliseconds)
+{
+  struct timespec duration;
+  duration.tv_sec = milliseconds / 1000;
+  duration.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+  while (nanosleep(&duration, &duration) < 0 && errno == EINTR)
+  {
+  }
+}
+
+uint64_t monotonicMilliseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+uint64_t monotonicMicroseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+int cpuCount()
+{
+  long count = sysconf(_SC_NPROCESSORS_CONF);
+  return count > 0 ? (int)count : 1;
+}
+
+int cpuNode(int cpu)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  DIR *dir = opendir(path);
+  if (dir == NULL)
+    return -1;
+
+  // The node shows up as a nodeN link next to the CPU's topology, and is missing on kernels built without NUMA.
+  int node = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+    {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+int pinCurrentThread(int cpu)
+{
+  if (cpu < 0 || cpu >= CPU_SETSIZE)
+    return PLATFORM_FAILURE;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) < 0)
+    return PLATFORM_FAILURE;
+  return PLATFORM_SUCCESS;
+}
+
+int socketIncomingCpu(socket_t sock, int *cpu)
+{
+#ifdef SO_INCOMING_CPU
+  socklen_t length = sizeof(*cpu);
+  if (getsockopt(sock, SOL_SOCKET, SO_INCOMING_CPU, cpu, &length) == 0 && *cpu >= 0)
+    return PLATFORM_SUCCESS;
+#endif
+  return PLATFORM_FAILURE;
+}
+
 void shutdownRead(socket_t sock)
 {
   shutdown(sock, SHUT_RD);
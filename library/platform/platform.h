@@ -7,6 +7,7 @@ extern "C"
 #endif
 
 #include <stdio.h>
+#include <stdint.h>
 
 #define PLATFORM_FAILURE -1
 #define PLATFORM_SUCCESS 1
@@ -34,6 +35,41 @@ typedef int socket_t;
 #error "Unsupported platform"
 #endif
 
+#ifdef PLATFORM_WINDOWS
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// 64 bit atomics. The plain ones are relaxed, enough for counters bumped from any thread without a lock.
+#ifdef PLATFORM_WINDOWS
+#define ATOMIC_ADD(target, value) InterlockedExchangeAdd64((volatile LONG64 *)(target), (LONG64)(value))
+#define ATOMIC_LOAD(target) ((uint64_t)InterlockedCompareExchange64((volatile LONG64 *)(target), 0, 0))
+#define ATOMIC_CAS(target, expected, desired) \
+  (InterlockedCompareExchange64((volatile LONG64 *)(target), (LONG64)(desired), (LONG64)(expected)) == (LONG64)(expected))
+#define ATOMIC_LOAD_ACQUIRE(target) ATOMIC_LOAD(target)
+#define ATOMIC_STORE_RELEASE(target, value) InterlockedExchange64((volatile LONG64 *)(target), (LONG64)(value))
+#define ATOMIC_FENCE() MemoryBarrier()
+#else
+#define ATOMIC_ADD(target, value) __atomic_fetch_add((target), (value), __ATOMIC_RELAXED)
+#define ATOMIC_LOAD(target) __atomic_load_n((target), __ATOMIC_RELAXED)
+#define ATOMIC_CAS(target, expected, desired) __sync_bool_compare_and_swap((target), (expected), (desired))
+#define ATOMIC_LOAD_ACQUIRE(target) __atomic_load_n((target), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE_RELEASE(target, value) __atomic_store_n((target), (value), __ATOMIC_RELEASE)
+#define ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+  typedef enum
+  {
+    SOCKET_OPTION_SEND_BUFFER,
+    SOCKET_OPTION_RECEIVE_BUFFER,
+    SOCKET_OPTION_NO_DELAY,
+    SOCKET_OPTION_CORK,
+    SOCKET_OPTION_BUSY_POLL,
+    SOCKET_OPTION_QUICK_ACK,
+    SOCKET_OPTION_PRIORITY
+  } SocketOption;
+
   struct sockaddr_in createSockaddrIn(int port, const char *ipAddress);
   int platformInit();
   void platformCleanup();
@@ -41,8 +77,45 @@ typedef int socket_t;
   int bindSocket(socket_t socket, const struct sockaddr *addr, socklen_t addrlen);
   int listenSocket(socket_t socket, int maxClients);
   socket_t acceptSocket(socket_t socket, struct sockaddr *addr, socklen_t *addrlen);
+  // Accepts one waiting connection from a non-blocking listening socket as a non-blocking, close-on-exec socket.
+  // Returns 0 when none is waiting.
+  int acceptPending(socket_t socket, socket_t *client, struct sockaddr *addr, socklen_t *addrlen);
+  int setSocketBlocking(socket_t socket, int blocking);
+  // Connections completed by the kernel but not accepted yet, and the backlog it applies to the listening socket.
+  int getAcceptQueue(socket_t socket, int *depth, int *limit);
   int connectSocket(socket_t socket, const struct sockaddr *addr, socklen_t addrlen);
+  // Unix domain stream sockets named after a port, so local servers and clients find each other the way TCP ones do.
+  socket_t createLocalSocket();
+  int bindLocalSocket(socket_t socket, int port);
+  int connectLocalSocket(socket_t socket, int port);
+  // Shared memory segments handed to another process over a local socket, and the futex style waits its users sleep
+  // on. Linux only, the Windows versions fail.
+  int createSharedMemory(size_t size);
+  int sharedMemorySize(int descriptor, size_t *size);
+  void *mapSharedMemory(int descriptor, size_t size, int writable);
+  // Copies into a segment without mapping it, which spares the page faults of a mapping only ever written once.
+  int writeSharedMemory(int descriptor, size_t offset, const void *bytes, size_t length);
+  // Seals a segment against any further write or resize, which requires that no writable mapping of it is left.
+  int sealSharedMemory(int descriptor);
+  int sharedMemorySealed(int descriptor);
+  void unmapSharedMemory(void *memory, size_t size);
+  void closeDescriptor(int descriptor);
+  // Regular files, mapped and sized with the shared memory functions above. A writable file is created or truncated.
+  int openFile(const char *path, int writable);
+  int resizeFile(int descriptor, size_t size);
+  int sendDescriptor(socket_t socket, int descriptor, const void *bytes, size_t length);
+  // Like sendDataNonBlocking, with the descriptor passed along the bytes.
+  int sendDescriptorNonBlocking(socket_t socket, int descriptor, const void *bytes, size_t length);
+  // Returns the bytes received, with descriptor set to -1 when none came along.
+  int recvDescriptor(socket_t socket, int *descriptor, void *bytes, size_t length);
+  // Sleeps while word holds expected, in memory that may be shared with another process. Returns 0 on a timeout.
+  int waitAddress(uint32_t *word, uint32_t expected, int timeoutMs);
+  void wakeAddress(uint32_t *word);
   int sendData(socket_t socket, const void *buf, size_t len, int flags);
+  int sendAll(socket_t socket, const void *buf, size_t len, int flags);
+  int sendDataNonBlocking(socket_t socket, const void *buf, size_t len);
+  int pollWritable(const socket_t *sockets, int *writable, int count, int timeoutMs);
+  int pollReadable(socket_t socket, int timeoutMs);
   int recvData(socket_t socket, void *buf, size_t len, int flags);
   int recvAll(socket_t socket, void *buf, size_t len, int flags);
 
@@ -51,6 +124,19 @@ typedef int socket_t;
 
   int platformGetLastError();
 
+  int setSocketOption(socket_t socket, SocketOption option, int value);
+  int getSocketOption(socket_t socket, SocketOption option, int *value);
+  void sleepMilliseconds(int milliseconds);
+  uint64_t monotonicMilliseconds();
+  uint64_t monotonicMicroseconds();
+
+  int cpuCount();
+  // NUMA node of a CPU, 0 where the platform has no notion of nodes and -1 for an unknown CPU.
+  int cpuNode(int cpu);
+  int pinCurrentThread(int cpu);
+  // CPU whose receive queue last handled packets of a connected socket.
+  int socketIncomingCpu(socket_t socket, int *cpu);
+
   void shutdownRead(socket_t socket);
   void shutdownWrite(socket_t socket);
   void shutdownBoth(socket_t socket);
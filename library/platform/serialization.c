@@ -1,4 +1,61 @@
 #include "serialization.h"
+#include <stdlib.h>
+#include <string.h>
+
+int byteBufferAppend(ByteBuffer *buffer, const void *bytes, size_t length)
+{
+  if (buffer->length + length > buffer->capacity)
+  {
+    size_t capacity = buffer->capacity ? buffer->capacity : 64;
+    while (capacity < buffer->length + length)
+    {
+      capacity *= 2;
+    }
+
+    uint8_t *grown = (uint8_t *)realloc(buffer->bytes, capacity);
+    if (grown == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+    buffer->bytes = grown;
+    buffer->capacity = capacity;
+  }
+
+  memcpy(buffer->bytes + buffer->length, bytes, length);
+  buffer->length += length;
+  return PLATFORM_SUCCESS;
+}
+
+void byteBufferFree(ByteBuffer *buffer)
+{
+  free(buffer->bytes);
+  buffer->bytes = NULL;
+  buffer->length = 0;
+  buffer->capacity = 0;
+}
+
+int reservePayload(ByteBuffer *payload, size_t size)
+{
+  if (payload->capacity > RETAINED_PAYLOAD_SIZE && size < RETAINED_PAYLOAD_SIZE)
+  {
+    byteBufferFree(payload);
+  }
+  if (payload->capacity < size + 1)
+  {
+    // Nothing in the buffer is kept, so there is no point in realloc copying it.
+    byteBufferFree(payload);
+    payload->bytes = (uint8_t *)malloc(size + 1);
+    if (payload->bytes == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+    payload->capacity = size + 1;
+  }
+
+  payload->length = size;
+  payload->bytes[size] = '\0';
+  return PLATFORM_SUCCESS;
+}
 
 int sendInt(socket_t socket, int value)
 {
@@ -36,7 +93,7 @@ int recvInt(socket_t socket, int *out)
     return PLATFORM_FAILURE;
   }
 
-  result = recvData(socket, &size, 4, 0);
+  result = recvAll(socket, &size, 4, 0);
   if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
   {
     return result;
@@ -47,7 +104,7 @@ int recvInt(socket_t socket, int *out)
     return PLATFORM_FAILURE;
   }
 
-  result = recvData(socket, &netValue, 4, 0);
+  result = recvAll(socket, &netValue, 4, 0);
   if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
   {
     return result;
@@ -97,7 +154,7 @@ int recvFloat(socket_t socket, float *out)
     return PLATFORM_FAILURE;
   }
 
-  result = recvData(socket, &size, 4, 0);
+  result = recvAll(socket, &size, 4, 0);
   if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
   {
     return result;
@@ -108,7 +165,7 @@ int recvFloat(socket_t socket, float *out)
     return PLATFORM_FAILURE;
   }
 
-  result = recvData(socket, &netValue, 4, 0);
+  result = recvAll(socket, &netValue, 4, 0);
   if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
   {
     return result;
@@ -160,7 +217,7 @@ int recvString(socket_t socket, char **out)
     return PLATFORM_FAILURE;
   }
 
-  result = recvData(socket, &size, 4, 0);
+  result = recvAll(socket, &size, 4, 0);
   if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
   {
     return result;
@@ -191,21 +248,21 @@ int sendJSON(socket_t socket, const cJSON *json)
 {
   uint8_t type = TYPE_JSON;
   char *str = cJSON_PrintUnformatted(json);
-  uint32_t length = strlen(str);
-  uint32_t size = htonl(length);
-  if (sendData(socket, &type, sizeof(uint8_t), 0) == PLATFORM_FAILURE)
+  if (str == NULL)
   {
     return PLATFORM_FAILURE;
   }
-  if (sendData(socket, &size, sizeof(uint32_t), 0) == PLATFORM_FAILURE)
-  {
-    return PLATFORM_FAILURE;
-  }
-  if (sendData(socket, str, length, 0) == PLATFORM_FAILURE)
+  uint32_t length = strlen(str);
+  uint32_t size = htonl(length);
+  int result = PLATFORM_FAILURE;
+  if (sendData(socket, &type, sizeof(uint8_t), 0) != PLATFORM_FAILURE &&
+      sendData(socket, &size, sizeof(uint32_t), 0) != PLATFORM_FAILURE &&
+      sendData(socket, str, length, 0) != PLATFORM_FAILURE)
   {
-    return PLATFORM_FAILURE;
+    result = PLATFORM_SUCCESS;
   }
-  return PLATFORM_SUCCESS;
+  free(str);
+  return result;
 }
 
 int recvJSON(socket_t socket, cJSON **json)
@@ -225,7 +282,7 @@ int recvJSON(socket_t socket, cJSON **json)
     return PLATFORM_FAILURE;
   }
 
-  result = recvData(socket, &size, 4, 0);
+  result = recvAll(socket, &size, 4, 0);
   if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
   {
     return result;
@@ -257,7 +314,204 @@ int recvJSON(socket_t socket, cJSON **json)
   return PLATFORM_SUCCESS;
 }
 
+int encodeRaw(ByteBuffer *buffer, NetworkedType type, const void *bytes, uint32_t size)
+{
+  uint8_t header[5];
+  uint32_t netSize = htonl(size);
+  header[0] = (uint8_t)type;
+  memcpy(header + 1, &netSize, sizeof(uint32_t));
+
+  size_t start = buffer->length;
+  if (byteBufferAppend(buffer, header, sizeof(header)) == PLATFORM_FAILURE)
+  {
+    return PLATFORM_FAILURE;
+  }
+  if (size > 0 && byteBufferAppend(buffer, bytes, size) == PLATFORM_FAILURE)
+  {
+    buffer->length = start;
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int encodeData(ByteBuffer *buffer, Data data)
+{
+  switch (data.type)
+  {
+  case TYPE_INT:
+  {
+    uint32_t number = htonl(data.data.i);
+    return encodeRaw(buffer, TYPE_INT, &number, sizeof(uint32_t));
+  }
+  case TYPE_FLOAT:
+  {
+    uint32_t number;
+    memcpy(&number, &data.data.f, sizeof(float));
+    number = htonl(number);
+    return encodeRaw(buffer, TYPE_FLOAT, &number, sizeof(uint32_t));
+  }
+  case TYPE_STRING:
+    return encodeRaw(buffer, TYPE_STRING, data.data.s, (uint32_t)strlen(data.data.s));
+  case TYPE_JSON:
+  {
+    char *str = cJSON_PrintUnformatted(data.data.json);
+    if (str == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+    int result = encodeRaw(buffer, TYPE_JSON, str, (uint32_t)strlen(str));
+    cJSON_free(str);
+    return result;
+  }
+  case TYPE_SNAPSHOT:
+  case TYPE_SNAPSHOT_ACK:
+  case TYPE_REQUEST:
+  case TYPE_RESPONSE:
+  case TYPE_HEARTBEAT:
+    return encodeRaw(buffer, data.type, data.data.raw.bytes, data.data.raw.size);
+  default:
+    return PLATFORM_FAILURE;
+  }
+}
+
+int decodeData(const uint8_t *bytes, size_t length, Data *data)
+{
+  uint32_t size;
+  memset(data, 0, sizeof(Data));
+  if (length < 1 + sizeof(uint32_t))
+  {
+    return PLATFORM_FAILURE;
+  }
+  memcpy(&size, bytes + 1, sizeof(uint32_t));
+  size = ntohl(size);
+  if (size != length - 1 - sizeof(uint32_t))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  const uint8_t *payload = bytes + 1 + sizeof(uint32_t);
+  NetworkedType type = (NetworkedType)bytes[0];
+
+  // The type is only set once decoding succeeded, so freeRecvData() is always safe on the result.
+  switch (type)
+  {
+  case TYPE_INT:
+  case TYPE_FLOAT:
+  {
+    uint32_t number;
+    if (size != sizeof(uint32_t))
+    {
+      return PLATFORM_FAILURE;
+    }
+    memcpy(&number, payload, sizeof(uint32_t));
+    number = ntohl(number);
+    if (type == TYPE_INT)
+    {
+      data->data.i = (int)number;
+    }
+    else
+    {
+      memcpy(&data->data.f, &number, sizeof(float));
+    }
+    break;
+  }
+  case TYPE_STRING:
+  {
+    char *str = (char *)malloc(size + 1);
+    if (str == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+    memcpy(str, payload, size);
+    str[size] = '\0';
+    data->data.s = str;
+    break;
+  }
+  case TYPE_JSON:
+    data->data.json = cJSON_ParseWithLength((const char *)payload, size);
+    if (data->data.json == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+    break;
+  default:
+    return PLATFORM_FAILURE;
+  }
+
+  data->type = type;
+  return PLATFORM_SUCCESS;
+}
+
+int decodeFrame(const uint8_t *bytes, size_t length, Data *data)
+{
+  NetworkedType type = length > 0 ? (NetworkedType)bytes[0] : (NetworkedType)0;
+  if (type != TYPE_SNAPSHOT && type != TYPE_SNAPSHOT_ACK && type != TYPE_REQUEST && type != TYPE_RESPONSE && type != TYPE_HEARTBEAT &&
+      type != TYPE_REJECTED)
+  {
+    return decodeData(bytes, length, data);
+  }
+
+  uint32_t size;
+  memset(data, 0, sizeof(Data));
+  if (length < 1 + sizeof(uint32_t))
+  {
+    return PLATFORM_FAILURE;
+  }
+  memcpy(&size, bytes + 1, sizeof(uint32_t));
+  size = ntohl(size);
+  if (size != length - 1 - sizeof(uint32_t))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  const uint8_t *payload = bytes + 1 + sizeof(uint32_t);
+  if (type == TYPE_REJECTED)
+  {
+    uint32_t reason;
+    if (size != sizeof(uint32_t))
+    {
+      return PLATFORM_FAILURE;
+    }
+    memcpy(&reason, payload, sizeof(uint32_t));
+    data->data.i = (int)ntohl(reason);
+  }
+  else
+  {
+    uint8_t *copy = (uint8_t *)malloc(size > 0 ? size : 1);
+    if (copy == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+    memcpy(copy, payload, size);
+    data->data.raw.bytes = copy;
+    data->data.raw.size = size;
+  }
+
+  data->type = type;
+  return PLATFORM_SUCCESS;
+}
+
+int sendRaw(socket_t socket, NetworkedType type, const void *bytes, uint32_t size)
+{
+  ByteBuffer frame = {0};
+  if (encodeRaw(&frame, type, bytes, size) == PLATFORM_FAILURE)
+  {
+    byteBufferFree(&frame);
+    return PLATFORM_FAILURE;
+  }
+
+  int result = sendAll(socket, frame.bytes, frame.length, 0);
+  byteBufferFree(&frame);
+  return result;
+}
+
 int recvAny(socket_t socket, Data *data)
+{
+  size_t frameLength;
+  return recvAnyFrame(socket, data, &frameLength, NULL);
+}
+
+int recvAnyFrame(socket_t socket, Data *data, size_t *frameLength, uint64_t *startedAt)
 {
   uint8_t rawType;
   int result = recvData(socket, &rawType, 1, 0);
@@ -266,12 +520,24 @@ int recvAny(socket_t socket, Data *data)
   {
     return result;
   }
+  if (startedAt)
+  {
+    *startedAt = monotonicMicroseconds();
+  }
+  return recvFrameBody(socket, data->type, data, frameLength);
+}
 
-  if (data->type == TYPE_INT)
+int recvFrameBody(socket_t socket, NetworkedType type, Data *data, size_t *frameLength)
+{
+  int result;
+  data->type = type;
+
+  // A rejection carries its reason as an int.
+  if (data->type == TYPE_INT || data->type == TYPE_REJECTED)
   {
     uint32_t size, netValue;
 
-    result = recvData(socket, &size, 4, 0);
+    result = recvAll(socket, &size, 4, 0);
     if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
     {
       return result;
@@ -281,8 +547,9 @@ int recvAny(socket_t socket, Data *data)
     {
       return PLATFORM_FAILURE;
     }
+    *frameLength = 1 + sizeof(uint32_t) + sizeof(uint32_t);
 
-    result = recvData(socket, &netValue, 4, 0);
+    result = recvAll(socket, &netValue, 4, 0);
     if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
     {
       return result;
@@ -296,7 +563,7 @@ int recvAny(socket_t socket, Data *data)
   {
     uint32_t size, netValue;
 
-    result = recvData(socket, &size, 4, 0);
+    result = recvAll(socket, &size, 4, 0);
     if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
     {
       return result;
@@ -306,8 +573,9 @@ int recvAny(socket_t socket, Data *data)
     {
       return PLATFORM_FAILURE;
     }
+    *frameLength = 1 + sizeof(uint32_t) + sizeof(float);
 
-    result = recvData(socket, &netValue, 4, 0);
+    result = recvAll(socket, &netValue, 4, 0);
     if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
     {
       return result;
@@ -321,12 +589,13 @@ int recvAny(socket_t socket, Data *data)
   {
     uint32_t size;
 
-    result = recvData(socket, &size, 4, 0);
+    result = recvAll(socket, &size, 4, 0);
     if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
     {
       return result;
     }
     size = ntohl(size);
+    *frameLength = 1 + sizeof(uint32_t) + size;
 
     char *buf = (char *)malloc(size + 1);
     if (buf == NULL)
@@ -350,12 +619,13 @@ int recvAny(socket_t socket, Data *data)
   {
     uint32_t size;
 
-    result = recvData(socket, &size, 4, 0);
+    result = recvAll(socket, &size, 4, 0);
     if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
     {
       return result;
     }
     size = ntohl(size);
+    *frameLength = 1 + sizeof(uint32_t) + size;
 
     char *buf = (char *)malloc(size + 1);
     if (buf == NULL)
@@ -381,9 +651,78 @@ int recvAny(socket_t socket, Data *data)
     return PLATFORM_SUCCESS;
   }
 
+  if (data->type == TYPE_SNAPSHOT || data->type == TYPE_SNAPSHOT_ACK || data->type == TYPE_REQUEST || data->type == TYPE_RESPONSE ||
+      data->type == TYPE_HEARTBEAT)
+  {
+    uint32_t size;
+
+    result = recvAll(socket, &size, 4, 0);
+    if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
+    {
+      return result;
+    }
+    size = ntohl(size);
+    *frameLength = 1 + sizeof(uint32_t) + size;
+
+    uint8_t *buf = (uint8_t *)malloc(size > 0 ? size : 1);
+    if (buf == NULL)
+    {
+      return PLATFORM_FAILURE;
+    }
+
+    if (size > 0)
+    {
+      result = recvAll(socket, buf, size, 0);
+      if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
+      {
+        free(buf);
+        return result;
+      }
+    }
+
+    data->data.raw.bytes = buf;
+    data->data.raw.size = size;
+    return PLATFORM_SUCCESS;
+  }
+
   return PLATFORM_FAILURE;
 }
 
+int recvFrameView(socket_t socket, NetworkedType type, ByteBuffer *payload, Data *data, size_t *frameLength)
+{
+  if (type != TYPE_STRING && type != TYPE_JSON)
+  {
+    return recvFrameBody(socket, type, data, frameLength);
+  }
+
+  uint32_t size;
+  data->type = type;
+  int result = recvAll(socket, &size, 4, 0);
+  if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
+  {
+    return result;
+  }
+  size = ntohl(size);
+  *frameLength = 1 + sizeof(uint32_t) + size;
+
+  if (reservePayload(payload, size) != PLATFORM_SUCCESS)
+  {
+    return PLATFORM_FAILURE;
+  }
+  if (size > 0)
+  {
+    result = recvAll(socket, payload->bytes, size, 0);
+    if (result == PLATFORM_CONNECTION_CLOSED || result == PLATFORM_FAILURE)
+    {
+      return result;
+    }
+  }
+
+  data->data.raw.bytes = payload->bytes;
+  data->data.raw.size = size;
+  return PLATFORM_SUCCESS;
+}
+
 int sendIntTo(socket_t socket, struct sockaddr_in *peerAddr, int value)
 {
   uint8_t type = TYPE_INT;
@@ -574,21 +913,21 @@ int sendJSONTo(socket_t socket, struct sockaddr_in *peerAddr, const cJSON *json)
 {
   uint8_t type = TYPE_JSON;
   char *str = cJSON_PrintUnformatted(json);
-  uint32_t length = strlen(str);
-  uint32_t size = htonl(length);
-  if (sendDataTo(socket, &type, sizeof(uint8_t), 0, peerAddr) == PLATFORM_FAILURE)
-  {
-    return PLATFORM_FAILURE;
-  }
-  if (sendDataTo(socket, &size, sizeof(uint32_t), 0, peerAddr) == PLATFORM_FAILURE)
+  if (str == NULL)
   {
     return PLATFORM_FAILURE;
   }
-  if (sendDataTo(socket, str, length, 0, peerAddr) == PLATFORM_FAILURE)
+  uint32_t length = strlen(str);
+  uint32_t size = htonl(length);
+  int result = PLATFORM_FAILURE;
+  if (sendDataTo(socket, &type, sizeof(uint8_t), 0, peerAddr) != PLATFORM_FAILURE &&
+      sendDataTo(socket, &size, sizeof(uint32_t), 0, peerAddr) != PLATFORM_FAILURE &&
+      sendDataTo(socket, str, length, 0, peerAddr) != PLATFORM_FAILURE)
   {
-    return PLATFORM_FAILURE;
+    result = PLATFORM_SUCCESS;
   }
-  return PLATFORM_SUCCESS;
+  free(str);
+  return result;
 }
 
 int recvJSONFrom(socket_t socket, struct sockaddr_in *peerAddr, cJSON **json)
@@ -777,6 +1116,13 @@ void freeRecvData(Data *data)
   case TYPE_JSON:
     cJSON_Delete(data->data.json);
     break;
+  case TYPE_SNAPSHOT:
+  case TYPE_SNAPSHOT_ACK:
+  case TYPE_REQUEST:
+  case TYPE_RESPONSE:
+  case TYPE_HEARTBEAT:
+    free(data->data.raw.bytes);
+    break;
   default:
     break;
   }
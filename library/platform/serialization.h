@@ -9,6 +9,9 @@ extern "C"
 #include "platform.h"
 #include "cJSON.h"
 
+// A receive buffer grown past this by one large message is given back once smaller ones follow.
+#define RETAINED_PAYLOAD_SIZE (1024 * 1024)
+
   typedef enum
   {
     TYPE_INT = 1,
@@ -16,7 +19,14 @@ extern "C"
     TYPE_STRING = 3,
     TYPE_JSON = 4,
     TYPE_CONNECTED = 5,
-    TYPE_DISCONNECTED = 6
+    TYPE_DISCONNECTED = 6,
+    TYPE_SNAPSHOT = 7,
+    TYPE_SNAPSHOT_ACK = 8,
+    TYPE_REQUEST = 9,
+    TYPE_RESPONSE = 10,
+    TYPE_HEARTBEAT = 11,
+    TYPE_REJECTED = 12,
+    TYPE_HANDOFF = 13
   } NetworkedType;
 
   typedef struct
@@ -28,9 +38,27 @@ extern "C"
       float f;
       char *s;
       cJSON *json;
+      struct
+      {
+        uint8_t *bytes;
+        uint32_t size;
+      } raw;
     } data;
   } Data;
 
+  typedef struct
+  {
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+  } ByteBuffer;
+
+  int byteBufferAppend(ByteBuffer *buffer, const void *bytes, size_t length);
+  void byteBufferFree(ByteBuffer *buffer);
+  // Makes payload hold size bytes followed by a terminating zero, reusing its allocation when it is large enough.
+  // The previous contents are not kept.
+  int reservePayload(ByteBuffer *payload, size_t size);
+
   int sendInt(socket_t socket, int value);
   int recvInt(socket_t socket, int *out);
 
@@ -43,7 +71,23 @@ extern "C"
   int sendJSON(socket_t socket, const cJSON *json);
   int recvJSON(socket_t socket, cJSON **json);
 
+  int encodeRaw(ByteBuffer *buffer, NetworkedType type, const void *bytes, uint32_t size);
+  int encodeData(ByteBuffer *buffer, Data data);
+  int decodeData(const uint8_t *bytes, size_t length, Data *data);
+  // Like decodeData, and also takes every type recvAnyFrame does, for streams read other than from a socket.
+  int decodeFrame(const uint8_t *bytes, size_t length, Data *data);
+
+  int sendRaw(socket_t socket, NetworkedType type, const void *bytes, uint32_t size);
+
   int recvAny(socket_t socket, Data *data);
+  // Like recvAny, and also reports the size of the frame on the wire and, unless startedAt is NULL, when its first
+  // byte was read.
+  int recvAnyFrame(socket_t socket, Data *data, size_t *frameLength, uint64_t *startedAt);
+  // The rest of a frame whose type byte was already read.
+  int recvFrameBody(socket_t socket, NetworkedType type, Data *data, size_t *frameLength);
+  // Like recvFrameBody, except that the text of a string or JSON frame is left undecoded in payload, which is reused
+  // from frame to frame. data->data.raw then points into payload and must not be freed.
+  int recvFrameView(socket_t socket, NetworkedType type, ByteBuffer *payload, Data *data, size_t *frameLength);
 
   int sendIntTo(socket_t socket, struct sockaddr_in *peerAddr, int value);
   int recvIntFrom(socket_t socket, struct sockaddr_in *peerAddr, int *out);
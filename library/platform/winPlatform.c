@@ -2,6 +2,8 @@
 
 #ifdef PLATFORM_WINDOWS
 
+#include <afunix.h>
+
 struct sockaddr_in createSockaddrIn(int port, const char *ipAddress)
 {
   struct sockaddr_in addr;
@@ -77,6 +79,38 @@ socket_t acceptSocket(socket_t socket, struct sockaddr *addr, socklen_t *addrlen
   return clientSocket;
 }
 
+int acceptPending(socket_t socket, socket_t *client, struct sockaddr *addr, socklen_t *addrlen)
+{
+  socket_t clientSocket = accept(socket, addr, addrlen);
+  if (clientSocket == INVALID_SOCKET)
+  {
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAECONNRESET ? 0 : PLATFORM_FAILURE;
+  }
+
+  // Accepted sockets inherit the non-blocking mode of the listening socket. Winsock has no close-on-exec flag.
+  *client = clientSocket;
+  return PLATFORM_SUCCESS;
+}
+
+int setSocketBlocking(socket_t socket, int blocking)
+{
+  u_long mode = blocking ? 0 : 1;
+  if (ioctlsocket(socket, FIONBIO, &mode) == SOCKET_ERROR)
+  {
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int getAcceptQueue(socket_t socket, int *depth, int *limit)
+{
+  // Winsock does not report the accept queue.
+  *depth = 0;
+  *limit = 0;
+  return PLATFORM_FAILURE;
+}
+
 int connectSocket(socket_t socket, const struct sockaddr *addr, socklen_t addrlen)
 {
   if (connect(socket, addr, addrlen) == SOCKET_ERROR)
@@ -87,6 +121,118 @@ int connectSocket(socket_t socket, const struct sockaddr *addr, socklen_t addrle
   return PLATFORM_SUCCESS;
 }
 
+socket_t createLocalSocket()
+{
+  socket_t sock_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock_fd == INVALID_SOCKET)
+  {
+    return PLATFORM_FAILURE;
+  }
+  return sock_fd;
+}
+
+// Windows has no abstract namespace, so the socket is a file in the temporary directory.
+static void localAddress(int port, struct sockaddr_un *addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  char directory[MAX_PATH];
+  DWORD length = GetTempPathA(sizeof(directory), directory);
+  snprintf(addr->sun_path, sizeof(addr->sun_path), "%snex.%d.sock", length > 0 && length < sizeof(directory) ? directory : "", port);
+}
+
+int bindLocalSocket(socket_t socket, int port)
+{
+  struct sockaddr_un addr;
+  localAddress(port, &addr);
+  // A server that exited leaves its socket file behind, which would make the bind fail.
+  DeleteFileA(addr.sun_path);
+  return bindSocket(socket, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+int connectLocalSocket(socket_t socket, int port)
+{
+  struct sockaddr_un addr;
+  localAddress(port, &addr);
+  return connectSocket(socket, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+// Winsock cannot pass handles between processes and WaitOnAddress only works within one, so there is no shared
+// memory transport on Windows.
+int createSharedMemory(size_t size)
+{
+  return PLATFORM_FAILURE;
+}
+
+int sharedMemorySize(int descriptor, size_t *size)
+{
+  return PLATFORM_FAILURE;
+}
+
+void *mapSharedMemory(int descriptor, size_t size, int writable)
+{
+  return NULL;
+}
+
+int sealSharedMemory(int descriptor)
+{
+  return PLATFORM_FAILURE;
+}
+
+int sharedMemorySealed(int descriptor)
+{
+  return PLATFORM_FAILURE;
+}
+
+int writeSharedMemory(int descriptor, size_t offset, const void *bytes, size_t length)
+{
+  return PLATFORM_FAILURE;
+}
+
+void unmapSharedMemory(void *memory, size_t size)
+{
+}
+
+void closeDescriptor(int descriptor)
+{
+}
+
+int openFile(const char *path, int writable)
+{
+  return PLATFORM_FAILURE;
+}
+
+int resizeFile(int descriptor, size_t size)
+{
+  return PLATFORM_FAILURE;
+}
+
+int sendDescriptor(socket_t socket, int descriptor, const void *bytes, size_t length)
+{
+  return PLATFORM_FAILURE;
+}
+
+int sendDescriptorNonBlocking(socket_t socket, int descriptor, const void *bytes, size_t length)
+{
+  return PLATFORM_FAILURE;
+}
+
+int recvDescriptor(socket_t socket, int *descriptor, void *bytes, size_t length)
+{
+  *descriptor = -1;
+  return PLATFORM_FAILURE;
+}
+
+int waitAddress(uint32_t *word, uint32_t expected, int timeoutMs)
+{
+  sleepMilliseconds(timeoutMs);
+  return 0;
+}
+
+void wakeAddress(uint32_t *word)
+{
+}
+
 int sendData(socket_t socket, const void *buf, size_t len, int flags)
 {
   if (socket == INVALID_SOCKET)
@@ -102,6 +248,112 @@ int sendData(socket_t socket, const void *buf, size_t len, int flags)
   return PLATFORM_SUCCESS;
 }
 
+int sendAll(socket_t socket, const void *buf, size_t len, int flags)
+{
+  if (socket == INVALID_SOCKET)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  size_t totalSent = 0;
+  const char *buffer = (const char *)buf;
+
+  while (totalSent < len)
+  {
+    int bytesSent = send(socket, buffer + totalSent, (int)(len - totalSent), flags);
+    if (bytesSent == SOCKET_ERROR)
+    {
+      printf("Send failed to socket %d. Error: %d\n", socket, WSAGetLastError());
+      return PLATFORM_FAILURE;
+    }
+    totalSent += bytesSent;
+  }
+
+  return PLATFORM_SUCCESS;
+}
+
+int sendDataNonBlocking(socket_t socket, const void *buf, size_t len)
+{
+  if (socket == INVALID_SOCKET)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  // Winsock has no per call MSG_DONTWAIT, so only send once the socket reports writable.
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(socket, &writeSet);
+  struct timeval timeout = {0, 0};
+  int ready = select(0, NULL, &writeSet, NULL, &timeout);
+  if (ready == SOCKET_ERROR)
+  {
+    printf("select failed on socket %d. Error: %d\n", socket, WSAGetLastError());
+    return PLATFORM_FAILURE;
+  }
+  if (ready == 0)
+  {
+    return 0;
+  }
+
+  int bytesSent = send(socket, (const char *)buf, (int)len, 0);
+  if (bytesSent == SOCKET_ERROR)
+  {
+    if (WSAGetLastError() == WSAEWOULDBLOCK)
+    {
+      return 0;
+    }
+    printf("Send failed to socket %d. Error: %d\n", socket, WSAGetLastError());
+    return PLATFORM_FAILURE;
+  }
+  return bytesSent;
+}
+
+int pollWritable(const socket_t *sockets, int *writable, int count, int timeoutMs)
+{
+  WSAPOLLFD *fds = (WSAPOLLFD *)malloc(count * sizeof(WSAPOLLFD));
+  if (fds == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    fds[i].fd = sockets[i];
+    fds[i].events = POLLWRNORM;
+    fds[i].revents = 0;
+  }
+
+  int ready = count > 0 ? WSAPoll(fds, count, timeoutMs) : (Sleep(timeoutMs), 0);
+  for (int i = 0; i < count; i++)
+  {
+    writable[i] = ready > 0 && (fds[i].revents & (POLLWRNORM | POLLERR | POLLHUP)) != 0;
+  }
+  free(fds);
+
+  if (ready == SOCKET_ERROR)
+  {
+    printf("WSAPoll failed. Error: %d\n", WSAGetLastError());
+    return PLATFORM_FAILURE;
+  }
+  return ready;
+}
+
+int pollReadable(socket_t sock, int timeoutMs)
+{
+  WSAPOLLFD fd;
+  fd.fd = sock;
+  fd.events = POLLRDNORM;
+  fd.revents = 0;
+
+  int ready = WSAPoll(&fd, 1, timeoutMs);
+  if (ready == SOCKET_ERROR)
+  {
+    printf("WSAPoll failed. Error: %d\n", WSAGetLastError());
+    return PLATFORM_FAILURE;
+  }
+  return ready > 0 ? PLATFORM_SUCCESS : 0;
+}
+
 int recvData(socket_t socket, void *buf, size_t len, int flags)
 {
   if (socket == INVALID_SOCKET)
@@ -178,6 +430,120 @@ int platformGetLastError()
   return WSAGetLastError();
 }
 
+static int socketOptionName(SocketOption option, int *level, int *name)
+{
+  switch (option)
+  {
+  case SOCKET_OPTION_SEND_BUFFER:
+    *level = SOL_SOCKET;
+    *name = SO_SNDBUF;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_RECEIVE_BUFFER:
+    *level = SOL_SOCKET;
+    *name = SO_RCVBUF;
+    return PLATFORM_SUCCESS;
+  case SOCKET_OPTION_NO_DELAY:
+    *level = IPPROTO_TCP;
+    *name = TCP_NODELAY;
+    return PLATFORM_SUCCESS;
+  default:
+    // TCP_CORK, SO_BUSY_POLL, TCP_QUICKACK and SO_PRIORITY have no Winsock equivalent.
+    return PLATFORM_FAILURE;
+  }
+}
+
+int setSocketOption(socket_t socket, SocketOption option, int value)
+{
+  int level, name;
+  if (socketOptionName(option, &level, &name) == PLATFORM_FAILURE)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  if (setsockopt(socket, level, name, (const char *)&value, sizeof(value)) == SOCKET_ERROR)
+  {
+    printf("setsockopt failed. Error: %d\n", WSAGetLastError());
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int getSocketOption(socket_t socket, SocketOption option, int *value)
+{
+  int level, name;
+  if (socketOptionName(option, &level, &name) == PLATFORM_FAILURE)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  int length = sizeof(*value);
+  *value = 0;
+  if (getsockopt(socket, level, name, (char *)value, &length) == SOCKET_ERROR)
+  {
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+void sleepMilliseconds(int milliseconds)
+{
+  Sleep(milliseconds);
+}
+
+uint64_t monotonicMilliseconds()
+{
+  return GetTickCount64();
+}
+
+uint64_t monotonicMicroseconds()
+{
+  static LARGE_INTEGER frequency;
+  if (frequency.QuadPart == 0)
+  {
+    QueryPerformanceFrequency(&frequency);
+  }
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return (uint64_t)(now.QuadPart / frequency.QuadPart) * 1000000 + (uint64_t)(now.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+int cpuCount()
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+}
+
+int cpuNode(int cpu)
+{
+  UCHAR node;
+  if (cpu < 0 || cpu > 255 || !GetNumaProcessorNode((UCHAR)cpu, &node) || node == 0xFF)
+  {
+    return -1;
+  }
+  return node;
+}
+
+int pinCurrentThread(int cpu)
+{
+  if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8))
+  {
+    return PLATFORM_FAILURE;
+  }
+  if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) == 0)
+  {
+    return PLATFORM_FAILURE;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int socketIncomingCpu(socket_t socket, int *cpu)
+{
+  // Winsock has no SO_INCOMING_CPU.
+  return PLATFORM_FAILURE;
+}
+
 void shutdownRead(socket_t socket)
 {
   shutdown(socket, SD_RECEIVE);
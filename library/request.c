@@ -0,0 +1,279 @@
+#include "request.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define REQUEST_INITIAL_CAPACITY 16
+
+RequestTable *createRequestTable(TimerWheel *timers)
+{
+  RequestTable *table = (RequestTable *)calloc(1, sizeof(RequestTable));
+  if (table == NULL)
+  {
+    return NULL;
+  }
+
+  table->entries = (PendingRequest *)calloc(REQUEST_INITIAL_CAPACITY, sizeof(PendingRequest));
+  if (table->entries == NULL || pthread_mutex_init(&table->lock, NULL) != 0)
+  {
+    free(table->entries);
+    free(table);
+    return NULL;
+  }
+
+  table->capacity = REQUEST_INITIAL_CAPACITY;
+  table->timers = timers;
+  return table;
+}
+
+void destroyRequestTable(RequestTable *table)
+{
+  if (table == NULL)
+  {
+    return;
+  }
+
+  for (uint32_t i = 0; i < table->capacity; i++)
+  {
+    if (table->entries[i].id != 0)
+    {
+      cancelTimer(table->timers, table->entries[i].timer);
+    }
+  }
+  free(table->entries);
+  pthread_mutex_destroy(&table->lock);
+  free(table);
+}
+
+static uint32_t slotFor(const RequestTable *table, uint32_t id)
+{
+  return (id * 2654435761u) & (table->capacity - 1);
+}
+
+static void insertEntry(RequestTable *table, const PendingRequest *request)
+{
+  uint32_t slot = slotFor(table, request->id);
+  while (table->entries[slot].id != 0)
+  {
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+  table->entries[slot] = *request;
+  table->count++;
+}
+
+static int grow(RequestTable *table)
+{
+  PendingRequest *old = table->entries;
+  uint32_t oldCapacity = table->capacity;
+
+  PendingRequest *entries = (PendingRequest *)calloc(oldCapacity * 2, sizeof(PendingRequest));
+  if (entries == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  table->entries = entries;
+  table->capacity = oldCapacity * 2;
+  table->count = 0;
+  for (uint32_t i = 0; i < oldCapacity; i++)
+  {
+    if (old[i].id != 0)
+    {
+      insertEntry(table, &old[i]);
+    }
+  }
+  free(old);
+  return PLATFORM_SUCCESS;
+}
+
+static int findSlot(const RequestTable *table, uint32_t id)
+{
+  uint32_t slot = slotFor(table, id);
+  while (table->entries[slot].id != 0)
+  {
+    if (table->entries[slot].id == id)
+    {
+      return (int)slot;
+    }
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+  return -1;
+}
+
+// Backward shift deletion keeps probe sequences intact without tombstones.
+static void removeSlot(RequestTable *table, uint32_t slot)
+{
+  uint32_t mask = table->capacity - 1;
+  uint32_t hole = slot;
+  uint32_t next = (slot + 1) & mask;
+
+  while (table->entries[next].id != 0)
+  {
+    uint32_t home = slotFor(table, table->entries[next].id);
+    if (((next - home) & mask) >= ((next - hole) & mask))
+    {
+      table->entries[hole] = table->entries[next];
+      hole = next;
+    }
+    next = (next + 1) & mask;
+  }
+
+  memset(&table->entries[hole], 0, sizeof(PendingRequest));
+  table->count--;
+}
+
+int addPendingRequest(RequestTable *table, uint64_t deadline, void (*onResponse)(RequestStatus, Data, void *), void *userData, uint32_t *id)
+{
+  pthread_mutex_lock(&table->lock);
+
+  if ((table->count + 1) * 4 > table->capacity * 3 && grow(table) == PLATFORM_FAILURE)
+  {
+    pthread_mutex_unlock(&table->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  PendingRequest request;
+  do
+  {
+    request.id = ++table->nextId;
+  } while (request.id == 0 || findSlot(table, request.id) >= 0);
+
+  request.timer = 0;
+  if (deadline != 0 && addTimer(table->timers, deadline, TIMER_REQUEST_DEADLINE, table, request.id, &request.timer) == PLATFORM_FAILURE)
+  {
+    pthread_mutex_unlock(&table->lock);
+    return PLATFORM_FAILURE;
+  }
+  request.onResponse = onResponse;
+  request.userData = userData;
+  insertEntry(table, &request);
+  *id = request.id;
+
+  pthread_mutex_unlock(&table->lock);
+  return PLATFORM_SUCCESS;
+}
+
+int takePendingRequest(RequestTable *table, uint32_t id, PendingRequest *request)
+{
+  pthread_mutex_lock(&table->lock);
+
+  int slot = id != 0 ? findSlot(table, id) : -1;
+  if (slot < 0)
+  {
+    pthread_mutex_unlock(&table->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  *request = table->entries[slot];
+  removeSlot(table, (uint32_t)slot);
+  cancelTimer(table->timers, request->timer);
+
+  pthread_mutex_unlock(&table->lock);
+  return PLATFORM_SUCCESS;
+}
+
+void cancelPendingRequests(RequestTable *table, RequestStatus status)
+{
+  if (table == NULL)
+  {
+    return;
+  }
+
+  ByteBuffer cancelled = {0};
+  pthread_mutex_lock(&table->lock);
+  for (uint32_t i = 0; i < table->capacity; i++)
+  {
+    if (table->entries[i].id != 0)
+    {
+      cancelTimer(table->timers, table->entries[i].timer);
+      byteBufferAppend(&cancelled, &table->entries[i], sizeof(PendingRequest));
+    }
+  }
+  memset(table->entries, 0, table->capacity * sizeof(PendingRequest));
+  table->count = 0;
+  pthread_mutex_unlock(&table->lock);
+
+  Data empty;
+  memset(&empty, 0, sizeof(Data));
+  PendingRequest *requests = (PendingRequest *)cancelled.bytes;
+  for (size_t i = 0; i < cancelled.length / sizeof(PendingRequest); i++)
+  {
+    requests[i].onResponse(status, empty, requests[i].userData);
+  }
+  byteBufferFree(&cancelled);
+}
+
+int encodeRequest(ByteBuffer *frame, uint32_t id, Data data)
+{
+  ByteBuffer payload = {0};
+  uint32_t netId = htonl(id);
+
+  int result = byteBufferAppend(&payload, &netId, sizeof(uint32_t));
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = encodeData(&payload, data);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = encodeRaw(frame, TYPE_REQUEST, payload.bytes, (uint32_t)payload.length);
+  }
+
+  byteBufferFree(&payload);
+  return result;
+}
+
+int encodeResponse(ByteBuffer *frame, uint32_t id, RequestStatus status, Data data)
+{
+  ByteBuffer payload = {0};
+  uint32_t netId = htonl(id);
+  uint8_t netStatus = (uint8_t)status;
+
+  int result = byteBufferAppend(&payload, &netId, sizeof(uint32_t));
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = byteBufferAppend(&payload, &netStatus, sizeof(uint8_t));
+  }
+  if (result == PLATFORM_SUCCESS && status == REQUEST_OK)
+  {
+    result = encodeData(&payload, data);
+  }
+  if (result == PLATFORM_SUCCESS)
+  {
+    result = encodeRaw(frame, TYPE_RESPONSE, payload.bytes, (uint32_t)payload.length);
+  }
+
+  byteBufferFree(&payload);
+  return result;
+}
+
+int decodeRequest(const Data *frame, uint32_t *id, Data *data)
+{
+  memset(data, 0, sizeof(Data));
+  if (frame->data.raw.size < sizeof(uint32_t))
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  memcpy(id, frame->data.raw.bytes, sizeof(uint32_t));
+  *id = ntohl(*id);
+  return decodeData(frame->data.raw.bytes + sizeof(uint32_t), frame->data.raw.size - sizeof(uint32_t), data);
+}
+
+int decodeResponse(const Data *frame, uint32_t *id, RequestStatus *status, Data *data)
+{
+  const size_t headerSize = sizeof(uint32_t) + sizeof(uint8_t);
+  memset(data, 0, sizeof(Data));
+  if (frame->data.raw.size < headerSize)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  memcpy(id, frame->data.raw.bytes, sizeof(uint32_t));
+  *id = ntohl(*id);
+  *status = (RequestStatus)frame->data.raw.bytes[sizeof(uint32_t)];
+
+  if (*status != REQUEST_OK)
+  {
+    return PLATFORM_SUCCESS;
+  }
+  return decodeData(frame->data.raw.bytes + headerSize, frame->data.raw.size - headerSize, data);
+}
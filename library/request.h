@@ -0,0 +1,47 @@
+#ifndef REQUEST_H
+#define REQUEST_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <pthread.h>
+#include "nex.h"
+#include "timer.h"
+
+  typedef struct
+  {
+    uint32_t id;
+    TimerId timer;
+    void (*onResponse)(RequestStatus, Data, void *);
+    void *userData;
+  } PendingRequest;
+
+  // Open addressing table of in flight requests keyed by correlation id. Id 0 marks an empty slot.
+  typedef struct
+  {
+    PendingRequest *entries;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t nextId;
+    TimerWheel *timers;
+    pthread_mutex_t lock;
+  } RequestTable;
+
+  // Deadlines are armed on timers, firing a TIMER_REQUEST_DEADLINE event with the table as owner and the id as value.
+  RequestTable *createRequestTable(TimerWheel *timers);
+  void destroyRequestTable(RequestTable *table);
+
+  int addPendingRequest(RequestTable *table, uint64_t deadline, void (*onResponse)(RequestStatus, Data, void *), void *userData, uint32_t *id);
+  int takePendingRequest(RequestTable *table, uint32_t id, PendingRequest *request);
+  void cancelPendingRequests(RequestTable *table, RequestStatus status);
+
+  int encodeRequest(ByteBuffer *frame, uint32_t id, Data data);
+  int encodeResponse(ByteBuffer *frame, uint32_t id, RequestStatus status, Data data);
+  int decodeRequest(const Data *frame, uint32_t *id, Data *data);
+  int decodeResponse(const Data *frame, uint32_t *id, RequestStatus *status, Data *data);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,316 @@
+#include "sharedRing.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_HEADER_SIZE 5
+
+static size_t segmentSize(size_t capacity)
+{
+  return 2 * (sizeof(SharedRing) + capacity);
+}
+
+// The server sends through the first ring of the segment and the client through the second.
+static SharedLink *mapLink(socket_t socket, int descriptor, size_t capacity, int server)
+{
+  SharedLink *link = (SharedLink *)calloc(1, sizeof(SharedLink));
+  if (link == NULL)
+  {
+    return NULL;
+  }
+
+  link->size = segmentSize(capacity);
+  link->memory = (uint8_t *)mapSharedMemory(descriptor, link->size, 1);
+  if (link->memory == NULL)
+  {
+    free(link);
+    return NULL;
+  }
+
+  SharedRing *first = (SharedRing *)link->memory;
+  SharedRing *second = (SharedRing *)(link->memory + sizeof(SharedRing) + capacity);
+  link->socket = socket;
+  link->capacity = capacity;
+  link->send = server ? first : second;
+  link->receive = server ? second : first;
+  return link;
+}
+
+SharedLink *offerSharedLink(socket_t socket)
+{
+  int descriptor = createSharedMemory(segmentSize(SHARED_RING_CAPACITY));
+  if (descriptor == PLATFORM_FAILURE)
+  {
+    return NULL;
+  }
+
+  // A new segment is zero filled, which already is an empty, open ring in both directions.
+  SharedLink *link = mapLink(socket, descriptor, SHARED_RING_CAPACITY, 1);
+  uint32_t netCapacity = htonl(SHARED_RING_CAPACITY);
+  if (link && sendDescriptor(socket, descriptor, &netCapacity, sizeof(netCapacity)) != PLATFORM_SUCCESS)
+  {
+    destroySharedLink(link);
+    link = NULL;
+  }
+  closeDescriptor(descriptor);
+  return link;
+}
+
+SharedLink *acceptSharedLink(socket_t socket, int timeoutMs)
+{
+  if (pollReadable(socket, timeoutMs) != PLATFORM_SUCCESS)
+  {
+    return NULL;
+  }
+
+  uint32_t netCapacity = 0;
+  int descriptor;
+  int received = recvDescriptor(socket, &descriptor, &netCapacity, sizeof(netCapacity));
+  size_t capacity = ntohl(netCapacity);
+  size_t size = 0;
+
+  // A rejection frame comes without a descriptor.
+  SharedLink *link = NULL;
+  if (received == sizeof(netCapacity) && descriptor >= 0 && capacity > 0 && capacity <= SHARED_RING_MAX_CAPACITY && (capacity & (capacity - 1)) == 0 &&
+      sharedMemorySize(descriptor, &size) == PLATFORM_SUCCESS && size == segmentSize(capacity))
+  {
+    link = mapLink(socket, descriptor, capacity, 0);
+  }
+  closeDescriptor(descriptor);
+  return link;
+}
+
+static void wakeRing(SharedRing *ring)
+{
+  ATOMIC_ADD(&ring->dataSignal, 1);
+  wakeAddress(&ring->dataSignal);
+  ATOMIC_ADD(&ring->spaceSignal, 1);
+  wakeAddress(&ring->spaceSignal);
+}
+
+void closeSharedLink(SharedLink *link)
+{
+  if (link == NULL)
+  {
+    return;
+  }
+
+  ATOMIC_STORE_RELEASE(&link->send->closed, 1);
+  ATOMIC_STORE_RELEASE(&link->receive->closed, 1);
+  wakeRing(link->send);
+  wakeRing(link->receive);
+}
+
+void destroySharedLink(SharedLink *link)
+{
+  if (link == NULL)
+  {
+    return;
+  }
+
+  unmapSharedMemory(link->memory, link->size);
+  byteBufferFree(&link->frame);
+  free(link);
+}
+
+// Wakes the other side if it sleeps on signal. The fence orders the position just published before the flag is read,
+// pairing with the one in waitForChange.
+static void signalPeer(uint32_t *signal, uint64_t *waiting)
+{
+  ATOMIC_FENCE();
+  if (ATOMIC_LOAD(waiting))
+  {
+    ATOMIC_ADD(signal, 1);
+    wakeAddress(signal);
+  }
+}
+
+// Waits for the other side to move position away from seen: the head for a reader, the tail for a writer.
+static int waitForChange(SharedLink *link, SharedRing *ring, uint64_t *position, uint64_t seen, uint32_t *signal, uint64_t *waiting)
+{
+  for (int spin = 0;; spin++)
+  {
+    if (ATOMIC_LOAD_ACQUIRE(position) != seen)
+    {
+      return PLATFORM_SUCCESS;
+    }
+    if (ATOMIC_LOAD_ACQUIRE(&ring->closed))
+    {
+      return PLATFORM_CONNECTION_CLOSED;
+    }
+    if (spin < SHARED_RING_SPINS)
+    {
+      continue;
+    }
+
+    uint32_t expected = ATOMIC_LOAD_ACQUIRE(signal);
+    ATOMIC_STORE_RELEASE(waiting, 1);
+    ATOMIC_FENCE();
+    int woken = PLATFORM_SUCCESS;
+    if (ATOMIC_LOAD_ACQUIRE(position) == seen && !ATOMIC_LOAD_ACQUIRE(&ring->closed))
+    {
+      woken = waitAddress(signal, expected, SHARED_RING_CHECK_INTERVAL_MS);
+    }
+    ATOMIC_STORE_RELEASE(waiting, 0);
+
+    // Nothing is ever sent on the socket after the handshake, so it only turns readable once the peer closed it.
+    if (woken == 0 && pollReadable(link->socket, 0) != 0)
+    {
+      closeSharedLink(link);
+      return PLATFORM_CONNECTION_CLOSED;
+    }
+  }
+}
+
+static int readRing(SharedLink *link, uint8_t *bytes, size_t length, uint64_t *startedAt)
+{
+  SharedRing *ring = link->receive;
+  const uint8_t *data = (const uint8_t *)(ring + 1);
+  size_t done = 0;
+
+  while (done < length)
+  {
+    uint64_t tail = ring->tail;
+    uint64_t head = ATOMIC_LOAD_ACQUIRE(&ring->head);
+    if (head == tail)
+    {
+      int result = waitForChange(link, ring, &ring->head, tail, &ring->dataSignal, &ring->readerWaiting);
+      if (result != PLATFORM_SUCCESS)
+      {
+        return result;
+      }
+      continue;
+    }
+
+    // A head further ahead than the ring holds can only come from a corrupted segment.
+    if (head - tail > link->capacity)
+    {
+      closeSharedLink(link);
+      return PLATFORM_CONNECTION_CLOSED;
+    }
+    if (startedAt && done == 0)
+    {
+      *startedAt = monotonicMicroseconds();
+    }
+
+    size_t chunk = head - tail < length - done ? (size_t)(head - tail) : length - done;
+    size_t offset = (size_t)(tail & (link->capacity - 1));
+    size_t first = chunk < link->capacity - offset ? chunk : link->capacity - offset;
+    memcpy(bytes + done, data + offset, first);
+    memcpy(bytes + done + first, data, chunk - first);
+    done += chunk;
+
+    ATOMIC_STORE_RELEASE(&ring->tail, tail + chunk);
+    signalPeer(&ring->spaceSignal, &ring->writerWaiting);
+  }
+  return PLATFORM_SUCCESS;
+}
+
+static size_t copyIn(SharedLink *link, const uint8_t *bytes, size_t length)
+{
+  SharedRing *ring = link->send;
+  uint8_t *data = (uint8_t *)(ring + 1);
+  uint64_t head = ring->head;
+  uint64_t used = head - ATOMIC_LOAD_ACQUIRE(&ring->tail);
+  if (used >= link->capacity)
+  {
+    return 0;
+  }
+
+  size_t room = link->capacity - (size_t)used;
+  size_t chunk = length < room ? length : room;
+  size_t offset = (size_t)(head & (link->capacity - 1));
+  size_t first = chunk < link->capacity - offset ? chunk : link->capacity - offset;
+  memcpy(data + offset, bytes, first);
+  memcpy(data, bytes + first, chunk - first);
+
+  ATOMIC_STORE_RELEASE(&ring->head, head + chunk);
+  signalPeer(&ring->dataSignal, &ring->readerWaiting);
+  return chunk;
+}
+
+int writeSharedLink(SharedLink *link, const uint8_t *bytes, size_t length)
+{
+  SharedRing *ring = link->send;
+  size_t done = 0;
+
+  while (done < length)
+  {
+    if (ATOMIC_LOAD_ACQUIRE(&ring->closed))
+    {
+      return PLATFORM_FAILURE;
+    }
+
+    uint64_t tail = ATOMIC_LOAD_ACQUIRE(&ring->tail);
+    size_t copied = copyIn(link, bytes + done, length - done);
+    if (copied == 0 && waitForChange(link, ring, &ring->tail, tail, &ring->spaceSignal, &ring->writerWaiting) != PLATFORM_SUCCESS)
+    {
+      return PLATFORM_FAILURE;
+    }
+    done += copied;
+  }
+  return PLATFORM_SUCCESS;
+}
+
+int writeSharedLinkSome(SharedLink *link, const uint8_t *bytes, size_t length)
+{
+  if (ATOMIC_LOAD_ACQUIRE(&link->send->closed))
+  {
+    return PLATFORM_FAILURE;
+  }
+  return (int)copyIn(link, bytes, length);
+}
+
+// Reads the next frame into link->frame, followed by a terminating zero so string payloads can be used in place.
+static int readFrame(SharedLink *link, size_t *frameLength, uint64_t *startedAt)
+{
+  ByteBuffer *frame = &link->frame;
+  uint8_t header[FRAME_HEADER_SIZE];
+  int result = readRing(link, header, FRAME_HEADER_SIZE, startedAt);
+  if (result != PLATFORM_SUCCESS)
+  {
+    return result;
+  }
+
+  uint32_t size;
+  memcpy(&size, header + 1, sizeof(uint32_t));
+  *frameLength = FRAME_HEADER_SIZE + (size_t)ntohl(size);
+
+  // Without room for the payload the stream cannot be resynchronized, so the connection ends.
+  if (reservePayload(frame, *frameLength) != PLATFORM_SUCCESS)
+  {
+    closeSharedLink(link);
+    return PLATFORM_CONNECTION_CLOSED;
+  }
+
+  memcpy(frame->bytes, header, FRAME_HEADER_SIZE);
+  return readRing(link, frame->bytes + FRAME_HEADER_SIZE, *frameLength - FRAME_HEADER_SIZE, NULL);
+}
+
+int recvSharedFrame(SharedLink *link, Data *data, size_t *frameLength, uint64_t *startedAt)
+{
+  int result = readFrame(link, frameLength, startedAt);
+  if (result != PLATFORM_SUCCESS)
+  {
+    return result;
+  }
+  return decodeFrame(link->frame.bytes, link->frame.length, data);
+}
+
+int recvSharedView(SharedLink *link, Data *data, size_t *frameLength, uint64_t *startedAt)
+{
+  int result = readFrame(link, frameLength, startedAt);
+  if (result != PLATFORM_SUCCESS)
+  {
+    return result;
+  }
+
+  NetworkedType type = (NetworkedType)link->frame.bytes[0];
+  if (type != TYPE_STRING && type != TYPE_JSON)
+  {
+    return decodeFrame(link->frame.bytes, link->frame.length, data);
+  }
+  data->type = type;
+  data->data.raw.bytes = link->frame.bytes + FRAME_HEADER_SIZE;
+  data->data.raw.size = (uint32_t)(link->frame.length - FRAME_HEADER_SIZE);
+  return PLATFORM_SUCCESS;
+}
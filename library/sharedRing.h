@@ -0,0 +1,73 @@
+#ifndef SHARED_RING_H
+#define SHARED_RING_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include "serialization.h"
+
+// Bytes in each direction of a shared memory connection, a power of two.
+#define SHARED_RING_CAPACITY (1024 * 1024)
+#define SHARED_RING_MAX_CAPACITY (1024 * 1024 * 1024)
+// Checks of the ring before a side with nothing to do goes to sleep, enough to catch a peer in the middle of a write.
+#define SHARED_RING_SPINS 128
+// A sleeping side wakes up this often to check the socket for a peer that went away without closing the ring.
+#define SHARED_RING_CHECK_INTERVAL_MS 50
+// How long a client waits for the server to hand over the segment after connecting.
+#define SHARED_HANDSHAKE_TIMEOUT_MS 5000
+
+  // One direction of a connection, followed in the segment by its bytes. head is only written by the producer and tail
+  // by the consumer, each on its own cache line. A side raises its waiting flag before it sleeps on a signal, so the
+  // other side only makes the wake up system call while someone actually sleeps.
+  typedef struct
+  {
+    uint64_t head;
+    uint8_t headPad[56];
+    uint64_t tail;
+    uint8_t tailPad[56];
+    uint32_t dataSignal;
+    uint32_t spaceSignal;
+    uint64_t readerWaiting;
+    uint64_t writerWaiting;
+    uint64_t closed;
+    uint8_t signalPad[32];
+  } SharedRing;
+
+  // The mapping of one connection in this process. The outbound queue is the only producer and the receive thread the
+  // only consumer, so neither direction needs a lock. capacity is kept here rather than read from the segment, which
+  // the other process can write.
+  typedef struct
+  {
+    socket_t socket;
+    uint8_t *memory;
+    size_t size;
+    size_t capacity;
+    SharedRing *send;
+    SharedRing *receive;
+    ByteBuffer frame;
+  } SharedLink;
+
+  // Creates the segment of a connection the server accepted and hands it to the client over the local socket.
+  SharedLink *offerSharedLink(socket_t socket);
+  // Waits for the segment the server hands over. Fails when the server turned the connection away instead.
+  SharedLink *acceptSharedLink(socket_t socket, int timeoutMs);
+  // Marks both directions closed and wakes up whoever sleeps on them. Data already in a ring is still delivered.
+  void closeSharedLink(SharedLink *link);
+  void destroySharedLink(SharedLink *link);
+
+  // Blocks while the ring is full.
+  int writeSharedLink(SharedLink *link, const uint8_t *bytes, size_t length);
+  // Writes what fits without blocking and returns how much that was.
+  int writeSharedLinkSome(SharedLink *link, const uint8_t *bytes, size_t length);
+  // The recvAnyFrame() of a shared memory connection. Returns PLATFORM_CONNECTION_CLOSED once the link is closed and
+  // drained, or the peer is gone.
+  int recvSharedFrame(SharedLink *link, Data *data, size_t *frameLength, uint64_t *startedAt);
+  // The recvFrameView() of a shared memory connection. Strings and JSON are left in link->frame, after the header.
+  int recvSharedView(SharedLink *link, Data *data, size_t *frameLength, uint64_t *startedAt);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,242 @@
+#include "timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TIMER_NONE UINT32_MAX
+#define TIMER_INITIAL_CAPACITY 64
+#define TIMER_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+TimerWheel *createTimerWheel(uint64_t now)
+{
+  TimerWheel *wheel = (TimerWheel *)calloc(1, sizeof(TimerWheel));
+  if (wheel == NULL)
+  {
+    return NULL;
+  }
+
+  if (pthread_mutex_init(&wheel->lock, NULL) != 0)
+  {
+    free(wheel);
+    return NULL;
+  }
+
+  for (int i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++)
+  {
+    wheel->heads[i] = TIMER_NONE;
+  }
+  wheel->freeList = TIMER_NONE;
+  wheel->tick = now / TIMER_TICK_MS;
+  return wheel;
+}
+
+void destroyTimerWheel(TimerWheel *wheel)
+{
+  if (wheel == NULL)
+  {
+    return;
+  }
+
+  free(wheel->nodes);
+  pthread_mutex_destroy(&wheel->lock);
+  free(wheel);
+}
+
+static int growNodes(TimerWheel *wheel)
+{
+  uint32_t capacity = wheel->capacity ? wheel->capacity * 2 : TIMER_INITIAL_CAPACITY;
+  TimerNode *nodes = (TimerNode *)realloc(wheel->nodes, capacity * sizeof(TimerNode));
+  if (nodes == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  memset(nodes + wheel->capacity, 0, (capacity - wheel->capacity) * sizeof(TimerNode));
+  for (uint32_t i = capacity; i > wheel->capacity; i--)
+  {
+    nodes[i - 1].next = wheel->freeList;
+    wheel->freeList = i - 1;
+  }
+  wheel->nodes = nodes;
+  wheel->capacity = capacity;
+  return PLATFORM_SUCCESS;
+}
+
+// Files a node under the level whose span covers its distance from the current tick.
+static void placeNode(TimerWheel *wheel, uint32_t index)
+{
+  TimerNode *node = &wheel->nodes[index];
+  uint64_t expires = node->expires;
+  uint64_t furthest = wheel->tick + ((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+  if (expires > furthest)
+  {
+    expires = furthest;
+  }
+
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && expires - wheel->tick >= (uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1)))
+  {
+    level++;
+  }
+
+  uint32_t list = level * TIMER_WHEEL_SLOTS + (uint32_t)((expires >> (TIMER_WHEEL_BITS * level)) & TIMER_SLOT_MASK);
+  node->list = list;
+  node->prev = TIMER_NONE;
+  node->next = wheel->heads[list];
+  if (node->next != TIMER_NONE)
+  {
+    wheel->nodes[node->next].prev = index;
+  }
+  wheel->heads[list] = index;
+}
+
+static void unlinkNode(TimerWheel *wheel, uint32_t index)
+{
+  TimerNode *node = &wheel->nodes[index];
+  if (node->prev != TIMER_NONE)
+  {
+    wheel->nodes[node->prev].next = node->next;
+  }
+  else
+  {
+    wheel->heads[node->list] = node->next;
+  }
+  if (node->next != TIMER_NONE)
+  {
+    wheel->nodes[node->next].prev = node->prev;
+  }
+}
+
+static void freeNode(TimerWheel *wheel, uint32_t index)
+{
+  TimerNode *node = &wheel->nodes[index];
+  node->armed = false;
+  node->generation++;
+  node->next = wheel->freeList;
+  wheel->freeList = index;
+  wheel->count--;
+}
+
+int addTimer(TimerWheel *wheel, uint64_t deadline, TimerKind kind, void *owner, uint32_t value, TimerId *id)
+{
+  if (wheel == NULL)
+  {
+    return PLATFORM_FAILURE;
+  }
+
+  pthread_mutex_lock(&wheel->lock);
+
+  if (wheel->freeList == TIMER_NONE && growNodes(wheel) == PLATFORM_FAILURE)
+  {
+    pthread_mutex_unlock(&wheel->lock);
+    return PLATFORM_FAILURE;
+  }
+
+  uint32_t index = wheel->freeList;
+  TimerNode *node = &wheel->nodes[index];
+  wheel->freeList = node->next;
+  wheel->count++;
+
+  // Generation 0 never appears in a handle, so a zeroed TimerId never matches.
+  if (node->generation == 0)
+  {
+    node->generation = 1;
+  }
+  uint64_t expires = (deadline + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+  node->expires = expires > wheel->tick ? expires : wheel->tick + 1;
+  node->armed = true;
+  node->event.kind = kind;
+  node->event.owner = owner;
+  node->event.value = value;
+  placeNode(wheel, index);
+
+  *id = ((uint64_t)node->generation << 32) | index;
+  pthread_mutex_unlock(&wheel->lock);
+  return PLATFORM_SUCCESS;
+}
+
+void cancelTimer(TimerWheel *wheel, TimerId id)
+{
+  if (wheel == NULL || id == 0)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&wheel->lock);
+  uint32_t index = (uint32_t)id;
+  if (index < wheel->capacity && wheel->nodes[index].armed && wheel->nodes[index].generation == (uint32_t)(id >> 32))
+  {
+    unlinkNode(wheel, index);
+    freeNode(wheel, index);
+  }
+  pthread_mutex_unlock(&wheel->lock);
+}
+
+// Moves every node of a higher level slot down to where its remaining distance belongs.
+static void cascade(TimerWheel *wheel, int level)
+{
+  uint32_t list = level * TIMER_WHEEL_SLOTS + (uint32_t)((wheel->tick >> (TIMER_WHEEL_BITS * level)) & TIMER_SLOT_MASK);
+  uint32_t index = wheel->heads[list];
+  wheel->heads[list] = TIMER_NONE;
+
+  while (index != TIMER_NONE)
+  {
+    uint32_t next = wheel->nodes[index].next;
+    placeNode(wheel, index);
+    index = next;
+  }
+}
+
+int advanceTimers(TimerWheel *wheel, uint64_t now, ByteBuffer *expired)
+{
+  if (wheel == NULL)
+  {
+    return PLATFORM_SUCCESS;
+  }
+
+  int result = PLATFORM_SUCCESS;
+  pthread_mutex_lock(&wheel->lock);
+
+  uint64_t target = now / TIMER_TICK_MS;
+  while (wheel->tick < target && result == PLATFORM_SUCCESS)
+  {
+    if (wheel->count == 0)
+    {
+      wheel->tick = target;
+      break;
+    }
+
+    wheel->tick++;
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+    {
+      if ((wheel->tick & (((uint64_t)1 << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+      {
+        break;
+      }
+      cascade(wheel, level);
+    }
+
+    uint32_t list = (uint32_t)(wheel->tick & TIMER_SLOT_MASK);
+    uint32_t index = wheel->heads[list];
+    while (index != TIMER_NONE && result == PLATFORM_SUCCESS)
+    {
+      TimerNode *node = &wheel->nodes[index];
+      uint32_t next = node->next;
+
+      // A timer clamped to the last slot may come around before it is due.
+      if (node->expires > wheel->tick)
+      {
+        unlinkNode(wheel, index);
+        placeNode(wheel, index);
+      }
+      else if ((result = byteBufferAppend(expired, &node->event, sizeof(TimerEvent))) == PLATFORM_SUCCESS)
+      {
+        unlinkNode(wheel, index);
+        freeNode(wheel, index);
+      }
+      index = next;
+    }
+  }
+
+  pthread_mutex_unlock(&wheel->lock);
+  return result;
+}
@@ -0,0 +1,72 @@
+#ifndef TIMER_H
+#define TIMER_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "serialization.h"
+
+// Resolution of the wheel. Deadlines are rounded up to the next tick.
+#define TIMER_TICK_MS 10
+// Four levels of 256 slots cover about 16 million ticks. Anything further out waits in the last slot and is
+// placed again when it comes around.
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+  typedef enum
+  {
+    TIMER_REQUEST_DEADLINE,
+    TIMER_HEARTBEAT,
+    TIMER_IDLE
+  } TimerKind;
+
+  // Handle of an armed timer, 0 for none. It carries a generation, so cancelling a timer that already fired is harmless.
+  typedef uint64_t TimerId;
+
+  typedef struct
+  {
+    TimerKind kind;
+    void *owner;
+    uint32_t value;
+  } TimerEvent;
+
+  typedef struct
+  {
+    uint64_t expires;
+    uint32_t next;
+    uint32_t prev;
+    uint32_t list;
+    uint32_t generation;
+    bool armed;
+    TimerEvent event;
+  } TimerNode;
+
+  // Hierarchical hashed timing wheel. Adding and cancelling are O(1), and advancing costs one slot per tick plus the
+  // timers that fire or move down a level.
+  typedef struct
+  {
+    uint32_t heads[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+    TimerNode *nodes;
+    uint32_t capacity;
+    uint32_t freeList;
+    uint32_t count;
+    uint64_t tick;
+    pthread_mutex_t lock;
+  } TimerWheel;
+
+  TimerWheel *createTimerWheel(uint64_t now);
+  void destroyTimerWheel(TimerWheel *wheel);
+
+  int addTimer(TimerWheel *wheel, uint64_t deadline, TimerKind kind, void *owner, uint32_t value, TimerId *id);
+  void cancelTimer(TimerWheel *wheel, TimerId id);
+  // Appends a TimerEvent to expired for every timer due by now. Fired timers are disarmed.
+  int advanceTimers(TimerWheel *wheel, uint64_t now, ByteBuffer *expired);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,202 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAX_EVENTS (1 << 20)
+
+static uint64_t nextTraceId = 0;
+static uint64_t nextThread = 0;
+
+// The ring this thread records into, valid while cachedTrace matches the id of the trace.
+static THREAD_LOCAL uint64_t cachedTrace = 0;
+static THREAD_LOCAL TraceRing *cachedRing = NULL;
+static THREAD_LOCAL uint32_t currentThread = 0;
+
+int initTrace(Trace *trace)
+{
+  memset(trace, 0, sizeof(Trace));
+  return pthread_mutex_init(&trace->lock, NULL) == 0 ? PLATFORM_SUCCESS : PLATFORM_FAILURE;
+}
+
+static uint32_t ringCapacity(int requested)
+{
+  if (requested <= 0)
+  {
+    return TRACE_DEFAULT_EVENTS;
+  }
+
+  uint32_t capacity = 1;
+  while (capacity < (uint32_t)requested && capacity < TRACE_MAX_EVENTS)
+  {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+// Copies what the rings gained since the last flush and passes it on. Called with trace->lock held.
+static void drainRings(Trace *trace)
+{
+  ByteBuffer events = {0};
+
+  for (TraceRing *ring = trace->rings; ring; ring = ring->next)
+  {
+    uint64_t head = ATOMIC_LOAD_ACQUIRE(&ring->head);
+    uint64_t start = head - ring->tail > ring->capacity ? head - ring->capacity : ring->tail;
+
+    for (uint64_t position = start; position < head; position++)
+    {
+      TraceSlot *slot = &ring->slots[position & (ring->capacity - 1)];
+      uint64_t sequence = ATOMIC_LOAD_ACQUIRE(&slot->sequence);
+      if (sequence != position + 1)
+      {
+        continue;
+      }
+
+      TraceEvent event = slot->event;
+      ATOMIC_FENCE();
+      if (ATOMIC_LOAD(&slot->sequence) == sequence)
+      {
+        byteBufferAppend(&events, &event, sizeof(TraceEvent));
+      }
+    }
+    ring->tail = head;
+  }
+
+  size_t count = events.length / sizeof(TraceEvent);
+  if (count > 0 && trace->sink)
+  {
+    trace->sink((const TraceEvent *)events.bytes, count, trace->userData);
+  }
+  byteBufferFree(&events);
+}
+
+void configureTrace(Trace *trace, const TraceOptions *options)
+{
+  pthread_mutex_lock(&trace->lock);
+
+  if (trace->enabled && !options->enabled)
+  {
+    trace->enabled = false;
+    drainRings(trace);
+  }
+
+  trace->eventsPerThread = ringCapacity(options->eventsPerThread);
+  trace->sink = options->sink;
+  trace->userData = options->userData;
+  if (options->enabled)
+  {
+    if (trace->id == 0)
+    {
+      trace->id = ATOMIC_ADD(&nextTraceId, 1) + 1;
+    }
+    trace->enabled = true;
+  }
+
+  pthread_mutex_unlock(&trace->lock);
+}
+
+void clearTrace(Trace *trace)
+{
+  pthread_mutex_lock(&trace->lock);
+
+  trace->enabled = false;
+  drainRings(trace);
+
+  TraceRing *ring = trace->rings;
+  while (ring)
+  {
+    TraceRing *next = ring->next;
+    free(ring->slots);
+    free(ring);
+    ring = next;
+  }
+  trace->rings = NULL;
+  trace->id = 0;
+
+  pthread_mutex_unlock(&trace->lock);
+}
+
+void flushTraceRings(Trace *trace)
+{
+  pthread_mutex_lock(&trace->lock);
+  drainRings(trace);
+  pthread_mutex_unlock(&trace->lock);
+}
+
+// Finds or creates the ring of this thread. Only the first event of a thread, or one after it switched contexts,
+// takes the lock.
+static TraceRing *threadRing(Trace *trace)
+{
+  uint64_t id = trace->id;
+  if (cachedTrace == id && cachedRing)
+  {
+    return cachedRing;
+  }
+
+  if (currentThread == 0)
+  {
+    currentThread = (uint32_t)(ATOMIC_ADD(&nextThread, 1) + 1);
+  }
+
+  pthread_mutex_lock(&trace->lock);
+
+  TraceRing *ring = trace->rings;
+  while (ring && ring->thread != currentThread)
+  {
+    ring = ring->next;
+  }
+
+  if (ring == NULL && trace->id == id && id != 0)
+  {
+    ring = (TraceRing *)calloc(1, sizeof(TraceRing));
+    TraceSlot *slots = ring ? (TraceSlot *)calloc(trace->eventsPerThread, sizeof(TraceSlot)) : NULL;
+    if (slots == NULL)
+    {
+      free(ring);
+      pthread_mutex_unlock(&trace->lock);
+      return NULL;
+    }
+
+    ring->thread = currentThread;
+    ring->capacity = trace->eventsPerThread;
+    ring->slots = slots;
+    ring->next = trace->rings;
+    trace->rings = ring;
+  }
+
+  pthread_mutex_unlock(&trace->lock);
+
+  cachedTrace = id;
+  cachedRing = ring;
+  return ring;
+}
+
+void traceEvent(Trace *trace, TraceStage stage, uint64_t start, uint64_t end, int64_t connection, NetworkedType type, size_t bytes)
+{
+  if (!trace->enabled)
+  {
+    return;
+  }
+
+  TraceRing *ring = threadRing(trace);
+  if (ring == NULL)
+  {
+    return;
+  }
+
+  uint64_t head = ring->head;
+  TraceSlot *slot = &ring->slots[head & (ring->capacity - 1)];
+  ATOMIC_STORE_RELEASE(&slot->sequence, 0);
+  ATOMIC_FENCE();
+
+  slot->event.stage = stage;
+  slot->event.thread = ring->thread;
+  slot->event.startMicroseconds = start;
+  slot->event.durationMicroseconds = end > start ? end - start : 0;
+  slot->event.connection = connection;
+  slot->event.type = type;
+  slot->event.bytes = bytes > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes;
+
+  ATOMIC_STORE_RELEASE(&slot->sequence, head + 1);
+  ATOMIC_STORE_RELEASE(&ring->head, head + 1);
+}
@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "nex.h"
+
+#define TRACE_DEFAULT_EVENTS 4096
+
+  // sequence is 0 while the owning thread rewrites the slot, and the position of the event plus one once it is done,
+  // so a reader racing with a wrap around can tell that it copied a torn event.
+  typedef struct
+  {
+    uint64_t sequence;
+    TraceEvent event;
+  } TraceSlot;
+
+  // Written by one thread only. head counts every event ever recorded, tail how far the last flush read.
+  typedef struct TraceRing
+  {
+    uint32_t thread;
+    uint32_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    TraceSlot *slots;
+    struct TraceRing *next;
+  } TraceRing;
+
+  typedef struct
+  {
+    volatile bool enabled;
+    // Identifies one lifetime of the rings, so threads can cache theirs without holding on to freed ones.
+    uint64_t id;
+    uint32_t eventsPerThread;
+    void (*sink)(const TraceEvent *events, size_t count, void *userData);
+    void *userData;
+    TraceRing *rings;
+    pthread_mutex_t lock;
+  } Trace;
+
+  int initTrace(Trace *trace);
+  // Applies new options. Turning tracing off flushes the rings to the old sink.
+  void configureTrace(Trace *trace, const TraceOptions *options);
+  // Flushes and frees the rings. Every thread that records must be done.
+  void clearTrace(Trace *trace);
+
+  void traceEvent(Trace *trace, TraceStage stage, uint64_t start, uint64_t end, int64_t connection, NetworkedType type, size_t bytes);
+  void flushTraceRings(Trace *trace);
+
+#ifdef __cplusplus
+}
+#endif
+#endif